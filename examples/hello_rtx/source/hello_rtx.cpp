@@ -116,45 +116,14 @@ public:
 		cgb::copy(stagingBuffer, mIndexBuffer);
 	}
 
-	static void load_model(std::string inPath, std::unique_ptr<cgb::Model>& outModel, cgb::vertex_buffer& outVertexBuffer, cgb::index_buffer& outIndexBuffer, int mesh_index)
+	static void load_model(std::string inPath, std::shared_ptr<cgb::Model>& outModel, std::shared_ptr<cgb::mesh_buffers>& outBuffers, int mesh_index)
 	{
-		outModel = cgb::Model::LoadFromFile(inPath, glm::mat4(1.0f));
-		auto& mesh = outModel->mesh_at(mesh_index);
-		
-		{
-			auto stagingBuffer = cgb::buffer::create(
-				mesh.m_vertex_data.size(),
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-
-			// Filling the staging buffer!
-			//   This is done by mapping the buffer memory into CPU accessible memory with vkMapMemory. [2]
-			stagingBuffer.fill_host_coherent_memory(mesh.m_vertex_data.data());
-
-			outVertexBuffer = cgb::vertex_buffer::create(
-				mesh.m_size_one_vertex, mesh.m_vertex_data.size() / mesh.m_size_one_vertex,
-				vk::BufferUsageFlagBits::eTransferDst,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-			// Transfer the data from the staging buffer into the vertex buffer
-			cgb::copy(stagingBuffer, outVertexBuffer);
-		}
-
-		{
-			auto stagingBuffer = cgb::buffer::create(
-				sizeof(mesh.m_indices[0]) * mesh.m_indices.size(),
-				vk::BufferUsageFlagBits::eTransferSrc,
-				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-
-			stagingBuffer.fill_host_coherent_memory(mesh.m_indices.data());
-
-			outIndexBuffer = cgb::index_buffer::create(
-				vk::IndexType::eUint32, mesh.m_indices.size(),
-				vk::BufferUsageFlagBits::eTransferDst,
-				vk::MemoryPropertyFlagBits::eDeviceLocal);
-
-			cgb::copy(stagingBuffer, outIndexBuffer);
+		// Models and their buffers are shared with every other user of the same file or geometry
+		outModel = cgb::model_registry::instance().load(inPath);
+		if (!outModel) {
+			throw std::runtime_error("failed to load " + inPath);
 		}
+		outBuffers = cgb::get_or_create_mesh_buffers(outModel->mesh_at(mesh_index));
 	}
 
 	void create_uniform_buffers()
@@ -295,29 +264,13 @@ public:
 
 	void create_texture_image()
 	{
-		int width, height, channels;
-		stbi_set_flip_vertically_on_load(true);
-		stbi_uc* pixels = stbi_load("assets/chalet.jpg", &width, &height, &channels, STBI_rgb_alpha);
-		size_t imageSize = width * height * 4;
-
-		if (!pixels) {
-			throw std::runtime_error("Couldnt load image using stbi_load");
-		}
-
-		auto stagingBuffer = cgb::buffer::create(
-			imageSize,
-			vk::BufferUsageFlagBits::eTransferSrc,
-			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		// Copy texture into staging buffer
-		stagingBuffer.fill_host_coherent_memory(pixels);
-
-		stbi_image_free(pixels);
-
-		auto img = cgb::image::create2D(width, height);
-		cgb::transition_image_layout(img, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal);
-		cgb::copy_buffer_to_image(stagingBuffer, img);
-		cgb::transition_image_layout(img, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
-		mImage = std::make_shared<cgb::image>(std::move(img));
+		// Decode and generate the mip chain on the CPU, processed textures are cached on disk
+		cgb::texture_settings settings;
+		settings.mSrgb = false;
+		settings.mFlipVertically = true;
+		settings.mCacheDirectory = "cache/textures";
+		auto texture = cgb::load_texture("assets/chalet.jpg", settings);
+		mImage = std::make_shared<cgb::image>(cgb::create_texture_image(texture));
 	}
 
 	void create_depth_buffer()
@@ -349,15 +302,15 @@ public:
 			.setGeometryType(vk::GeometryTypeNV::eTriangles)
 			.setGeometry(vk::GeometryDataNV()
 						 .setTriangles(vk::GeometryTrianglesNV()
-									   .setVertexData(mModelVertices.mBuffer)
+									   .setVertexData(mModelPositions.mBuffer)
 									   .setVertexOffset(0)
-									   .setVertexCount(mModelVertices.mVertexCount)
-									   .setVertexStride(mModelVertices.mSize / mModelVertices.mVertexCount)
+									   .setVertexCount(mModelPositions.mVertexCount)
+									   .setVertexStride(sizeof(glm::vec3))
 									   .setVertexFormat(vk::Format::eR32G32B32Sfloat)
-									   .setIndexData(mModelIndices.mBuffer)
+									   .setIndexData(mModelBuffers->mIndexBuffer.mBuffer)
 									   .setIndexOffset(0)
-									   .setIndexCount(mModelIndices.mIndexCount)
-									   .setIndexType(mModelIndices.mIndexType)
+									   .setIndexCount(mModelBuffers->mIndexBuffer.mIndexCount)
+									   .setIndexType(mModelBuffers->mIndexBuffer.mIndexType)
 									   .setTransformData(nullptr)
 									   .setTransformOffset(0)))
 			.setFlags(vk::GeometryFlagBitsNV::eOpaque); 
@@ -366,15 +319,15 @@ public:
 		//	.setGeometryType(vk::GeometryTypeNV::eTriangles)
 		//	.setGeometry(vk::GeometryDataNV()
 		//				 .setTriangles(vk::GeometryTrianglesNV()
-		//							   .setVertexData(mSphereVertices.mBuffer)
+		//							   .setVertexData(mSphereBuffers->mVertexBuffer.mBuffer)
 		//							   .setVertexOffset(0)
-		//							   .setVertexCount(mSphereVertices.mVertexCount)
-		//							   .setVertexStride(mSphereVertices.mSize / mSphereVertices.mVertexCount)
+		//							   .setVertexCount(mSphereBuffers->mVertexBuffer.mVertexCount)
+		//							   .setVertexStride(mSphereBuffers->mVertexBuffer.mSize / mSphereBuffers->mVertexBuffer.mVertexCount)
 		//							   .setVertexFormat(vk::Format::eR32G32B32Sfloat)
-		//							   .setIndexData(mSphereIndices.mBuffer)
+		//							   .setIndexData(mSphereBuffers->mIndexBuffer.mBuffer)
 		//							   .setIndexOffset(0)
-		//							   .setIndexCount(mSphereIndices.mIndexCount)
-		//							   .setIndexType(mSphereIndices.mIndexType)
+		//							   .setIndexCount(mSphereBuffers->mIndexBuffer.mIndexCount)
+		//							   .setIndexType(mSphereBuffers->mIndexBuffer.mIndexType)
 		//							   .setTransformData(nullptr)
 		//							   .setTransformOffset(0)));
 	}
@@ -580,8 +533,13 @@ public:
 		create_vertex_buffer();
 		create_index_buffer();
 
-		load_model("assets/sponza_structure.obj", mModel, mModelVertices, mModelIndices, 2);
-		load_model("assets/sphere.obj", mSphere, mSphereVertices, mSphereIndices, 0);
+		load_model("assets/sponza_structure.obj", mModel, mModelBuffers, 2);
+		// The BLAS only needs positions, build it from a tightly packed position stream
+		mModelPositions = cgb::create_position_vertex_buffer(mModel->mesh_at(2));
+		load_model("assets/sphere.obj", mSphere, mSphereBuffers, 0);
+		const auto registryStats = cgb::model_registry::instance().statistics();
+		LOG_INFO(fmt::format("model registry: {} of {} geometry requests shared, {} bytes not uploaded again",
+			registryStats.mGeometryHits, registryStats.mGeometryRequests, registryStats.mGeometryBytesSaved));
 		create_texture_image();
 		mImageView = cgb::image_view::create(mImage, vk::Format::eR8G8B8A8Unorm, vk::ImageAspectFlagBits::eColor);
 		mSampler = cgb::sampler::create();
@@ -655,7 +613,7 @@ public:
 			//cgb::context().draw_triangle(mPipeline, cmdbfr);
 			//cgb::context().draw_vertices(mPipeline, cmdbfr, mVertexBuffer);
 			//cgb::context().draw_indexed(mPipeline, cmdbfr, mVertexBuffer, mIndexBuffer);
-			cgb::context().draw_indexed(mPipeline, cmdbfr, mModelVertices, mModelIndices);
+			cgb::context().draw_indexed(mPipeline, cmdbfr, mModelBuffers->mVertexBuffer, mModelBuffers->mIndexBuffer);
 			cmdbfr.end_render_pass();
 
 			// TODO: image barriers instead of wait idle!!
@@ -781,13 +739,12 @@ public:
 private:
 	const std::vector<Vertex> mVertices;
 	const std::vector<uint16_t> mIndices;
-	std::unique_ptr<cgb::Model> mModel;
-	std::unique_ptr<cgb::Model> mSphere;
+	std::shared_ptr<cgb::Model> mModel;
+	std::shared_ptr<cgb::Model> mSphere;
 #ifdef USE_VULKAN_CONTEXT
-	cgb::vertex_buffer mModelVertices;
-	cgb::index_buffer mModelIndices;
-	cgb::vertex_buffer mSphereVertices;
-	cgb::index_buffer mSphereIndices;
+	std::shared_ptr<cgb::mesh_buffers> mModelBuffers;
+	cgb::vertex_buffer mModelPositions;
+	std::shared_ptr<cgb::mesh_buffers> mSphereBuffers;
 	cgb::vertex_buffer mVertexBuffer;
 	cgb::index_buffer mIndexBuffer;
 	std::vector<cgb::uniform_buffer> mUniformBuffers;
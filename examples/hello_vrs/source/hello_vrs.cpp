@@ -17,6 +17,7 @@
 #include "vulkan_resource_bundle_layout.h"
 #include "vulkan_resource_bundle_group.h"
 #include "vulkan_resource_bundle.h"
+#include "vulkan_render_graph.h"
 
 
 #include "eyetracking_interface.h"
@@ -68,7 +69,8 @@ private:
 	std::shared_ptr<cgb::vulkan_image_presenter> imagePresenter;
 	std::shared_ptr<cgb::vulkan_render_queue> mVulkanRenderQueue;
 	std::unique_ptr<cgb::vulkan_renderer> mRenderer;
-	std::shared_ptr<cgb::vulkan_renderer> mVrsRenderer;
+	// one graph per frame, each generates the frame's vrs image before the render pass which uses it
+	std::vector<std::unique_ptr<cgb::vulkan_render_graph>> mVrsRenderGraphs;
 	std::shared_ptr<cgb::vulkan_pipeline> mRenderVulkanPipeline;
 	std::shared_ptr<cgb::vulkan_pipeline> mComputeVulkanPipeline;
 	std::shared_ptr<cgb::vulkan_framebuffer> mVulkanFramebuffer;
@@ -143,12 +145,7 @@ private:
 		drawCommandBufferManager = std::make_shared<cgb::vulkan_command_buffer_manager>(imagePresenter->get_swap_chain_images_count(), commandPool, cgb::vulkan_context::instance().graphicsQueue);
 		mVulkanRenderQueue = std::make_shared<cgb::vulkan_render_queue>(cgb::vulkan_context::instance().graphicsQueue);
 
-		std::vector<std::shared_ptr<cgb::vulkan_renderer>> dependentRenderers = {};
-		if (cgb::vulkan_context::instance().shadingRateImageSupported) {
-			mVrsRenderer = std::make_shared<cgb::vulkan_renderer>(nullptr, mVulkanRenderQueue, drawCommandBufferManager, std::vector<std::shared_ptr<cgb::vulkan_renderer>>{}, true);
-			dependentRenderers.push_back(mVrsRenderer);
-		}
-		mRenderer = std::make_unique<cgb::vulkan_renderer>(imagePresenter, mVulkanRenderQueue, drawCommandBufferManager, dependentRenderers);
+		mRenderer = std::make_unique<cgb::vulkan_renderer>(imagePresenter, mVulkanRenderQueue, drawCommandBufferManager, std::vector<std::shared_ptr<cgb::vulkan_renderer>>{});
 
 		createColorResources();
 		createDepthResources();
@@ -218,6 +215,7 @@ private:
 			mVrsImageComputeDrawer->set_descriptor_sets(mVrsComputeDescriptorSets);
 			mVrsImageComputeDrawer->set_width_height(vrsImages[0]->get_width(), vrsImages[0]->get_height());
 			mVrsImageComputeDrawer->set_eye_inf(eyeInf);
+			createVrsRenderGraphs();
 		}
 
 		renderObject = new cgb::vulkan_render_object(imagePresenter->get_swap_chain_images_count(), verticesQuad, indicesQuad, mResourceBundleLayout, mResourceBundleGroup, texture, transferCommandBufferManager, vrsDebugTextureImages);
@@ -287,9 +285,7 @@ private:
 		mVulkanFramebuffer.reset();
 
 		imagePresenter.reset();
-		if (cgb::vulkan_context::instance().shadingRateImageSupported) {
-			mVrsRenderer.reset();
-		}
+		mVrsRenderGraphs.clear();
 		mRenderer.reset();
 	}
 
@@ -369,7 +365,7 @@ private:
 		cgb::vulkan_context::instance().vulkanFramebuffer = mVulkanFramebuffer;
 
 		if (cgb::vulkan_context::instance().shadingRateImageSupported) {
-			mVrsRenderer->render(std::vector<cgb::vulkan_render_object*>{}, mVrsImageComputeDrawer.get());
+			mRenderer->render(*mVrsRenderGraphs[cgb::vulkan_context::instance().currentFrame]);
 		}
 
 		std::vector<cgb::vulkan_render_object*> renderObjects;
@@ -386,7 +382,7 @@ private:
 	void createDescriptorSetLayout()
 	{
 		mResourceBundleLayout = std::make_shared<cgb::vulkan_resource_bundle_layout>();
-		mResourceBundleLayout->add_binding(0, vk::DescriptorType::eUniformBuffer, cgb::ShaderStageFlagBits::eVertex);
+		mResourceBundleLayout->add_binding(0, vk::DescriptorType::eUniformBufferDynamic, cgb::ShaderStageFlagBits::eVertex);
 		mResourceBundleLayout->add_binding(1, vk::DescriptorType::eCombinedImageSampler, cgb::ShaderStageFlagBits::eFragment);
 
 		if (cgb::vulkan_context::instance().shadingRateImageSupported) {
@@ -556,6 +552,32 @@ private:
 		}
 	}
 
+	void createVrsRenderGraphs()
+	{
+		for (size_t i = 0; i < cgb::vulkan_context::instance().dynamicRessourceCount; i++) {
+			auto graph = std::make_unique<cgb::vulkan_render_graph>();
+			// the render pass reads the vrs image as shading rate image and the debug image in the fragment shader
+			auto vrsImage = graph->import_image("vrs image", vrsImages[i], vk::ImageLayout::eShadingRateOptimalNV, vk::ImageLayout::eShadingRateOptimalNV);
+			auto vrsDebugImage = graph->import_image("vrs debug image", vrsDebugImages[i], vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eShaderReadOnlyOptimal);
+
+			auto vrsPass = graph->add_pass("vrs image compute", [this, i](vk::CommandBuffer commandBuffer) {
+				mVrsImageComputeDrawer->record_dispatch(commandBuffer, i);
+			});
+			graph->use(vrsPass, vrsImage, cgb::vulkan_render_graph::resource_usage::storage_write);
+			graph->use(vrsPass, vrsDebugImage, cgb::vulkan_render_graph::resource_usage::storage_write);
+			graph->compile();
+
+			// both images are transitioned to eGeneral before the dispatch and back afterwards, nothing is transient
+			if (graph->get_barrier_count() != 4 || graph->get_transient_memory_size() != 0) {
+				throw std::runtime_error("unexpected vrs render graph!");
+			}
+			LOG_INFO(fmt::format("vrs render graph {}: {} barriers in {} batches, {} bytes of transient memory", i,
+				graph->get_barrier_count(), graph->get_barrier_batch_count(), graph->get_transient_memory_size()));
+
+			mVrsRenderGraphs.push_back(std::move(graph));
+		}
+	}
+
 	void load_model(std::string inPath, glm::mat4 transform, const unsigned int model_loader_flags, std::unique_ptr<cgb::Model>& outModel)
 	{
 		outModel = cgb::Model::LoadFromFile(inPath, transform, model_loader_flags);
@@ -563,8 +585,9 @@ private:
 
 		auto outVertexBuffer = std::make_shared<cgb::vulkan_buffer>(sizeof(mesh.m_vertex_data[0]) * mesh.m_vertex_data.size(),
 			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, mesh.m_vertex_data.data());
-		auto outIndexBuffer = std::make_shared<cgb::vulkan_buffer>(sizeof(mesh.m_indices[0]) * mesh.m_indices.size(),
-			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, mesh.m_indices.data());
+		auto indexData = mesh.index_data();
+		auto outIndexBuffer = std::make_shared<cgb::vulkan_buffer>(indexData.size(),
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, indexData.data());
 
 		// TODO
 		// uniform buffer
@@ -595,7 +618,7 @@ private:
 		//	mResourceBundle->add_dynamic_image_resource(2, vk::ImageLayout::eShaderReadOnlyOptimal, debugTextures);
 		//}
 
-		mSponzaModel = std::make_shared<cgb::vulkan_render_object>(std::vector< std::shared_ptr<cgb::vulkan_buffer>>({outVertexBuffer}), outIndexBuffer, mesh.m_indices.size());
+		mSponzaModel = std::make_shared<cgb::vulkan_render_object>(std::vector< std::shared_ptr<cgb::vulkan_buffer>>({outVertexBuffer}), outIndexBuffer, mesh.m_indices.size(), cgb::index_type_for_size(mesh.index_size()));
 	}
 };
 
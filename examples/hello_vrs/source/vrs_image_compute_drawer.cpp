@@ -30,9 +30,6 @@ namespace cgb {
 
 		vk::CommandBuffer commandBuffer = mCommandBufferManager->get_command_buffer(vk::CommandBufferLevel::eSecondary, beginInfo);
 
-		// bind pipeline for this compute command
-		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline->get_pipeline());
-
 		vk::ImageMemoryBarrier imgMemBarrier = {};
 		imgMemBarrier.srcAccessMask = {};
 		imgMemBarrier.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
@@ -59,18 +56,7 @@ namespace cgb {
 		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eShadingRateImageNV, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, nullptr, imgMemBarrier);
 
 
-		std::vector<vk::DescriptorSet> descriptorSetsToBind = { mDescriptorSets[vulkan_context::instance().currentFrame], mVrsComputeDebugDescriptorSets[vulkan_context::instance().currentFrame] };
-		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPipeline->get_pipeline_layout(), 0, 2, descriptorSetsToBind.data(), 0, nullptr);
-
-		auto eyeData = mEyeInf->get_eyetracking_data();
-		auto data = vrs_eye_comp_data();
-		data.eyePoint = glm::vec2(eyeData.positionX, eyeData.positionY);
-		data.imgSize = glm::vec2(mWidth, mHeight);
-
-		auto arr = vk::ArrayProxy<const vrs_eye_comp_data>(data);
-		commandBuffer.pushConstants(mPipeline->get_pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, arr);
-
-		commandBuffer.dispatch(std::ceil(mWidth * 1.0 / WORKGROUP_SIZE), std::ceil(mHeight * 1.0 / WORKGROUP_SIZE), 1);
+		record_dispatch(commandBuffer, vulkan_context::instance().currentFrame);
 
 		imgMemBarrier = {};
 		imgMemBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
@@ -108,6 +94,25 @@ namespace cgb {
 		//}
 	}
 
+	void vrs_image_compute_drawer::record_dispatch(vk::CommandBuffer commandBuffer, size_t frame)
+	{
+		// bind pipeline for this compute command
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mPipeline->get_pipeline());
+
+		std::vector<vk::DescriptorSet> descriptorSetsToBind = { mDescriptorSets[frame], mVrsComputeDebugDescriptorSets[frame] };
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mPipeline->get_pipeline_layout(), 0, 2, descriptorSetsToBind.data(), 0, nullptr);
+
+		auto eyeData = mEyeInf->get_eyetracking_data();
+		auto data = vrs_eye_comp_data();
+		data.eyePoint = glm::vec2(eyeData.positionX, eyeData.positionY);
+		data.imgSize = glm::vec2(mWidth, mHeight);
+
+		auto arr = vk::ArrayProxy<const vrs_eye_comp_data>(data);
+		commandBuffer.pushConstants(mPipeline->get_pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, arr);
+
+		commandBuffer.dispatch(std::ceil(mWidth * 1.0 / WORKGROUP_SIZE), std::ceil(mHeight * 1.0 / WORKGROUP_SIZE), 1);
+	}
+
 	void vrs_image_compute_drawer::createVrsComputeDescriptorSetLayout() {
 		vk::DescriptorSetLayoutBinding storageImageLayoutBinding = {};
 		storageImageLayoutBinding.binding = 1;
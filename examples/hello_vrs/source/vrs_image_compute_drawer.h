@@ -19,6 +19,9 @@ namespace cgb {
 		virtual ~vrs_image_compute_drawer();
 
 		virtual void draw(std::vector<vulkan_render_object*> renderObjects);
+		// records the compute dispatch which writes the vrs image and the debug image of the frame, without any barriers,
+		// which are left to the caller, e.g. a render graph in which both images are storage writes
+		void record_dispatch(vk::CommandBuffer commandBuffer, size_t frame);
 
 		void set_descriptor_sets(std::vector<vk::DescriptorSet> descriptorSets) { mDescriptorSets = descriptorSets; }
 		void set_width_height(int width, int height) { mWidth = width; mHeight = height; }
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// the uniforms of a group's first render object are used for the whole group, only view and projection are shared
+layout(push_constant) uniform PushUniforms
+{
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	mat4 mvp;
+} pushConst;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+
+// per-instance data of vulkan_instanced_drawer, the model matrix takes locations 3 to 6
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in uvec2 instanceIds;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+void main() {
+    gl_Position = pushConst.proj * pushConst.view * instanceModel * vec4(inPosition, 1.0);
+    fragColor = inColor;
+    fragTexCoord = inTexCoord;
+}
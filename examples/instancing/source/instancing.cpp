@@ -0,0 +1,558 @@
+// instancing.cpp : Defines the entry point for the console application.
+//
+#include "cg_base.h"
+#include "vulkan_render_object.h"
+#include "vulkan_texture.h"
+#include "vulkan_command_buffer_manager.h"
+#include "vulkan_drawer.h"
+#include "vulkan_instanced_drawer.h"
+#include "vulkan_indirect_drawer.h"
+#include "vulkan_geometry_pool.h"
+#include "vulkan_image_presenter.h"
+#include "vulkan_render_queue.h"
+#include "vulkan_renderer.h"
+#include "vulkan_pipeline.h"
+#include "vulkan_framebuffer.h"
+#include "vulkan_resource_bundle_layout.h"
+#include "vulkan_resource_bundle_group.h"
+#include "vulkan_resource_bundle.h"
+
+// benchmark scene: a static grid of 100k props, which are copies of a few prototypes
+const uint32_t GRID_WIDTH = 500;
+const uint32_t GRID_DEPTH = 200;
+const float GRID_SPACING = 1.5f;
+
+// every prototype mesh is combined with every material
+const std::vector<std::string> TEXTURE_PATHS = { "assets/chalet.jpg", "assets/texture.jpg" };
+
+enum class draw_mode {
+	// one instanced draw per prototype
+	instanced,
+	// one draw per prop
+	single,
+	// one indirect draw for all props, whose geometry lies in one geometry pool
+	indirect,
+	// like indirect, but the props are culled on the gpu
+	indirect_gpu_culling
+};
+
+// a unit cube with four vertices per face, so that every face shows the whole texture
+std::vector<Vertex> create_cube_vertices()
+{
+	const glm::vec3 normals[] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	const glm::vec2 corners[] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	std::vector<Vertex> vertices;
+	for (const glm::vec3& normal : normals) {
+		const glm::vec3 tangent = glm::abs(normal.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+		const glm::vec3 bitangent = glm::cross(normal, tangent);
+		for (const glm::vec2& corner : corners) {
+			const glm::vec3 position = 0.5f * (normal + corner.x * tangent + corner.y * bitangent);
+			vertices.push_back({ position, 0.5f * normal + 0.5f, 0.5f * corner + 0.5f });
+		}
+	}
+	return vertices;
+}
+
+std::vector<uint32_t> create_cube_indices()
+{
+	std::vector<uint32_t> indices;
+	for (uint32_t face = 0; face < 6; face++) {
+		const uint32_t first = face * 4;
+		indices.insert(indices.end(), { first, first + 1, first + 2, first + 2, first + 3, first });
+	}
+	return indices;
+}
+
+class instancing_behavior : public cgb::cg_element
+{
+
+public:
+	instancing_behavior() {}
+private:
+
+	vk::CommandPool commandPool;
+	vk::CommandPool transferCommandPool;
+
+	std::vector<std::shared_ptr<cgb::vulkan_image>> textureImages;
+	std::vector<std::shared_ptr<cgb::vulkan_texture>> textures;
+	std::shared_ptr<cgb::vulkan_command_buffer_manager> drawCommandBufferManager;
+	std::shared_ptr<cgb::vulkan_command_buffer_manager> transferCommandBufferManager;
+	std::unique_ptr<cgb::vulkan_drawer> mDrawer;
+	std::unique_ptr<cgb::vulkan_instanced_drawer> mInstancedDrawer;
+	std::unique_ptr<cgb::vulkan_indirect_drawer> mIndirectDrawer;
+	std::unique_ptr<cgb::vulkan_indirect_drawer> mGpuCullingIndirectDrawer;
+
+	// render target needed for MSAA
+	std::shared_ptr<cgb::vulkan_image> colorImage;
+	std::shared_ptr<cgb::vulkan_image> depthImage;
+	std::shared_ptr<cgb::vulkan_image_presenter> imagePresenter;
+	std::shared_ptr<cgb::vulkan_render_queue> mVulkanRenderQueue;
+	std::unique_ptr<cgb::vulkan_renderer> mRenderer;
+	std::shared_ptr<cgb::vulkan_pipeline> mRenderVulkanPipeline;
+	std::shared_ptr<cgb::vulkan_pipeline> mInstancedVulkanPipeline;
+	std::shared_ptr<cgb::vulkan_pipeline> mIndirectVulkanPipeline;
+	std::shared_ptr<cgb::vulkan_framebuffer> mVulkanFramebuffer;
+	std::shared_ptr<cgb::vulkan_resource_bundle_layout> mResourceBundleLayout;
+	std::shared_ptr<cgb::vulkan_resource_bundle_layout> mIndirectResourceBundleLayout;
+	std::shared_ptr<cgb::vulkan_resource_bundle_group> mResourceBundleGroup;
+
+	// one prototype per mesh and material, the props share their geometry and resource bundle
+	std::vector<std::unique_ptr<cgb::vulkan_render_object>> mPrototypes;
+	std::vector<std::unique_ptr<cgb::vulkan_render_object>> mProps;
+	std::vector<cgb::vulkan_render_object*> mRenderObjects;
+	// the same props with their geometry in the geometry pool, for the indirect drawers
+	std::shared_ptr<cgb::vulkan_geometry_pool> mGeometryPool;
+	std::vector<std::unique_ptr<cgb::vulkan_render_object>> mIndirectPrototypes;
+	std::vector<std::unique_ptr<cgb::vulkan_render_object>> mIndirectProps;
+	std::vector<cgb::vulkan_render_object*> mIndirectRenderObjects;
+	cgb::frustum mCullingFrustum;
+
+	draw_mode mDrawMode = draw_mode::instanced;
+	bool mCullingEnabled = false;
+
+public:
+	void initialize() override
+	{
+		initVulkan();
+	}
+
+	void finalize() override
+	{
+		// wait for all commands to complete
+		cgb::vulkan_context::instance().device.waitIdle();
+
+		cleanup();
+	}
+
+	void update() override
+	{
+		if (cgb::input().key_pressed(cgb::key_code::escape)) {
+			cgb::current_composition().stop();
+		}
+		// compare with one draw call per prop and with one indirect draw for all props
+		if (cgb::input().key_pressed(cgb::key_code::i)) {
+			switch (mDrawMode) {
+			case draw_mode::instanced:
+				mDrawMode = draw_mode::single;
+				break;
+			case draw_mode::single:
+				mDrawMode = mIndirectDrawer ? draw_mode::indirect : draw_mode::instanced;
+				break;
+			case draw_mode::indirect:
+				mDrawMode = draw_mode::indirect_gpu_culling;
+				break;
+			case draw_mode::indirect_gpu_culling:
+				mDrawMode = draw_mode::instanced;
+				break;
+			}
+		}
+		if (cgb::input().key_pressed(cgb::key_code::c)) {
+			mCullingEnabled = !mCullingEnabled;
+			std::vector<cgb::vulkan_drawer*> drawers = { mDrawer.get(), mInstancedDrawer.get() };
+			if (mIndirectDrawer) {
+				drawers.push_back(mIndirectDrawer.get());
+				drawers.push_back(mGpuCullingIndirectDrawer.get());
+			}
+			for (cgb::vulkan_drawer* drawer : drawers) {
+				if (mCullingEnabled) {
+					drawer->set_culling_frustum(mCullingFrustum);
+				}
+				else {
+					drawer->disable_culling();
+				}
+			}
+		}
+	}
+
+	void render() override
+	{
+		static float sum_t = 0.0f;
+		static uint32_t frames = 0;
+
+		drawFrame();
+
+		frames++;
+		sum_t += cgb::time().delta_time();
+		if (sum_t >= 1.0f) {
+			const float frameTime = 1000.0f * sum_t / frames;
+			std::string mode;
+			size_t drawCalls = 0;
+			switch (mDrawMode) {
+			case draw_mode::instanced:
+				mode = "instanced";
+				drawCalls = mInstancedDrawer->get_group_count();
+				break;
+			case draw_mode::single:
+				mode = "one draw per prop";
+				drawCalls = mRenderObjects.size() - mDrawer->get_culled_count();
+				break;
+			case draw_mode::indirect:
+				mode = "indirect";
+				drawCalls = 1;
+				break;
+			case draw_mode::indirect_gpu_culling:
+				mode = "indirect with gpu culling";
+				drawCalls = 1;
+				break;
+			}
+			const std::string title = fmt::format("{} props, {}{}: {:.2f} ms, {} draw calls", mRenderObjects.size(),
+				mode, mCullingEnabled ? ", culled" : "", frameTime, drawCalls);
+			cgb::context().main_window()->set_title(title.c_str());
+			sum_t = 0.0f;
+			frames = 0;
+		}
+	}
+
+private:
+	void initVulkan()
+	{
+		// without instancing, the uniforms of every prop are written every frame
+		cgb::vulkan_context::instance().frameAllocatorSize = 32 * 1024 * 1024;
+		cgb::vulkan_context::instance().initVulkan();
+
+		createCommandPools();
+
+		transferCommandBufferManager = std::make_shared<cgb::vulkan_command_buffer_manager>(transferCommandPool, cgb::vulkan_context::instance().graphicsQueue);
+		cgb::vulkan_context::instance().transferCommandBufferManager = transferCommandBufferManager;
+
+		imagePresenter = std::make_shared<cgb::vulkan_image_presenter>(cgb::vulkan_context::instance().presentQueue, cgb::vulkan_context::instance().surface, cgb::vulkan_context::instance().findQueueFamilies());
+		cgb::vulkan_context::instance().dynamicRessourceCount = imagePresenter->get_swap_chain_images_count();
+		drawCommandBufferManager = std::make_shared<cgb::vulkan_command_buffer_manager>(imagePresenter->get_swap_chain_images_count(), commandPool, cgb::vulkan_context::instance().graphicsQueue);
+		mVulkanRenderQueue = std::make_shared<cgb::vulkan_render_queue>(cgb::vulkan_context::instance().graphicsQueue);
+		mRenderer = std::make_unique<cgb::vulkan_renderer>(imagePresenter, mVulkanRenderQueue, drawCommandBufferManager, std::vector<std::shared_ptr<cgb::vulkan_renderer>>{});
+
+		createColorResources();
+		createDepthResources();
+
+		mVulkanFramebuffer = std::make_shared<cgb::vulkan_framebuffer>(cgb::vulkan_context::instance().msaaSamples, colorImage, depthImage, imagePresenter);
+		createDescriptorSetLayout();
+		mResourceBundleGroup = std::make_shared<cgb::vulkan_resource_bundle_group>();
+
+		vk::Viewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)imagePresenter->get_swap_chain_extent().width;
+		viewport.height = (float)imagePresenter->get_swap_chain_extent().height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		vk::Rect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = imagePresenter->get_swap_chain_extent();
+
+		//Atribute description bindings
+		auto bind1 = std::make_shared<vulkan_attribute_description_binding>(1, sizeof(Vertex), vk::VertexInputRate::eVertex);
+		bind1->add_attribute_description(0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos));
+		bind1->add_attribute_description(1, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, color));
+		auto bind2 = std::make_shared<vulkan_attribute_description_binding>(2, sizeof(Vertex), vk::VertexInputRate::eVertex);
+		bind2->add_attribute_description(2, vk::Format::eR32G32Sfloat, offsetof(Vertex, texCoord));
+
+		// one draw per prop, the model matrix is part of the uniforms
+		mRenderVulkanPipeline = std::make_shared<cgb::vulkan_pipeline>("shaders/single.vert.spv", "shaders/instancing.frag.spv", mVulkanFramebuffer->get_render_pass(), viewport, scissor, cgb::vulkan_context::instance().msaaSamples, std::vector<std::shared_ptr<cgb::vulkan_resource_bundle_layout>> { mResourceBundleLayout });
+		mRenderVulkanPipeline->add_attr_desc_binding(bind1);
+		mRenderVulkanPipeline->add_attr_desc_binding(bind2);
+		mRenderVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eVertex, "shaders/single.vert.spv");
+		mRenderVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eFragment, "shaders/instancing.frag.spv");
+		mRenderVulkanPipeline->bake();
+		mDrawer = std::make_unique<cgb::vulkan_drawer>(drawCommandBufferManager, mRenderVulkanPipeline);
+
+		// one draw per group of props which share their mesh and material, the model matrices are instance attributes
+		mInstancedVulkanPipeline = std::make_shared<cgb::vulkan_pipeline>("shaders/instanced.vert.spv", "shaders/instancing.frag.spv", mVulkanFramebuffer->get_render_pass(), viewport, scissor, cgb::vulkan_context::instance().msaaSamples, std::vector<std::shared_ptr<cgb::vulkan_resource_bundle_layout>> { mResourceBundleLayout });
+		mInstancedVulkanPipeline->add_attr_desc_binding(bind1);
+		mInstancedVulkanPipeline->add_attr_desc_binding(bind2);
+		mInstancedVulkanPipeline->add_attr_desc_binding(cgb::vulkan_instanced_drawer::create_instance_binding(3, 3));
+		mInstancedVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eVertex, "shaders/instanced.vert.spv");
+		mInstancedVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eFragment, "shaders/instancing.frag.spv");
+		mInstancedVulkanPipeline->bake();
+		mInstancedDrawer = std::make_unique<cgb::vulkan_instanced_drawer>(drawCommandBufferManager, mInstancedVulkanPipeline, 3);
+
+		// one indirect draw for all props, the model matrices are read from the drawer's per-draw data
+		if (cgb::context().supports_multi_draw_indirect()) {
+			mIndirectVulkanPipeline = std::make_shared<cgb::vulkan_pipeline>("shaders/indirect.vert.spv", "shaders/instancing.frag.spv", mVulkanFramebuffer->get_render_pass(), viewport, scissor, cgb::vulkan_context::instance().msaaSamples, std::vector<std::shared_ptr<cgb::vulkan_resource_bundle_layout>> { mIndirectResourceBundleLayout });
+			mIndirectVulkanPipeline->add_attr_desc_binding(bind1);
+			mIndirectVulkanPipeline->add_attr_desc_binding(bind2);
+			mIndirectVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eVertex, "shaders/indirect.vert.spv");
+			mIndirectVulkanPipeline->add_shader(cgb::ShaderStageFlagBits::eFragment, "shaders/instancing.frag.spv");
+			mIndirectVulkanPipeline->bake();
+		}
+
+		createTextures();
+		if (mIndirectVulkanPipeline) {
+			createIndirectDrawers();
+		}
+		createScene();
+	}
+
+	void createScene()
+	{
+		const std::vector<std::pair<std::vector<Vertex>, std::vector<uint32_t>>> meshes = {
+			{ create_cube_vertices(), create_cube_indices() },
+			{ verticesQuad, indicesQuad }
+		};
+
+		for (const auto& mesh : meshes) {
+			cgb::aabb bounds;
+			for (const Vertex& vertex : mesh.first) {
+				bounds.extend(vertex.pos);
+			}
+			for (const auto& texture : textures) {
+				auto prototype = std::make_unique<cgb::vulkan_render_object>(imagePresenter->get_swap_chain_images_count(), mesh.first, mesh.second, mResourceBundleLayout, mResourceBundleGroup, texture, transferCommandBufferManager, std::vector<std::shared_ptr<cgb::vulkan_texture>>{});
+				prototype->set_bounds(bounds);
+				mPrototypes.push_back(std::move(prototype));
+			}
+			// the indirect drawers have one resource bundle for all props, so they only need one prototype per mesh
+			if (mGeometryPool) {
+				auto prototype = std::make_unique<cgb::vulkan_render_object>(mGeometryPool, mesh.first, mesh.second);
+				prototype->set_bounds(bounds);
+				mIndirectPrototypes.push_back(std::move(prototype));
+			}
+		}
+		for (const auto& prototype : mPrototypes) {
+			mResourceBundleGroup->allocate_resource_bundle(prototype->get_resource_bundle().get());
+		}
+
+		// the camera and the props do not move, so the uniforms are set once
+		UniformBufferObject ubo = {};
+		const glm::vec3 center = glm::vec3(0.5f * GRID_SPACING * GRID_WIDTH, 0.0f, 0.5f * GRID_SPACING * GRID_DEPTH);
+		ubo.view = glm::lookAt(center + glm::vec3(0.0f, 150.0f, 250.0f), center, glm::vec3(0.0f, 1.0f, 0.0f));
+		ubo.proj = glm::perspective(glm::radians(60.0f), imagePresenter->get_swap_chain_extent().width / (float)imagePresenter->get_swap_chain_extent().height, 0.1f, 1000.0f);
+		ubo.proj[1][1] *= -1;
+		mCullingFrustum = cgb::frustum::from_matrix(ubo.proj * ubo.view);
+
+		mProps.reserve(GRID_WIDTH * GRID_DEPTH);
+		mRenderObjects.reserve(GRID_WIDTH * GRID_DEPTH);
+		mIndirectProps.reserve(mGeometryPool ? GRID_WIDTH * GRID_DEPTH : 0);
+		mIndirectRenderObjects.reserve(mGeometryPool ? GRID_WIDTH * GRID_DEPTH : 0);
+		for (uint32_t z = 0; z < GRID_DEPTH; z++) {
+			for (uint32_t x = 0; x < GRID_WIDTH; x++) {
+				const float angle = glm::radians(static_cast<float>((x * 37 + z * 11) % 360));
+				ubo.model = glm::translate(glm::mat4(1.0f), glm::vec3(x * GRID_SPACING, 0.0f, z * GRID_SPACING)) * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+				ubo.mvp = ubo.proj * ubo.view * ubo.model;
+				// interleave the prototypes, so that consecutive render objects rarely share their state
+				const size_t prototypeIndex = (x + z * 3) % mPrototypes.size();
+				mProps.push_back(std::make_unique<cgb::vulkan_render_object>(*mPrototypes[prototypeIndex], ubo));
+				mRenderObjects.push_back(mProps.back().get());
+				if (mGeometryPool) {
+					mIndirectProps.push_back(std::make_unique<cgb::vulkan_render_object>(*mIndirectPrototypes[prototypeIndex / textures.size()], ubo));
+					mIndirectRenderObjects.push_back(mIndirectProps.back().get());
+				}
+			}
+		}
+	}
+
+	void createIndirectDrawers()
+	{
+		// room for the meshes of all prototypes
+		mGeometryPool = std::make_shared<cgb::vulkan_geometry_pool>(sizeof(Vertex), 1024, 4096);
+
+		// every drawer fills binding 0 of its own resource bundle, which has to be allocated afterwards
+		auto indirectResourceBundle = mResourceBundleGroup->create_resource_bundle(mIndirectResourceBundleLayout, true);
+		indirectResourceBundle->add_image_resource(1, vk::ImageLayout::eShaderReadOnlyOptimal, textures[0]);
+		mIndirectDrawer = std::make_unique<cgb::vulkan_indirect_drawer>(drawCommandBufferManager, mIndirectVulkanPipeline, mGeometryPool, indirectResourceBundle, GRID_WIDTH * GRID_DEPTH);
+		mResourceBundleGroup->allocate_resource_bundle(indirectResourceBundle.get());
+
+		auto gpuCullingResourceBundle = mResourceBundleGroup->create_resource_bundle(mIndirectResourceBundleLayout, true);
+		gpuCullingResourceBundle->add_image_resource(1, vk::ImageLayout::eShaderReadOnlyOptimal, textures[0]);
+		mGpuCullingIndirectDrawer = std::make_unique<cgb::vulkan_indirect_drawer>(drawCommandBufferManager, mIndirectVulkanPipeline, mGeometryPool, gpuCullingResourceBundle, GRID_WIDTH * GRID_DEPTH);
+		mGpuCullingIndirectDrawer->enable_gpu_culling("shaders/indirect_cull.comp.spv");
+		mResourceBundleGroup->allocate_resource_bundle(gpuCullingResourceBundle.get());
+	}
+
+	void cleanup()
+	{
+		cleanupSwapChain();
+
+		mRenderObjects.clear();
+		mProps.clear();
+		mPrototypes.clear();
+		mIndirectRenderObjects.clear();
+		mIndirectProps.clear();
+		mIndirectPrototypes.clear();
+		mGeometryPool.reset();
+		mResourceBundleGroup.reset();
+
+		textures.clear();
+		textureImages.clear();
+		transferCommandBufferManager.reset();
+		mVulkanRenderQueue.reset();
+		drawCommandBufferManager.reset();
+
+		cgb::vulkan_context::instance().device.destroyCommandPool(transferCommandPool);
+		cgb::vulkan_context::instance().device.destroyCommandPool(commandPool);
+	}
+
+	void cleanupSwapChain()
+	{
+		colorImage.reset();
+		depthImage.reset();
+
+		mDrawer.reset();
+		mInstancedDrawer.reset();
+		mIndirectDrawer.reset();
+		mGpuCullingIndirectDrawer.reset();
+		mRenderVulkanPipeline.reset();
+		mInstancedVulkanPipeline.reset();
+		mIndirectVulkanPipeline.reset();
+		mVulkanFramebuffer.reset();
+
+		imagePresenter.reset();
+		mRenderer.reset();
+	}
+
+	void createCommandPools()
+	{
+		cgb::QueueFamilyIndices queueFamilyIndices = cgb::vulkan_context::instance().findQueueFamilies();
+
+		vk::CommandPoolCreateInfo poolInfo = {};
+		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer; // Optional
+
+		if (cgb::vulkan_context::instance().device.createCommandPool(&poolInfo, nullptr, &commandPool) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create command pool!");
+		}
+
+		// create command pool for data transfers
+		vk::CommandPoolCreateInfo transferPoolInfo = {};
+		transferPoolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+		transferPoolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient; // Optional
+
+		if (cgb::vulkan_context::instance().device.createCommandPool(&transferPoolInfo, nullptr, &transferCommandPool) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create command pool for data transfers!");
+		}
+	}
+
+	void drawFrame()
+	{
+		mRenderer->start_frame();
+		cgb::vulkan_context::instance().vulkanFramebuffer = mVulkanFramebuffer;
+
+		switch (mDrawMode) {
+		case draw_mode::instanced:
+			mRenderer->render(mRenderObjects, mInstancedDrawer.get());
+			break;
+		case draw_mode::single:
+			mRenderer->render(mRenderObjects, mDrawer.get());
+			break;
+		case draw_mode::indirect:
+			mRenderer->render(mIndirectRenderObjects, mIndirectDrawer.get());
+			break;
+		case draw_mode::indirect_gpu_culling:
+			mRenderer->render(mIndirectRenderObjects, mGpuCullingIndirectDrawer.get());
+			break;
+		}
+		mRenderer->end_frame();
+	}
+
+	void createDescriptorSetLayout()
+	{
+		mResourceBundleLayout = std::make_shared<cgb::vulkan_resource_bundle_layout>();
+		mResourceBundleLayout->add_binding(0, vk::DescriptorType::eUniformBufferDynamic, cgb::ShaderStageFlagBits::eVertex);
+		mResourceBundleLayout->add_binding(1, vk::DescriptorType::eCombinedImageSampler, cgb::ShaderStageFlagBits::eFragment);
+		mResourceBundleLayout->bake();
+
+		// the indirect drawers write the per-draw data into a storage buffer instead of the uniforms
+		mIndirectResourceBundleLayout = std::make_shared<cgb::vulkan_resource_bundle_layout>();
+		mIndirectResourceBundleLayout->add_binding(0, vk::DescriptorType::eStorageBuffer, cgb::ShaderStageFlagBits::eVertex);
+		mIndirectResourceBundleLayout->add_binding(1, vk::DescriptorType::eCombinedImageSampler, cgb::ShaderStageFlagBits::eFragment);
+		mIndirectResourceBundleLayout->bake();
+	}
+
+	// image / texture
+
+	void createTextures()
+	{
+		for (const std::string& texturePath : TEXTURE_PATHS) {
+			int texWidth, texHeight, texChannels;
+			stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+			if (!pixels) {
+				throw std::runtime_error("failed to load texture image!");
+			}
+			textureImages.push_back(std::make_shared<cgb::vulkan_image>(transferCommandBufferManager, pixels, texWidth, texHeight, texChannels));
+			textures.push_back(std::make_shared<cgb::vulkan_texture>(textureImages.back()));
+
+			stbi_image_free(pixels);
+		}
+	}
+
+	// attachments for framebuffer (color image to render to before resolve, depth image)
+
+	void createDepthResources()
+	{
+		vk::Format depthFormat = findDepthFormat();
+
+		depthImage = std::make_shared<cgb::vulkan_image>(transferCommandBufferManager, imagePresenter->get_swap_chain_extent().width, imagePresenter->get_swap_chain_extent().height, 1, cgb::vulkan_context::instance().msaaSamples, depthFormat,
+			vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eDepth);
+		depthImage->transition_image_layout(depthFormat, vk::ImageLayout::eUndefined, vk::ImageLayout::eDepthStencilAttachmentOptimal, 1);
+	}
+
+	vk::Format findDepthFormat()
+	{
+		return findSupportedFormat(
+			{ vk::Format::eD32Sfloat, vk::Format::eD32SfloatS8Uint, vk::Format::eD24UnormS8Uint },
+			vk::ImageTiling::eOptimal,
+			vk::FormatFeatureFlagBits::eDepthStencilAttachment
+		);
+	}
+
+	vk::Format findSupportedFormat(const std::vector<vk::Format>& candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features)
+	{
+		for (vk::Format format : candidates) {
+			vk::FormatProperties props;
+			cgb::vulkan_context::instance().physicalDevice.getFormatProperties(format, &props);
+
+			if (tiling == vk::ImageTiling::eLinear && (props.linearTilingFeatures & features) == features) {
+				return format;
+			}
+			else if (tiling == vk::ImageTiling::eOptimal && (props.optimalTilingFeatures & features) == features) {
+				return format;
+			}
+		}
+
+		throw std::runtime_error("failed to find supported format!");
+	}
+
+	void createColorResources()
+	{
+		vk::Format colorFormat = imagePresenter->get_swap_chain_image_format();
+
+		colorImage = std::make_shared<cgb::vulkan_image>(transferCommandBufferManager, imagePresenter->get_swap_chain_extent().width, imagePresenter->get_swap_chain_extent().height, 1, cgb::vulkan_context::instance().msaaSamples, colorFormat,
+			vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, vk::ImageAspectFlagBits::eColor);
+		colorImage->transition_image_layout(colorFormat, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, 1);
+	}
+};
+
+
+int main()
+{
+	try {
+		cgb::settings::gApplicationName = "Instancing";
+		cgb::settings::gApplicationVersion = cgb::make_version(1, 0, 0);
+
+		// Create a window which we're going to use to render to
+		auto mainWnd = cgb::context().create_window("Instancing");
+		mainWnd->set_resolution({ 1600, 900 });
+		// do not wait for vertical blank, so that the frame time can be compared
+		mainWnd->set_presentaton_mode(cgb::presentation_mode::immediate);
+		mainWnd->open();
+
+		// Create a "behavior" which contains functionality of our program
+		auto instancingBehavior = instancing_behavior();
+
+		// Create a composition of all things that define the essence of
+		// our program, which there are:
+		//  - a timer
+		//  - an executor
+		//  - a window
+		//  - a behavior
+		auto instancing = cgb::composition<cgb::varying_update_timer, cgb::sequential_executor>({
+					&instancingBehavior
+				});
+
+		// Let's go:
+		instancing.start();
+	}
+	catch (std::runtime_error& re) {
+		LOG_ERROR_EM(re.what());
+	}
+}
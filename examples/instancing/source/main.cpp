@@ -1,7 +0,0 @@
-#include "please_include.h"
-
-
-int main()
-{
-	auto tex = please::context().create_texture();
-}
\ No newline at end of file
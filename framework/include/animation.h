@@ -0,0 +1,148 @@
+#pragma once
+
+namespace cgb
+{
+	class Mesh;
+
+	/**	Local transformations of all bones of a skeleton in structure-of-arrays layout, i.e. one
+	 *	array per scalar component. This allows to process four bones at once with SIMD instructions.
+	 */
+	struct pose
+	{
+		std::vector<float> mTx, mTy, mTz;
+		std::vector<float> mRx, mRy, mRz, mRw;
+		std::vector<float> mSx, mSy, mSz;
+
+		size_t size() const { return mTx.size(); }
+		void resize(size_t pBoneCount);
+
+		glm::vec3 translation(size_t pBone) const { return { mTx[pBone], mTy[pBone], mTz[pBone] }; }
+		glm::quat rotation(size_t pBone) const { return glm::quat(mRw[pBone], mRx[pBone], mRy[pBone], mRz[pBone]); }
+		glm::vec3 scale(size_t pBone) const { return { mSx[pBone], mSy[pBone], mSz[pBone] }; }
+		void set(size_t pBone, const glm::vec3& pTranslation, const glm::quat& pRotation, const glm::vec3& pScale);
+
+		/** Returns the bone's transformation relative to its parent */
+		glm::mat4 local_matrix(size_t pBone) const;
+	};
+
+	/**	The bone hierarchy which animations are applied to. Bones are stored in depth-first order,
+	 *	i.e. every parent is stored before its children.
+	 */
+	struct skeleton
+	{
+		std::vector<std::string> mNames;
+		/** Index of every bone's parent, -1 for the root */
+		std::vector<int32_t> mParents;
+		/** The local transformations of all bones when no animation is applied */
+		pose mRestPose;
+
+		size_t bone_count() const { return mParents.size(); }
+		/** Returns the index of the bone with the given name, or -1 */
+		int32_t find_bone(const std::string& pName) const;
+	};
+
+	/** Keyframes of one component (translation, rotation or scale) of one bone */
+	struct keyframe_channel
+	{
+		/** Times of the keyframes in seconds, ascending */
+		std::vector<float> mTimes;
+		/** Number of scalars per keyframe: 3 for translations and scales, 4 for rotations (x, y, z, w) */
+		uint32_t mComponentCount = 0;
+		/** mTimes.size() * mComponentCount values, empty if the channel is quantized */
+		std::vector<float> mValues;
+		/** Quantized values, each one mapped linearly onto [mMin, mMin + mExtent]; empty if not quantized */
+		std::vector<uint16_t> mQuantizedValues;
+		glm::vec4 mMin{ 0.0f };
+		glm::vec4 mExtent{ 0.0f };
+
+		bool empty() const { return mTimes.empty(); }
+		bool quantized() const { return !mQuantizedValues.empty(); }
+		/** Returns the value of the given keyframe, dequantized if neccessary */
+		glm::vec4 value_at(size_t pKey) const;
+		/** Memory occupied by the keyframes in bytes */
+		size_t size_in_bytes() const;
+	};
+
+	/** All animated components of one bone */
+	struct animation_track
+	{
+		int32_t mBoneIndex;
+		keyframe_channel mTranslations;
+		keyframe_channel mRotations;
+		keyframe_channel mScales;
+	};
+
+	/** One animation, i.e. a set of keyframe tracks for some bones of a skeleton */
+	class animation_clip
+	{
+	public:
+		/**	Imports the channels of an Assimp animation for the given skeleton. Channels of nodes which
+		 *	are not part of the skeleton are ignored.
+		 *	@param pQuantize	If true, keyframe values are stored with 16 bits per component
+		 */
+		static animation_clip from_assimp(const aiAnimation* pAnimation, const skeleton& pSkeleton, bool pQuantize = false);
+
+		const std::string& name() const { return mName; }
+		/** Duration in seconds */
+		float duration() const { return mDuration; }
+		const std::vector<animation_track>& tracks() const { return mTracks; }
+		/** Memory occupied by all keyframes in bytes */
+		size_t size_in_bytes() const;
+
+		/**	Samples the clip at the given time in seconds and writes the result into outPose.
+		 *	Bones which are not animated by this clip are not modified, i.e. outPose should be
+		 *	initialized with the skeleton's rest pose.
+		 *	@param pLoop	If true, the time wraps around at the end of the clip, otherwise it is clamped
+		 */
+		void sample(float pTime, pose& outPose, bool pLoop = true) const;
+
+	private:
+		std::string mName;
+		float mDuration = 0.0f;
+		std::vector<animation_track> mTracks;
+	};
+
+	/**	Blends two poses: outPose = (1 - pWeight) * pFrom + pWeight * pTo, with rotations being
+	 *	normalized-lerped along the shortest path. Processes four bones per SIMD instruction.
+	 *	outPose may alias pFrom or pTo.
+	 */
+	extern void blend_poses(const pose& pFrom, const pose& pTo, float pWeight, pose& outPose);
+
+	/** Computes the transformations of all bones relative to the skeleton's root space */
+	extern void compute_global_transforms(const skeleton& pSkeleton, const pose& pPose, std::vector<glm::mat4>& outGlobalTransforms);
+
+	/**	Computes the matrices which transform the given mesh's vertices from bind pose into the
+	 *	animated pose, indexed like the mesh's bone indices. Meshes without bones yield an empty palette.
+	 */
+	extern void compute_skinning_palette(const std::vector<glm::mat4>& pGlobalTransforms, const Mesh& pMesh, std::vector<glm::mat4>& outPalette);
+
+	/** One clip which contributes to an @ref animated_character */
+	struct animation_layer
+	{
+		const animation_clip* mClip;
+		/** Current time in seconds */
+		float mTime;
+		/** Blend weight, the weights of all layers of a character are normalized */
+		float mWeight;
+		bool mLoop = true;
+	};
+
+	/** State of one animated instance of a skeleton */
+	struct animated_character
+	{
+		const skeleton* mSkeleton;
+		std::vector<animation_layer> mLayers;
+		/** The blended pose of the last update */
+		pose mPose;
+		/** The transformations of all bones after the last update, see @ref compute_global_transforms */
+		std::vector<glm::mat4> mGlobalTransforms;
+		/** Scratch memory for sampling the layers */
+		pose mLayerPose;
+	};
+
+	/**	Samples and blends the layers of all given characters and computes their global bone
+	 *	transformations. The characters are distributed over the threads of @ref worker_pool::shared.
+	 *	@param pMaxThreads	Upper limit for the number of threads, 0 means all of the pool's threads
+	 */
+	extern void update_characters(std::span<animated_character> pCharacters, size_t pMaxThreads = 0);
+}
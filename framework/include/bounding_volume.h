@@ -0,0 +1,44 @@
+#pragma once
+
+namespace cgb
+{
+	/** An axis-aligned bounding box. A default-constructed box is empty, i.e. mMin > mMax. */
+	struct aabb
+	{
+		glm::vec3 mMin{ std::numeric_limits<float>::max() };
+		glm::vec3 mMax{ std::numeric_limits<float>::lowest() };
+
+		bool empty() const { return mMin.x > mMax.x || mMin.y > mMax.y || mMin.z > mMax.z; }
+		glm::vec3 center() const { return 0.5f * (mMin + mMax); }
+		/** Half of the box's size along each axis */
+		glm::vec3 half_extent() const { return 0.5f * (mMax - mMin); }
+
+		void extend(const glm::vec3& pPoint) { mMin = glm::min(mMin, pPoint); mMax = glm::max(mMax, pPoint); }
+		void extend(const aabb& pOther) { mMin = glm::min(mMin, pOther.mMin); mMax = glm::max(mMax, pOther.mMax); }
+
+		/** Returns the box which encloses this box after it has been transformed by the given affine matrix */
+		aabb transformed(const glm::mat4& pMatrix) const;
+	};
+
+	/** A bounding sphere, a negative radius denotes an empty sphere */
+	struct bounding_sphere
+	{
+		glm::vec3 mCenter{ 0.0f };
+		float mRadius = -1.0f;
+
+		bool empty() const { return mRadius < 0.0f; }
+
+		/** Returns the sphere which encloses this sphere after it has been transformed by the given affine matrix */
+		bounding_sphere transformed(const glm::mat4& pMatrix) const;
+		/** Returns the smallest sphere which encloses both spheres */
+		bounding_sphere merged(const bounding_sphere& pOther) const;
+	};
+
+	/** Computes the bounding box of the given points */
+	extern aabb compute_aabb(const glm::vec3* pPoints, size_t pCount);
+
+	/**	Computes a bounding sphere of the given points, centered at the center of pBounds,
+	 *	which must be the points' bounding box. This is what the meshlets use as well.
+	 */
+	extern bounding_sphere compute_bounding_sphere(const glm::vec3* pPoints, size_t pCount, const aabb& pBounds);
+}
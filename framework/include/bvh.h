@@ -0,0 +1,129 @@
+#pragma once
+
+namespace cgb
+{
+	/**	One node of a bounding volume hierarchy, 32 bytes so that two of them fit into a cache line.
+	 *	Inner nodes have a count of 0 and their two children stored next to each other at mLeftOrFirst
+	 *	and mLeftOrFirst + 1. Leaves reference mCount primitives starting at mLeftOrFirst.
+	 */
+	struct bvh_node
+	{
+		glm::vec3 mMin;
+		uint32_t mLeftOrFirst;
+		glm::vec3 mMax;
+		uint32_t mCount;
+
+		bool is_leaf() const { return mCount > 0; }
+	};
+	static_assert(sizeof(bvh_node) == 32, "bvh_node is expected to be 32 bytes");
+
+	/** Settings for building bounding volume hierarchies */
+	struct bvh_settings
+	{
+		/** Nodes with at most this many primitives may become leaves; nodes at a depth of 64 become leaves in any case */
+		uint32_t mMaxLeafSize = 4;
+		/** Number of bins per axis which candidate splits are evaluated for, at most 64 */
+		uint32_t mBinCount = 16;
+		/** Upper limit for the number of threads which build subtrees, 0 means one per hardware thread */
+		size_t mMaxThreads = 0;
+	};
+
+	/** A ray segment from mOrigin + mTMin * mDirection to mOrigin + mTMax * mDirection */
+	struct ray
+	{
+		glm::vec3 mOrigin;
+		glm::vec3 mDirection;
+		float mTMin = 0.0f;
+		float mTMax = std::numeric_limits<float>::infinity();
+	};
+
+	/** The closest intersection of a ray with the triangles of a mesh or model */
+	struct ray_hit
+	{
+		/** Ray parameter of the intersection, infinity if nothing has been hit */
+		float mT = std::numeric_limits<float>::infinity();
+		/** Barycentric coordinates of the hit point w.r.t. the triangle's second and third vertex */
+		glm::vec2 mBarycentrics{ 0.0f };
+		/** Index of the triangle within the mesh, i.e. its first index is at 3 * mTriangleIndex */
+		uint32_t mTriangleIndex = 0;
+		uint32_t mMeshIndex = 0;
+		/** Index within the mesh's instances, 0 for hits against a single mesh */
+		uint32_t mInstanceIndex = 0;
+
+		bool hit() const { return mT < std::numeric_limits<float>::infinity(); }
+	};
+
+	/**	A bounding volume hierarchy over the triangles of one mesh, built with the surface area heuristic
+	 *	from binned split candidates. It keeps its own copy of the vertex positions, which @ref refit updates.
+	 */
+	class triangle_bvh
+	{
+	public:
+		/** Builds the hierarchy over the given triangle list; subtrees are built in parallel */
+		static triangle_bvh build(std::vector<glm::vec3> pPositions, std::vector<uint32_t> pIndices, const bvh_settings& pSettings = {});
+		/** Builds the hierarchy over the full-resolution triangles of the given mesh */
+		static triangle_bvh build(const Mesh& pMesh, const bvh_settings& pSettings = {});
+
+		/**	Updates the vertex positions (e.g. after skinning) and the bounds of all nodes without changing the
+		 *	topology of the hierarchy. Cheap, but traversal gets slower the more the triangles move relative to each other.
+		 *	pPositions must contain as many positions as the hierarchy has been built with.
+		 */
+		void refit(std::span<const glm::vec3> pPositions);
+
+		/**	Finds the closest intersection along the ray. outHit is only modified if a hit which is closer than
+		 *	outHit.mT has been found; mMeshIndex and mInstanceIndex are left untouched.
+		 */
+		bool intersect(const ray& pRay, ray_hit& outHit) const;
+		/** Intersects four rays at once; their bounds are tested against the nodes with SIMD instructions */
+		void intersect_packet(const std::array<ray, 4>& pRays, std::array<ray_hit, 4>& outHits) const;
+		/** Returns true if anything is hit along the ray, which is faster than finding the closest hit */
+		bool occluded(const ray& pRay) const;
+
+		/** Bounds of all triangles, empty if there are none */
+		aabb bounds() const;
+		const std::vector<bvh_node>& nodes() const { return mNodes; }
+		size_t triangle_count() const { return mTriangleIndices.size(); }
+
+	private:
+		std::vector<bvh_node> mNodes;
+		std::vector<glm::vec3> mPositions;
+		std::vector<uint32_t> mIndices;
+		/** Triangle indices in the order in which the leaves reference them */
+		std::vector<uint32_t> mTriangleIndices;
+	};
+
+	/**	A two-level hierarchy over a model: one @ref triangle_bvh per mesh and a top-level hierarchy over
+	 *	all instances of all meshes. Rays are given relative to the model's root node.
+	 */
+	class model_bvh
+	{
+	public:
+		static model_bvh build(const Model& pModel, const bvh_settings& pSettings = {});
+
+		/** Finds the closest intersection with any instance, see @ref triangle_bvh::intersect */
+		bool intersect(const ray& pRay, ray_hit& outHit) const;
+		bool occluded(const ray& pRay) const;
+
+		/** Refits the given mesh's hierarchy to new vertex positions and the top-level hierarchy to its new bounds */
+		void refit_mesh(size_t pMeshIndex, std::span<const glm::vec3> pPositions);
+
+		const triangle_bvh& mesh_bvh(size_t pMeshIndex) const { return mMeshBvhs.at(pMeshIndex); }
+		const std::vector<bvh_node>& nodes() const { return mNodes; }
+
+	private:
+		struct instance
+		{
+			glm::mat4 mTransformation;
+			glm::mat4 mInverseTransformation;
+			uint32_t mMeshIndex;
+			uint32_t mInstanceIndex;
+		};
+
+		void refit_top_level();
+
+		std::vector<triangle_bvh> mMeshBvhs;
+		/** All instances in the order in which the top-level leaves reference them */
+		std::vector<instance> mInstances;
+		std::vector<bvh_node> mNodes;
+	};
+}
@@ -22,6 +22,11 @@
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <thread>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <filesystem>
 #include <cstdlib>
 
 #include <stdio.h>
@@ -36,6 +41,8 @@
 #include <assimp/scene.h>       // Output data structure
 #include <assimp/postprocess.h> // Post processing flags
 #include <assimp/anim.h>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
 
 #include <imgui.h>
 
@@ -50,11 +57,14 @@
 #endif
 
 // -------------------- CG-Base includes --------------------
+#include "device_memory_allocator.h"
+#include "ring_allocator.h"
 #include "context_types.h"
 #include "context.h"
 #include "string_utils.h"
 #include "log.h"
 #include "various_utils.h"
+#include "worker_pool.h"
 #include "math_utils.h"
 #include "key_code.h"
 #include "key_state.h"
@@ -100,6 +110,19 @@ namespace cgb
 #include "composition.h"
 
 #include "transform.h"
+#include "index_codec.h"
+#include "mesh_simplifier.h"
+#include "meshlet.h"
+#include "bounding_volume.h"
+#include "mapped_file.h"
+#include "animation.h"
+#include "skinning.h"
 #include "model.h"
+#include "mesh_cache.h"
+#include "model_registry.h"
+#include "texture_pipeline.h"
 #include "camera.h"
+#include "frustum.h"
+#include "bvh.h"
+#include "dynamic_aabb_tree.h"
 #include "quake_camera.h"
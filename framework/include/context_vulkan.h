@@ -54,6 +54,10 @@ namespace cgb
 		vk::Queue& graphics_queue() { return mGraphicsQueue; }
 		vk::Queue& presentation_queue() { return mPresentQueue; }
 		vk::Queue& transfer_queue() { return mTransferQueue; }
+		/** True if VK_KHR_draw_indirect_count has been enabled, i.e. indirect draws can read their draw count from a buffer */
+		bool supports_draw_indirect_count() const { return mDrawIndirectCountSupported; }
+		/** True if one indirect draw call may issue multiple draws with non-zero first instances (multiDrawIndirect and drawIndirectFirstInstance) */
+		bool supports_multi_draw_indirect() const { return mMultiDrawIndirectSupported; }
 
 		window* create_window(const std::string&);
 
@@ -239,6 +243,22 @@ namespace cgb
 		 */
 		uint32_t find_memory_type_index(uint32_t pMemoryTypeBits, vk::MemoryPropertyFlags pMemoryProperties);
 
+		/** The memory types and heaps of the physical device, which are queried once when it is selected */
+		const vk::PhysicalDeviceMemoryProperties& memory_properties() const { return mMemoryProperties; }
+
+		/** The allocator which buffers, images, and acceleration structures get their memory from.
+		 *	It is available after the logical device has been created.
+		 */
+		device_memory_allocator& memory_allocator() { return *mMemoryAllocator; }
+
+		/** Sub-allocates memory which satisfies the given requirements from the @ref memory_allocator
+		 *	@param pRequirements		Requirements of the resource which the memory is for
+		 *	@param pMemoryProperties	Properties which the memory type must have
+		 *	@param pKind				Linear for buffers and linearly tiled images, optimal for optimally tiled images
+		 *	@param pLifetime			Transient allocations are released all at once, see @ref device_memory_allocator::reset_transient
+		 */
+		device_allocation allocate_memory(const vk::MemoryRequirements& pRequirements, vk::MemoryPropertyFlags pMemoryProperties, device_resource_kind pKind, device_allocation_lifetime pLifetime = device_allocation_lifetime::general);
+
 		/** Sets the sharing mode parameter on the given @ref vk::BufferCreateInfo struct.
 		 *	If there are two distinct queue families, concurrent sharing mode will be set for both queues,
 		 *	if there is only one queue family to handle transfer and graphics, sharing mode will be set to exclusive.
@@ -268,8 +288,13 @@ namespace cgb
 		VkDebugUtilsMessengerEXT mDebugCallbackHandle;
 		std::vector<swap_chain_data_ptr> mSurfSwap;
 		vk::PhysicalDevice mPhysicalDevice;
+		vk::PhysicalDeviceMemoryProperties mMemoryProperties;
 		vk::Device mLogicalDevice;
+		std::unique_ptr<vulkan_memory_backend> mMemoryBackend;
+		std::unique_ptr<device_memory_allocator> mMemoryAllocator;
 		vk::DispatchLoaderDynamic mDynamicDispatch;
+		bool mDrawIndirectCountSupported = false;
+		bool mMultiDrawIndirectSupported = false;
 
 		vk::Queue mGraphicsQueue;
 		uint32_t mGraphicsQueueIndex;
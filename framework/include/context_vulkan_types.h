@@ -236,10 +236,32 @@ namespace cgb
 		vk::CommandPool mCommandPool;
 	};
 
+	/** Implements the @ref device_memory_backend with a logical device */
+	class vulkan_memory_backend : public device_memory_backend
+	{
+	public:
+		/** pMemoryBudgetSupported states whether VK_EXT_memory_budget has been enabled for the device */
+		vulkan_memory_backend(vk::Device pDevice, vk::PhysicalDevice pPhysicalDevice, bool pMemoryBudgetSupported) noexcept;
+
+		device_memory_handle allocate(uint32_t pMemoryTypeIndex, uint64_t pSize) override;
+		void free(device_memory_handle pMemory) override;
+		void* map(device_memory_handle pMemory) override;
+		bool query_budgets(std::vector<device_memory_budget>& outBudgets) override;
+
+	private:
+		vk::Device mDevice;
+		vk::PhysicalDevice mPhysicalDevice;
+		bool mMemoryBudgetSupported;
+	};
+
+	/** Converts between the device memory of a @ref vulkan_memory_backend and the allocator's handles */
+	extern vk::DeviceMemory to_device_memory(device_memory_handle pHandle);
+	extern device_memory_handle to_device_memory_handle(vk::DeviceMemory pMemory);
+
 	struct buffer
 	{
 		buffer() noexcept;
-		buffer(size_t, const vk::BufferUsageFlags&, const vk::Buffer&, const vk::MemoryPropertyFlags&, const vk::DeviceMemory&) noexcept;
+		buffer(size_t, const vk::BufferUsageFlags&, const vk::Buffer&, const vk::MemoryPropertyFlags&, const device_allocation&) noexcept;
 		buffer(const buffer&) = delete;
 		buffer(buffer&&) noexcept;
 		buffer& operator=(const buffer&) = delete;
@@ -253,7 +275,8 @@ namespace cgb
 		vk::BufferUsageFlags mBufferFlags;
 		vk::Buffer mBuffer;
 		vk::MemoryPropertyFlags mMemoryProperties;
-		vk::DeviceMemory mMemory;
+		/** Sub-allocated from the context's @ref device_memory_allocator */
+		device_allocation mMemory;
 	};
 	
 	extern void copy(const buffer& pSource, const buffer& pDestination);
@@ -285,6 +308,42 @@ namespace cgb
 		uint32_t mIndexCount;
 	};
 
+	/** Returns the vk::IndexType which corresponds to indices of the given size in bytes (i.e. 2 or 4) */
+	extern vk::IndexType index_type_for_size(size_t pIndexSize);
+
+	class Mesh;
+
+	/**	Creates a device-local vertex buffer and uploads the given data to it. If the vulkan_context has been initialized, the upload
+	 *	goes through its staging ring and is executed before the next submission of vulkan_render_queue or vulkan_command_buffer_manager;
+	 *	otherwise, it goes through a staging buffer of its own and has been executed when the function returns.
+	 */
+	extern vertex_buffer create_vertex_buffer(const void* pData, size_t pSizeOneVertex, size_t pVertexCount, vk::BufferUsageFlags pAdditionalBufferUsageFlags = vk::BufferUsageFlags());
+
+	/**	Creates a vertex buffer which contains only the tightly packed positions (one glm::vec3 per vertex)
+	 *	of the given mesh. Intended for depth-only, shadow and BLAS passes, which would otherwise fetch
+	 *	the whole interleaved vertex for nothing but its position.
+	 */
+	extern vertex_buffer create_position_vertex_buffer(const Mesh& pMesh, vk::BufferUsageFlags pAdditionalBufferUsageFlags = vk::BufferUsageFlags());
+
+	/**	Creates a vertex buffer which contains all attributes of the given mesh except for the position.
+	 *	The mesh must have split vertex streams, see @ref Mesh::SplitVertexStreams; use
+	 *	@ref Mesh::attribute_offset to translate the interleaved attribute offsets.
+	 */
+	extern vertex_buffer create_attribute_vertex_buffer(const Mesh& pMesh, vk::BufferUsageFlags pAdditionalBufferUsageFlags = vk::BufferUsageFlags());
+
+	/** Device-local vertex and index buffers of one mesh */
+	struct mesh_buffers
+	{
+		vertex_buffer mVertexBuffer;
+		index_buffer mIndexBuffer;
+	};
+
+	/**	Returns the buffers of the given mesh. Meshes with identical geometry share their buffers,
+	 *	i.e. the geometry is uploaded only once as long as the returned buffers are alive.
+	 *	See @ref model_registry for the statistics.
+	 */
+	extern std::shared_ptr<mesh_buffers> get_or_create_mesh_buffers(const Mesh& pMesh);
+
 	struct uniform_buffer : public buffer
 	{
 		uniform_buffer() noexcept;
@@ -326,7 +385,7 @@ namespace cgb
 	struct image
 	{
 		image() noexcept;
-		image(const vk::ImageCreateInfo&, const vk::Image&, const vk::DeviceMemory&) noexcept;
+		image(const vk::ImageCreateInfo&, const vk::Image&, const device_allocation&) noexcept;
 		image(const image&) = delete;
 		image(image&&) noexcept;
 		image& operator=(const image&) = delete;
@@ -337,19 +396,33 @@ namespace cgb
 							  vk::Format format = vk::Format::eR8G8B8A8Unorm, 
 							  vk::ImageTiling tiling = vk::ImageTiling::eOptimal, 
 							  vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-							  vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal);
+							  vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal,
+							  uint32_t mipLevels = 1u);
 
 		vk::ImageMemoryBarrier create_barrier(vk::AccessFlags pSrcAccessMask, vk::AccessFlags pDstAccessMask, vk::ImageLayout pOldLayout, vk::ImageLayout pNewLayout, std::optional<vk::ImageSubresourceRange> pSubresourceRange = std::nullopt) const;
 
 		vk::ImageCreateInfo mInfo;
 		vk::Image mImage;
-		vk::DeviceMemory mMemory;
+		/** Sub-allocated from the context's @ref device_memory_allocator */
+		device_allocation mMemory;
 	};
 
 	extern void transition_image_layout(const image& pImage, vk::Format pFormat, vk::ImageLayout pOldLayout, vk::ImageLayout pNewLayout);
 
 	extern void copy_buffer_to_image(const buffer& pSrcBuffer, const image& pDstImage);
 
+	struct texture_data;
+
+	/** Returns the format which matches the given texture's compression and color space */
+	extern vk::Format texture_format(const texture_data& pTexture);
+
+	/**	Creates a sampled image from a texture which has been processed by the texture pipeline
+	 *	(see @ref load_texture) and uploads all of its mip levels at once, in the same way as @ref create_vertex_buffer.
+	 *	The returned image is in eShaderReadOnlyOptimal layout once the upload has been executed.
+	 *	BC-compressed textures require the textureCompressionBC device feature.
+	 */
+	extern image create_texture_image(const texture_data& pTexture);
+
 	struct command_buffer
 	{
 		void begin_recording();
@@ -419,7 +492,7 @@ namespace cgb
 	struct acceleration_structure
 	{
 		acceleration_structure() noexcept;
-		acceleration_structure(const vk::AccelerationStructureInfoNV& pAccStructureInfo, const vk::AccelerationStructureNV& pAccStructure, const acceleration_structure_handle& pHandle, const vk::MemoryPropertyFlags& pMemoryProperties, const vk::DeviceMemory& pMemory);
+		acceleration_structure(const vk::AccelerationStructureInfoNV& pAccStructureInfo, const vk::AccelerationStructureNV& pAccStructure, const acceleration_structure_handle& pHandle, const vk::MemoryPropertyFlags& pMemoryProperties, const device_allocation& pMemory);
 		acceleration_structure(const buffer&) = delete;
 		acceleration_structure(acceleration_structure&&) noexcept;
 		acceleration_structure& operator=(const acceleration_structure&) = delete;
@@ -436,13 +509,13 @@ namespace cgb
 		vk::AccelerationStructureNV mAccStructure;
 		acceleration_structure_handle mHandle;
 		vk::MemoryPropertyFlags mMemoryProperties;
-		vk::DeviceMemory mMemory;
+		device_allocation mMemory;
 	};
 
 	struct shader_binding_table : public buffer
 	{
 		shader_binding_table() noexcept;
-		shader_binding_table(size_t, const vk::BufferUsageFlags&, const vk::Buffer&, const vk::MemoryPropertyFlags&, const vk::DeviceMemory&) noexcept;
+		shader_binding_table(size_t, const vk::BufferUsageFlags&, const vk::Buffer&, const vk::MemoryPropertyFlags&, const device_allocation&) noexcept;
 		shader_binding_table(const sampler&) = delete;
 		shader_binding_table(shader_binding_table&&) noexcept;
 		shader_binding_table& operator=(const shader_binding_table&) = delete;
@@ -0,0 +1,231 @@
+#pragma once
+
+namespace cgb
+{
+	/** Handle of device memory as returned by a @ref device_memory_backend, e.g. a VkDeviceMemory. 0 is not a valid handle. */
+	using device_memory_handle = uint64_t;
+
+	/** How much memory of a heap is available to and used by the application */
+	struct device_memory_budget
+	{
+		/** How much memory of the heap the application can use without degrading performance */
+		uint64_t mBudget = 0;
+		/** How much memory of the heap the application uses; if reported by the device, this includes memory of other allocators */
+		uint64_t mUsage = 0;
+		/** Bytes which this allocator has allocated from the heap */
+		uint64_t mReservedBytes = 0;
+		/** Bytes of the heap which this allocator has handed out */
+		uint64_t mUsedBytes = 0;
+		/** True if budget and usage have been reported by the device, false if they are estimated from the allocator's own bookkeeping */
+		bool mReportedByDevice = false;
+	};
+
+	/**	The device functions which the @ref device_memory_allocator builds upon. The Vulkan context implements
+	 *	them with its logical device; tests can implement them with a mock device.
+	 */
+	class device_memory_backend
+	{
+	public:
+		virtual ~device_memory_backend() = default;
+		/** Allocates device memory of the given memory type, returns 0 if there is not enough memory left */
+		virtual device_memory_handle allocate(uint32_t pMemoryTypeIndex, uint64_t pSize) = 0;
+		/** Frees device memory, which also unmaps it */
+		virtual void free(device_memory_handle pMemory) = 0;
+		/** Maps the whole device memory into the host's address space */
+		virtual void* map(device_memory_handle pMemory) = 0;
+		/**	Sets mBudget and mUsage of each heap if the device reports them (e.g. via VK_EXT_memory_budget) and
+		 *	returns true, returns false otherwise. outBudgets has one element per heap.
+		 */
+		virtual bool query_budgets(std::vector<device_memory_budget>& /*outBudgets*/) { return false; }
+	};
+
+	/** Properties of a memory type, as far as the allocator is concerned */
+	struct device_memory_type
+	{
+		/** Host-visible memory is mapped persistently */
+		bool mHostVisible = false;
+		/** Size of the heap which the memory type belongs to */
+		uint64_t mHeapSize = 0;
+		uint32_t mHeapIndex = 0;
+	};
+
+	/**	Resources which are laid out linearly (buffers and linearly tiled images) and optimally tiled images must be
+	 *	bufferImageGranularity apart if they share device memory, which is why the allocator has to know the kind.
+	 */
+	enum struct device_resource_kind
+	{
+		linear,
+		optimal
+	};
+
+	/** General allocations live until they are freed, transient ones until the next @ref device_memory_allocator::reset_transient */
+	enum struct device_allocation_lifetime
+	{
+		general,
+		transient
+	};
+
+	/** Settings of a @ref device_memory_allocator */
+	struct device_memory_allocator_settings
+	{
+		/** Size of the device memory blocks which general allocations are placed in; reduced for small heaps */
+		uint64_t mBlockSize = 64ull << 20;
+		/** Size of the device memory blocks which transient allocations are placed in */
+		uint64_t mTransientBlockSize = 16ull << 20;
+		/** General allocations which are larger than this get device memory of their own */
+		uint64_t mDedicatedThreshold = 32ull << 20;
+		/** The device's VkPhysicalDeviceLimits::bufferImageGranularity */
+		uint64_t mBufferImageGranularity = 1;
+		/** If the device does not report budgets, this fraction of each heap's size is considered to be its budget */
+		double mBudgetFraction = 0.8;
+	};
+
+	/** A range of device memory which has been handed out by a @ref device_memory_allocator */
+	struct device_allocation
+	{
+		device_memory_handle mMemory = 0;
+		uint64_t mOffset = 0;
+		uint64_t mSize = 0;
+		/** Points to the first byte of the allocation if the memory type is host visible, nullptr otherwise */
+		void* mMapped = nullptr;
+		uint32_t mMemoryTypeIndex = 0;
+		/** Bookkeeping of the allocator */
+		uint32_t mBlock = 0;
+		uint32_t mRange = 0;
+
+		bool valid() const { return 0 != mMemory; }
+	};
+
+	/**	Asks the owners of resources which can be recreated on demand, e.g. streamed textures, to free at least pBytes
+	 *	of the heap with index pHeapIndex. Returns the number of bytes which have been freed.
+	 */
+	using device_memory_eviction_callback = std::function<uint64_t(uint32_t pHeapIndex, uint64_t pBytes)>;
+
+	/**	A move of an allocation which @ref device_memory_allocator::plan_defragmentation has planned. The owner has to
+	 *	copy the resource's contents from mSource to mDestination and bind the resource to mDestination.
+	 */
+	struct device_defragmentation_move
+	{
+		device_allocation mSource;
+		device_allocation mDestination;
+		/** The owner and alignment which have been registered via @ref device_memory_allocator::set_owner */
+		void* mOwner = nullptr;
+		uint64_t mAlignment = 1;
+	};
+
+	/** Allocation statistics of one memory type or of all of them */
+	struct device_memory_statistics
+	{
+		/** Number of device memory objects, i.e. blocks plus dedicated allocations */
+		size_t mDeviceMemoryCount = 0;
+		size_t mBlockCount = 0;
+		size_t mDedicatedAllocationCount = 0;
+		/** Number of live allocations, including dedicated ones */
+		size_t mAllocationCount = 0;
+		/** Bytes which have been allocated from the device */
+		uint64_t mReservedBytes = 0;
+		/** Bytes which have been handed out, excluding alignment padding */
+		uint64_t mUsedBytes = 0;
+	};
+
+	/**	Sub-allocates resources from large blocks of device memory, so that the number of device allocations stays
+	 *	far below maxMemoryAllocationCount and allocating a resource rarely involves the driver.
+	 *
+	 *	General allocations are managed with a two-level segregated fit allocator (TLSF) per block, which finds and
+	 *	frees ranges in constant time. Transient allocations are taken from separate blocks with a linear allocator
+	 *	and are all released at once by @ref reset_transient. Large allocations get device memory of their own.
+	 *	Linear and optimal resources are only placed in the same block if the buffer-image granularity is 1.
+	 *
+	 *	New device memory is only allocated within the heap's budget. If a heap is over budget or the device runs out
+	 *	of memory, the eviction callbacks are asked to free memory before the allocator exceeds the budget anyway.
+	 *	Allocations whose resources can be recreated elsewhere can be registered with an owner; @ref plan_defragmentation
+	 *	then plans moves out of sparsely used blocks, so that these can be returned to the device.
+	 *
+	 *	All functions are thread-safe. Eviction callbacks are invoked without holding the allocator's lock.
+	 */
+	class device_memory_allocator
+	{
+	public:
+		device_memory_allocator(device_memory_backend& pBackend, std::vector<device_memory_type> pMemoryTypes, const device_memory_allocator_settings& pSettings = {});
+		device_memory_allocator(const device_memory_allocator&) = delete;
+		device_memory_allocator(device_memory_allocator&&) = delete;
+		device_memory_allocator& operator=(const device_memory_allocator&) = delete;
+		device_memory_allocator& operator=(device_memory_allocator&&) = delete;
+		/** Frees all blocks. Dedicated allocations which are still alive are left to their owners. */
+		~device_memory_allocator();
+
+		/**	Allocates pSize bytes at an offset which is a multiple of pAlignment (a power of two) from the given memory type.
+		 *	Throws if the device is out of memory.
+		 */
+		device_allocation allocate(uint32_t pMemoryTypeIndex, uint64_t pSize, uint64_t pAlignment, device_resource_kind pKind = device_resource_kind::linear, device_allocation_lifetime pLifetime = device_allocation_lifetime::general);
+		/** Frees a general allocation and resets it. Transient allocations are left alone, they are freed by @ref reset_transient. */
+		void free(device_allocation& pAllocation);
+
+		/** Releases all transient allocations at once. Must only be called when the device does not use them anymore. */
+		void reset_transient();
+		/** Returns the memory of all blocks without allocations to the device */
+		void release_empty_blocks();
+
+		/** Registers a callback which is asked to free memory when a heap is over its budget; returns an id for @ref remove_eviction_callback */
+		size_t add_eviction_callback(device_memory_eviction_callback pCallback);
+		void remove_eviction_callback(size_t pId);
+
+		/**	Marks a general allocation as movable by @ref plan_defragmentation; pOwner is handed back with the moves and
+		 *	pAlignment is the alignment which the allocation has been made with. nullptr marks it as not movable again.
+		 *	Allocations are not movable by default, dedicated and transient allocations are never moved.
+		 */
+		void set_owner(const device_allocation& pAllocation, void* pOwner, uint64_t pAlignment = 1);
+		/**	Plans moves of movable allocations out of the least used block of each memory type into the fullest other
+		 *	blocks, moving at most pMaxBytes. The destinations are allocated already, the sources stay allocated until
+		 *	@ref finish_defragmentation, which must be called once the owners have moved their resources and the
+		 *	device does not use the sources anymore. If a resource is destroyed before, its owner frees both allocations
+		 *	of the move instead. No new device memory is allocated for the destinations.
+		 */
+		std::vector<device_defragmentation_move> plan_defragmentation(uint64_t pMaxBytes, size_t pMaxMoves = std::numeric_limits<size_t>::max());
+		/** Frees the sources of the moves and registers the owners for their destinations */
+		void finish_defragmentation(std::vector<device_defragmentation_move>& pMoves);
+
+		device_memory_statistics statistics() const;
+		device_memory_statistics statistics(uint32_t pMemoryTypeIndex) const;
+		/** The budget of each heap, as reported by the backend or estimated from the allocator's bookkeeping */
+		std::vector<device_memory_budget> budgets() const;
+		/** Writes the statistics of each memory type and the budget of each heap to the log */
+		void log_statistics() const;
+		const std::vector<device_memory_type>& memory_types() const { return mMemoryTypes; }
+
+	private:
+		struct block;
+
+		/**	Tries to allocate without exceeding the heap's budget if pWithinBudget is set. Returns an invalid allocation if
+		 *	that is not possible or if the device is out of memory, and sets outShortfall to the number of bytes which are missing.
+		 */
+		device_allocation try_allocate(uint32_t pMemoryTypeIndex, uint64_t pSize, uint64_t pAlignment, device_resource_kind pKind, device_allocation_lifetime pLifetime, bool pWithinBudget, uint64_t& outShortfall);
+		/** How many bytes of new device memory can be allocated from the memory type's heap without exceeding its budget */
+		uint64_t budget_remaining(uint32_t pMemoryTypeIndex) const;
+		std::vector<device_memory_budget> budgets_unlocked() const;
+		/** Books an allocation of pSize bytes at pOffset into the block */
+		device_allocation allocation_in_block(uint32_t pBlock, uint64_t pOffset, uint64_t pSize, uint32_t pRange);
+		/** Calls the eviction callbacks until pBytes have been freed; must be called without holding the lock */
+		uint64_t evict(uint32_t pHeapIndex, uint64_t pBytes);
+
+		/** Allocates a new block from the device, reducing its size if the device is short on memory */
+		block* create_block(uint32_t pMemoryTypeIndex, uint64_t pMinSize, uint64_t pPreferredSize, device_resource_kind pKind, device_allocation_lifetime pLifetime);
+		void release_block(uint32_t pBlock);
+		bool kind_compatible(const block& pBlock, device_resource_kind pKind) const;
+		device_allocation allocate_dedicated(uint32_t pMemoryTypeIndex, uint64_t pSize);
+
+		device_memory_backend& mBackend;
+		std::vector<device_memory_type> mMemoryTypes;
+		device_memory_allocator_settings mSettings;
+		/** Indexed by device_allocation::mBlock, released blocks leave nullptr behind */
+		std::vector<std::unique_ptr<block>> mBlocks;
+		std::vector<size_t> mDedicatedCounts;
+		std::vector<uint64_t> mDedicatedBytes;
+		size_t mHeapCount = 0;
+		std::vector<std::pair<size_t, device_memory_eviction_callback>> mEvictionCallbacks;
+		size_t mNextEvictionCallbackId = 0;
+		mutable std::mutex mMutex;
+		/** Serializes calls of the eviction callbacks, which might allocate and free themselves */
+		std::recursive_mutex mEvictionMutex;
+	};
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+namespace cgb
+{
+	/** Settings of a @ref dynamic_aabb_tree */
+	struct dynamic_aabb_tree_settings
+	{
+		/** Every leaf's box is enlarged by this margin along each axis, so that small movements do not require an update of the tree */
+		float mFatMargin = 0.1f;
+		/** The fat box is additionally extended by this multiple of an object's displacement in the direction of its movement */
+		float mDisplacementMultiplier = 2.0f;
+	};
+
+	/**	A bounding volume hierarchy over dynamic objects, which supports inserting, moving, and removing them
+	 *	at any time. Leaves store enlarged ("fat") boxes, so that an object only has to be reinserted once
+	 *	it leaves its fat box. Insertion chooses the sibling with the surface area heuristic and the tree is
+	 *	kept in shape by rotations which reduce the surface area of the nodes on the path to the root.
+	 *
+	 *	Objects can either be updated explicitly via their proxy ids, or they can be tracked via their
+	 *	transforms, in which case @ref update_tracked only touches those whose transform has changed.
+	 */
+	class dynamic_aabb_tree
+	{
+	public:
+		using proxy_id = uint32_t;
+		static constexpr proxy_id invalid_proxy = std::numeric_limits<proxy_id>::max();
+
+		/** One entry of a batch update, see @ref update(std::span<const proxy_update>) */
+		struct proxy_update
+		{
+			proxy_id mProxy;
+			aabb mBounds;
+			glm::vec3 mDisplacement{ 0.0f };
+		};
+
+		dynamic_aabb_tree(const dynamic_aabb_tree_settings& pSettings = {});
+
+		/** Inserts an object with the given bounds into the tree and returns its proxy id */
+		proxy_id insert(const aabb& pBounds, uint64_t pUserData = 0);
+		/** Removes the object from the tree; the proxy id becomes invalid and might be handed out again */
+		void remove(proxy_id pProxy);
+		/**	Sets new bounds of an object. pDisplacement is the object's movement since the last update and is
+		 *	used to predict its movement. Returns true if the object had to be reinserted into the tree.
+		 */
+		bool update(proxy_id pProxy, const aabb& pBounds, const glm::vec3& pDisplacement = glm::vec3{ 0.0f });
+		/** Updates multiple objects at once and returns the number of objects which had to be reinserted */
+		size_t update(std::span<const proxy_update> pUpdates);
+
+		/**	Inserts an object which follows the given transform. Its bounds are pLocalBounds transformed by the
+		 *	transform's global transformation matrix. Removing the proxy via @ref remove stops the tracking.
+		 */
+		proxy_id track(transform::ptr pTransform, const aabb& pLocalBounds, uint64_t pUserData = 0);
+		/** Sets new local bounds of a tracked object, e.g. after its mesh has changed */
+		void set_local_bounds(proxy_id pProxy, const aabb& pLocalBounds);
+		/**	Updates all tracked objects whose transform has changed since the last call, which is intended
+		 *	to happen once per frame. Returns the number of objects which had to be reinserted.
+		 */
+		size_t update_tracked();
+
+		/** Adds all objects whose fat boxes overlap the given box to outProxies */
+		void query_aabb(const aabb& pBounds, std::vector<proxy_id>& outProxies) const;
+		/** Adds all objects whose fat boxes overlap the given sphere to outProxies */
+		void query_sphere(const bounding_sphere& pSphere, std::vector<proxy_id>& outProxies) const;
+		/** Adds all objects whose fat boxes intersect the frustum to outProxies; contained subtrees are not tested any further */
+		void query_frustum(const frustum& pFrustum, std::vector<proxy_id>& outProxies) const;
+		/**	Adds all objects whose fat boxes are hit by the ray segment to outProxies, ordered by the distance
+		 *	at which the ray enters their boxes. Exact intersections are up to the caller, e.g. via a @ref triangle_bvh.
+		 */
+		void query_ray(const ray& pRay, std::vector<proxy_id>& outProxies) const;
+		/** Adds all pairs of objects whose fat boxes overlap to outPairs, every pair once with the smaller id first */
+		void query_pairs(std::vector<std::pair<proxy_id, proxy_id>>& outPairs) const;
+
+		uint64_t user_data(proxy_id pProxy) const { return leaf(pProxy).mUserData; }
+		/** The enlarged box which is stored in the tree */
+		const aabb& fat_bounds(proxy_id pProxy) const { return leaf(pProxy).mBounds; }
+		/** The number of objects in the tree */
+		size_t size() const { return mProxyCount; }
+		/** The height of the tree, 0 if it is empty or only contains one object */
+		int height() const { return null_node == mRoot ? 0 : mNodes[mRoot].mHeight; }
+		/** Sum of the surface areas of all inner nodes, a measure of the tree's quality for queries */
+		float total_inner_area() const;
+
+	private:
+		static constexpr uint32_t null_node = std::numeric_limits<uint32_t>::max();
+
+		struct node
+		{
+			aabb mBounds;
+			/** The parent node, or the next free node while the node is not in use */
+			uint32_t mParentOrNext = null_node;
+			uint32_t mChild1 = null_node;
+			uint32_t mChild2 = null_node;
+			/** 0 for leaves, -1 for unused nodes */
+			int32_t mHeight = -1;
+			uint64_t mUserData = 0;
+			/** Index into mTracked if the leaf follows a transform */
+			uint32_t mTrackedIndex = null_node;
+
+			bool is_leaf() const { return null_node == mChild1; }
+		};
+
+		struct tracked_object
+		{
+			transform::ptr mTransform;
+			aabb mLocalBounds;
+			glm::vec3 mLastCenter;
+			uint64_t mChangeCount;
+			proxy_id mProxy;
+		};
+
+		const node& leaf(proxy_id pProxy) const;
+		uint32_t allocate_node();
+		void free_node(uint32_t pNode);
+		void insert_leaf(uint32_t pLeaf);
+		void remove_leaf(uint32_t pLeaf);
+		/** Refits bounds and heights from the given node up to the root and rotates where that reduces the surface area */
+		void refit_and_rotate(uint32_t pNode);
+		void rotate(uint32_t pNode);
+		aabb fatten(const aabb& pBounds, const glm::vec3& pDisplacement) const;
+
+		dynamic_aabb_tree_settings mSettings;
+		std::vector<node> mNodes;
+		uint32_t mRoot = null_node;
+		uint32_t mFreeList = null_node;
+		size_t mProxyCount = 0;
+		std::vector<tracked_object> mTracked;
+	};
+}
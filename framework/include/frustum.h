@@ -0,0 +1,53 @@
+#pragma once
+
+namespace cgb
+{
+	/**	@brief A view frustum, represented by six planes
+	 *
+	 *	All plane normals point into the frustum and are normalized, i.e. for a point p
+	 *	and a plane (n, d), dot(n, p) + d is the signed distance of p to the plane, which
+	 *	is positive on the inside.
+	 */
+	class frustum
+	{
+	public:
+		// Note: near and far are macros on Windows, hence the suffixes
+		enum plane_index { left_plane = 0, right_plane, bottom_plane, top_plane, near_plane, far_plane };
+
+		frustum() noexcept;
+
+		/**	Extracts the planes from a combined projection and view matrix (Gribb & Hartmann).
+		 *	The resulting planes are in the space which the matrix transforms from, i.e. world
+		 *	space for a projection * view matrix. Assumes a clip-space depth range of [0, 1],
+		 *	which is what @ref camera produces.
+		 */
+		static frustum from_matrix(const glm::mat4& pProjectionAndView);
+
+		/** Extracts the world-space frustum of the given camera */
+		static frustum from_camera(const camera& pCamera);
+
+		/** Returns true if the sphere intersects or is contained in the frustum */
+		bool intersects_sphere(const glm::vec3& pCenter, float pRadius) const;
+		bool intersects_sphere(const bounding_sphere& pSphere) const { return intersects_sphere(pSphere.mCenter, pSphere.mRadius); }
+
+		/** Returns true if the box intersects or is contained in the frustum. Boxes which are too close
+		 *	to a corner of the frustum may be reported as intersecting although they are outside. */
+		bool intersects_aabb(const aabb& pBox) const;
+
+		/** Returns the plane at the given index as (normal, distance) */
+		const glm::vec4& plane(plane_index pIndex) const { return mPlanes[pIndex]; }
+		const std::array<glm::vec4, 6>& planes() const { return mPlanes; }
+
+	private:
+		std::array<glm::vec4, 6> mPlanes;
+	};
+
+	/**	Tests all the given boxes against the frustum and writes the indices of those which
+	 *	intersect it to outVisible (which is cleared first). Four boxes are tested at once with
+	 *	SSE instructions where available. Boxes and frustum must be given in the same space.
+	 */
+	extern void cull_aabbs(std::span<const aabb> pBoxes, const frustum& pFrustum, std::vector<uint32_t>& outVisible);
+
+	/** Like @ref cull_aabbs, but for bounding spheres */
+	extern void cull_spheres(std::span<const bounding_sphere> pSpheres, const frustum& pFrustum, std::vector<uint32_t>& outVisible);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace cgb
+{
+	/** The value which is reserved as primitive restart index for 16-bit index buffers.
+	 *	It is never used as a regular index when indices are packed into 16 bits.
+	 */
+	static constexpr uint32_t kPrimitiveRestartIndex16 = 0xFFFF;
+
+	/** Returns the smallest size of one index in bytes (i.e. 2 or 4) which is able
+	 *	to represent all of the given indices without loss.
+	 */
+	extern size_t smallest_index_size(const std::vector<uint32_t>& pIndices);
+
+	/** Packs the given indices tightly into a byte buffer with pIndexSize bytes per index.
+	 *	@param pIndexSize	Must be either 2 or 4. All indices must be representable with that size.
+	 */
+	extern std::vector<uint8_t> pack_indices(const std::vector<uint32_t>& pIndices, size_t pIndexSize);
+
+	/** Reverses @ref pack_indices and returns 32-bit indices again */
+	extern std::vector<uint32_t> unpack_indices(const uint8_t* pData, size_t pIndexCount, size_t pIndexSize);
+
+	/** Compresses the indices of a triangle list for on-disk storage.
+	 *	Every index is stored as a variable-length integer, either as a reference to the next
+	 *	not yet used vertex (which is the common case for meshes in vertex-cache-friendly order)
+	 *	or as zigzag-encoded delta to the previous index. This typically results in one to two
+	 *	bytes per index.
+	 */
+	extern std::vector<uint8_t> compress_indices(const std::vector<uint32_t>& pIndices);
+
+	/** Decompresses indices which have been compressed with @ref compress_indices
+	 *	@param pIndexCount	The number of indices which have been compressed
+	 *	Throws a std::runtime_error if the data is truncated or corrupt.
+	 */
+	extern std::vector<uint32_t> decompress_indices(const uint8_t* pData, size_t pDataSize, size_t pIndexCount);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+namespace cgb
+{
+	/** A read-only memory mapping of a whole file. The mapping is released when the object is destroyed. */
+	class mapped_file
+	{
+	public:
+		mapped_file() noexcept;
+		mapped_file(const mapped_file&) = delete;
+		mapped_file(mapped_file&&) noexcept;
+		mapped_file& operator=(const mapped_file&) = delete;
+		mapped_file& operator=(mapped_file&&) noexcept;
+		~mapped_file();
+
+		/** Maps the file at the given path into memory.
+		 *	Throws a std::runtime_error if the file can not be opened or mapped.
+		 */
+		static mapped_file open(const std::string& pPath);
+
+		const std::byte* data() const { return mData; }
+		size_t size() const { return mSize; }
+		std::span<const std::byte> bytes() const { return { mData, mSize }; }
+
+	private:
+		void close() noexcept;
+
+		const std::byte* mData;
+		size_t mSize;
+		/** Native file and file mapping handles, only used on Windows */
+		void* mFileHandle;
+		void* mMappingHandle;
+	};
+
+	/** An Assimp::IOStream which reads from memory without copying it upfront.
+	 *	It keeps the mapped file which it reads from (if any) alive.
+	 */
+	class mapped_io_stream : public Assimp::IOStream
+	{
+	public:
+		mapped_io_stream(std::span<const std::byte> pData, std::shared_ptr<const mapped_file> pFile = nullptr);
+
+		size_t Read(void* pvBuffer, size_t pSize, size_t pCount) override;
+		size_t Write(const void* pvBuffer, size_t pSize, size_t pCount) override;
+		aiReturn Seek(size_t pOffset, aiOrigin pOrigin) override;
+		size_t Tell() const override;
+		size_t FileSize() const override;
+		void Flush() override;
+
+	private:
+		std::span<const std::byte> mData;
+		size_t mPosition;
+		std::shared_ptr<const mapped_file> mFile;
+	};
+
+	/**	An Assimp::IOSystem which memory-maps every file that an import opens, i.e. the model file
+	 *	itself as well as dependent files like .mtl files. Every file is mapped only once per
+	 *	IO system, even though importers tend to open the same file several times (e.g. for format
+	 *	detection). The IO system is read-only; opening a file for writing fails.
+	 */
+	class mapped_io_system : public Assimp::IOSystem
+	{
+	public:
+		bool Exists(const char* pFile) const override;
+		char getOsSeparator() const override;
+		Assimp::IOStream* Open(const char* pFile, const char* pMode = "rb") override;
+		void Close(Assimp::IOStream* pFile) override;
+
+		/** Number of distinct files which have been mapped */
+		size_t mapped_file_count() const { return mMappedFiles.size(); }
+		/** Total size of all mapped files in bytes */
+		size_t mapped_bytes() const;
+
+	private:
+		std::unordered_map<std::string, std::shared_ptr<const mapped_file>> mMappedFiles;
+	};
+}
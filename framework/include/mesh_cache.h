@@ -0,0 +1,26 @@
+#pragma once
+
+namespace cgb
+{
+	/** Version of the binary mesh cache format. Increase whenever the layout changes;
+	 *	cache files with a different version are rejected when loading.
+	 */
+	static constexpr uint32_t kMeshCacheVersion = 5;
+
+	/** Serializes one mesh into the given binary stream.
+	 *	@param pCompressIndices	If true, the indices are stored with @ref compress_indices,
+	 *							otherwise they are stored packed with the mesh's index size.
+	 */
+	extern void write_mesh_to_cache(std::ostream& pStream, const Mesh& pMesh, bool pCompressIndices);
+
+	/** Deserializes one mesh which has been written with @ref write_mesh_to_cache */
+	extern Mesh read_mesh_from_cache(std::istream& pStream);
+
+	/** Writes all the given meshes, prefixed by a header containing the format version, into a cache file */
+	extern void save_meshes_to_cache(const std::string& pPath, const std::vector<Mesh>& pMeshes, bool pCompressIndices = true);
+
+	/** Loads all meshes from a cache file which has been written with @ref save_meshes_to_cache
+	 *	Throws a std::runtime_error if the file can not be read or has been written with another format version.
+	 */
+	extern std::vector<Mesh> load_meshes_from_cache(const std::string& pPath);
+}
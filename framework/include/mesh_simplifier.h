@@ -0,0 +1,39 @@
+#pragma once
+
+namespace cgb
+{
+	/** Settings which control the generation of a mesh's chain of levels of detail */
+	struct lod_settings
+	{
+		/** Maximum number of levels which are generated in addition to the full-resolution mesh */
+		uint32_t mMaxLevelCount = 4;
+		/** Target index count of each level relative to the index count of the previous level */
+		float mReductionPerLevel = 0.5f;
+		/** Levels whose object-space error would exceed this value are not generated */
+		float mMaxError = std::numeric_limits<float>::max();
+		/** The chain ends as soon as a level is not smaller than this ratio of the previous level's index count */
+		float mMinReductionPerLevel = 0.95f;
+	};
+
+	/**	Simplifies an indexed triangle list with quadric error metrics (Garland & Heckbert) by
+	 *	collapsing edges onto existing vertices, so that the result can be used with the original
+	 *	vertex buffer. Vertices which share their position with other vertices (i.e. UV, normal or
+	 *	other attribute seams) and non-manifold vertices are never moved, vertices on open borders
+	 *	only move along the border.
+	 *
+	 *	@param pPositions			Positions of all vertices which are referenced by pIndices
+	 *	@param pIndices				Triangle list which is to be simplified
+	 *	@param pTargetIndexCount	Simplification stops once the index count is at or below this value
+	 *	@param pMaxError			Simplification stops before a collapse would exceed this object-space error
+	 *	@param outError				Receives the object-space error of the result (an approximate distance to the input surface)
+	 *	@return	The indices of the simplified triangle list
+	 */
+	extern std::vector<uint32_t> simplify_triangles(const std::vector<glm::vec3>& pPositions, const std::vector<uint32_t>& pIndices, size_t pTargetIndexCount, float pMaxError, float& outError);
+
+	/**	Converts a tolerable error in pixels into the tolerable object-space error of a level of detail
+	 *	which is pDistance units away from a perspective camera.
+	 *	@param pFieldOfViewY	Vertical field of view in radians
+	 *	@param pViewportHeight	Height of the viewport in pixels
+	 */
+	extern float lod_error_threshold(float pDistance, float pFieldOfViewY, float pViewportHeight, float pPixelError);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+namespace cgb
+{
+	class frustum;
+
+	/** One cluster of triangles with a bounded number of vertices and primitives */
+	struct meshlet
+	{
+		/** Offset of the first entry in @ref meshlet_data::mVertices */
+		uint32_t mVertexOffset;
+		/** Offset of the first local index in @ref meshlet_data::mTriangles */
+		uint32_t mTriangleOffset;
+		uint32_t mVertexCount;
+		uint32_t mTriangleCount;
+	};
+
+	/** Culling data of one meshlet, in the mesh's object space */
+	struct meshlet_bounds
+	{
+		/** Bounding sphere */
+		glm::vec3 mCenter;
+		float mRadius;
+		/** Normal cone: average triangle normal ... */
+		glm::vec3 mConeAxis;
+		/** ... and the sine of the cone's half angle; a value >= 1 means that the meshlet can not be backface culled */
+		float mConeCutoff;
+	};
+
+	/** All meshlets of one mesh */
+	struct meshlet_data
+	{
+		std::vector<meshlet> mMeshlets;
+		std::vector<meshlet_bounds> mBounds;
+		/** Meshlet-local vertex index -> index into the mesh's vertex data */
+		std::vector<uint32_t> mVertices;
+		/** Three meshlet-local vertex indices per triangle */
+		std::vector<uint8_t> mTriangles;
+		uint32_t mMaxVertices = 0;
+		uint32_t mMaxTriangles = 0;
+
+		bool empty() const { return mMeshlets.empty(); }
+	};
+
+	/** Statistics of one @ref cull_meshlets invocation */
+	struct meshlet_culling_stats
+	{
+		size_t mTested = 0;
+		size_t mFrustumCulled = 0;
+		size_t mBackfaceCulled = 0;
+		size_t mVisibleTriangles = 0;
+	};
+
+	/**	Partitions a triangle list into meshlets with at most pMaxVertices unique vertices and
+	 *	pMaxTriangles triangles each. Meshlets are grown greedily from adjacent triangles which
+	 *	add the fewest new vertices, which keeps them compact and improves their bounds.
+	 *	The defaults match the recommendations for NVIDIA mesh shaders. pMaxVertices must be less than 255.
+	 *	Normal cones assume counter-clockwise front faces.
+	 */
+	extern meshlet_data build_meshlets(const std::vector<glm::vec3>& pPositions, const std::vector<uint32_t>& pIndices, uint32_t pMaxVertices = 64, uint32_t pMaxTriangles = 124);
+
+	/**	CPU reference implementation of cluster culling: Tests all meshlets against the frustum and
+	 *	their normal cones against the camera position. pFrustum and pCameraPosition must be given
+	 *	in world space, pModelMatrix transforms the meshlets' bounds from object to world space.
+	 *	The indices of all meshlets which are potentially visible are written to outVisible.
+	 */
+	extern void cull_meshlets(const meshlet_data& pMeshlets, const glm::mat4& pModelMatrix, const frustum& pFrustum, const glm::vec3& pCameraPosition, std::vector<uint32_t>& outVisible, meshlet_culling_stats* outStats = nullptr);
+}
@@ -20,6 +20,9 @@ namespace cgb
 		MOLF_loadTexCoords2 = 0x080000,
 		MOLF_loadTexCoords3 = 0x100000,
 		MOLF_loadBones = 0x200000,
+		// post-processing flags
+		MOLF_generateLods = 0x1000000,
+		MOLF_splitVertexStreams = 0x2000000,
 		// the default flags
 		MOLF_default = MOLF_triangulate | MOLF_smoothNormals | MOLF_limitBoneWeights,
 	};
@@ -69,6 +72,85 @@ namespace cgb
 
 
 
+	/*! One simplified level of detail of a mesh. It shares the vertex data with the full-resolution mesh. */
+	struct MeshLod
+	{
+		std::vector<uint32_t> m_indices;
+		/*! Object-space error compared to the full-resolution mesh, approximately a distance */
+		float m_error;
+	};
+
+	/*! One node of a model's scene graph */
+	struct ModelNode
+	{
+		std::string m_name;
+		/*! Index of the parent node, -1 for the root node */
+		int m_parent;
+		std::vector<int> m_children;
+		/*! Transformation relative to the parent node */
+		glm::mat4 m_local_transformation;
+		/*! Transformation relative to the root node */
+		glm::mat4 m_global_transformation;
+		/*! Indices of the meshes which are referenced by this node */
+		std::vector<unsigned int> m_mesh_indices;
+	};
+
+	/*! One placement of a mesh within its model, i.e. one reference of a scene graph node to the mesh */
+	struct MeshInstance
+	{
+		/*! Transformation relative to the model's root node */
+		glm::mat4 m_transformation;
+		/*! Index of the referencing node within Model::nodes(), -1 if the model has no scene graph nodes (e.g. if it has been loaded by Model::LoadFromCache) */
+		int m_node_index;
+
+		/*! Returns the upper 3x4 part of m_transformation in row-major order, as needed for ray tracing instance descriptions */
+		std::array<float, 12> transformation_3x4() const
+		{
+			const glm::mat4 t = glm::transpose(m_transformation);
+			std::array<float, 12> result;
+			memcpy(result.data(), glm::value_ptr(t), sizeof(result));
+			return result;
+		}
+	};
+
+	/*! One bone which influences the vertices of a mesh, referenced by the bone indices in the vertex data */
+	struct MeshBone
+	{
+		std::string m_name;
+		/*! Index of the corresponding bone of Model::skeleton() (which equals its node index), -1 if there is none */
+		int m_node_index;
+		/*! Transforms from mesh space into the bone's space in bind pose */
+		glm::mat4 m_offset_matrix;
+	};
+
+	/*! A blend shape of a mesh, stored as offsets relative to the mesh's vertices */
+	struct MeshMorphTarget
+	{
+		std::string m_name;
+		/*! The weight as specified by the model file */
+		float m_default_weight;
+		/*! One offset per vertex, empty if the morph target does not affect the positions */
+		std::vector<glm::vec3> m_position_deltas;
+		/*! One offset per vertex, empty if the morph target does not affect the normals */
+		std::vector<glm::vec3> m_normal_deltas;
+	};
+
+	/*! Memory statistics of the last import of a model from an Assimp scene */
+	struct ModelImportStats
+	{
+		/*! Bytes of transient data (e.g. bone weights) which have been placed into the import's arena */
+		size_t m_transient_bytes = 0;
+		/*! Heap allocations which the arena had to make for the transient data */
+		size_t m_transient_allocations = 0;
+		/*! Heap allocations which the meshes' vertex and index buffers have made, counted where they are resized */
+		size_t m_output_allocations = 0;
+		/*! Bytes which these allocations have requested */
+		size_t m_output_bytes = 0;
+		/*! Files which have been memory-mapped during the import, including dependent files like .mtl */
+		size_t m_mapped_files = 0;
+		size_t m_mapped_bytes = 0;
+	};
+
 	using MeshIdx = int;
 	using VAOMap = std::unordered_map<VertexAttribData, uint32_t>;
 
@@ -87,8 +169,25 @@ namespace cgb
 		VAOMap m_vertex_array_objects;
 
 		std::vector<uint8_t> m_vertex_data;
+
+		/*! Tightly packed positions, e.g. for depth-only passes and acceleration structure builds.
+		 *  Only filled after SplitVertexStreams has been invoked. */
+		std::vector<glm::vec3> m_position_data;
+		/*! All attributes except the positions, interleaved with m_size_one_attribute_vertex bytes per vertex.
+		 *  Only filled after SplitVertexStreams has been invoked. */
+		std::vector<uint8_t> m_attribute_data;
+		size_t m_size_one_attribute_vertex;
 		
 		std::vector<uint32_t> m_indices;
+
+		/*! Size of one index in bytes when uploaded to the GPU: 2 if all indices fit into 16 bits, 4 otherwise */
+		size_t m_index_size;
+
+		/*! Simplified levels of detail in order of decreasing detail, level 0 (i.e. m_indices) is not contained */
+		std::vector<MeshLod> m_lods;
+
+		/*! Clusters of triangles for cluster culling and mesh shaders, empty unless BuildMeshlets has been invoked */
+		meshlet_data m_meshlets;
 		
 		/*! If indices are intended to be used with GL_PATCHES, this holds the patch size */
 		int m_patch_size;
@@ -115,11 +214,29 @@ namespace cgb
 
 		glm::mat4 m_scene_transformation_matrix;
 
+		/*! All placements of this mesh, one per referencing scene graph node */
+		std::vector<MeshInstance> m_instances;
+
+		/*! The bones referenced by the bone indices of the vertices, empty if the mesh has no bones */
+		std::vector<MeshBone> m_bones;
+
+		/*! Morph targets imported from Assimp's animation meshes */
+		std::vector<MeshMorphTarget> m_morph_targets;
+
+		/*! Bounds of the vertex positions in the mesh's object space */
+		aabb m_local_bounds;
+		cgb::bounding_sphere m_local_bounding_sphere;
+		/*! Bounds of all instances relative to the model's root node */
+		aabb m_bounds;
+		cgb::bounding_sphere m_bounding_sphere;
+
 	public:
 		// Constructor - initialize everything
 		Mesh() :
 			m_index(-1),
 			m_vertex_data_layout(VertexAttribData::Nothing),
+			m_size_one_attribute_vertex(0),
+			m_index_size(sizeof(uint32_t)),
 			m_size_one_vertex(0),
 			m_position_offset(0),
 			m_normal_offset(0),
@@ -144,11 +261,50 @@ namespace cgb
 		const std::string& name() const { return m_name; }
 		VertexAttribData vertex_data_layout() const { return m_vertex_data_layout; }
 		const std::vector<uint8_t>& vertex_data() const { return m_vertex_data; }
+		bool has_split_vertex_streams() const { return !m_position_data.empty(); }
+		const std::vector<glm::vec3>& position_data() const { return m_position_data; }
+		const std::vector<uint8_t>& attribute_data() const { return m_attribute_data; }
+		size_t size_one_attribute_vertex() const { return m_size_one_attribute_vertex; }
+		/*! Converts an offset within the interleaved vertex data (e.g. m_normal_offset) into the corresponding offset within the attribute stream */
+		size_t attribute_offset(size_t interleaved_offset) const { return interleaved_offset > m_position_offset ? interleaved_offset - m_position_size : interleaved_offset; }
+		size_t num_vertices() const { return 0 == m_size_one_vertex ? 0 : m_vertex_data.size() / m_size_one_vertex; }
 		const std::vector<uint32_t>& indices() const { return m_indices; }
 		uint32_t indices_length() const { return static_cast<uint32_t>(m_indices.size()); }
+		size_t index_size() const { return m_index_size; }
+		bool has_16bit_indices() const { return m_index_size == sizeof(uint16_t); }
+		/*! Returns the indices tightly packed with index_size() bytes per index, ready to be uploaded into an index buffer */
+		std::vector<uint8_t> index_data() const;
+
+		/*! Number of levels of detail, including the full-resolution level 0 */
+		size_t lod_count() const { return m_lods.size() + 1; }
+		const std::vector<uint32_t>& lod_indices(size_t level) const { return 0 == level ? m_indices : m_lods.at(level - 1).m_indices; }
+		float lod_error(size_t level) const { return 0 == level ? 0.0f : m_lods.at(level - 1).m_error; }
+		/*! Returns the coarsest level of detail whose error does not exceed max_error */
+		size_t select_lod(float max_error) const;
+		/*! Returns the indices of the given level packed like index_data() */
+		std::vector<uint8_t> lod_index_data(size_t level) const;
+		const meshlet_data& meshlets() const { return m_meshlets; }
+		/*! Returns all vertex positions */
+		std::vector<glm::vec3> vertex_positions() const;
+		/*! Hash over the vertex layout, the vertex data and the indices. Meshes with equal hashes
+		 *  have identical geometry and can share GPU buffers. Computed on every call. */
+		uint64_t content_hash() const;
+		/*! Size of the vertex data and the indices (as uploaded, i.e. with index_size() bytes per index) */
+		size_t geometry_bytes() const { return m_vertex_data.size() + m_indices.size() * m_index_size; }
 
 		int patch_size() const { return m_patch_size; }
+		/*! Transformation of the last instance; meshes which are referenced by several nodes have several instances() */
 		const glm::mat4& transformation_matrix() const { return m_scene_transformation_matrix; }
+		const std::vector<MeshInstance>& instances() const { return m_instances; }
+		size_t instance_count() const { return m_instances.size(); }
+		const std::vector<MeshBone>& bones() const { return m_bones; }
+		const std::vector<MeshMorphTarget>& morph_targets() const { return m_morph_targets; }
+		/*! Bounds in object space, i.e. of the untransformed vertex positions */
+		const aabb& local_bounds() const { return m_local_bounds; }
+		const cgb::bounding_sphere& local_bounding_sphere() const { return m_local_bounding_sphere; }
+		/*! Bounds of all instances (or of m_scene_transformation_matrix if there are none) relative to the model's root node */
+		const aabb& bounds() const { return m_bounds; }
+		const cgb::bounding_sphere& bounding_sphere() const { return m_bounding_sphere; }
 
 		glm::vec3 vertex_position_at(size_t index) const;
 		glm::vec3 vertex_normal_at(size_t index) const;
@@ -196,6 +352,17 @@ namespace cgb
 		void SetIndices(std::vector<uint32_t>&& indices, int patch_size);
 		void SetIndices(const std::vector<uint32_t>& indices, int patch_size);
 
+		/*! (Re-)generates the chain of simplified levels of detail of this mesh */
+		void GenerateLods(const lod_settings& settings);
+		/*! Fills the position-only stream and the attribute stream from the interleaved vertex data */
+		void SplitVertexStreams();
+		/*! (Re-)builds the meshlets of the full-resolution level of detail */
+		void BuildMeshlets(uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+		/*! Computes the object-space bounds from the vertex data, e.g. after SetVertexData, and updates the transformed bounds */
+		void ComputeBounds();
+		/*! Transforms the object-space bounds by all instances into the bounds relative to the model's root node */
+		void UpdateTransformedBounds();
+
 	};
 
 	using MeshRef = std::reference_wrapper<Mesh>;
@@ -221,14 +388,22 @@ namespace cgb
 
 		std::vector<Mesh> m_meshes;
 
-#ifdef false
-		std::vector<Animator*> m_animators;
-		std::map<unsigned int, AnimationClip> m_animation_clips;
-#endif
+		/*! All scene graph nodes as bones, in the same order as m_nodes */
+		cgb::skeleton m_skeleton;
+		std::vector<animation_clip> m_animation_clips;
+
+		/*! Bounds of all meshes relative to the root node, i.e. without m_load_transformation_matrix */
+		aabb m_bounds;
+		cgb::bounding_sphere m_bounding_sphere;
 
 		/// The transformation matrix specified while
 		glm::mat4 m_load_transformation_matrix;
 
+		ModelImportStats m_import_stats;
+
+		/*! The scene graph in depth-first order, i.e. parents are stored before their children */
+		std::vector<ModelNode> m_nodes;
+
 	public:
 		Model(const glm::mat4& loadTransMatrix = glm::mat4(1.0f));
 		Model(const Model& other) = delete;
@@ -240,16 +415,33 @@ namespace cgb
 	public:
 		static std::unique_ptr<Model> LoadFromFile(const std::string& path, const glm::mat4& transform_matrix, const unsigned int model_loader_flags = MOLF_default);
 		static std::unique_ptr<Model> LoadFromMemory(const std::string& memory, const glm::mat4& transform_matrix, const unsigned int model_loader_flags = MOLF_default);
+		/*! Imports a model directly from the given memory (e.g. a mapped file) without copying it.
+		 *  Dependent files are opened relative to the current working directory. */
+		static std::unique_ptr<Model> LoadFromMemory(std::span<const std::byte> memory, const glm::mat4& transform_matrix, const unsigned int model_loader_flags = MOLF_default);
+		/*! Loads a model from a binary mesh cache file which has been written by SaveToCache.
+		 *  The meshes' instances are restored with their transformations, the scene graph nodes are not part of the cache,
+		 *  so the instances' node indices are -1. */
+		static std::unique_ptr<Model> LoadFromCache(const std::string& path, const glm::mat4& transform_matrix);
+		/*! Writes all meshes into a binary mesh cache file, optionally with compressed indices */
+		void SaveToCache(const std::string& path, bool with_compressed_indices = true) const;
+
+		/*! Generates the levels of detail of all meshes, the meshes are processed in parallel */
+		void GenerateLods(const lod_settings& settings = lod_settings{});
+		/*! Fills the position-only and attribute streams of all meshes */
+		void SplitVertexStreams();
+		/*! Builds the meshlets of all meshes, the meshes are processed in parallel */
+		void BuildMeshlets(uint32_t max_vertices = 64, uint32_t max_triangles = 124);
 
 	private:
 		unsigned static int CompileAssimpImportFlags(const unsigned int modelLoaderFlags);
 		bool LoadFromFile(const std::string& path, const unsigned int modelLoaderFlags = MOLF_default);
-		bool LoadFromMemory(const std::string& data, const unsigned int modelLoaderFlags = MOLF_default);
+		bool LoadFromMemory(std::span<const std::byte> data, const unsigned int modelLoaderFlags = MOLF_default);
 		bool PostLoadProcessing(Assimp::Importer& importer, const aiScene* scene, const std::string* file_path_or_null);
 
 		bool InitScene(const aiScene* scene);
-		bool InitMesh(const int index, const aiMesh* paiMesh);
-		void InitTransformationMatrices(const aiNode* pNode, const aiMatrix4x4& accTrans);
+		bool InitMesh(const int index, const aiMesh* paiMesh, std::pmr::memory_resource* transient_memory);
+		void InitTransformationMatrices(const aiNode* pNode, const aiMatrix4x4& accTrans, int parentIndex = -1);
+		void InitSkeleton(const aiScene* scene);
 
 		static void PrintIndent(std::ostream& stream, int indent);
 		static void PrintMatrix(std::ostream& stream, const aiMatrix4x4& mat, int indent);
@@ -270,12 +462,32 @@ namespace cgb
 	public:
 		const glm::mat4& transformation_matrix() const;
 		const glm::mat4 transformation_matrix(unsigned int meshIndex) const;
+		/*! Returns the transformations of all instances of the given mesh, including the load transformation.
+		 *  Ready to be uploaded for instanced draws. */
+		std::vector<glm::mat4> instance_transformation_matrices(unsigned int meshIndex) const;
+
+		const std::vector<ModelNode>& nodes() const { return m_nodes; }
+		const ModelNode& node_at(unsigned int nodeIndex) const { return m_nodes.at(nodeIndex); }
+		/*! Total number of mesh instances over all meshes */
+		size_t num_instances() const;
+
+		/*! The skeleton which the animation clips are applied to. Its bones are the scene graph nodes. */
+		const cgb::skeleton& skeleton() const { return m_skeleton; }
+		const std::vector<animation_clip>& animation_clips() const { return m_animation_clips; }
+
+		/*! Bounds of all meshes' instances relative to the model's root node. Transform them
+		 *  by transformation_matrix() to include the load transformation. */
+		const aabb& bounds() const { return m_bounds; }
+		const cgb::bounding_sphere& bounding_sphere() const { return m_bounding_sphere; }
+		/*! Recomputes the model's bounds from the meshes' bounds, e.g. after meshes have been modified */
+		void UpdateBounds();
 
 		static void PrintNodeTree(const aiScene* scene, std::ostream& stream);
 		static void PrintAnimationTree(const aiScene* scene, std::ostream& stream);
 		static void PrintMeshes(const aiScene* scene, std::ostream& stream);
 
 		size_t num_meshes() const;
+		const ModelImportStats& import_stats() const { return m_import_stats; }
 		size_t num_vertices(unsigned int meshIndex) const;
 		size_t indices_length(unsigned int meshIndex) const;
 
@@ -315,6 +527,7 @@ namespace cgb
 		}
 
 		Mesh& mesh_at(unsigned int meshIndex);
+		const Mesh& mesh_at(unsigned int meshIndex) const;
 
 	};
 
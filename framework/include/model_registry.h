@@ -0,0 +1,132 @@
+#pragma once
+
+namespace cgb
+{
+	/** Statistics of a @ref model_registry */
+	struct model_registry_stats
+	{
+		/** Models which are currently alive */
+		size_t mLiveModels = 0;
+		size_t mModelRequests = 0;
+		/** Requests which have been served with an already loaded model */
+		size_t mModelHits = 0;
+		/** Vertex and index bytes which did not have to be loaded again thanks to model hits */
+		size_t mModelBytesSaved = 0;
+
+		/** Shared geometry resources (e.g. GPU buffers) which are currently alive */
+		size_t mLiveGeometries = 0;
+		size_t mGeometryRequests = 0;
+		/** Requests which have been served with an existing resource of identical geometry */
+		size_t mGeometryHits = 0;
+		/** Vertex and index bytes which did not have to be uploaded again thanks to geometry hits */
+		size_t mGeometryBytesSaved = 0;
+	};
+
+	/**	@brief Process-wide registry of shared models and geometry resources
+	 *
+	 *	Models are keyed by their path and loader flags, identical requests share one instance.
+	 *	Geometry resources (like GPU buffers) are keyed by the meshes' content hashes, i.e.
+	 *	identical submeshes -- within one model or across models -- share one resource.
+	 *	The registry only holds weak references: a model or a resource is freed as soon as the
+	 *	last handle to it has been released. The copies of the geometry which tell resources apart
+	 *	are dropped lazily by later registrations, or by @ref collect_garbage. All methods are thread-safe.
+	 */
+	class model_registry
+	{
+	public:
+		/** The process-wide instance */
+		static model_registry& instance();
+
+		/**	Returns the model at the given path, loading it if it is not alive already.
+		 *	Shared models are loaded without a load transformation, apply transformations
+		 *	per usage instead. Do not modify a shared model.
+		 *	Returns nullptr if loading failed.
+		 */
+		std::shared_ptr<Model> load(const std::string& pPath, unsigned int pModelLoaderFlags = MOLF_default);
+
+		/**	Returns the resource of type T which has been created for a mesh with identical geometry,
+		 *	or creates it with pCreateFunc() if there is none alive.
+		 *	@param pCreateFunc	Must return a std::shared_ptr<T> for pMesh
+		 */
+		template <typename T, typename F>
+		std::shared_ptr<T> get_or_create_geometry(const Mesh& pMesh, F pCreateFunc)
+		{
+			const geometry_key key{ pMesh.content_hash(), pMesh.geometry_bytes(), typeid(T).hash_code() };
+			{
+				std::lock_guard<std::mutex> guard(mMutex);
+				++mStats.mGeometryRequests;
+				if (auto existing = find_geometry(key, pMesh)) {
+					++mStats.mGeometryHits;
+					mStats.mGeometryBytesSaved += pMesh.geometry_bytes();
+					return std::static_pointer_cast<T>(existing);
+				}
+			}
+
+			// Create outside of the lock, creation might be expensive (e.g. an upload)
+			std::shared_ptr<T> created = pCreateFunc();
+			std::lock_guard<std::mutex> guard(mMutex);
+			if (auto existing = find_geometry(key, pMesh)) {
+				// Another thread has been faster, keep its resource
+				++mStats.mGeometryHits;
+				mStats.mGeometryBytesSaved += pMesh.geometry_bytes();
+				return std::static_pointer_cast<T>(existing);
+			}
+			add_geometry(key, pMesh, created);
+			return created;
+		}
+
+		/** Returns the current statistics */
+		model_registry_stats statistics() const;
+
+		/** Removes the entries of models and resources which have been freed in the meantime */
+		void collect_garbage();
+
+	private:
+		struct geometry_key
+		{
+			uint64_t mContentHash;
+			size_t mBytes;
+			size_t mType;
+
+			bool operator==(const geometry_key& other) const
+			{
+				return mContentHash == other.mContentHash && mBytes == other.mBytes && mType == other.mType;
+			}
+		};
+
+		struct geometry_key_hash
+		{
+			size_t operator()(const geometry_key& pKey) const
+			{
+				return static_cast<size_t>(pKey.mContentHash ^ (pKey.mType * 0x9E3779B97F4A7C15ull));
+			}
+		};
+
+		/** A shared resource and a copy of the geometry it has been created for, which tells
+		 *	meshes with identical geometry apart from hash collisions */
+		struct geometry_entry
+		{
+			VertexAttribData mVertexDataLayout;
+			size_t mIndexSize;
+			std::vector<uint8_t> mVertexData;
+			std::vector<uint32_t> mIndices;
+			std::weak_ptr<void> mResource;
+
+			bool has_geometry_of(const Mesh& pMesh) const;
+		};
+
+		/** Returns the live resource for pMesh's geometry, or nullptr; mMutex must be locked */
+		std::shared_ptr<void> find_geometry(const geometry_key& pKey, const Mesh& pMesh);
+		/** Registers the resource for pMesh's geometry; mMutex must be locked */
+		void add_geometry(const geometry_key& pKey, const Mesh& pMesh, std::shared_ptr<void> pResource);
+		/** Removes the entries of freed resources and their geometry copies; mMutex must be locked */
+		void remove_expired_geometries();
+
+		mutable std::mutex mMutex;
+		std::unordered_map<std::string, std::weak_ptr<Model>> mModels;
+		std::unordered_multimap<geometry_key, geometry_entry, geometry_key_hash> mGeometries;
+		/** Number of geometry entries after the last sweep of freed resources */
+		size_t mGeometriesAfterSweep = 16;
+		model_registry_stats mStats;
+	};
+}
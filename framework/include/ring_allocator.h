@@ -0,0 +1,50 @@
+#pragma once
+
+namespace cgb
+{
+	/**	Hands out ranges of a fixed-size ring buffer, e.g. a persistently mapped staging buffer, in FIFO order.
+	 *	Allocations are grouped into batches which correspond to submissions to the device: @ref close_batch
+	 *	ends the current batch, and once the device has finished with the oldest batch, @ref retire_oldest_batch
+	 *	releases all of its ranges at once. The allocator does not know about fences, its owner does.
+	 */
+	class ring_allocator
+	{
+	public:
+		explicit ring_allocator(uint64_t pSize);
+
+		/**	Allocates pSize bytes at an offset which is a multiple of pAlignment (a power of two) and returns the offset.
+		 *	Returns an empty optional if there is not enough contiguous space left before the oldest live batch;
+		 *	the owner then has to wait for that batch and retire it.
+		 */
+		std::optional<uint64_t> allocate(uint64_t pSize, uint64_t pAlignment = 1);
+		/** Ends the current batch. Does nothing if nothing has been allocated since the previous call. */
+		void close_batch();
+		/** Releases the ranges of the oldest closed batch */
+		void retire_oldest_batch();
+
+		/** True if allocations have been made since the last @ref close_batch */
+		bool has_open_batch() const { return mOpenBytes > 0; }
+		/** Number of closed batches which have not been retired yet */
+		size_t closed_batch_count() const { return mClosedBatches.size(); }
+		uint64_t size() const { return mSize; }
+		/** Bytes which are in use by live batches, including alignment padding and the skipped end of the ring */
+		uint64_t used() const { return mUsedBytes; }
+
+	private:
+		struct batch
+		{
+			/** The offset behind the last range of the batch */
+			uint64_t mEnd;
+			uint64_t mBytes;
+		};
+
+		uint64_t mSize;
+		/** Offset of the next allocation */
+		uint64_t mHead = 0;
+		/** Offset of the first range of the oldest live batch */
+		uint64_t mTail = 0;
+		uint64_t mUsedBytes = 0;
+		uint64_t mOpenBytes = 0;
+		std::deque<batch> mClosedBatches;
+	};
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+namespace cgb
+{
+	class Mesh;
+
+	/** How the influences of multiple bones onto one vertex are combined */
+	enum struct skinning_method
+	{
+		/** Blends the bones' matrices, cheap but volume-losing for strong twists */
+		linear_blend,
+		/** Blends the bones' rigid transformations as dual quaternions, scale is ignored */
+		dual_quaternion
+	};
+
+	/** Settings for @ref skin_mesh */
+	struct skinning_settings
+	{
+		skinning_method mMethod = skinning_method::linear_blend;
+		/** Number of vertices which are gathered, morphed and skinned at once; small enough to stay in the L1/L2 cache */
+		size_t mBlockSize = 1024;
+		/** Upper limit for the number of threads of @ref worker_pool::shared the blocks are distributed over, 0 means all of them */
+		size_t mMaxThreads = 1;
+	};
+
+	/**	Computes the skinned positions and normals of all vertices of a mesh on the CPU.
+	 *	The morph targets are applied first, with one weight per morph target of the mesh; pass an empty
+	 *	span to skip them. Afterwards, the vertices are transformed by the palette as computed by
+	 *	@ref compute_skinning_palette. Meshes without bones are only morphed.
+	 *	@param outPositions	Receives one position per vertex, must hold at least pMesh.num_vertices() elements
+	 *	@param outNormals	Receives one normal per vertex, or may be empty if no normals are needed
+	 *	Throws a std::runtime_error if one of the buffers is too small or a bone index is outside the palette.
+	 */
+	extern void skin_mesh(const Mesh& pMesh, std::span<const glm::mat4> pPalette, std::span<const float> pMorphWeights,
+		std::span<glm::vec3> outPositions, std::span<glm::vec3> outNormals, const skinning_settings& pSettings = {});
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+namespace cgb
+{
+	/** Block compression formats which textures can be converted into */
+	enum struct texture_compression : uint32_t
+	{
+		none,
+		/** 4 bits per pixel, 1-bit alpha at most */
+		bc1,
+		/** 8 bits per pixel, with interpolated alpha */
+		bc3
+	};
+
+	/** Settings for @ref load_texture and @ref load_textures */
+	struct texture_settings
+	{
+		bool mGenerateMipmaps = true;
+		texture_compression mCompression = texture_compression::none;
+		/** If true, the texture holds sRGB colors, which are filtered in linear space when generating mipmaps */
+		bool mSrgb = true;
+		bool mFlipVertically = false;
+		/** If not empty, processed textures are stored in and loaded from this directory.
+		 *	Cache entries are keyed by the source file's path, size and modification time and by the settings.
+		 */
+		std::string mCacheDirectory;
+	};
+
+	/** One mip level of a texture */
+	struct texture_level
+	{
+		uint32_t mWidth;
+		uint32_t mHeight;
+		/** Tightly packed RGBA8 pixels or compressed blocks, depending on @ref texture_data::mCompression */
+		std::vector<uint8_t> mData;
+	};
+
+	/** A decoded and processed texture, ready to be uploaded */
+	struct texture_data
+	{
+		std::string mPath;
+		texture_compression mCompression = texture_compression::none;
+		bool mSrgb = true;
+		/** Mip levels in order of decreasing size, level 0 is the full-resolution image */
+		std::vector<texture_level> mLevels;
+		/** True if the texture has been loaded from the cache instead of being processed */
+		bool mFromCache = false;
+
+		uint32_t width() const { return mLevels.empty() ? 0u : mLevels[0].mWidth; }
+		uint32_t height() const { return mLevels.empty() ? 0u : mLevels[0].mHeight; }
+		uint32_t level_count() const { return static_cast<uint32_t>(mLevels.size()); }
+		size_t size_in_bytes() const;
+	};
+
+	/** Returns the number of mip levels of a full mip chain for the given size */
+	extern uint32_t mip_level_count(uint32_t pWidth, uint32_t pHeight);
+
+	/**	Generates all mip levels below the given RGBA8 image with stb_image_resize.
+	 *	Each level is filtered from the previous one; sRGB images are filtered in linear space.
+	 */
+	extern std::vector<texture_level> generate_mip_chain(const uint8_t* pRgba, uint32_t pWidth, uint32_t pHeight, bool pSrgb);
+
+	/** Compresses an RGBA8 image into BC1 or BC3 blocks with stb_dxt. Partial blocks at the borders are padded by clamping. */
+	extern std::vector<uint8_t> compress_texture_level(const uint8_t* pRgba, uint32_t pWidth, uint32_t pHeight, texture_compression pCompression);
+
+	/**	Decodes the image at the given path with stb_image and processes it according to pSettings.
+	 *	Throws a std::runtime_error if the image can not be decoded.
+	 */
+	extern texture_data load_texture(const std::string& pPath, const texture_settings& pSettings = {});
+
+	/**	Loads all the given textures, distributed over the threads of @ref worker_pool::shared.
+	 *	The results are in the same order as pPaths. Must not be called from within another job of the shared pool.
+	 *	@param pMaxThreads	Upper limit for the number of threads, 0 means all threads of the pool
+	 */
+	extern std::vector<texture_data> load_textures(const std::vector<std::string>& pPaths, const texture_settings& pSettings = {}, size_t pMaxThreads = 0);
+}
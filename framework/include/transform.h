@@ -62,11 +62,18 @@ namespace cgb
 		/** Returns the parent of this transform or nullptr */
 		transform::ptr parent();
 
+		/** Incremented whenever the global transformation matrix might have changed, i.e. when this transform
+		 *	or one of its parents is modified, or when it is attached or detached. Compare it against a stored value
+		 *	to find out whether the transform has moved since. */
+		uint64_t change_count() const { return mChangeCount; }
+
 	private:
 		/** Updates the internal matrix based on translation, rotation scale */
 		void update_matrix_from_transforms();
 		/** Extracts translation, rotation and scale from the matrix and sets the internal fields' values */ 
 		void update_transforms_from_matrix();
+		/** Increments the change count of this transform and of all its descendants */
+		void mark_changed();
 
 	protected:
 		/** Orthogonal basis + translation in a 4x4 matrix */
@@ -82,6 +89,9 @@ namespace cgb
 		transform::ptr mParent;
 		/** List of child transforms */
 		std::vector<transform::ptr> mChilds;
+
+		/** See change_count() */
+		uint64_t mChangeCount = 0;
 	};
 
 	void attach_transform(transform::ptr pParent, transform::ptr pChild);
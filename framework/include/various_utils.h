@@ -60,4 +60,120 @@ namespace cgb
 		is.close();
 		return buffer;
 	}
+
+	/**	Invokes pFunc(i) for every i in [0, pCount) distributed over multiple worker threads
+	 *	and blocks until all invocations have finished.
+	 *	@param pMaxThreads	Upper limit for the number of threads, 0 means std::thread::hardware_concurrency()
+	 *	If any invocation throws, the first exception is rethrown in the calling thread.
+	 */
+	template <typename F>
+	void parallel_for(size_t pCount, F pFunc, size_t pMaxThreads = 0)
+	{
+		size_t numThreads = 0 == pMaxThreads ? std::max(1u, std::thread::hardware_concurrency()) : pMaxThreads;
+		numThreads = std::min(numThreads, pCount);
+		if (numThreads <= 1) {
+			for (size_t i = 0; i < pCount; ++i) {
+				pFunc(i);
+			}
+			return;
+		}
+
+		std::atomic<size_t> next{ 0 };
+		std::exception_ptr firstException;
+		std::mutex exceptionMutex;
+		auto worker = [&]() {
+			for (size_t i = next++; i < pCount; i = next++) {
+				try {
+					pFunc(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> guard(exceptionMutex);
+					if (!firstException) {
+						firstException = std::current_exception();
+					}
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads - 1);
+		for (size_t t = 1; t < numThreads; ++t) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		if (firstException) {
+			std::rethrow_exception(firstException);
+		}
+	}
+
+	/**	Fast non-cryptographic 64-bit hash of a block of memory, e.g. for detecting duplicate data.
+	 *	Hashes of several blocks can be chained by passing the previous hash as pSeed.
+	 */
+	inline uint64_t hash_bytes(const void* pData, size_t pSize, uint64_t pSeed = 14695981039346656037ull)
+	{
+		constexpr uint64_t prime = 1099511628211ull;
+		const auto* bytes = static_cast<const uint8_t*>(pData);
+		uint64_t hash = pSeed ^ (pSize * 0x9E3779B97F4A7C15ull);
+		size_t i = 0;
+		// 8 bytes at a time, the shift mixes the high bits back in
+		for (; i + sizeof(uint64_t) <= pSize; i += sizeof(uint64_t)) {
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(uint64_t));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+		}
+		for (; i < pSize; ++i) {
+			hash = (hash ^ bytes[i]) * prime;
+		}
+		return hash;
+	}
+
+	/**	A std::pmr::memory_resource which forwards to an upstream resource and counts the
+	 *	allocations which pass through it. Put it underneath an arena to find out how often
+	 *	the arena actually had to go to the heap.
+	 */
+	class counting_memory_resource : public std::pmr::memory_resource
+	{
+	public:
+		explicit counting_memory_resource(std::pmr::memory_resource* pUpstream = std::pmr::get_default_resource()) noexcept
+			: mUpstream(pUpstream)
+		{ }
+
+		size_t allocation_count() const { return mAllocationCount; }
+		size_t bytes_allocated() const { return mBytesAllocated; }
+		size_t bytes_in_use() const { return mBytesInUse; }
+		size_t peak_bytes_in_use() const { return mPeakBytesInUse; }
+
+	private:
+		void* do_allocate(size_t pBytes, size_t pAlignment) override
+		{
+			void* result = mUpstream->allocate(pBytes, pAlignment);
+			++mAllocationCount;
+			mBytesAllocated += pBytes;
+			mBytesInUse += pBytes;
+			mPeakBytesInUse = std::max(mPeakBytesInUse, mBytesInUse);
+			return result;
+		}
+
+		void do_deallocate(void* pPtr, size_t pBytes, size_t pAlignment) override
+		{
+			mUpstream->deallocate(pPtr, pBytes, pAlignment);
+			mBytesInUse -= pBytes;
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& pOther) const noexcept override
+		{
+			return this == &pOther;
+		}
+
+		std::pmr::memory_resource* mUpstream;
+		size_t mAllocationCount = 0;
+		size_t mBytesAllocated = 0;
+		size_t mBytesInUse = 0;
+		size_t mPeakBytesInUse = 0;
+	};
 }
@@ -0,0 +1,58 @@
+#pragma once
+
+namespace cgb
+{
+	/**	@brief A fixed set of threads which is kept alive between jobs
+	 *
+	 *	@ref parallel_for starts and joins its threads on every call, which is fine for loading
+	 *	but too expensive for work which is repeated every frame. A worker_pool creates its
+	 *	threads once and hands index ranges to them with @ref run. The calling thread takes
+	 *	part in every job as worker 0. A job which is started while another one is running, i.e.
+	 *	from another thread or from within a job, runs on its calling thread only.
+	 */
+	class worker_pool
+	{
+	public:
+		/** @param pThreadCount	Workers including the calling thread, 0 means std::thread::hardware_concurrency() */
+		explicit worker_pool(size_t pThreadCount = 0);
+		worker_pool(const worker_pool&) = delete;
+		worker_pool& operator=(const worker_pool&) = delete;
+		~worker_pool();
+
+		/** Workers including the calling thread */
+		size_t thread_count() const { return mThreads.size() + 1; }
+
+		/**	Invokes pFunc(index, worker) for each index in [0, pCount) and blocks until all invocations have finished.
+		 *	worker identifies the thread which makes the invocation, e.g. to select per-thread resources, and is
+		 *	smaller than the number of workers which take part. It is unique among the invocations of this job only,
+		 *	a job which runs on its calling thread passes 0 while the running job might use worker 0 as well.
+		 *	@param pMaxThreads	Upper limit for the number of workers which take part, 0 means all of them
+		 *	If any invocation throws, the first exception is rethrown in the calling thread.
+		 */
+		void run(size_t pCount, const std::function<void(size_t, size_t)>& pFunc, size_t pMaxThreads = 0);
+
+		/** The process-wide pool with one worker per hardware thread, for per-frame work outside of the renderers */
+		static worker_pool& shared();
+
+	private:
+		void worker_main(size_t pWorker);
+		void process(size_t pWorker);
+
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::condition_variable mJobStarted;
+		std::condition_variable mJobFinished;
+		bool mStopping = false;
+		/** Set while the workers are assigned to a job */
+		std::atomic<bool> mBusy{ false };
+
+		// the current job, written under mMutex before the workers are woken up
+		uint64_t mJobNumber = 0;
+		const std::function<void(size_t, size_t)>* mJob = nullptr;
+		size_t mJobCount = 0;
+		size_t mJobWorkers = 0;
+		size_t mPendingWorkers = 0;
+		std::atomic<size_t> mNextIndex{ 0 };
+		std::exception_ptr mFirstException;
+	};
+}
@@ -2,12 +2,13 @@
 #include "vulkan_context.h"
 
 #include "vulkan_memory.h"
+#include "vulkan_memory_manager.h"
 
 #include "vulkan_command_buffer_manager.h"
 
 namespace cgb {
 
-	class vulkan_buffer
+	class vulkan_buffer : public vulkan_movable_resource
 	{
 	public:
 		// simple standard constructor
@@ -22,23 +23,53 @@ namespace cgb {
 		vulkan_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager = vulkan_context::instance().transferCommandBufferManager);
 
 		// initializes the memory of the buffer with the given data
-		// uses a staging buffer to copy the data
+		// host visible buffers are written directly, others are uploaded through the context's staging ring,
+		// which submits the copy with its next flush
 		vulkan_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, void* data, std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager = vulkan_context::instance().transferCommandBufferManager);
 
 		virtual ~vulkan_buffer();
 
 		vk::Buffer get_vk_buffer() { return mBuffer; }
+		// persistently mapped memory of host visible buffers, nullptr otherwise
+		void* get_mapped() { return mBufferMemory.mapped; }
 
 		// copies the srcBuffer into this buffer with the given size
 		void copy_buffer(vk::Buffer srcBuffer, vk::DeviceSize size);
 
-		// updates this buffer with the given buffer data and size
+		// updates this buffer with the given buffer data and size, in the same way as the initializing constructor,
+		// but the staging ring records the copy on the graphics queue, after the work which might still use the buffer
 		void update_buffer(void* bufferData, vk::DeviceSize size);
 
+		// device local buffers which are not referenced by descriptor sets are movable by the defragmentation by default;
+		// owners which keep using the vk::Buffer after they have got it, e.g. while they append to it, have to forbid it
+		void set_movable(bool movable);
+
+		// uploads through the staging ring are asynchronous; these poll or wait for the latest one
+		bool is_uploaded();
+		void wait_for_upload();
+
 	private:
+		friend class vulkan_memory_manager;
+
 		vk::Buffer mBuffer;
 		vulkan_memory mBufferMemory;
 		std::shared_ptr<vulkan_command_buffer_manager> mCommandBufferManager;
+		uint64_t mUploadTicket = 0;
+		vk::DeviceSize mSize = 0;
+		vk::BufferUsageFlags mUsage;
+		// the buffer which is being copied from while the defragmentation moves this buffer, see vulkan_memory_manager::defragment()
+		vk::Buffer mMovedFromBuffer;
+		// true if the buffer has been created with the usages which a move needs
+		bool mCopyable = false;
+		vk::DeviceSize mAlignment = 1;
+
+		// newBuffer lets the staging ring copy on the transfer queue, which is only valid before the buffer has been used
+		void upload(void* bufferData, vk::DeviceSize size, bool newBuffer);
+		// device local buffers can be moved by the defragmentation unless they are referenced by descriptor sets,
+		// since those would keep referring to the old buffer
+		static bool is_movable(vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties);
+		void begin_move(vk::CommandBuffer commandBuffer, const vulkan_memory& newMemory) override;
+		void finish_move() override;
 
 		void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer & buffer, vulkan_memory & cgbMemory);
 	};
@@ -39,6 +39,15 @@ namespace cgb {
 		}
 	};
 
+	// a command pool of one worker thread for one frame, see vulkan_command_buffer_manager::get_worker_command_buffer()
+	// the pool is reset as a whole when its frame starts again, which resets all of its command buffers
+	struct worker_command_pool {
+		vk::CommandPool mCommandPool;
+		std::vector<vk::CommandBuffer> mCommandBuffers;
+		// command buffers which have been handed out since the last reset
+		size_t mUsedCount = 0;
+	};
+
 	class vulkan_command_buffer_manager
 	{
 	public:
@@ -52,6 +61,19 @@ namespace cgb {
 		// resets all command buffers at the beginnng of the frame
 		void reset_command_buffers();
 
+		// command pools are externally synchronized, so every thread which records in parallel needs its own ones
+		// creates command pools for the given number of workers for each frame and the threads which record with them,
+		// must be called before the workers start; the threads are kept for the following frames
+		void prepare_workers(uint32_t workerCount);
+		// the threads which record in parallel, worker i of a job records with get_worker_command_buffer(i, ...)
+		worker_pool& get_workers() { return *mWorkers; }
+		// begins a secondary command buffer from the worker's command pool of the current frame
+		// may be called concurrently for different workers
+		vk::CommandBuffer get_worker_command_buffer(uint32_t worker, vk::CommandBufferBeginInfo &beginInfo);
+		// appends the command buffers which workers have recorded to this frame's recorded secondary command buffers,
+		// they are executed in the given order after the ones which have been recorded before
+		void add_worker_command_buffers(const std::vector<vk::CommandBuffer> &commandBuffers);
+
 
 		vk::CommandBuffer begin_single_time_commands();
 		void end_single_time_commands(vk::CommandBuffer commandBuffer);
@@ -64,6 +86,12 @@ namespace cgb {
 		// deleted with command pool
 		command_buffer_system mSecondaryCmdBuffers;
 		command_buffer_system mPrimaryCmdBuffers;
+		// [frame][worker], the command buffers are deleted with the worker command pools
+		std::vector<std::vector<worker_command_pool>> mWorkerPools;
+		// one thread per worker command pool of a frame, including the thread which calls worker_pool::run()
+		std::unique_ptr<worker_pool> mWorkers;
+		// worker command buffers among this frame's recorded secondary command buffers, which must not be recycled with mCommandPool
+		std::vector<std::vector<vk::CommandBuffer>> mRecordedWorkerCmdBuffers;
 
 		void create_command_buffers();
 
@@ -33,6 +33,8 @@ namespace cgb {
 
 	class vulkan_framebuffer;
 	class vulkan_memory_manager;
+	class vulkan_staging_ring;
+	class vulkan_frame_allocator;
 	class vulkan_command_buffer_manager;
 
 	struct SwapChainSupportDetails {
@@ -74,7 +76,13 @@ namespace cgb {
 		vk::SurfaceKHR surface;
 		vk::SampleCountFlagBits msaaSamples = vk::SampleCountFlagBits::e1;
 
-		vulkan_memory_manager* memoryManager;
+		vulkan_memory_manager* memoryManager = nullptr;
+		// all uploads to device local buffers and images go through the staging ring
+		vulkan_staging_ring* stagingRing = nullptr;
+		// per frame data, e.g. uniforms, is sub-allocated from the frame allocator
+		vulkan_frame_allocator* frameAllocator = nullptr;
+		// bytes per frame in flight, set it before initVulkan() if the uniforms of all render objects do not fit
+		vk::DeviceSize frameAllocatorSize = 4 * 1024 * 1024;
 
 		std::shared_ptr<vulkan_framebuffer> vulkanFramebuffer;
 
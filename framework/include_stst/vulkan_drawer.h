@@ -12,6 +12,12 @@
 
 namespace cgb {
 
+	// bind commands which have been recorded and those which have been skipped because the state was bound already
+	struct bind_counters {
+		size_t issued = 0;
+		size_t skipped = 0;
+	};
+
 	class vulkan_drawer
 	{
 	public:
@@ -21,13 +27,64 @@ namespace cgb {
 		virtual void draw(std::vector<vulkan_render_object*> renderObjects);
 
 		void set_vrs_images(std::vector<std::shared_ptr<vulkan_image>> vrsImages) { mVrsImages = vrsImages; }
+
+		// render objects with bounds which are outside of the given world-space frustum are not drawn
+		void set_culling_frustum(const frustum& cullingFrustum) { mCullingFrustum = cullingFrustum; }
+		void disable_culling() { mCullingFrustum.reset(); }
+		// number of render objects which have been culled during the last draw call
+		size_t get_culled_count() { return mCulledCount; }
+
+		// large lists of render objects are split into chunks of at least minObjectsPerThread objects, which are recorded
+		// into one secondary command buffer each by up to maxThreads threads (0 means one per hardware thread, 1 records on the calling thread)
+		void set_recording_threads(uint32_t maxThreads, size_t minObjectsPerThread = 512) { mMaxRecordingThreads = maxThreads; mMinObjectsPerThread = std::max<size_t>(minObjectsPerThread, 1); }
+
+		// if enabled, render objects are sorted by vertex buffer, index buffer and descriptor set, so that consecutive draws share
+		// as much state as possible, and front to back from the given world-space position among draws which share all of it
+		// disabled by default, since the order of the render objects might matter, e.g. for blending
+		void set_sorting(bool enabled) { mSortingEnabled = enabled; }
+		void set_sorting_view_position(const glm::vec3& viewPosition) { mSortingViewPosition = viewPosition; }
+		// bind commands of the last draw call
+		bind_counters get_bind_counters() { return mBindCounters; }
 	protected:
 		std::shared_ptr<vulkan_command_buffer_manager> mCommandBufferManager;
 		std::vector<std::shared_ptr<vulkan_image>> mVrsImages;
 
 		std::shared_ptr<vulkan_pipeline> mPipeline;
 
+		std::optional<frustum> mCullingFrustum;
+		size_t mCulledCount = 0;
+		// kept between frames to avoid allocations
+		std::vector<aabb> mWorldBounds;
+		std::vector<uint32_t> mVisibleIndices;
+		std::vector<uint32_t> mUniformOffsets;
+
+		uint32_t mMaxRecordingThreads = 0;
+		size_t mMinObjectsPerThread = 512;
+
+		// the state which a draw binds, compared in the order of the members when sorting
+		// the geometry comes first, since the descriptor sets are mostly per object; the depth only orders draws with equal state
+		struct draw_key {
+			vk::Buffer vertexBuffer;
+			vk::Buffer indexBuffer;
+			vk::DescriptorSet descriptorSet;
+			float depth;
+			vulkan_render_object* renderObject;
+
+			bool operator<(const draw_key& other) const {
+				return std::tie(vertexBuffer, indexBuffer, descriptorSet, depth) < std::tie(other.vertexBuffer, other.indexBuffer, other.descriptorSet, other.depth);
+			}
+		};
+		bool mSortingEnabled = false;
+		glm::vec3 mSortingViewPosition = glm::vec3(0.0f);
+		std::vector<draw_key> mDrawKeys;
+		bind_counters mBindCounters;
+
+		std::vector<vulkan_render_object*> cull(const std::vector<vulkan_render_object*>& renderObjects);
+		void sort(std::vector<vulkan_render_object*>& renderObjects);
 		void record_secondary_command_buffer(std::vector<vulkan_render_object*> renderObjects);
+		// binds the pipeline and records the draws of renderObjects[begin, end), whose uniform offsets are in mUniformOffsets
+		// bind commands are only recorded if the state differs from the previous draw's
+		bind_counters record_draws(vk::CommandBuffer commandBuffer, const std::vector<vulkan_render_object*>& renderObjects, size_t begin, size_t end);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include "vulkan_context.h"
+
+#include "vulkan_buffer.h"
+
+namespace cgb {
+
+	// a linear allocator for data which is written by the cpu every frame, e.g. uniforms of render objects
+	// one large, persistently mapped buffer is split into one region per frame in flight; allocating is a pointer bump
+	// within the current frame's region, and the region is reset as a whole when its frame starts again
+	// the buffer can be bound once with eUniformBufferDynamic or eStorageBufferDynamic descriptors,
+	// the allocations are then selected with their offsets as dynamic offsets in bindDescriptorSets
+	class vulkan_frame_allocator
+	{
+	public:
+		struct allocation {
+			void* mapped;
+			// offset from the start of the buffer, to be used as dynamic offset
+			uint32_t offset;
+		};
+
+		vulkan_frame_allocator(vk::DeviceSize frameSize, uint32_t frameCount);
+		virtual ~vulkan_frame_allocator();
+
+		// starts using the region of the given frame in flight, whose previous use must have finished on the device
+		// does nothing if the frame is the current one already, so that multiple renderers can start the same frame
+		void begin_frame(size_t frameIndex);
+
+		// returns a range of the given size from the current frame's region, aligned for uniform and storage buffer offsets
+		allocation allocate(vk::DeviceSize size);
+
+		// incremented with every frame, to find out whether an allocation belongs to the current frame
+		uint64_t get_frame_serial() { return mFrameSerial; }
+		std::shared_ptr<vulkan_buffer> get_buffer() { return mBuffer; }
+		// bytes which have been allocated in the current frame
+		vk::DeviceSize get_used() { return mUsed; }
+
+	private:
+		std::shared_ptr<vulkan_buffer> mBuffer;
+		vk::DeviceSize mFrameSize;
+		uint32_t mFrameCount;
+		vk::DeviceSize mAlignment;
+
+		size_t mCurrentFrame = 0;
+		uint64_t mFrameSerial = 1;
+		vk::DeviceSize mUsed = 0;
+	};
+
+}
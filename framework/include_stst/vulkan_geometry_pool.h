@@ -0,0 +1,42 @@
+#pragma once
+#include "vulkan_context.h"
+
+#include "vulkan_buffer.h"
+
+namespace cgb {
+
+	// where a mesh lies within the buffers of a vulkan_geometry_pool, in the terms of drawIndexed
+	struct vulkan_mesh_range {
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		int32_t vertexOffset = 0;
+	};
+
+	// packs the vertices and indices of many meshes into one large vertex buffer and one large index buffer,
+	// so that all of them can be drawn without binding buffers in between, e.g. with one indirect draw (see vulkan_indirect_drawer)
+	// meshes are appended and stay until the pool is destroyed; indices are always 32 bit and relative to the mesh's own vertices
+	class vulkan_geometry_pool
+	{
+	public:
+		vulkan_geometry_pool(vk::DeviceSize vertexSize, uint32_t maxVertexCount, uint32_t maxIndexCount);
+		virtual ~vulkan_geometry_pool();
+
+		// uploads the mesh through the staging ring, throws if the pool is full
+		vulkan_mesh_range add_mesh(const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices);
+
+		std::shared_ptr<vulkan_buffer> get_vertex_buffer() { return mVertexBuffer; }
+		std::shared_ptr<vulkan_buffer> get_index_buffer() { return mIndexBuffer; }
+		uint32_t get_vertex_count() { return mVertexCount; }
+		uint32_t get_index_count() { return mIndexCount; }
+
+	private:
+		std::shared_ptr<vulkan_buffer> mVertexBuffer;
+		std::shared_ptr<vulkan_buffer> mIndexBuffer;
+		vk::DeviceSize mVertexSize;
+		uint32_t mMaxVertexCount;
+		uint32_t mMaxIndexCount;
+		uint32_t mVertexCount = 0;
+		uint32_t mIndexCount = 0;
+	};
+
+}
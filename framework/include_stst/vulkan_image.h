@@ -2,11 +2,12 @@
 #include "vulkan_context.h"
 
 #include "vulkan_memory.h"
+#include "vulkan_memory_manager.h"
 #include "vulkan_command_buffer_manager.h"
 #include "vulkan_buffer.h"
 
 namespace cgb {
-	class vulkan_image
+	class vulkan_image : public vulkan_movable_resource
 	{
 	public:
 		vulkan_image(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, void* pixels, int texWidth, int texHeight, int texChannels);
@@ -14,6 +15,10 @@ namespace cgb {
 		vulkan_image(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling,
 			vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::ImageAspectFlags aspects);
 
+		// creates an image without memory, which is bound later with bind_memory(), e.g. to memory which is shared by
+		// images that are not used at the same time, see vulkan_render_graph
+		vulkan_image(uint32_t width, uint32_t height, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspects);
+
 		virtual ~vulkan_image();
 
 		vk::Image get_image() { return mImage; }
@@ -29,6 +34,20 @@ namespace cgb {
 
 		void transition_image_layout(vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels);
 
+		// only for images which have been created without memory; the memory is owned by the caller and is not freed with the image
+		vk::MemoryRequirements get_memory_requirements();
+		void bind_memory(vk::DeviceMemory memory, vk::DeviceSize offset);
+
+		// allows the defragmentation to move the image, which is recreated together with its view; images are not movable by default,
+		// since descriptor sets and framebuffers keep referring to the old view, so only owners which get the image and its view whenever
+		// they record commands may allow it; layout is the one in which the image is between frames, which a move keeps
+		// the image must have been created with its own memory and with transfer src and transfer dst usage
+		void set_movable(bool movable, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+		// texture images are uploaded asynchronously; these poll or wait for the upload of the pixels and the mipmap generation
+		bool is_uploaded();
+		void wait_for_upload();
+
 		int get_width() { return mTexWidth; }
 		int get_height() { return mTexHeight; }
 	private:
@@ -47,6 +66,14 @@ namespace cgb {
 		vk::ImageUsageFlags mUsage;
 		vk::MemoryPropertyFlags mMemoryProperties;
 		vk::ImageAspectFlags mAspects;
+		uint64_t mUploadTicket = 0;
+		// false if the memory has been bound with bind_memory()
+		bool mOwnsMemory = true;
+		// the image and view which are being copied from while the defragmentation moves this image, see vulkan_memory_manager::defragment()
+		vk::Image mMovedFromImage;
+		vk::ImageView mMovedFromImageView;
+		vk::ImageLayout mMovableLayout = vk::ImageLayout::eUndefined;
+		vk::DeviceSize mAlignment = 1;
 
 
 		std::shared_ptr<vulkan_command_buffer_manager> mCommandBufferManager;
@@ -55,8 +82,11 @@ namespace cgb {
 		void create_image(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
 			vk::MemoryPropertyFlags properties, vk::Image & image, vulkan_memory & imageMemory);
 		bool has_stencil_component(vk::Format format);
-		void copy_buffer_to_image(vulkan_buffer& buffer, vk::Image image, uint32_t width, uint32_t height);
-		void generate_mipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+		void record_layout_transition(vk::CommandBuffer commandBuffer, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels);
+		void generate_mipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+
+		void begin_move(vk::CommandBuffer commandBuffer, const vulkan_memory& newMemory) override;
+		void finish_move() override;
 
 		void create_texture_image_view();
 		vk::ImageView create_image_view(vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels);
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "vulkan_drawer.h"
+#include "vulkan_geometry_pool.h"
+#include "vulkan_resource_bundle_layout.h"
+#include "vulkan_resource_bundle_group.h"
+#include "vulkan_resource_bundle.h"
+
+namespace cgb {
+
+	// per-draw data of vulkan_indirect_drawer as the shaders read it (std430), see shaders/indirect.vert
+	struct indirect_draw_data {
+		glm::mat4 model;
+		glm::mat4 mvp;
+		// object-space bounds for the culling pass, w of the extent is 0 for objects without bounds, which are never culled
+		glm::vec4 boundsCenter;
+		glm::vec4 boundsExtent;
+	};
+
+	// draws render objects whose geometry lies in one vulkan_geometry_pool with a single indirect draw call
+	// the draw commands and the per-draw data are written into per-frame buffers; the draw command of an object has its
+	// index as first instance, so the vertex shader finds the object's indirect_draw_data at gl_InstanceIndex
+	// with gpu culling, a compute pass tests the bounds against the culling frustum and compacts the visible draw commands,
+	// whose count is then read from a buffer if VK_KHR_draw_indirect_count is available
+	class vulkan_indirect_drawer : public vulkan_drawer
+	{
+	public:
+		// binding 0 of the resource bundle's layout must be an eStorageBuffer binding for the vertex shader, which the drawer
+		// fills with its per-draw data; the bundle must be dynamic and allocated after the drawer has been created
+		vulkan_indirect_drawer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, std::shared_ptr<vulkan_pipeline> pipeline,
+			std::shared_ptr<vulkan_geometry_pool> geometryPool, std::shared_ptr<vulkan_resource_bundle> resourceBundle, uint32_t maxDrawCount);
+		virtual ~vulkan_indirect_drawer();
+
+		// all render objects must have been created with the drawer's geometry pool
+		void draw(std::vector<vulkan_render_object*> renderObjects) override;
+
+		// culls against the culling frustum on the gpu with the given compute shader (shaders/indirect_cull.comp) instead of on the cpu
+		// get_culled_count() is 0 then, since the result is not read back
+		void enable_gpu_culling(const std::string& cullShaderFilename);
+		bool is_gpu_culling_enabled() { return mCullPipeline != nullptr; }
+
+	private:
+		// must match shaders/indirect_cull.comp
+		static const uint32_t CULL_WORKGROUP_SIZE = 64;
+		// the culled draw commands follow the draw count, which is padded to 16 bytes
+		static const vk::DeviceSize CULLED_COMMANDS_OFFSET = 16;
+
+		struct cull_push_constants {
+			glm::vec4 planes[6];
+			uint32_t drawCount;
+			// 1 if the visible draw commands are compacted and counted, 0 if culled draw commands get an instance count of 0
+			uint32_t compact;
+		};
+
+		std::shared_ptr<vulkan_geometry_pool> mGeometryPool;
+		std::shared_ptr<vulkan_resource_bundle> mResourceBundle;
+		uint32_t mMaxDrawCount;
+
+		// one buffer per swap chain image, like the dynamic resources of resource bundles
+		std::vector<std::shared_ptr<vulkan_buffer>> mDrawDataBuffers;
+		std::vector<std::shared_ptr<vulkan_buffer>> mDrawCommandBuffers;
+		std::vector<std::shared_ptr<vulkan_buffer>> mCulledCommandBuffers;
+
+		std::shared_ptr<vulkan_pipeline> mCullPipeline;
+		std::shared_ptr<vulkan_resource_bundle_layout> mCullResourceBundleLayout;
+		std::shared_ptr<vulkan_resource_bundle_group> mCullResourceBundleGroup;
+		std::shared_ptr<vulkan_resource_bundle> mCullResourceBundle;
+
+		// records the culling pass into the staging ring's graphics command buffer, which is submitted before the frame
+		void record_cull_pass(uint32_t drawCount);
+		void record_indirect_draws(uint32_t drawCount, bool culledOnGpu);
+	};
+
+}
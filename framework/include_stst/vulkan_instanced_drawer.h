@@ -0,0 +1,71 @@
+#pragma once
+
+#include "vulkan_drawer.h"
+#include "vulkan_attribute_description_binding.h"
+
+namespace cgb {
+
+	// per-instance data of vulkan_instanced_drawer, read as vertex attributes with instance input rate
+	struct instance_data {
+		glm::mat4 model;
+		// index of the render object in the list which has been drawn, e.g. for picking; with culling, in the list of those which are visible
+		uint32_t objectId;
+		// index of the instanced draw which contains the instance
+		uint32_t groupId;
+	};
+
+	// draws render objects which share their geometry and resource bundle with one instanced draw per group of such objects,
+	// e.g. render objects created from the same prototype
+	// the model matrices and ids of all instances are written into a per-frame instance buffer, which is bound as vertex buffer
+	// with instance input rate, see create_instance_binding(); the uniforms and push uniforms of a group's first render object
+	// are used for the whole group, so the vertex shader takes the model matrix from the instance data and only view and
+	// projection from the push uniforms
+	class vulkan_instanced_drawer : public vulkan_drawer
+	{
+	public:
+		vulkan_instanced_drawer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, std::shared_ptr<vulkan_pipeline> pipeline, uint32_t instanceBinding = 3);
+		virtual ~vulkan_instanced_drawer();
+
+		void draw(std::vector<vulkan_render_object*> renderObjects) override;
+
+		// the vertex input binding of the instance data, which has to be added to the pipeline; the model matrix takes the
+		// four locations starting at firstLocation, the object and group ids the one after them
+		static std::shared_ptr<vulkan_attribute_description_binding> create_instance_binding(uint32_t binding = 3, uint32_t firstLocation = 3);
+
+		// instanced draws of the last draw call
+		size_t get_group_count() { return mGroupCount; }
+
+	private:
+		// the state which the instances of a group share, compared in the order of the members
+		struct instance_key {
+			vk::DescriptorSet descriptorSet;
+			vk::Buffer vertexBuffer;
+			vk::Buffer indexBuffer;
+			vk::IndexType indexType;
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+			uint32_t objectIndex;
+
+			bool same_group(const instance_key& other) const {
+				return std::tie(descriptorSet, vertexBuffer, indexBuffer, indexType, firstIndex, indexCount, vertexOffset)
+					== std::tie(other.descriptorSet, other.vertexBuffer, other.indexBuffer, other.indexType, other.firstIndex, other.indexCount, other.vertexOffset);
+			}
+			bool operator<(const instance_key& other) const {
+				return std::tie(descriptorSet, vertexBuffer, indexBuffer, indexType, firstIndex, indexCount, vertexOffset, objectIndex)
+					< std::tie(other.descriptorSet, other.vertexBuffer, other.indexBuffer, other.indexType, other.firstIndex, other.indexCount, other.vertexOffset, other.objectIndex);
+			}
+		};
+
+		uint32_t mInstanceBinding;
+		// one buffer per swap chain image, like the dynamic resources of resource bundles; grown when it is too small
+		std::vector<std::shared_ptr<vulkan_buffer>> mInstanceBuffers;
+		std::vector<size_t> mInstanceCapacities;
+		// kept between frames to avoid allocations
+		std::vector<instance_key> mInstanceKeys;
+		size_t mGroupCount = 0;
+
+		void reserve_instances(size_t frame, size_t instanceCount);
+	};
+
+}
@@ -10,6 +10,9 @@ namespace cgb {
 
 		vk::DeviceMemory memory;
 		vk::DeviceSize offset;
+		// points to the memory at offset if it is host visible, the memory stays mapped until it is freed
+		void* mapped = nullptr;
+		device_allocation allocation;
 	};
 
 }
\ No newline at end of file
@@ -4,16 +4,55 @@
 #include "vulkan_memory.h"
 
 namespace cgb {
+
+	// a buffer or image whose memory vulkan_memory_manager::defragment() may move, see vulkan_memory_manager::set_movable()
+	class vulkan_movable_resource
+	{
+	public:
+		virtual ~vulkan_movable_resource() {}
+
+		// records a copy to a new resource in the given memory and uses the new resource from now on
+		virtual void begin_move(vk::CommandBuffer commandBuffer, const vulkan_memory& newMemory) = 0;
+		// destroys the old resource, whose memory is freed by the memory manager
+		virtual void finish_move() = 0;
+	};
+
 	class vulkan_memory_manager
 	{
 	public:
 		vulkan_memory_manager();
 		virtual ~vulkan_memory_manager();
 
-		void allocate_memory(vk::MemoryRequirements memRequirements, vk::MemoryPropertyFlags properties, vulkan_memory &cgbMemory);
+		// sub-allocates the memory from the context's device_memory_allocator; kind must be optimal for optimally tiled images
+		void allocate_memory(vk::MemoryRequirements memRequirements, vk::MemoryPropertyFlags properties, vulkan_memory &cgbMemory, device_resource_kind kind = device_resource_kind::linear);
 		void free_memory(vulkan_memory &cgbMemory);
+
+		// allows or forbids defragment() to move the resource's memory, alignment is the one of the resource's memory requirements
+		// resources are not movable unless they allow it; a move which has been planned already is finished, but is the last one
+		void set_movable(vulkan_movable_resource* resource, const vulkan_memory& cgbMemory, vk::DeviceSize alignment, bool movable = true);
+
+		// moves buffers and images out of the least used block of device memory into fuller ones, so that the block can be released
+		// the copies are recorded into the staging ring's graphics command buffer, at most maxBytes per pass;
+		// a new pass is only planned once the frames which might still use the old resources have finished
+		// called by vulkan_renderer at the start of each frame
+		void defragment(vk::DeviceSize maxBytes);
+		// called by resources which are destroyed while they are being moved
+		void cancel_move(vulkan_movable_resource* resource);
+
+		device_memory_statistics get_statistics() const { return cgb::context().memory_allocator().statistics(); }
+		std::vector<device_memory_budget> get_budgets() const { return cgb::context().memory_allocator().budgets(); }
+		// writes the statistics and heap budgets to the log
+		void log_statistics() const { cgb::context().memory_allocator().log_statistics(); }
+
 	private:
-		uint32_t find_memory_type(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+		std::vector<device_defragmentation_move> mPendingMoves;
+		// the moves are finished once their copies have been executed and the frames of mPendingFrameSerial have finished
+		uint64_t mPendingTicket = 0;
+		uint64_t mPendingFrameSerial = 0;
+		// resources with pending moves which must not be moved again
+		std::vector<vulkan_movable_resource*> mUnmovableAfterMove;
+
+		static void assign_allocation(const device_allocation& allocation, vulkan_memory &cgbMemory);
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#pragma once
+#include "vulkan_context.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "vulkan_image.h"
+#include "vulkan_buffer.h"
+#include "vulkan_memory.h"
+
+namespace cgb {
+
+	// a frame graph: passes declare which images and buffers they use and how, and the graph derives the synchronization
+	// passes are executed in the order in which they have been added, which has to be an order in which every resource is
+	// written before it is read; compile() culls the passes whose results are never used, emits the pipeline barriers and
+	// layout transitions between the remaining passes batched into one pipelineBarrier per pass, and creates the transient images,
+	// whose memory is shared by images which are not used by the same passes
+	// the graph is compiled once and executed every frame; to change it, e.g. after a resize, clear() it and add it again
+	class vulkan_render_graph
+	{
+	public:
+		using resource_id = uint32_t;
+		using pass_id = uint32_t;
+
+		// how a pass uses a resource; determines the pipeline stages, the access, the image layout and, for transient images, the image usage
+		enum class resource_usage {
+			color_attachment,
+			depth_stencil_attachment,
+			// depth test without depth writes
+			depth_stencil_read,
+			// sampled in vertex, fragment or compute shaders
+			shader_read,
+			// storage image or storage buffer in compute or fragment shaders
+			storage_read,
+			storage_write,
+			transfer_src,
+			transfer_dst,
+			shading_rate_image,
+			vertex_buffer,
+			index_buffer,
+			indirect_buffer,
+			uniform_buffer
+		};
+
+		// a transient image, which is created by compile() and only exists for the passes which use it
+		struct image_desc {
+			uint32_t width;
+			uint32_t height;
+			vk::Format format;
+			vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+		};
+
+		// executes a pass, the barriers for its resources have been recorded into the command buffer already
+		using record_function = std::function<void(vk::CommandBuffer commandBuffer)>;
+
+		vulkan_render_graph();
+		virtual ~vulkan_render_graph();
+
+		resource_id create_image(const std::string& name, const image_desc& desc);
+		// images which are used before or after the graph; they are expected in initialLayout when the graph is executed
+		// and are left in finalLayout, which keeps the last layout within the graph if it is eUndefined
+		resource_id import_image(const std::string& name, std::shared_ptr<vulkan_image> image, vk::ImageLayout initialLayout, vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined);
+		resource_id import_buffer(const std::string& name, std::shared_ptr<vulkan_buffer> buffer);
+
+		pass_id add_pass(const std::string& name, record_function record);
+		// declares that the pass reads or writes the resource; usages which write are color and depth attachments,
+		// storage writes and transfer destinations, and all of them keep what they do not overwrite, so every use of a
+		// resource keeps the passes which have written it before
+		void use(pass_id passId, resource_id resourceId, resource_usage usage);
+		// the pass is never culled, e.g. because it writes to the swap chain outside of the graph
+		void set_side_effects(pass_id passId);
+
+		void compile();
+		// records all passes which have not been culled, must only be called after compile()
+		void execute(vk::CommandBuffer commandBuffer);
+		// destroys the transient images and removes all passes and resources
+		// like the destructor, it must only be called when the device does not use the transient images anymore
+		void clear();
+
+		// only valid after compile(), also for transient images which are used as render pass attachments or in descriptor sets
+		std::shared_ptr<vulkan_image> get_image(resource_id resourceId);
+		std::shared_ptr<vulkan_buffer> get_buffer(resource_id resourceId);
+		// the layout in which a pass finds an image with the given usage, e.g. for the initial and final layouts of render pass attachments
+		static vk::ImageLayout get_layout(resource_usage usage);
+
+		bool is_culled(pass_id passId);
+		// pipelineBarrier calls and image or buffer barriers which execute() records, including those after the last pass
+		size_t get_barrier_batch_count() { return mBarrierBatchCount; }
+		size_t get_barrier_count() { return mBarrierCount; }
+		// memory of the transient images with and without sharing it between them
+		vk::DeviceSize get_transient_memory_size() { return mTransientMemorySize; }
+		vk::DeviceSize get_unaliased_memory_size() { return mUnaliasedMemorySize; }
+
+	private:
+		struct usage_info {
+			vk::PipelineStageFlags stages;
+			vk::AccessFlags access;
+			vk::ImageLayout layout;
+			bool write;
+			vk::ImageUsageFlags imageUsage;
+		};
+
+		struct resource_access {
+			resource_id resource;
+			resource_usage usage;
+		};
+
+		struct pass {
+			std::string name;
+			record_function record;
+			std::vector<resource_access> accesses;
+			bool sideEffects = false;
+			bool culled = false;
+
+			// recorded before the pass
+			vk::PipelineStageFlags srcStages;
+			vk::PipelineStageFlags dstStages;
+			std::vector<vk::ImageMemoryBarrier> imageBarriers;
+			std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+			// buffers get new handles when the defragmentation moves them, so the handles are set by execute()
+			std::vector<resource_id> bufferBarrierResources;
+		};
+
+		// what has happened to a resource since the last barrier which covers it
+		struct resource_state {
+			vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+			// stages and access of the last write or layout transition
+			vk::PipelineStageFlags writeStages;
+			vk::AccessFlags writeAccess;
+			// stages and access to which the last write has been made visible
+			vk::PipelineStageFlags visibleStages;
+			vk::AccessFlags visibleAccess;
+			// stages which have read since the last write
+			vk::PipelineStageFlags readStages;
+		};
+
+		struct resource {
+			std::string name;
+			bool transient;
+			image_desc desc;
+			std::shared_ptr<vulkan_image> image;
+			std::shared_ptr<vulkan_buffer> buffer;
+			vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined;
+			vk::ImageLayout finalLayout = vk::ImageLayout::eUndefined;
+
+			// filled by compile(): first and last pass of the schedule which use it
+			uint32_t firstUse = UINT32_MAX;
+			uint32_t lastUse = 0;
+			// the memory of transient images
+			uint32_t memorySlot = UINT32_MAX;
+			resource_state state;
+		};
+
+		// memory which is shared by transient images whose lifetimes do not overlap
+		struct memory_slot {
+			vk::MemoryRequirements requirements;
+			// lifetimes of the images which have been placed into the slot, as first and last use
+			std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+			vulkan_memory memory;
+			// the last use of the slot's images, which the first use of the next image has to wait for
+			vk::PipelineStageFlags lastStages;
+			vk::AccessFlags lastWriteAccess;
+		};
+
+		std::vector<pass> mPasses;
+		std::vector<resource> mResources;
+		std::vector<memory_slot> mMemorySlots;
+		// indices of the passes which have not been culled, in execution order
+		std::vector<pass_id> mSchedule;
+		bool mCompiled = false;
+
+		// recorded after the last pass for the imported resources
+		vk::PipelineStageFlags mFinalSrcStages;
+		vk::PipelineStageFlags mFinalDstStages;
+		std::vector<vk::ImageMemoryBarrier> mFinalImageBarriers;
+		std::vector<vk::BufferMemoryBarrier> mFinalBufferBarriers;
+		std::vector<resource_id> mFinalBufferBarrierResources;
+
+		size_t mBarrierBatchCount = 0;
+		size_t mBarrierCount = 0;
+		vk::DeviceSize mTransientMemorySize = 0;
+		vk::DeviceSize mUnaliasedMemorySize = 0;
+
+		static usage_info get_usage_info(resource_usage usage);
+		static vk::ImageAspectFlags get_aspects(vk::Format format);
+
+		void cull_passes();
+		void create_transient_images();
+		// simulates the schedule and computes the barriers of all passes
+		void build_barriers();
+		// adds the barrier which the access needs to the pass, if any, and updates the state of the resource
+		void add_barrier(pass& schedulePass, resource_id resourceId, const usage_info& info);
+		void update_buffer_handles(std::vector<vk::BufferMemoryBarrier>& barriers, const std::vector<resource_id>& resources);
+		void destroy_transient_images();
+	};
+
+}
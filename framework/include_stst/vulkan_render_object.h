@@ -14,6 +14,7 @@
 #include "vulkan_resource_bundle_layout.h"
 #include "vulkan_resource_bundle_group.h"
 #include "vulkan_resource_bundle.h"
+#include "vulkan_geometry_pool.h"
 
 struct Vertex {
 	glm::vec3 pos;
@@ -83,15 +84,26 @@ namespace cgb {
 	{
 	public:
 		// simple standard constructor
-		vulkan_render_object(std::vector<std::shared_ptr<vulkan_buffer>> vertexBuffers, std::shared_ptr<vulkan_buffer> indexBuffer, size_t indexCount); // TODO resourceBundles/DescriptorSets for Uniforms and Textures
+		vulkan_render_object(std::vector<std::shared_ptr<vulkan_buffer>> vertexBuffers, std::shared_ptr<vulkan_buffer> indexBuffer, size_t indexCount, vk::IndexType indexType = vk::IndexType::eUint32); // TODO resourceBundles/DescriptorSets for Uniforms and Textures
 
 
 		vulkan_render_object(uint32_t imageCount, std::vector<Vertex> vertices, std::vector<uint32_t> indices,
 			std::shared_ptr<vulkan_resource_bundle_layout> resourceBundleLayout, std::shared_ptr<vulkan_resource_bundle_group> resourceBundleGroup,
 			std::shared_ptr<vulkan_texture> texture, std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, std::vector<std::shared_ptr<vulkan_texture>> debugTextures);
+
+		// adds the geometry to the shared buffers of the pool instead of creating its own, for vulkan_indirect_drawer
+		// such objects have no resource bundle, the drawer provides the uniforms and textures
+		vulkan_render_object(std::shared_ptr<vulkan_geometry_pool> geometryPool, std::vector<Vertex> vertices, std::vector<uint32_t> indices);
+
+		// shares the buffers and the resource bundle of the prototype and only has its own uniforms, e.g. for many copies of a prop,
+		// which vulkan_instanced_drawer then draws with one instanced draw; the vertices and indices are not copied
+		vulkan_render_object(const vulkan_render_object& prototype, const UniformBufferObject& ubo);
 		virtual ~vulkan_render_object();
 
 		size_t get_index_count() { return mIndexCount; }
+		vk::IndexType get_index_type() { return mIndexType; }
+		// the range of the index and vertex buffers which belongs to this object, the whole buffers unless they are shared
+		const vulkan_mesh_range& get_mesh_range() { return mMeshRange; }
 		std::vector<Vertex> get_vertices() { return mVertices; }
 		std::vector<uint32_t> get_indices() { return mIndices; }
 
@@ -101,10 +113,20 @@ namespace cgb {
 		//void setIndexBuffer(vk::Buffer indexBuffer) { _indexBuffer = indexBuffer; }
 
 		PushUniforms get_push_uniforms() { return mPushUniforms; }
+		const UniformBufferObject& get_uniforms() { return mUniforms; }
+
+		// bounds in object space, used for view-frustum culling; objects without bounds are never culled
+		void set_bounds(const aabb& bounds) { mBounds = bounds; }
+		const aabb& get_bounds() { return mBounds; }
 
 		std::shared_ptr<vulkan_resource_bundle> get_resource_bundle() { return mResourceBundle; }
 
+		// the uniforms are copied into the frame allocator's current frame when the object is drawn; they are used until the next update,
+		// so currentImage is not needed anymore
+		// binding 0 of the resource bundle layout must be an eUniformBufferDynamic binding
 		void update_uniform_buffer(uint32_t currentImage, UniformBufferObject ubo);
+		// dynamic offset of the uniforms in the current frame, for bindDescriptorSets
+		uint32_t get_uniform_offset();
 
 	private:
 		uint32_t mImageCount;
@@ -115,10 +137,16 @@ namespace cgb {
 		std::vector<std::shared_ptr<vulkan_buffer>> mVertexBuffers;
 		std::shared_ptr<vulkan_buffer> mIndexBuffer; 
 		size_t mIndexCount;
+		vk::IndexType mIndexType;
+		vulkan_mesh_range mMeshRange;
 
-		std::vector<std::shared_ptr<vulkan_buffer>> mUniformBuffers;
+		UniformBufferObject mUniforms = {};
+		uint32_t mUniformOffset = 0;
+		// frame serial of the frame allocator when mUniforms were last written, 0 if never
+		uint64_t mUniformFrameSerial = 0;
 
 		PushUniforms mPushUniforms;
+		aabb mBounds;
 		// TODO PERFORMANCE use multiple descriptor sets / per render pass, e.g. shadow pass does not use textures
 		// or like suggested for AMD Hardware, use one large descriptor set for everything and index into Texture arrays and uniforms
 		// suggestion: use an array of descriptor sets, the drawer then can decide, which descriptor set to use, 
@@ -126,7 +154,7 @@ namespace cgb {
 		// this offers the most flexibility for the user of the framework, while still being easy to use
 		std::shared_ptr<vulkan_resource_bundle> mResourceBundle;
 
-		void create_uniform_buffer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager);
+		void write_uniforms();
 		void create_descriptor_sets(std::shared_ptr<vulkan_resource_bundle_layout> resourceBundleLayout, std::shared_ptr<vulkan_resource_bundle_group> resourceBundleGroup,
 			std::shared_ptr<vulkan_texture> texture, std::vector<std::shared_ptr<vulkan_texture>> debugTextures);
 	};
@@ -9,6 +9,7 @@
 #include "vulkan_drawer.h"
 #include "vulkan_image_presenter.h"
 #include "vulkan_render_queue.h"
+#include "vulkan_render_graph.h"
 
 namespace cgb {
 
@@ -21,6 +22,9 @@ namespace cgb {
 
 		void start_frame();
 		void render(std::vector<vulkan_render_object*> renderObjects, vulkan_drawer* drawer);
+		// records the passes of a compiled render graph into this frame's primary command buffer, ahead of the renderer's render pass
+		// they are part of the same submission, so the graph's barriers synchronize them without semaphores
+		void render(vulkan_render_graph& renderGraph);
 		void end_frame();
 
 		// manually submit renderer, not needed for OpenGl, done automatically on end_frame or if rendering a successor
@@ -0,0 +1,110 @@
+#pragma once
+#include "vulkan_context.h"
+
+#include "vulkan_memory.h"
+
+#include <vector>
+#include <deque>
+
+namespace cgb {
+
+	// a persistently mapped, host visible staging buffer from which all uploads sub-allocate
+	// copies to new resources are recorded on the dedicated transfer queue (cgb::context().transfer_queue()) if the device has one,
+	// and the uploaded resources are handed over to the graphics queue with queue family ownership transfers;
+	// updates of resources which might be in use are recorded on the graphics queue;
+	// commands which need the graphics queue, e.g. mipmap generation, are recorded into a second command buffer per batch
+	// flush() submits the batch with a fence, and the batch's part of the ring is reused as soon as that fence is signaled
+	// vulkan_render_queue and vulkan_command_buffer_manager flush before they submit, so uploads are always
+	// executed before the work that uses them
+	class vulkan_staging_ring
+	{
+	public:
+		// identifies the batch which contains an upload, see is_complete() and wait()
+		// 0 is never handed out and is always complete
+		using upload_ticket = uint64_t;
+
+		vulkan_staging_ring(vk::DeviceSize size);
+		virtual ~vulkan_staging_ring();
+
+		// copies the data into the ring and records a copy to the given buffer, which is owned by the graphics queue family afterwards
+		// the copy is recorded on the graphics queue after a barrier which waits for all work submitted before, so the buffer may be in use;
+		// newBuffer allows the copy on the dedicated transfer queue, which requires an exclusive buffer that no queue has used yet
+		upload_ticket upload_to_buffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size, bool newBuffer = false);
+
+		// copies the pixels into the ring and records copies to mip level 0 of the given image, whose contents are discarded
+		// all mip levels are left in transfer dst layout and owned by the graphics queue family, ready for get_graphics_command_buffer()
+		// images larger than the ring are copied in chunks of rows
+		upload_ticket upload_to_image(vk::Image dstImage, const void* pixels, uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t mipLevels);
+		// copies the data into the ring and records the given copies, whose buffer offsets are relative to data, e.g. for images
+		// whose mip levels are precomputed or compressed; the data must fit into the ring, the image is left like by upload_to_image()
+		upload_ticket upload_to_image_levels(vk::Image dstImage, const void* data, vk::DeviceSize size, const std::vector<vk::BufferImageCopy>& regions, uint32_t mipLevels);
+
+		// graphics queue command buffer of the current batch, which is executed after the batch's copies, e.g. for layout transitions
+		// only valid until the next upload or flush, since a full ring submits the batch
+		vk::CommandBuffer get_graphics_command_buffer();
+		// ticket of the batch which get_graphics_command_buffer() records into
+		upload_ticket get_current_ticket();
+
+		// submits all uploads recorded since the last flush in one submission per queue, does nothing if there are none
+		void flush();
+
+		// flushes and waits until all uploads have been executed
+		void wait_idle();
+
+		// called before work is submitted to the given queue: flushes, and also waits for the uploads if the queue
+		// is not the graphics queue, since submission order only orders work within one queue
+		void flush_for(vk::Queue queue);
+
+		// returns true if the batch of the ticket has been executed, without blocking
+		bool is_complete(upload_ticket ticket);
+		// flushes the batch of the ticket if necessary and waits until it has been executed
+		void wait(upload_ticket ticket);
+
+		vk::DeviceSize get_size() { return mRing.size(); }
+		// false if the transfer queue is the graphics queue, in which case each batch is one submission
+		bool has_dedicated_transfer_queue() { return mTransferQueueFamily != mGraphicsQueueFamily; }
+
+	private:
+		struct batch {
+			vk::CommandBuffer transferCommandBuffer;
+			// only used with a dedicated transfer queue, equal to transferCommandBuffer otherwise
+			vk::CommandBuffer graphicsCommandBuffer;
+			// signaled by the transfer submission, waited on by the graphics submission
+			vk::Semaphore transferFinished;
+			vk::Fence fence;
+			upload_ticket ticket = 0;
+			// false if the batch only recorded commands but did not allocate from the ring
+			bool hasRingRanges = false;
+		};
+
+		vk::Buffer mBuffer;
+		vulkan_memory mMemory;
+		ring_allocator mRing;
+
+		uint32_t mTransferQueueFamily;
+		uint32_t mGraphicsQueueFamily;
+		vk::Queue mTransferQueue;
+		vk::Queue mGraphicsQueue;
+		vk::CommandPool mTransferCommandPool;
+		vk::CommandPool mGraphicsCommandPool;
+
+		// being recorded, its ticket is 0 if nothing has been recorded since the last flush
+		batch mCurrentBatch;
+		// submitted, oldest first
+		std::deque<batch> mSubmittedBatches;
+		// reset and ready to record
+		std::vector<batch> mFreeBatches;
+		upload_ticket mNextTicket = 1;
+
+		// begins recording a batch if none is being recorded
+		batch& current_batch();
+		// allocates from the ring, flushes and waits for the oldest batches if it is full
+		vk::DeviceSize allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+		// hands an uploaded image over to the graphics queue if there is a dedicated transfer queue
+		void hand_over_image(vk::ImageMemoryBarrier& barrier);
+		// retires all submitted batches whose fences are signaled
+		void retire_completed_batches();
+		void retire_oldest_batch();
+	};
+
+}
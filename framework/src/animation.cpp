@@ -0,0 +1,346 @@
+#include "animation.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CGB_ANIMATION_SSE
+#endif
+
+namespace cgb
+{
+	namespace
+	{
+		/** Multiplies two column-major 4x4 matrices */
+		inline glm::mat4 multiply(const glm::mat4& a, const glm::mat4& b)
+		{
+#ifdef CGB_ANIMATION_SSE
+			const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+			const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+			const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+			const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+			glm::mat4 result;
+			for (int c = 0; c < 4; ++c) {
+				__m128 r = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+				r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+				r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+				r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+				_mm_storeu_ps(&result[c][0], r);
+			}
+			return result;
+#else
+			return a * b;
+#endif
+		}
+
+		void lerp_array(const float* a, const float* b, float pWeight, float* out, size_t pCount)
+		{
+			size_t i = 0;
+#ifdef CGB_ANIMATION_SSE
+			const __m128 w = _mm_set1_ps(pWeight);
+			for (; i + 4 <= pCount; i += 4) {
+				const __m128 va = _mm_loadu_ps(a + i);
+				const __m128 vb = _mm_loadu_ps(b + i);
+				_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), w)));
+			}
+#endif
+			for (; i < pCount; ++i) {
+				out[i] = a[i] + (b[i] - a[i]) * pWeight;
+			}
+		}
+
+		glm::vec4 sample_channel(const keyframe_channel& pChannel, float pTime, bool pIsRotation)
+		{
+			const auto& times = pChannel.mTimes;
+			if (times.size() == 1 || pTime <= times.front()) {
+				return pChannel.value_at(0);
+			}
+			if (pTime >= times.back()) {
+				return pChannel.value_at(times.size() - 1);
+			}
+			const size_t k1 = static_cast<size_t>(std::upper_bound(times.begin(), times.end(), pTime) - times.begin());
+			const size_t k0 = k1 - 1;
+			const float alpha = (pTime - times[k0]) / (times[k1] - times[k0]);
+			const glm::vec4 v0 = pChannel.value_at(k0);
+			glm::vec4 v1 = pChannel.value_at(k1);
+			if (!pIsRotation) {
+				return glm::mix(v0, v1, alpha);
+			}
+			// normalized lerp along the shortest path
+			if (glm::dot(v0, v1) < 0.0f) {
+				v1 = -v1;
+			}
+			return glm::normalize(glm::mix(v0, v1, alpha));
+		}
+
+		template <typename Key, typename F>
+		keyframe_channel import_channel(const Key* pKeys, unsigned int pCount, double pTicksPerSecond, uint32_t pComponentCount, F pGetValue, bool pQuantize)
+		{
+			keyframe_channel channel;
+			channel.mComponentCount = pComponentCount;
+			channel.mTimes.resize(pCount);
+			std::vector<float> values(static_cast<size_t>(pCount) * pComponentCount);
+			for (unsigned int k = 0; k < pCount; ++k) {
+				channel.mTimes[k] = static_cast<float>(pKeys[k].mTime / pTicksPerSecond);
+				const glm::vec4 v = pGetValue(pKeys[k].mValue);
+				for (uint32_t c = 0; c < pComponentCount; ++c) {
+					values[k * pComponentCount + c] = v[c];
+				}
+			}
+
+			if (!pQuantize || 0 == pCount) {
+				channel.mValues = std::move(values);
+				return channel;
+			}
+
+			glm::vec4 maxValue{ std::numeric_limits<float>::lowest() };
+			channel.mMin = glm::vec4{ std::numeric_limits<float>::max() };
+			for (unsigned int k = 0; k < pCount; ++k) {
+				for (uint32_t c = 0; c < pComponentCount; ++c) {
+					channel.mMin[c] = std::min(channel.mMin[c], values[k * pComponentCount + c]);
+					maxValue[c] = std::max(maxValue[c], values[k * pComponentCount + c]);
+				}
+			}
+			channel.mExtent = glm::vec4{ 0.0f };
+			for (uint32_t c = 0; c < pComponentCount; ++c) {
+				channel.mExtent[c] = maxValue[c] - channel.mMin[c];
+			}
+			channel.mQuantizedValues.resize(values.size());
+			for (size_t i = 0; i < values.size(); ++i) {
+				const uint32_t c = static_cast<uint32_t>(i % pComponentCount);
+				const float normalized = channel.mExtent[c] > 0.0f ? (values[i] - channel.mMin[c]) / channel.mExtent[c] : 0.0f;
+				channel.mQuantizedValues[i] = static_cast<uint16_t>(std::lround(glm::clamp(normalized, 0.0f, 1.0f) * 65535.0f));
+			}
+			return channel;
+		}
+	}
+
+	void pose::resize(size_t pBoneCount)
+	{
+		for (auto* component : { &mTx, &mTy, &mTz, &mRx, &mRy, &mRz, &mRw, &mSx, &mSy, &mSz }) {
+			component->resize(pBoneCount);
+		}
+	}
+
+	void pose::set(size_t pBone, const glm::vec3& pTranslation, const glm::quat& pRotation, const glm::vec3& pScale)
+	{
+		mTx[pBone] = pTranslation.x; mTy[pBone] = pTranslation.y; mTz[pBone] = pTranslation.z;
+		mRx[pBone] = pRotation.x; mRy[pBone] = pRotation.y; mRz[pBone] = pRotation.z; mRw[pBone] = pRotation.w;
+		mSx[pBone] = pScale.x; mSy[pBone] = pScale.y; mSz[pBone] = pScale.z;
+	}
+
+	glm::mat4 pose::local_matrix(size_t pBone) const
+	{
+		glm::mat4 m = glm::mat4_cast(rotation(pBone));
+		m[0] *= mSx[pBone];
+		m[1] *= mSy[pBone];
+		m[2] *= mSz[pBone];
+		m[3] = glm::vec4(translation(pBone), 1.0f);
+		return m;
+	}
+
+	int32_t skeleton::find_bone(const std::string& pName) const
+	{
+		const auto it = std::find(mNames.begin(), mNames.end(), pName);
+		return it == mNames.end() ? -1 : static_cast<int32_t>(it - mNames.begin());
+	}
+
+	glm::vec4 keyframe_channel::value_at(size_t pKey) const
+	{
+		glm::vec4 result{ 0.0f };
+		const size_t offset = pKey * mComponentCount;
+		if (quantized()) {
+			for (uint32_t c = 0; c < mComponentCount; ++c) {
+				result[c] = mMin[c] + mExtent[c] * (static_cast<float>(mQuantizedValues[offset + c]) / 65535.0f);
+			}
+		}
+		else {
+			for (uint32_t c = 0; c < mComponentCount; ++c) {
+				result[c] = mValues[offset + c];
+			}
+		}
+		return result;
+	}
+
+	size_t keyframe_channel::size_in_bytes() const
+	{
+		return mTimes.size() * sizeof(float) + mValues.size() * sizeof(float) + mQuantizedValues.size() * sizeof(uint16_t);
+	}
+
+	animation_clip animation_clip::from_assimp(const aiAnimation* pAnimation, const skeleton& pSkeleton, bool pQuantize)
+	{
+		std::unordered_map<std::string, int32_t> boneIndices;
+		boneIndices.reserve(pSkeleton.bone_count());
+		for (size_t i = 0; i < pSkeleton.bone_count(); ++i) {
+			boneIndices.emplace(pSkeleton.mNames[i], static_cast<int32_t>(i));
+		}
+
+		const double ticksPerSecond = 0.0 != pAnimation->mTicksPerSecond ? pAnimation->mTicksPerSecond : 25.0;
+		animation_clip clip;
+		clip.mName = pAnimation->mName.data;
+		clip.mDuration = static_cast<float>(pAnimation->mDuration / ticksPerSecond);
+		clip.mTracks.reserve(pAnimation->mNumChannels);
+		for (unsigned int i = 0; i < pAnimation->mNumChannels; ++i) {
+			const aiNodeAnim* channel = pAnimation->mChannels[i];
+			const auto bone = boneIndices.find(channel->mNodeName.data);
+			if (bone == boneIndices.end()) {
+				LOG_WARNING(fmt::format("Animation '{}' has a channel for node '{}' which is not part of the skeleton", clip.mName, channel->mNodeName.data));
+				continue;
+			}
+
+			auto& track = clip.mTracks.emplace_back();
+			track.mBoneIndex = bone->second;
+			track.mTranslations = import_channel(channel->mPositionKeys, channel->mNumPositionKeys, ticksPerSecond, 3,
+				[](const aiVector3D& v) { return glm::vec4(v.x, v.y, v.z, 0.0f); }, pQuantize);
+			track.mRotations = import_channel(channel->mRotationKeys, channel->mNumRotationKeys, ticksPerSecond, 4,
+				[](const aiQuaternion& q) { return glm::vec4(q.x, q.y, q.z, q.w); }, pQuantize);
+			track.mScales = import_channel(channel->mScalingKeys, channel->mNumScalingKeys, ticksPerSecond, 3,
+				[](const aiVector3D& v) { return glm::vec4(v.x, v.y, v.z, 0.0f); }, pQuantize);
+		}
+		return clip;
+	}
+
+	size_t animation_clip::size_in_bytes() const
+	{
+		size_t size = 0;
+		for (const auto& track : mTracks) {
+			size += track.mTranslations.size_in_bytes() + track.mRotations.size_in_bytes() + track.mScales.size_in_bytes();
+		}
+		return size;
+	}
+
+	void animation_clip::sample(float pTime, pose& outPose, bool pLoop) const
+	{
+		float time = pTime;
+		if (mDuration > 0.0f) {
+			if (pLoop) {
+				time = std::fmod(time, mDuration);
+				if (time < 0.0f) {
+					time += mDuration;
+				}
+			}
+			else {
+				time = glm::clamp(time, 0.0f, mDuration);
+			}
+		}
+
+		for (const auto& track : mTracks) {
+			const size_t b = static_cast<size_t>(track.mBoneIndex);
+			if (!track.mTranslations.empty()) {
+				const auto t = sample_channel(track.mTranslations, time, false);
+				outPose.mTx[b] = t.x; outPose.mTy[b] = t.y; outPose.mTz[b] = t.z;
+			}
+			if (!track.mRotations.empty()) {
+				const auto r = sample_channel(track.mRotations, time, true);
+				outPose.mRx[b] = r.x; outPose.mRy[b] = r.y; outPose.mRz[b] = r.z; outPose.mRw[b] = r.w;
+			}
+			if (!track.mScales.empty()) {
+				const auto s = sample_channel(track.mScales, time, false);
+				outPose.mSx[b] = s.x; outPose.mSy[b] = s.y; outPose.mSz[b] = s.z;
+			}
+		}
+	}
+
+	void blend_poses(const pose& pFrom, const pose& pTo, float pWeight, pose& outPose)
+	{
+		assert(pFrom.size() == pTo.size());
+		const size_t n = pFrom.size();
+		outPose.resize(n);
+
+		lerp_array(pFrom.mTx.data(), pTo.mTx.data(), pWeight, outPose.mTx.data(), n);
+		lerp_array(pFrom.mTy.data(), pTo.mTy.data(), pWeight, outPose.mTy.data(), n);
+		lerp_array(pFrom.mTz.data(), pTo.mTz.data(), pWeight, outPose.mTz.data(), n);
+		lerp_array(pFrom.mSx.data(), pTo.mSx.data(), pWeight, outPose.mSx.data(), n);
+		lerp_array(pFrom.mSy.data(), pTo.mSy.data(), pWeight, outPose.mSy.data(), n);
+		lerp_array(pFrom.mSz.data(), pTo.mSz.data(), pWeight, outPose.mSz.data(), n);
+
+		// Rotations: nlerp with the target negated where necessary to take the shortest path
+		size_t i = 0;
+#ifdef CGB_ANIMATION_SSE
+		const __m128 w = _mm_set1_ps(pWeight);
+		const __m128 signBit = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= n; i += 4) {
+			const __m128 ax = _mm_loadu_ps(&pFrom.mRx[i]), ay = _mm_loadu_ps(&pFrom.mRy[i]), az = _mm_loadu_ps(&pFrom.mRz[i]), aw = _mm_loadu_ps(&pFrom.mRw[i]);
+			__m128 bx = _mm_loadu_ps(&pTo.mRx[i]), by = _mm_loadu_ps(&pTo.mRy[i]), bz = _mm_loadu_ps(&pTo.mRz[i]), bw = _mm_loadu_ps(&pTo.mRw[i]);
+			const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+			const __m128 flip = _mm_and_ps(dot, signBit);
+			bx = _mm_xor_ps(bx, flip); by = _mm_xor_ps(by, flip); bz = _mm_xor_ps(bz, flip); bw = _mm_xor_ps(bw, flip);
+			const __m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), w));
+			const __m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), w));
+			const __m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), w));
+			const __m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), w));
+			const __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+			const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSq));
+			_mm_storeu_ps(&outPose.mRx[i], _mm_mul_ps(rx, invLength));
+			_mm_storeu_ps(&outPose.mRy[i], _mm_mul_ps(ry, invLength));
+			_mm_storeu_ps(&outPose.mRz[i], _mm_mul_ps(rz, invLength));
+			_mm_storeu_ps(&outPose.mRw[i], _mm_mul_ps(rw, invLength));
+		}
+#endif
+		for (; i < n; ++i) {
+			const glm::vec4 a(pFrom.mRx[i], pFrom.mRy[i], pFrom.mRz[i], pFrom.mRw[i]);
+			glm::vec4 b(pTo.mRx[i], pTo.mRy[i], pTo.mRz[i], pTo.mRw[i]);
+			if (glm::dot(a, b) < 0.0f) {
+				b = -b;
+			}
+			const glm::vec4 r = glm::normalize(glm::mix(a, b, pWeight));
+			outPose.mRx[i] = r.x; outPose.mRy[i] = r.y; outPose.mRz[i] = r.z; outPose.mRw[i] = r.w;
+		}
+	}
+
+	void compute_global_transforms(const skeleton& pSkeleton, const pose& pPose, std::vector<glm::mat4>& outGlobalTransforms)
+	{
+		const size_t n = pSkeleton.bone_count();
+		outGlobalTransforms.resize(n);
+		for (size_t i = 0; i < n; ++i) {
+			const int32_t parent = pSkeleton.mParents[i];
+			assert(parent < static_cast<int32_t>(i));
+			outGlobalTransforms[i] = parent < 0
+				? pPose.local_matrix(i)
+				: multiply(outGlobalTransforms[parent], pPose.local_matrix(i));
+		}
+	}
+
+	void compute_skinning_palette(const std::vector<glm::mat4>& pGlobalTransforms, const Mesh& pMesh, std::vector<glm::mat4>& outPalette)
+	{
+		const auto& bones = pMesh.m_bones;
+		outPalette.resize(bones.size());
+		if (bones.empty()) {
+			return;
+		}
+		// Like the mesh's vertices, the palette is relative to the model's root node
+		const glm::mat4 inverseRoot = glm::inverse(pGlobalTransforms.at(0));
+		for (size_t j = 0; j < bones.size(); ++j) {
+			outPalette[j] = bones[j].m_node_index < 0
+				? glm::mat4(1.0f)
+				: multiply(multiply(inverseRoot, pGlobalTransforms[bones[j].m_node_index]), bones[j].m_offset_matrix);
+		}
+	}
+
+	void update_characters(std::span<animated_character> pCharacters, size_t pMaxThreads)
+	{
+		// runs every frame, so the threads are kept alive in the shared pool
+		worker_pool::shared().run(pCharacters.size(), [&pCharacters](size_t c, size_t) {
+			auto& character = pCharacters[c];
+			const auto& restPose = character.mSkeleton->mRestPose;
+			character.mPose = restPose;
+
+			float accumulatedWeight = 0.0f;
+			for (const auto& layer : character.mLayers) {
+				if (layer.mWeight <= 0.0f || nullptr == layer.mClip) {
+					continue;
+				}
+				if (0.0f == accumulatedWeight) {
+					layer.mClip->sample(layer.mTime, character.mPose, layer.mLoop);
+					accumulatedWeight = layer.mWeight;
+					continue;
+				}
+				character.mLayerPose = restPose;
+				layer.mClip->sample(layer.mTime, character.mLayerPose, layer.mLoop);
+				accumulatedWeight += layer.mWeight;
+				// incremental weighted average, which normalizes the weights of all layers
+				blend_poses(character.mPose, character.mLayerPose, layer.mWeight / accumulatedWeight, character.mPose);
+			}
+
+			compute_global_transforms(*character.mSkeleton, character.mPose, character.mGlobalTransforms);
+		}, pMaxThreads);
+	}
+}
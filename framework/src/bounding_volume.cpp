@@ -0,0 +1,74 @@
+#include "bounding_volume.h"
+
+namespace cgb
+{
+	aabb aabb::transformed(const glm::mat4& pMatrix) const
+	{
+		if (empty()) {
+			return *this;
+		}
+		// Arvo's method: each column's contribution to the new extent only depends on its sign
+		const glm::vec3 center = glm::vec3(pMatrix * glm::vec4(this->center(), 1.0f));
+		const glm::vec3 halfExtent = half_extent();
+		const glm::vec3 newHalfExtent =
+			glm::abs(glm::vec3(pMatrix[0])) * halfExtent.x +
+			glm::abs(glm::vec3(pMatrix[1])) * halfExtent.y +
+			glm::abs(glm::vec3(pMatrix[2])) * halfExtent.z;
+		return aabb{ center - newHalfExtent, center + newHalfExtent };
+	}
+
+	bounding_sphere bounding_sphere::transformed(const glm::mat4& pMatrix) const
+	{
+		if (empty()) {
+			return *this;
+		}
+		const float maxScale = std::sqrt(std::max({
+			glm::dot(glm::vec3(pMatrix[0]), glm::vec3(pMatrix[0])),
+			glm::dot(glm::vec3(pMatrix[1]), glm::vec3(pMatrix[1])),
+			glm::dot(glm::vec3(pMatrix[2]), glm::vec3(pMatrix[2])) }));
+		return bounding_sphere{ glm::vec3(pMatrix * glm::vec4(mCenter, 1.0f)), mRadius * maxScale };
+	}
+
+	bounding_sphere bounding_sphere::merged(const bounding_sphere& pOther) const
+	{
+		if (pOther.empty()) {
+			return *this;
+		}
+		if (empty()) {
+			return pOther;
+		}
+		const glm::vec3 offset = pOther.mCenter - mCenter;
+		const float distance = glm::length(offset);
+		if (distance + pOther.mRadius <= mRadius) {
+			return *this;
+		}
+		if (distance + mRadius <= pOther.mRadius) {
+			return pOther;
+		}
+		const float radius = 0.5f * (distance + mRadius + pOther.mRadius);
+		return bounding_sphere{ mCenter + offset * ((radius - mRadius) / distance), radius };
+	}
+
+	aabb compute_aabb(const glm::vec3* pPoints, size_t pCount)
+	{
+		aabb result;
+		for (size_t i = 0; i < pCount; ++i) {
+			result.extend(pPoints[i]);
+		}
+		return result;
+	}
+
+	bounding_sphere compute_bounding_sphere(const glm::vec3* pPoints, size_t pCount, const aabb& pBounds)
+	{
+		if (0 == pCount) {
+			return bounding_sphere{};
+		}
+		const glm::vec3 center = pBounds.center();
+		float radiusSq = 0.0f;
+		for (size_t i = 0; i < pCount; ++i) {
+			const glm::vec3 d = pPoints[i] - center;
+			radiusSq = std::max(radiusSq, glm::dot(d, d));
+		}
+		return bounding_sphere{ center, std::sqrt(radiusSq) };
+	}
+}
@@ -0,0 +1,558 @@
+#include "bvh.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CGB_BVH_SSE
+#endif
+
+namespace cgb
+{
+	namespace
+	{
+		/** Nodes at this depth become leaves regardless of their primitive count, which bounds the traversal stacks
+		 *	also for degenerate input, e.g. primitives whose splits keep cutting off a single one */
+		constexpr uint32_t kMaxTreeDepth = 64;
+		/** A depth-first traversal defers at most one node per level, plus the two children of the current node */
+		constexpr uint32_t kMaxTraversalStackSize = kMaxTreeDepth + 1;
+		/** Below this many primitives, the whole hierarchy is built on the calling thread */
+		constexpr uint32_t kMinPrimitivesForParallelBuild = 4096;
+		constexpr uint32_t kMaxBinCount = 64;
+
+		struct build_primitive
+		{
+			aabb mBounds;
+			glm::vec3 mCentroid;
+			uint32_t mIndex;
+		};
+
+		struct subtree_task
+		{
+			uint32_t mNodeIndex;
+			uint32_t mBegin;
+			uint32_t mEnd;
+			uint32_t mDepth;
+		};
+
+		float half_area(const aabb& pBox)
+		{
+			const glm::vec3 e = pBox.mMax - pBox.mMin;
+			return e.x * e.y + e.y * e.z + e.z * e.x;
+		}
+
+		void set_bounds(bvh_node& pNode, const aabb& pBounds)
+		{
+			pNode.mMin = pBounds.mMin;
+			pNode.mMax = pBounds.mMax;
+		}
+
+		aabb node_bounds(const bvh_node& pNode)
+		{
+			return aabb{ pNode.mMin, pNode.mMax };
+		}
+
+		/**	Builds the subtree for the primitives [pBegin, pEnd) into pNodes[pNodeIndex], reordering the primitives.
+		 *	If outTasks is given, subtrees at pParallelDepth are not built but recorded as tasks.
+		 */
+		void build_node(std::vector<bvh_node>& pNodes, uint32_t pNodeIndex, build_primitive* pPrimitives, uint32_t pBegin, uint32_t pEnd,
+			const bvh_settings& pSettings, uint32_t pDepth, uint32_t pParallelDepth, std::vector<subtree_task>* outTasks)
+		{
+			aabb bounds, centroidBounds;
+			for (uint32_t i = pBegin; i < pEnd; ++i) {
+				bounds.extend(pPrimitives[i].mBounds);
+				centroidBounds.extend(pPrimitives[i].mCentroid);
+			}
+			set_bounds(pNodes[pNodeIndex], bounds);
+			const uint32_t count = pEnd - pBegin;
+
+			auto makeLeaf = [&]() {
+				pNodes[pNodeIndex].mLeftOrFirst = pBegin;
+				pNodes[pNodeIndex].mCount = count;
+			};
+			if (count <= 1 || pDepth >= kMaxTreeDepth) {
+				makeLeaf();
+				return;
+			}
+			if (nullptr != outTasks && pDepth >= pParallelDepth && count >= kMinPrimitivesForParallelBuild / 4) {
+				outTasks->push_back(subtree_task{ pNodeIndex, pBegin, pEnd, pDepth });
+				return;
+			}
+
+			// Evaluate the surface area heuristic at the borders between the bins of all three axes
+			const uint32_t binCount = glm::clamp(pSettings.mBinCount, 2u, kMaxBinCount);
+			const glm::vec3 extent = centroidBounds.mMax - centroidBounds.mMin;
+			int bestAxis = -1;
+			uint32_t bestSplit = 0;
+			float bestCost = std::numeric_limits<float>::max();
+			std::array<aabb, kMaxBinCount> binBounds;
+			std::array<uint32_t, kMaxBinCount> binCounts;
+			std::array<float, kMaxBinCount> rightCosts;
+			for (int axis = 0; axis < 3; ++axis) {
+				if (extent[axis] <= 0.0f) {
+					continue;
+				}
+				std::fill(binBounds.begin(), binBounds.end(), aabb{});
+				std::fill(binCounts.begin(), binCounts.end(), 0u);
+				const float scale = binCount / extent[axis];
+				for (uint32_t i = pBegin; i < pEnd; ++i) {
+					const uint32_t bin = std::min(binCount - 1, static_cast<uint32_t>((pPrimitives[i].mCentroid[axis] - centroidBounds.mMin[axis]) * scale));
+					binBounds[bin].extend(pPrimitives[i].mBounds);
+					++binCounts[bin];
+				}
+				// sweep from the right to get the costs of all right halves, then from the left
+				aabb right;
+				uint32_t rightCount = 0;
+				for (uint32_t b = binCount - 1; b > 0; --b) {
+					right.extend(binBounds[b]);
+					rightCount += binCounts[b];
+					rightCosts[b] = rightCount > 0 ? half_area(right) * rightCount : 0.0f;
+				}
+				aabb left;
+				uint32_t leftCount = 0;
+				for (uint32_t b = 0; b < binCount - 1; ++b) {
+					left.extend(binBounds[b]);
+					leftCount += binCounts[b];
+					const float cost = (leftCount > 0 ? half_area(left) * leftCount : 0.0f) + rightCosts[b + 1];
+					if (leftCount > 0 && leftCount < count && cost < bestCost) {
+						bestCost = cost;
+						bestAxis = axis;
+						bestSplit = b + 1;
+					}
+				}
+			}
+
+			// Traversing a node costs about as much as intersecting one primitive
+			const float parentArea = half_area(bounds);
+			const float leafCost = static_cast<float>(count);
+			const float splitCost = parentArea > 0.0f ? 1.0f + bestCost / parentArea : leafCost;
+			if (count <= pSettings.mMaxLeafSize && (bestAxis < 0 || splitCost >= leafCost)) {
+				makeLeaf();
+				return;
+			}
+
+			uint32_t mid = pBegin + count / 2;
+			if (bestAxis >= 0) {
+				const float scale = binCount / extent[bestAxis];
+				const float minCentroid = centroidBounds.mMin[bestAxis];
+				auto* split = std::partition(pPrimitives + pBegin, pPrimitives + pEnd, [&](const build_primitive& p) {
+					return std::min(binCount - 1, static_cast<uint32_t>((p.mCentroid[bestAxis] - minCentroid) * scale)) < bestSplit;
+				});
+				mid = static_cast<uint32_t>(split - pPrimitives);
+				if (mid == pBegin || mid == pEnd) {
+					mid = pBegin + count / 2;
+				}
+			}
+			// else: all centroids coincide, but there are too many primitives for a leaf, split them in the middle
+
+			const uint32_t leftIndex = static_cast<uint32_t>(pNodes.size());
+			pNodes.resize(pNodes.size() + 2);
+			pNodes[pNodeIndex].mLeftOrFirst = leftIndex;
+			pNodes[pNodeIndex].mCount = 0;
+			build_node(pNodes, leftIndex, pPrimitives, pBegin, mid, pSettings, pDepth + 1, pParallelDepth, outTasks);
+			build_node(pNodes, leftIndex + 1, pPrimitives, mid, pEnd, pSettings, pDepth + 1, pParallelDepth, outTasks);
+		}
+
+		/** Builds a hierarchy over the given primitives, which are reordered like the leaves reference them */
+		std::vector<bvh_node> build_hierarchy(std::vector<build_primitive>& pPrimitives, const bvh_settings& pSettings)
+		{
+			std::vector<bvh_node> nodes;
+			if (pPrimitives.empty()) {
+				return nodes;
+			}
+			nodes.reserve(2 * pPrimitives.size() / std::max(1u, pSettings.mMaxLeafSize) + 1);
+			nodes.resize(1);
+			const uint32_t count = static_cast<uint32_t>(pPrimitives.size());
+			if (count < kMinPrimitivesForParallelBuild || 1 == pSettings.mMaxThreads) {
+				build_node(nodes, 0, pPrimitives.data(), 0, count, pSettings, 0, 0, nullptr);
+				return nodes;
+			}
+
+			// Build the top levels here, and the subtrees below them in parallel into separate node arrays
+			const size_t threads = 0 == pSettings.mMaxThreads ? std::max(1u, std::thread::hardware_concurrency()) : pSettings.mMaxThreads;
+			uint32_t parallelDepth = 2;
+			while ((size_t{ 1 } << parallelDepth) < threads * 4) {
+				++parallelDepth;
+			}
+			std::vector<subtree_task> tasks;
+			build_node(nodes, 0, pPrimitives.data(), 0, count, pSettings, 0, parallelDepth, &tasks);
+
+			std::vector<std::vector<bvh_node>> subtrees(tasks.size());
+			parallel_for(tasks.size(), [&](size_t t) {
+				subtrees[t].resize(1);
+				build_node(subtrees[t], 0, pPrimitives.data(), tasks[t].mBegin, tasks[t].mEnd, pSettings, tasks[t].mDepth, 0, nullptr);
+			}, pSettings.mMaxThreads);
+
+			// Append the subtrees; every subtree's root replaces the task's placeholder node
+			for (size_t t = 0; t < tasks.size(); ++t) {
+				const auto& subtree = subtrees[t];
+				const uint32_t base = static_cast<uint32_t>(nodes.size()) - 1;
+				for (size_t i = 1; i < subtree.size(); ++i) {
+					nodes.push_back(subtree[i]);
+					if (!subtree[i].is_leaf()) {
+						nodes.back().mLeftOrFirst += base;
+					}
+				}
+				nodes[tasks[t].mNodeIndex] = subtree[0];
+				if (!subtree[0].is_leaf()) {
+					nodes[tasks[t].mNodeIndex].mLeftOrFirst += base;
+				}
+			}
+			return nodes;
+		}
+
+		/** Recomputes the bounds of all nodes, children are always stored behind their parents */
+		template <typename F>
+		void refit_nodes(std::vector<bvh_node>& pNodes, F pLeafBounds)
+		{
+			for (size_t i = pNodes.size(); i-- > 0;) {
+				auto& node = pNodes[i];
+				if (node.is_leaf()) {
+					set_bounds(node, pLeafBounds(node.mLeftOrFirst, node.mCount));
+				}
+				else {
+					aabb bounds = node_bounds(pNodes[node.mLeftOrFirst]);
+					bounds.extend(node_bounds(pNodes[node.mLeftOrFirst + 1]));
+					set_bounds(node, bounds);
+				}
+			}
+		}
+
+		/** Returns the entry distance of the ray into the box, or infinity if it misses the box within [pTMin, pTMax] */
+		float intersect_node(const bvh_node& pNode, const glm::vec3& pOrigin, const glm::vec3& pInvDirection, float pTMin, float pTMax)
+		{
+			const glm::vec3 t0 = (pNode.mMin - pOrigin) * pInvDirection;
+			const glm::vec3 t1 = (pNode.mMax - pOrigin) * pInvDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, pTMin));
+			const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, pTMax));
+			return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+		}
+
+		/**	Front-to-back traversal. pLeaf(first, count, tMax) intersects the leaf's primitives and returns
+		 *	the new maximum distance; returning a negative value terminates the traversal.
+		 */
+		template <typename F>
+		void traverse(const std::vector<bvh_node>& pNodes, const ray& pRay, F pLeaf)
+		{
+			if (pNodes.empty()) {
+				return;
+			}
+			const glm::vec3 invDirection = 1.0f / pRay.mDirection;
+			float tMax = pRay.mTMax;
+			std::array<uint32_t, kMaxTraversalStackSize> stack;
+			uint32_t stackSize = 0;
+			if (intersect_node(pNodes[0], pRay.mOrigin, invDirection, pRay.mTMin, tMax) == std::numeric_limits<float>::infinity()) {
+				return;
+			}
+			stack[stackSize++] = 0;
+			while (stackSize > 0) {
+				const bvh_node& node = pNodes[stack[--stackSize]];
+				if (node.is_leaf()) {
+					tMax = pLeaf(node.mLeftOrFirst, node.mCount, tMax);
+					if (tMax < 0.0f) {
+						return;
+					}
+					continue;
+				}
+				uint32_t nearChild = node.mLeftOrFirst, farChild = node.mLeftOrFirst + 1;
+				float tNear = intersect_node(pNodes[nearChild], pRay.mOrigin, invDirection, pRay.mTMin, tMax);
+				float tFar = intersect_node(pNodes[farChild], pRay.mOrigin, invDirection, pRay.mTMin, tMax);
+				if (tFar < tNear) {
+					std::swap(nearChild, farChild);
+					std::swap(tNear, tFar);
+				}
+				// push the far child first, so that the near one is visited first
+				assert(stackSize + 2 <= stack.size());
+				if (tFar != std::numeric_limits<float>::infinity()) {
+					stack[stackSize++] = farChild;
+				}
+				if (tNear != std::numeric_limits<float>::infinity()) {
+					stack[stackSize++] = nearChild;
+				}
+			}
+		}
+
+		/** Möller-Trumbore ray/triangle intersection, returns the distance or infinity */
+		float intersect_triangle(const ray& pRay, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, float pTMax, glm::vec2& outBarycentrics)
+		{
+			const glm::vec3 e1 = p1 - p0;
+			const glm::vec3 e2 = p2 - p0;
+			const glm::vec3 p = glm::cross(pRay.mDirection, e2);
+			const float det = glm::dot(e1, p);
+			if (std::abs(det) < 1e-12f) {
+				return std::numeric_limits<float>::infinity();
+			}
+			const float invDet = 1.0f / det;
+			const glm::vec3 s = pRay.mOrigin - p0;
+			const float u = glm::dot(s, p) * invDet;
+			if (u < 0.0f || u > 1.0f) {
+				return std::numeric_limits<float>::infinity();
+			}
+			const glm::vec3 q = glm::cross(s, e1);
+			const float v = glm::dot(pRay.mDirection, q) * invDet;
+			if (v < 0.0f || u + v > 1.0f) {
+				return std::numeric_limits<float>::infinity();
+			}
+			const float t = glm::dot(e2, q) * invDet;
+			if (t < pRay.mTMin || t > pTMax) {
+				return std::numeric_limits<float>::infinity();
+			}
+			outBarycentrics = glm::vec2(u, v);
+			return t;
+		}
+	}
+
+	triangle_bvh triangle_bvh::build(std::vector<glm::vec3> pPositions, std::vector<uint32_t> pIndices, const bvh_settings& pSettings)
+	{
+		triangle_bvh result;
+		result.mPositions = std::move(pPositions);
+		result.mIndices = std::move(pIndices);
+
+		const uint32_t triangleCount = static_cast<uint32_t>(result.mIndices.size() / 3);
+		std::vector<build_primitive> primitives(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			auto& primitive = primitives[t];
+			for (uint32_t k = 0; k < 3; ++k) {
+				primitive.mBounds.extend(result.mPositions[result.mIndices[t * 3 + k]]);
+			}
+			primitive.mCentroid = primitive.mBounds.center();
+			primitive.mIndex = t;
+		}
+
+		result.mNodes = build_hierarchy(primitives, pSettings);
+		result.mTriangleIndices.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; ++i) {
+			result.mTriangleIndices[i] = primitives[i].mIndex;
+		}
+		return result;
+	}
+
+	triangle_bvh triangle_bvh::build(const Mesh& pMesh, const bvh_settings& pSettings)
+	{
+		return build(pMesh.vertex_positions(), pMesh.m_indices, pSettings);
+	}
+
+	void triangle_bvh::refit(std::span<const glm::vec3> pPositions)
+	{
+		if (pPositions.size() != mPositions.size()) {
+			throw std::runtime_error(fmt::format("The hierarchy has been built over {} vertices, but {} positions have been passed for refitting", mPositions.size(), pPositions.size()));
+		}
+		std::copy(pPositions.begin(), pPositions.end(), mPositions.begin());
+		refit_nodes(mNodes, [this](uint32_t pFirst, uint32_t pCount) {
+			aabb bounds;
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				const uint32_t t = mTriangleIndices[i];
+				bounds.extend(mPositions[mIndices[t * 3]]);
+				bounds.extend(mPositions[mIndices[t * 3 + 1]]);
+				bounds.extend(mPositions[mIndices[t * 3 + 2]]);
+			}
+			return bounds;
+		});
+	}
+
+	bool triangle_bvh::intersect(const ray& pRay, ray_hit& outHit) const
+	{
+		bool found = false;
+		traverse(mNodes, ray{ pRay.mOrigin, pRay.mDirection, pRay.mTMin, std::min(pRay.mTMax, outHit.mT) }, [&](uint32_t pFirst, uint32_t pCount, float pTMax) {
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				const uint32_t t = mTriangleIndices[i];
+				glm::vec2 barycentrics;
+				const float distance = intersect_triangle(pRay, mPositions[mIndices[t * 3]], mPositions[mIndices[t * 3 + 1]], mPositions[mIndices[t * 3 + 2]], pTMax, barycentrics);
+				if (distance < pTMax) {
+					pTMax = distance;
+					outHit.mT = distance;
+					outHit.mBarycentrics = barycentrics;
+					outHit.mTriangleIndex = t;
+					found = true;
+				}
+			}
+			return pTMax;
+		});
+		return found;
+	}
+
+	void triangle_bvh::intersect_packet(const std::array<ray, 4>& pRays, std::array<ray_hit, 4>& outHits) const
+	{
+#ifdef CGB_BVH_SSE
+		if (mNodes.empty()) {
+			return;
+		}
+		// The rays in structure-of-arrays layout, one per lane
+		__m128 origin[3], invDirection[3];
+		for (int axis = 0; axis < 3; ++axis) {
+			origin[axis] = _mm_setr_ps(pRays[0].mOrigin[axis], pRays[1].mOrigin[axis], pRays[2].mOrigin[axis], pRays[3].mOrigin[axis]);
+			invDirection[axis] = _mm_setr_ps(1.0f / pRays[0].mDirection[axis], 1.0f / pRays[1].mDirection[axis], 1.0f / pRays[2].mDirection[axis], 1.0f / pRays[3].mDirection[axis]);
+		}
+		const __m128 tMin = _mm_setr_ps(pRays[0].mTMin, pRays[1].mTMin, pRays[2].mTMin, pRays[3].mTMin);
+		alignas(16) float tMaxLanes[4];
+		for (int lane = 0; lane < 4; ++lane) {
+			tMaxLanes[lane] = std::min(pRays[lane].mTMax, outHits[lane].mT);
+		}
+
+		std::array<uint32_t, kMaxTraversalStackSize> stack;
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const bvh_node& node = mNodes[stack[--stackSize]];
+			// Slab test of the node against all four rays; the packet descends if any of them hits it
+			__m128 entry = tMin;
+			__m128 exit = _mm_load_ps(tMaxLanes);
+			for (int axis = 0; axis < 3; ++axis) {
+				const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.mMin[axis]), origin[axis]), invDirection[axis]);
+				const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.mMax[axis]), origin[axis]), invDirection[axis]);
+				entry = _mm_max_ps(entry, _mm_min_ps(t0, t1));
+				exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+			}
+			const int activeLanes = _mm_movemask_ps(_mm_cmple_ps(entry, exit));
+			if (0 == activeLanes) {
+				continue;
+			}
+			if (!node.is_leaf()) {
+				assert(stackSize + 2 <= stack.size());
+				stack[stackSize++] = node.mLeftOrFirst + 1;
+				stack[stackSize++] = node.mLeftOrFirst;
+				continue;
+			}
+			for (int lane = 0; lane < 4; ++lane) {
+				if (0 == (activeLanes & (1 << lane))) {
+					continue;
+				}
+				for (uint32_t i = node.mLeftOrFirst; i < node.mLeftOrFirst + node.mCount; ++i) {
+					const uint32_t t = mTriangleIndices[i];
+					glm::vec2 barycentrics;
+					const float distance = intersect_triangle(pRays[lane], mPositions[mIndices[t * 3]], mPositions[mIndices[t * 3 + 1]], mPositions[mIndices[t * 3 + 2]], tMaxLanes[lane], barycentrics);
+					if (distance < tMaxLanes[lane]) {
+						tMaxLanes[lane] = distance;
+						outHits[lane].mT = distance;
+						outHits[lane].mBarycentrics = barycentrics;
+						outHits[lane].mTriangleIndex = t;
+					}
+				}
+			}
+		}
+#else
+		for (int lane = 0; lane < 4; ++lane) {
+			intersect(pRays[lane], outHits[lane]);
+		}
+#endif
+	}
+
+	bool triangle_bvh::occluded(const ray& pRay) const
+	{
+		bool found = false;
+		traverse(mNodes, pRay, [&](uint32_t pFirst, uint32_t pCount, float pTMax) {
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				const uint32_t t = mTriangleIndices[i];
+				glm::vec2 barycentrics;
+				if (intersect_triangle(pRay, mPositions[mIndices[t * 3]], mPositions[mIndices[t * 3 + 1]], mPositions[mIndices[t * 3 + 2]], pTMax, barycentrics) < pTMax) {
+					found = true;
+					return -1.0f;
+				}
+			}
+			return pTMax;
+		});
+		return found;
+	}
+
+	aabb triangle_bvh::bounds() const
+	{
+		return mNodes.empty() ? aabb{} : node_bounds(mNodes[0]);
+	}
+
+	model_bvh model_bvh::build(const Model& pModel, const bvh_settings& pSettings)
+	{
+		model_bvh result;
+		const size_t meshCount = pModel.num_meshes();
+		result.mMeshBvhs.resize(meshCount);
+		// One mesh per job; the meshes' own builds stay on their thread
+		bvh_settings meshSettings = pSettings;
+		meshSettings.mMaxThreads = 1;
+		parallel_for(meshCount, [&](size_t m) {
+			result.mMeshBvhs[m] = triangle_bvh::build(pModel.mesh_at(static_cast<unsigned int>(m)), meshSettings);
+		}, pSettings.mMaxThreads);
+
+		std::vector<instance> instances;
+		std::vector<build_primitive> primitives;
+		for (uint32_t m = 0; m < meshCount; ++m) {
+			const auto& mesh = pModel.mesh_at(m);
+			const aabb meshBounds = result.mMeshBvhs[m].bounds();
+			if (meshBounds.empty()) {
+				continue;
+			}
+			auto addInstance = [&](const glm::mat4& pTransformation, uint32_t pInstanceIndex) {
+				const aabb bounds = meshBounds.transformed(pTransformation);
+				primitives.push_back(build_primitive{ bounds, bounds.center(), static_cast<uint32_t>(instances.size()) });
+				instances.push_back(instance{ pTransformation, glm::inverse(pTransformation), m, pInstanceIndex });
+			};
+			if (mesh.m_instances.empty()) {
+				addInstance(mesh.m_scene_transformation_matrix, 0);
+			}
+			for (uint32_t i = 0; i < mesh.m_instances.size(); ++i) {
+				addInstance(mesh.m_instances[i].m_transformation, i);
+			}
+		}
+
+		result.mNodes = build_hierarchy(primitives, pSettings);
+		result.mInstances.reserve(instances.size());
+		for (const auto& primitive : primitives) {
+			result.mInstances.push_back(instances[primitive.mIndex]);
+		}
+		return result;
+	}
+
+	bool model_bvh::intersect(const ray& pRay, ray_hit& outHit) const
+	{
+		bool found = false;
+		traverse(mNodes, ray{ pRay.mOrigin, pRay.mDirection, pRay.mTMin, std::min(pRay.mTMax, outHit.mT) }, [&](uint32_t pFirst, uint32_t pCount, float pTMax) {
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				const auto& inst = mInstances[i];
+				// The direction is not normalized after the transformation, hence distances stay the same
+				const ray objectRay{ glm::vec3(inst.mInverseTransformation * glm::vec4(pRay.mOrigin, 1.0f)),
+					glm::vec3(inst.mInverseTransformation * glm::vec4(pRay.mDirection, 0.0f)), pRay.mTMin, pTMax };
+				if (mMeshBvhs[inst.mMeshIndex].intersect(objectRay, outHit)) {
+					pTMax = outHit.mT;
+					outHit.mMeshIndex = inst.mMeshIndex;
+					outHit.mInstanceIndex = inst.mInstanceIndex;
+					found = true;
+				}
+			}
+			return pTMax;
+		});
+		return found;
+	}
+
+	bool model_bvh::occluded(const ray& pRay) const
+	{
+		bool found = false;
+		traverse(mNodes, pRay, [&](uint32_t pFirst, uint32_t pCount, float pTMax) {
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				const auto& inst = mInstances[i];
+				const ray objectRay{ glm::vec3(inst.mInverseTransformation * glm::vec4(pRay.mOrigin, 1.0f)),
+					glm::vec3(inst.mInverseTransformation * glm::vec4(pRay.mDirection, 0.0f)), pRay.mTMin, pTMax };
+				if (mMeshBvhs[inst.mMeshIndex].occluded(objectRay)) {
+					found = true;
+					return -1.0f;
+				}
+			}
+			return pTMax;
+		});
+		return found;
+	}
+
+	void model_bvh::refit_mesh(size_t pMeshIndex, std::span<const glm::vec3> pPositions)
+	{
+		mMeshBvhs.at(pMeshIndex).refit(pPositions);
+		refit_top_level();
+	}
+
+	void model_bvh::refit_top_level()
+	{
+		refit_nodes(mNodes, [this](uint32_t pFirst, uint32_t pCount) {
+			aabb bounds;
+			for (uint32_t i = pFirst; i < pFirst + pCount; ++i) {
+				bounds.extend(mMeshBvhs[mInstances[i].mMeshIndex].bounds().transformed(mInstances[i].mTransformation));
+			}
+			return bounds;
+		});
+	}
+}
@@ -70,6 +70,10 @@ namespace cgb
 		// Destroy the semaphores
 		//cleanup_sync_objects(); <-- TODO
 
+		// Return all memory blocks to the device before it is destroyed
+		mMemoryAllocator.reset();
+		mMemoryBackend.reset();
+
 		// Destroy logical device
 		mLogicalDevice.destroy();
 
@@ -497,6 +501,7 @@ namespace cgb
 
 		// Handle success:
 		mPhysicalDevice = *currentSelection;
+		mMemoryProperties = mPhysicalDevice.getMemoryProperties();
 	}
 
 	auto vulkan::find_queue_families_for_criteria(vk::QueueFlags pRequiredFlags, vk::QueueFlags pForbiddenFlags, std::optional<vk::SurfaceKHR> pSurface)
@@ -633,15 +638,36 @@ namespace cgb
 			.setShadingRateCoarseSampleOrder(VK_TRUE);
 		auto activateShadingRateImage = shading_rate_image_extension_requested() && supports_shading_rate_image(mPhysicalDevice);
 
+		// Indirect draws of many meshes need multiDrawIndirect and drawIndirectFirstInstance, which are enabled if available
+		const auto supportedFeatures = mPhysicalDevice.getFeatures();
+		mMultiDrawIndirectSupported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+
 		// Enable certain device features:
 		auto deviceFeatures = vk::PhysicalDeviceFeatures2()
 			.setFeatures(vk::PhysicalDeviceFeatures()
 						 .setSamplerAnisotropy(VK_TRUE)
 						 .setVertexPipelineStoresAndAtomics(VK_TRUE)
-						 .setShaderStorageImageExtendedFormats(VK_TRUE))
+						 .setShaderStorageImageExtendedFormats(VK_TRUE)
+						 .setMultiDrawIndirect(mMultiDrawIndirectSupported ? VK_TRUE : VK_FALSE)
+						 .setDrawIndirectFirstInstance(mMultiDrawIndirectSupported ? VK_TRUE : VK_FALSE))
 			.setPNext(activateShadingRateImage ? &shadingRateImageFeatureNV : nullptr);
 
 		auto allRequiredDeviceExtensions = get_all_required_device_extensions();
+		// Optional extensions are enabled if the device supports them, the features which use them check whether they have been
+		const auto availableDeviceExtensions = mPhysicalDevice.enumerateDeviceExtensionProperties();
+		auto enable_if_supported = [&](const char* pExtension) {
+			const bool supported = std::any_of(std::begin(availableDeviceExtensions), std::end(availableDeviceExtensions), [pExtension](const vk::ExtensionProperties& ext) {
+				return strcmp(pExtension, ext.extensionName) == 0;
+			});
+			if (supported && std::none_of(std::begin(allRequiredDeviceExtensions), std::end(allRequiredDeviceExtensions), [pExtension](const char* ext) { return strcmp(pExtension, ext) == 0; })) {
+				allRequiredDeviceExtensions.push_back(pExtension);
+			}
+			return supported;
+		};
+		// The memory allocator keeps within the heaps' budgets, which are only known precisely with VK_EXT_memory_budget
+		const bool memoryBudgetSupported = enable_if_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		// Lets GPU-driven rendering take the number of indirect draws from a buffer
+		mDrawIndirectCountSupported = enable_if_supported(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
 		auto deviceCreateInfo = vk::DeviceCreateInfo()
 			.setQueueCreateInfoCount(static_cast<uint32_t>(queueCreateInfos.size()))
 			.setPQueueCreateInfos(queueCreateInfos.data())
@@ -656,6 +682,20 @@ namespace cgb
 		// Create a dynamic dispatch loader for extensions
 		mDynamicDispatch = vk::DispatchLoaderDynamic(mInstance, mLogicalDevice);
 
+		// All resources are sub-allocated from larger blocks of device memory
+		std::vector<device_memory_type> memoryTypes;
+		for (auto i = 0u; i < mMemoryProperties.memoryTypeCount; ++i) {
+			const auto& type = mMemoryProperties.memoryTypes[i];
+			memoryTypes.push_back(device_memory_type{
+				(type.propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) == vk::MemoryPropertyFlagBits::eHostVisible,
+				mMemoryProperties.memoryHeaps[type.heapIndex].size,
+				type.heapIndex });
+		}
+		device_memory_allocator_settings allocatorSettings;
+		allocatorSettings.mBufferImageGranularity = mPhysicalDevice.getProperties().limits.bufferImageGranularity;
+		mMemoryBackend = std::make_unique<vulkan_memory_backend>(mLogicalDevice, mPhysicalDevice, memoryBudgetSupported);
+		mMemoryAllocator = std::make_unique<device_memory_allocator>(*mMemoryBackend, std::move(memoryTypes), allocatorSettings);
+
 		mGraphicsQueue = mLogicalDevice.getQueue(mGraphicsQueueIndex, 0u);
 		mPresentQueue = mLogicalDevice.getQueue(mPresentQueueIndex, 0u);
 		mTransferQueue = mLogicalDevice.getQueue(mTransferQueueIndex, 0u);
@@ -1175,15 +1215,21 @@ namespace cgb
 		// when VRAM runs out. The different types of memory exist within these heaps. Right now we'll 
 		// only concern ourselves with the type of memory and not the heap it comes from, but you can 
 		// imagine that this can affect performance.
-		auto memProperties = mPhysicalDevice.getMemoryProperties();
-		for (auto i = 0u; i < memProperties.memoryTypeCount; ++i) {
-			if ((pMemoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & pMemoryProperties) == pMemoryProperties) {
+		for (auto i = 0u; i < mMemoryProperties.memoryTypeCount; ++i) {
+			if ((pMemoryTypeBits & (1 << i)) && (mMemoryProperties.memoryTypes[i].propertyFlags & pMemoryProperties) == pMemoryProperties) {
 				return i;
 			}
 		}
 		throw std::runtime_error("failed to find suitable memory type!");
 	}
 
+	device_allocation vulkan::allocate_memory(const vk::MemoryRequirements& pRequirements, vk::MemoryPropertyFlags pMemoryProperties, device_resource_kind pKind, device_allocation_lifetime pLifetime)
+	{
+		return mMemoryAllocator->allocate(
+			find_memory_type_index(pRequirements.memoryTypeBits, pMemoryProperties),
+			pRequirements.size, pRequirements.alignment, pKind, pLifetime);
+	}
+
 	void vulkan::set_sharing_mode_for_transfer(vk::BufferCreateInfo& pCreateInfo)
 	{
 		if (mGraphicsQueueIndex == mTransferQueueIndex) {
@@ -1,6 +1,9 @@
 #include "context_vulkan_types.h"
 #include <set>
 
+#include "vulkan_context.h"
+#include "vulkan_staging_ring.h"
+
 namespace cgb
 {
 	window::window()
@@ -836,11 +839,77 @@ namespace cgb
 		mCommandBuffer.endRenderPass();
 	}
 
+	vulkan_memory_backend::vulkan_memory_backend(vk::Device pDevice, vk::PhysicalDevice pPhysicalDevice, bool pMemoryBudgetSupported) noexcept
+		: mDevice(pDevice)
+		, mPhysicalDevice(pPhysicalDevice)
+		, mMemoryBudgetSupported(pMemoryBudgetSupported)
+	{ }
+
+	device_memory_handle vulkan_memory_backend::allocate(uint32_t pMemoryTypeIndex, uint64_t pSize)
+	{
+		auto allocInfo = vk::MemoryAllocateInfo()
+			.setAllocationSize(pSize)
+			.setMemoryTypeIndex(pMemoryTypeIndex);
+		vk::DeviceMemory memory;
+		const auto result = mDevice.allocateMemory(&allocInfo, nullptr, &memory);
+		if (vk::Result::eErrorOutOfDeviceMemory == result || vk::Result::eErrorOutOfHostMemory == result) {
+			return 0;
+		}
+		if (vk::Result::eSuccess != result) {
+			throw std::runtime_error(fmt::format("Allocating {} bytes of device memory failed with {}", pSize, vk::to_string(result)));
+		}
+		return to_device_memory_handle(memory);
+	}
+
+	void vulkan_memory_backend::free(device_memory_handle pMemory)
+	{
+		mDevice.freeMemory(to_device_memory(pMemory));
+	}
+
+	void* vulkan_memory_backend::map(device_memory_handle pMemory)
+	{
+		return mDevice.mapMemory(to_device_memory(pMemory), 0, VK_WHOLE_SIZE);
+	}
+
+	bool vulkan_memory_backend::query_budgets(std::vector<device_memory_budget>& outBudgets)
+	{
+		if (!mMemoryBudgetSupported) {
+			return false;
+		}
+		auto budgetProperties = vk::PhysicalDeviceMemoryBudgetPropertiesEXT();
+		auto memoryProperties = vk::PhysicalDeviceMemoryProperties2();
+		memoryProperties.pNext = &budgetProperties;
+		mPhysicalDevice.getMemoryProperties2(&memoryProperties);
+		const auto heapCount = std::min<size_t>(outBudgets.size(), memoryProperties.memoryProperties.memoryHeapCount);
+		for (size_t i = 0; i < heapCount; ++i) {
+			outBudgets[i].mBudget = budgetProperties.heapBudget[i];
+			outBudgets[i].mUsage = budgetProperties.heapUsage[i];
+		}
+		return true;
+	}
+
+	vk::DeviceMemory to_device_memory(device_memory_handle pHandle)
+	{
+		// VkDeviceMemory is a pointer on 64-bit platforms and a uint64_t otherwise
+		VkDeviceMemory memory;
+		static_assert(sizeof(memory) <= sizeof(pHandle));
+		memcpy(&memory, &pHandle, sizeof(memory));
+		return vk::DeviceMemory(memory);
+	}
+
+	device_memory_handle to_device_memory_handle(vk::DeviceMemory pMemory)
+	{
+		const VkDeviceMemory memory = pMemory;
+		device_memory_handle handle = 0;
+		memcpy(&handle, &memory, sizeof(memory));
+		return handle;
+	}
+
 	buffer::buffer() noexcept
-		: mSize{ 0u }, mBufferFlags(), mBuffer(nullptr), mMemoryProperties(), mMemory(nullptr)
+		: mSize{ 0u }, mBufferFlags(), mBuffer(nullptr), mMemoryProperties(), mMemory()
 	{ }
 
-	buffer::buffer(size_t pSize, const vk::BufferUsageFlags& pBufferFlags, const vk::Buffer& pBuffer, const vk::MemoryPropertyFlags& pMemoryProperties, const vk::DeviceMemory& pMemory) noexcept
+	buffer::buffer(size_t pSize, const vk::BufferUsageFlags& pBufferFlags, const vk::Buffer& pBuffer, const vk::MemoryPropertyFlags& pMemoryProperties, const device_allocation& pMemory) noexcept
 		: mSize{ pSize }, mBufferFlags(pBufferFlags), mBuffer{ pBuffer }, mMemoryProperties(pMemoryProperties), mMemory{ pMemory }
 	{ }
 
@@ -855,7 +924,7 @@ namespace cgb
 		other.mBufferFlags = vk::BufferUsageFlags();
 		other.mBuffer = nullptr;
 		other.mMemoryProperties = vk::MemoryPropertyFlags();
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 	}
 
 	buffer& buffer::operator=(buffer&& other) noexcept
@@ -869,7 +938,7 @@ namespace cgb
 		other.mBufferFlags = vk::BufferUsageFlags();
 		other.mBuffer = nullptr;
 		other.mMemoryProperties = vk::MemoryPropertyFlags();
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 		return *this;
 	}
 
@@ -879,9 +948,8 @@ namespace cgb
 			context().logical_device().destroyBuffer(mBuffer);
 			mBuffer = nullptr;
 		}
-		if (mMemory) {
-			context().logical_device().freeMemory(mMemory);
-			mMemory = nullptr;
+		if (mMemory.valid()) {
+			context().memory_allocator().free(mMemory);
 		}
 	}
 
@@ -907,27 +975,21 @@ namespace cgb
 		// The first step of allocating memory for the buffer is to query its memory requirements [2]
 		auto memRequirements = context().logical_device().getBufferMemoryRequirements(vkBuffer);
 
-		auto allocInfo = vk::MemoryAllocateInfo()
-			.setAllocationSize(memRequirements.size)
-			.setMemoryTypeIndex(context().find_memory_type_index(
-				memRequirements.memoryTypeBits, 
-				pMemoryProperties));
-
-		auto vkMemory = context().logical_device().allocateMemory(allocInfo);
+		auto memory = context().allocate_memory(memRequirements, pMemoryProperties, device_resource_kind::linear);
 
 		// If memory allocation was successful, then we can now associate this memory with the buffer
-		cgb::context().logical_device().bindBufferMemory(vkBuffer, vkMemory, 0);
+		cgb::context().logical_device().bindBufferMemory(vkBuffer, to_device_memory(memory.mMemory), memory.mOffset);
 
-		return buffer(pBufferSize, pUsageFlags, vkBuffer, pMemoryProperties, vkMemory);
+		return buffer(pBufferSize, pUsageFlags, vkBuffer, pMemoryProperties, memory);
 	}
 
 	void buffer::fill_host_coherent_memory(const void* pData, std::optional<size_t> pSize)
 	{
 		assert((mMemoryProperties & (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)) == (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+		// Host-visible memory is mapped persistently by the allocator
+		assert(nullptr != mMemory.mMapped);
 		vk::DeviceSize copySize = pSize ? *pSize : mSize;
-		void* mapped = context().logical_device().mapMemory(mMemory, 0, copySize);
-		memcpy(mapped, pData, copySize);
-		context().logical_device().unmapMemory(mMemory);
+		memcpy(mMemory.mMapped, pData, copySize);
 	}
 
 	void copy(const buffer& pSource, const buffer& pDestination)
@@ -1034,6 +1096,87 @@ namespace cgb
 		return indexBuffer;
 	}
 
+	vk::IndexType index_type_for_size(size_t pIndexSize)
+	{
+		switch (pIndexSize) {
+		case sizeof(uint16_t):
+			return vk::IndexType::eUint16;
+		case sizeof(uint32_t):
+			return vk::IndexType::eUint32;
+		default:
+			throw std::runtime_error(fmt::format("There is no vk::IndexType for indices of size {}", pIndexSize));
+		}
+	}
+
+	namespace
+	{
+		/** The staging ring of the vulkan_context, which shares the device of cgb::context(), or nullptr if it has not been initialized */
+		vulkan_staging_ring* staging_ring()
+		{
+			return vulkan_context::instance().stagingRing;
+		}
+
+		/**	Uploads the data to a new device-local buffer. With the staging ring, the copy is executed before the next submission
+		 *	of vulkan_render_queue or vulkan_command_buffer_manager, otherwise it has been executed when this function returns.
+		 */
+		void upload_to_new_buffer(const buffer& pDestination, const void* pData, size_t pSize)
+		{
+			if (auto* ring = staging_ring()) {
+				// Buffers which are also transfer sources are shared concurrently, which rules out the ownership transfer of the transfer queue
+				const bool exclusive = !(pDestination.mBufferFlags & vk::BufferUsageFlagBits::eTransferSrc);
+				ring->upload_to_buffer(pDestination.mBuffer, 0, pData, static_cast<vk::DeviceSize>(pSize), exclusive);
+				return;
+			}
+			auto stagingBuffer = buffer::create(pSize,
+				vk::BufferUsageFlagBits::eTransferSrc,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+			stagingBuffer.fill_host_coherent_memory(pData);
+			copy(stagingBuffer, pDestination);
+		}
+	}
+
+	vertex_buffer create_vertex_buffer(const void* pData, size_t pSizeOneVertex, size_t pVertexCount, vk::BufferUsageFlags pAdditionalBufferUsageFlags)
+	{
+		auto vertexBuffer = vertex_buffer::create(pSizeOneVertex, pVertexCount,
+			vk::BufferUsageFlagBits::eTransferDst | pAdditionalBufferUsageFlags,
+			vk::MemoryPropertyFlagBits::eDeviceLocal);
+		upload_to_new_buffer(vertexBuffer, pData, pSizeOneVertex * pVertexCount);
+		return vertexBuffer;
+	}
+
+	vertex_buffer create_position_vertex_buffer(const Mesh& pMesh, vk::BufferUsageFlags pAdditionalBufferUsageFlags)
+	{
+		if (pMesh.has_split_vertex_streams()) {
+			const auto& positions = pMesh.position_data();
+			return create_vertex_buffer(positions.data(), sizeof(glm::vec3), positions.size(), pAdditionalBufferUsageFlags);
+		}
+		const auto positions = pMesh.vertex_positions();
+		return create_vertex_buffer(positions.data(), sizeof(glm::vec3), positions.size(), pAdditionalBufferUsageFlags);
+	}
+
+	vertex_buffer create_attribute_vertex_buffer(const Mesh& pMesh, vk::BufferUsageFlags pAdditionalBufferUsageFlags)
+	{
+		if (!pMesh.has_split_vertex_streams()) {
+			throw std::runtime_error("The mesh has no separate attribute stream; call Mesh::SplitVertexStreams first");
+		}
+		return create_vertex_buffer(pMesh.attribute_data().data(), pMesh.size_one_attribute_vertex(), pMesh.num_vertices(), pAdditionalBufferUsageFlags);
+	}
+
+	std::shared_ptr<mesh_buffers> get_or_create_mesh_buffers(const Mesh& pMesh)
+	{
+		return model_registry::instance().get_or_create_geometry<mesh_buffers>(pMesh, [&pMesh]() {
+			auto result = std::make_shared<mesh_buffers>();
+			result->mVertexBuffer = create_vertex_buffer(pMesh.vertex_data().data(), pMesh.m_size_one_vertex, pMesh.num_vertices());
+
+			const auto indexData = pMesh.index_data();
+			result->mIndexBuffer = index_buffer::create(index_type_for_size(pMesh.index_size()), pMesh.indices_length(),
+				vk::BufferUsageFlagBits::eTransferDst,
+				vk::MemoryPropertyFlagBits::eDeviceLocal);
+			upload_to_new_buffer(result->mIndexBuffer, indexData.data(), indexData.size());
+			return result;
+		});
+	}
+
 	uniform_buffer::uniform_buffer() noexcept
 		: buffer()
 	{ }
@@ -1111,7 +1254,7 @@ namespace cgb
 		: mInfo(), mImage(), mMemory()
 	{ }
 
-	image::image(const vk::ImageCreateInfo& pInfo, const vk::Image& pImage, const vk::DeviceMemory& pMemory) noexcept
+	image::image(const vk::ImageCreateInfo& pInfo, const vk::Image& pImage, const device_allocation& pMemory) noexcept
 		: mInfo(pInfo), mImage(pImage), mMemory(pMemory)
 	{ }
 
@@ -1122,7 +1265,7 @@ namespace cgb
 	{ 
 		other.mInfo = vk::ImageCreateInfo();
 		other.mImage = nullptr;
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 	}
 
 	image& image::operator=(image&& other) noexcept
@@ -1132,7 +1275,7 @@ namespace cgb
 		mMemory = std::move(other.mMemory);
 		other.mInfo = vk::ImageCreateInfo();
 		other.mImage = nullptr;
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 		return *this;
 	}
 
@@ -1142,18 +1285,17 @@ namespace cgb
 			context().logical_device().destroyImage(mImage);
 			mImage = nullptr;
 		}
-		if (mMemory) {
-			context().logical_device().freeMemory(mMemory);
-			mMemory = nullptr;
+		if (mMemory.valid()) {
+			context().memory_allocator().free(mMemory);
 		}
 	}
 
-	image image::create2D(int width, int height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties)
+	image image::create2D(int width, int height, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, uint32_t mipLevels)
 	{
 		auto imageInfo = vk::ImageCreateInfo()
 			.setImageType(vk::ImageType::e2D)
 			.setExtent(vk::Extent3D(static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1u))
-			.setMipLevels(1u)
+			.setMipLevels(mipLevels)
 			.setArrayLayers(1u)
 			.setFormat(format)
 			.setTiling(tiling)
@@ -1166,15 +1308,12 @@ namespace cgb
 
 		auto memRequirements = context().logical_device().getImageMemoryRequirements(vkImage);
 
-		auto allocInfo = vk::MemoryAllocateInfo()
-			.setAllocationSize(memRequirements.size)
-			.setMemoryTypeIndex(context().find_memory_type_index(memRequirements.memoryTypeBits, properties));
-
-		auto vkMemory = context().logical_device().allocateMemory(allocInfo);
+		auto memory = context().allocate_memory(memRequirements, properties,
+			tiling == vk::ImageTiling::eOptimal ? device_resource_kind::optimal : device_resource_kind::linear);
 
 		// bind together:
-		context().logical_device().bindImageMemory(vkImage, vkMemory, 0);
-		return image(imageInfo, vkImage, vkMemory);
+		context().logical_device().bindImageMemory(vkImage, to_device_memory(memory.mMemory), memory.mOffset);
+		return image(imageInfo, vkImage, memory);
 	}
 
 	vk::ImageMemoryBarrier create_image_barrier(vk::Image pImage, vk::Format pFormat, vk::AccessFlags pSrcAccessMask, vk::AccessFlags pDstAccessMask, vk::ImageLayout pOldLayout, vk::ImageLayout pNewLayout, std::optional<vk::ImageSubresourceRange> pSubresourceRange)
@@ -1320,6 +1459,87 @@ namespace cgb
 		cgb::context().transfer_queue().waitIdle();
 	}
 
+	vk::Format texture_format(const texture_data& pTexture)
+	{
+		switch (pTexture.mCompression) {
+		case texture_compression::bc1:
+			return pTexture.mSrgb ? vk::Format::eBc1RgbaSrgbBlock : vk::Format::eBc1RgbaUnormBlock;
+		case texture_compression::bc3:
+			return pTexture.mSrgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+		default:
+			return pTexture.mSrgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+		}
+	}
+
+	image create_texture_image(const texture_data& pTexture)
+	{
+		const auto format = texture_format(pTexture);
+		auto img = image::create2D(static_cast<int>(pTexture.width()), static_cast<int>(pTexture.height()), format,
+			vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+			vk::MemoryPropertyFlagBits::eDeviceLocal, pTexture.level_count());
+
+		// All levels are uploaded at once, one copy region per level
+		std::vector<uint8_t> stagingData;
+		stagingData.reserve(pTexture.size_in_bytes());
+		std::vector<vk::BufferImageCopy> copyRegions;
+		copyRegions.reserve(pTexture.level_count());
+		for (uint32_t level = 0; level < pTexture.level_count(); ++level) {
+			const auto& lvl = pTexture.mLevels[level];
+			copyRegions.push_back(vk::BufferImageCopy()
+				.setBufferOffset(static_cast<vk::DeviceSize>(stagingData.size()))
+				.setBufferRowLength(0)
+				.setBufferImageHeight(0)
+				.setImageSubresource(vk::ImageSubresourceLayers()
+									 .setAspectMask(vk::ImageAspectFlagBits::eColor)
+									 .setMipLevel(level)
+									 .setBaseArrayLayer(0u)
+									 .setLayerCount(1u))
+				.setImageOffset({ 0u, 0u, 0u })
+				.setImageExtent(vk::Extent3D(lvl.mWidth, lvl.mHeight, 1u)));
+			stagingData.insert(stagingData.end(), lvl.mData.begin(), lvl.mData.end());
+		}
+
+		const auto allLevels = vk::ImageSubresourceRange()
+			.setAspectMask(vk::ImageAspectFlagBits::eColor)
+			.setBaseMipLevel(0u)
+			.setLevelCount(pTexture.level_count())
+			.setBaseArrayLayer(0u)
+			.setLayerCount(1u);
+
+		auto* ring = staging_ring();
+		if (nullptr != ring && stagingData.size() <= ring->get_size()) {
+			// The ring leaves the image in eTransferDstOptimal layout, owned by the graphics queue
+			ring->upload_to_image_levels(img.mImage, stagingData.data(), static_cast<vk::DeviceSize>(stagingData.size()), copyRegions, pTexture.level_count());
+			ring->get_graphics_command_buffer().pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), {}, {},
+				{ img.create_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, allLevels) });
+			return img;
+		}
+
+		auto stagingBuffer = buffer::create(stagingData.size(),
+			vk::BufferUsageFlagBits::eTransferSrc,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		stagingBuffer.fill_host_coherent_memory(stagingData.data());
+
+		auto commandBuffer = context().create_command_buffers_for_graphics(1, vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+		commandBuffer[0].begin_recording();
+		commandBuffer[0].mCommandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), {}, {},
+			{ img.create_barrier(vk::AccessFlags(), vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, allLevels) });
+		commandBuffer[0].mCommandBuffer.copyBufferToImage(stagingBuffer.mBuffer, img.mImage, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+		commandBuffer[0].mCommandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlags(), {}, {},
+			{ img.create_barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, allLevels) });
+		commandBuffer[0].end_recording();
+
+		auto submitInfo = vk::SubmitInfo()
+			.setCommandBufferCount(1u)
+			.setPCommandBuffers(&commandBuffer[0].mCommandBuffer);
+		context().graphics_queue().submit({ submitInfo }, nullptr);
+		context().graphics_queue().waitIdle();
+		return img;
+	}
+
 	image_view::image_view() noexcept
 		: mInfo()
 		, mImageView()
@@ -1370,7 +1590,7 @@ namespace cgb
 			.setSubresourceRange(vk::ImageSubresourceRange()
 								 .setAspectMask(pAspectFlags)
 								 .setBaseMipLevel(0u)
-								 .setLevelCount(1u)
+								 .setLevelCount(pImage->mInfo.mipLevels)
 								 .setBaseArrayLayer(0u)
 								 .setLayerCount(1u));
 		return image_view(viewInfo, context().logical_device().createImageView(viewInfo), pImage);
@@ -1429,7 +1649,7 @@ namespace cgb
 			.setMipmapMode(vk::SamplerMipmapMode::eLinear)
 			.setMipLodBias(0.0f)
 			.setMinLod(0.0f)
-			.setMaxLod(0.0f);
+			.setMaxLod(VK_LOD_CLAMP_NONE);
 		return sampler(context().logical_device().createSampler(samplerInfo));
 	}
 
@@ -1472,10 +1692,10 @@ namespace cgb
 		, mAccStructure(nullptr)
 		, mHandle()
 		, mMemoryProperties()
-		, mMemory(nullptr)
+		, mMemory()
 	{ }
 
-	acceleration_structure::acceleration_structure(const vk::AccelerationStructureInfoNV& pAccStructureInfo, const vk::AccelerationStructureNV& pAccStructure, const acceleration_structure_handle& pHandle, const vk::MemoryPropertyFlags& pMemoryProperties, const vk::DeviceMemory& pMemory)
+	acceleration_structure::acceleration_structure(const vk::AccelerationStructureInfoNV& pAccStructureInfo, const vk::AccelerationStructureNV& pAccStructure, const acceleration_structure_handle& pHandle, const vk::MemoryPropertyFlags& pMemoryProperties, const device_allocation& pMemory)
 		: mAccStructureInfo(pAccStructureInfo)
 		, mAccStructure(pAccStructure)
 		, mHandle(pHandle)
@@ -1494,7 +1714,7 @@ namespace cgb
 		other.mAccStructure = nullptr;
 		other.mHandle = acceleration_structure_handle();
 		other.mMemoryProperties = vk::MemoryPropertyFlags();
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 	}
 
 	acceleration_structure& acceleration_structure::operator=(acceleration_structure&& other) noexcept
@@ -1508,7 +1728,7 @@ namespace cgb
 		other.mAccStructure = nullptr;
 		other.mHandle = acceleration_structure_handle();
 		other.mMemoryProperties = vk::MemoryPropertyFlags();
-		other.mMemory = nullptr;
+		other.mMemory = device_allocation{};
 		return *this;
 	}
 
@@ -1518,9 +1738,8 @@ namespace cgb
 			context().logical_device().destroyAccelerationStructureNV(mAccStructure, nullptr, cgb::context().dynamic_dispatch());
 			mAccStructure = nullptr;
 		}
-		if (mMemory) {
-			context().logical_device().freeMemory(mMemory);
-			mMemory = nullptr;
+		if (mMemory.valid()) {
+			context().memory_allocator().free(mMemory);
 		}
 	}
 
@@ -1559,18 +1778,14 @@ namespace cgb
 
 		auto memPropertyFlags = vk::MemoryPropertyFlagBits::eDeviceLocal;
 
-		auto allocInfo = vk::MemoryAllocateInfo()
-			.setAllocationSize(memRequirements.memoryRequirements.size)
-			.setMemoryTypeIndex(context().find_memory_type_index(
-				memRequirements.memoryRequirements.memoryTypeBits,
-				memPropertyFlags));
-		auto deviceMemory = context().logical_device().allocateMemory(allocInfo);
+		// The layout of acceleration structures is opaque, keep them apart from linear resources
+		auto memory = context().allocate_memory(memRequirements.memoryRequirements, memPropertyFlags, device_resource_kind::optimal);
 
 		// bind memory to acceleration structure
 		auto bindInfo = vk::BindAccelerationStructureMemoryInfoNV()
 			.setAccelerationStructure(accStructure)
-			.setMemory(deviceMemory)
-			.setMemoryOffset(0)
+			.setMemory(to_device_memory(memory.mMemory))
+			.setMemoryOffset(memory.mOffset)
 			.setDeviceIndexCount(0)
 			.setPDeviceIndices(nullptr);
 		context().logical_device().bindAccelerationStructureMemoryNV({ bindInfo }, cgb::context().dynamic_dispatch());
@@ -1578,7 +1793,7 @@ namespace cgb
 		acceleration_structure_handle handle;
 		context().logical_device().getAccelerationStructureHandleNV(accStructure, sizeof(handle.mHandle), &handle.mHandle, cgb::context().dynamic_dispatch());
 
-		return acceleration_structure(accInfo, accStructure, handle, memPropertyFlags, deviceMemory);
+		return acceleration_structure(accInfo, accStructure, handle, memPropertyFlags, memory);
 	}
 
 	size_t acceleration_structure::get_scratch_buffer_size()
@@ -1595,7 +1810,7 @@ namespace cgb
 		: buffer()
 	{ }
 
-	shader_binding_table::shader_binding_table(size_t pSize, const vk::BufferUsageFlags& pBufferFlags, const vk::Buffer& pBuffer, const vk::MemoryPropertyFlags& pMemoryProperties, const vk::DeviceMemory& pMemory) noexcept
+	shader_binding_table::shader_binding_table(size_t pSize, const vk::BufferUsageFlags& pBufferFlags, const vk::Buffer& pBuffer, const vk::MemoryPropertyFlags& pMemoryProperties, const device_allocation& pMemory) noexcept
 		: buffer(pSize, pBufferFlags, pBuffer, pMemoryProperties, pMemory)
 	{ }
 
@@ -1622,10 +1837,8 @@ namespace cgb
 								vk::BufferUsageFlagBits::eTransferSrc,
 								vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
 
-		void* mapped = context().logical_device().mapMemory(b.mMemory, 0, b.mSize);
-		// Transfer something into the buffer's memory...
-		context().logical_device().getRayTracingShaderGroupHandlesNV(pRtPipeline.mPipeline, 0, numGroups, b.mSize, mapped, context().dynamic_dispatch());
-		context().logical_device().unmapMemory(b.mMemory);
+		// Transfer something into the buffer's memory, which the allocator keeps mapped...
+		context().logical_device().getRayTracingShaderGroupHandlesNV(pRtPipeline.mPipeline, 0, numGroups, b.mSize, b.mMemory.mMapped, context().dynamic_dispatch());
 		
 		auto sbt = shader_binding_table();
 		static_cast<buffer&>(sbt) = std::move(b);
@@ -0,0 +1,758 @@
+#include "device_memory_allocator.h"
+
+#include <bit>
+
+namespace cgb
+{
+	namespace
+	{
+		constexpr uint32_t kInvalidIndex = std::numeric_limits<uint32_t>::max();
+		/** device_allocation::mBlock of allocations which have device memory of their own */
+		constexpr uint32_t kDedicatedBlock = kInvalidIndex;
+
+		uint64_t align_up(uint64_t pValue, uint64_t pAlignment)
+		{
+			return (pValue + pAlignment - 1) & ~(pAlignment - 1);
+		}
+
+		/**	Two-level segregated fit allocator (Masmano et al.) over the range [0, size) of one block.
+		 *	Free ranges are kept in lists which are segregated by size: the first level splits by powers of two,
+		 *	the second level splits each power of two linearly into 32 lists. Bitmaps of the non-empty lists make
+		 *	finding a suitable list a matter of two bit scans.
+		 */
+		class tlsf_ranges
+		{
+		public:
+			explicit tlsf_ranges(uint64_t pSize)
+			{
+				mHeads.fill(kInvalidIndex);
+				insert_free(new_range(0, pSize, kInvalidIndex, kInvalidIndex));
+			}
+
+			/** Returns the index of the allocated range and its offset, or kInvalidIndex if there is no suitable free range */
+			uint32_t allocate(uint64_t pSize, uint64_t pAlignment, uint64_t& outOffset)
+			{
+				// Every range in the list which is found is large enough, even with the worst-case alignment padding
+				uint32_t fl, sl;
+				mapping(round_up_to_list(pSize + pAlignment - 1), fl, sl);
+				if (!find_non_empty_list(fl, sl)) {
+					return kInvalidIndex;
+				}
+				uint32_t index = mHeads[fl * kSecondLevelCount + sl];
+				remove_free(index);
+
+				const uint64_t offset = mRanges[index].mOffset;
+				const uint64_t padding = align_up(offset, pAlignment) - offset;
+				if (padding > 0) {
+					const uint32_t front = new_range(offset, padding, mRanges[index].mPrevPhys, index);
+					if (kInvalidIndex != mRanges[front].mPrevPhys) {
+						mRanges[mRanges[front].mPrevPhys].mNextPhys = front;
+					}
+					mRanges[index].mPrevPhys = front;
+					mRanges[index].mOffset += padding;
+					mRanges[index].mSize -= padding;
+					insert_free(front);
+				}
+				if (mRanges[index].mSize > pSize) {
+					const uint32_t back = new_range(mRanges[index].mOffset + pSize, mRanges[index].mSize - pSize, index, mRanges[index].mNextPhys);
+					if (kInvalidIndex != mRanges[back].mNextPhys) {
+						mRanges[mRanges[back].mNextPhys].mPrevPhys = back;
+					}
+					mRanges[index].mNextPhys = back;
+					mRanges[index].mSize = pSize;
+					insert_free(back);
+				}
+				++mUsedCount;
+				outOffset = mRanges[index].mOffset;
+				return index;
+			}
+
+			/** Frees the range and merges it with its free neighbors */
+			void free(uint32_t pIndex)
+			{
+				uint32_t index = pIndex;
+				const uint32_t prev = mRanges[index].mPrevPhys;
+				if (kInvalidIndex != prev && mRanges[prev].mFree) {
+					remove_free(prev);
+					mRanges[prev].mSize += mRanges[index].mSize;
+					unlink_next(prev);
+					index = prev;
+				}
+				const uint32_t next = mRanges[index].mNextPhys;
+				if (kInvalidIndex != next && mRanges[next].mFree) {
+					remove_free(next);
+					mRanges[index].mSize += mRanges[next].mSize;
+					unlink_next(index);
+				}
+				insert_free(index);
+				--mUsedCount;
+			}
+
+			bool empty() const { return 0 == mUsedCount; }
+			uint64_t offset_of(uint32_t pIndex) const { return mRanges[pIndex].mOffset; }
+			uint64_t size_of(uint32_t pIndex) const { return mRanges[pIndex].mSize; }
+
+		private:
+			static constexpr uint32_t kSecondLevelBits = 5;
+			static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelBits;
+			/** Sizes below this are split linearly into the second-level lists of the first first-level list */
+			static constexpr uint32_t kSmallSizeBits = 8;
+			static constexpr uint64_t kSmallSize = 1ull << kSmallSizeBits;
+			static constexpr uint32_t kFirstLevelCount = 64 - kSmallSizeBits + 1;
+
+			struct range
+			{
+				uint64_t mOffset;
+				uint64_t mSize;
+				uint32_t mPrevPhys;
+				uint32_t mNextPhys;
+				uint32_t mPrevFree;
+				uint32_t mNextFree;
+				bool mFree;
+			};
+
+			static void mapping(uint64_t pSize, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+			{
+				if (pSize < kSmallSize) {
+					outFirstLevel = 0;
+					outSecondLevel = static_cast<uint32_t>(pSize / (kSmallSize / kSecondLevelCount));
+					return;
+				}
+				const uint32_t msb = static_cast<uint32_t>(std::bit_width(pSize)) - 1;
+				outFirstLevel = msb - kSmallSizeBits + 1;
+				outSecondLevel = static_cast<uint32_t>(pSize >> (msb - kSecondLevelBits)) ^ kSecondLevelCount;
+			}
+
+			/** Rounds the size up to the smallest size of the next list, so that all ranges in the list which it maps to are large enough */
+			static uint64_t round_up_to_list(uint64_t pSize)
+			{
+				if (pSize < kSmallSize) {
+					return pSize + (kSmallSize / kSecondLevelCount) - 1;
+				}
+				const uint32_t msb = static_cast<uint32_t>(std::bit_width(pSize)) - 1;
+				return pSize + (1ull << (msb - kSecondLevelBits)) - 1;
+			}
+
+			bool find_non_empty_list(uint32_t& ioFirstLevel, uint32_t& ioSecondLevel) const
+			{
+				if (ioFirstLevel >= kFirstLevelCount) {
+					return false;
+				}
+				uint32_t secondLevelMap = mSecondLevelMaps[ioFirstLevel] & (~0u << ioSecondLevel);
+				if (0 == secondLevelMap) {
+					const uint64_t firstLevelMap = ioFirstLevel + 1 < 64 ? mFirstLevelMap & (~0ull << (ioFirstLevel + 1)) : 0;
+					if (0 == firstLevelMap) {
+						return false;
+					}
+					ioFirstLevel = static_cast<uint32_t>(std::countr_zero(firstLevelMap));
+					secondLevelMap = mSecondLevelMaps[ioFirstLevel];
+				}
+				ioSecondLevel = static_cast<uint32_t>(std::countr_zero(secondLevelMap));
+				return true;
+			}
+
+			uint32_t new_range(uint64_t pOffset, uint64_t pSize, uint32_t pPrevPhys, uint32_t pNextPhys)
+			{
+				const range r{ pOffset, pSize, pPrevPhys, pNextPhys, kInvalidIndex, kInvalidIndex, false };
+				if (mUnusedRanges.empty()) {
+					mRanges.push_back(r);
+					return static_cast<uint32_t>(mRanges.size() - 1);
+				}
+				const uint32_t index = mUnusedRanges.back();
+				mUnusedRanges.pop_back();
+				mRanges[index] = r;
+				return index;
+			}
+
+			/** Removes the physical successor of pIndex, which has been merged into it */
+			void unlink_next(uint32_t pIndex)
+			{
+				const uint32_t next = mRanges[pIndex].mNextPhys;
+				mRanges[pIndex].mNextPhys = mRanges[next].mNextPhys;
+				if (kInvalidIndex != mRanges[next].mNextPhys) {
+					mRanges[mRanges[next].mNextPhys].mPrevPhys = pIndex;
+				}
+				mUnusedRanges.push_back(next);
+			}
+
+			void insert_free(uint32_t pIndex)
+			{
+				uint32_t fl, sl;
+				mapping(mRanges[pIndex].mSize, fl, sl);
+				uint32_t& head = mHeads[fl * kSecondLevelCount + sl];
+				mRanges[pIndex].mFree = true;
+				mRanges[pIndex].mPrevFree = kInvalidIndex;
+				mRanges[pIndex].mNextFree = head;
+				if (kInvalidIndex != head) {
+					mRanges[head].mPrevFree = pIndex;
+				}
+				head = pIndex;
+				mFirstLevelMap |= 1ull << fl;
+				mSecondLevelMaps[fl] |= 1u << sl;
+			}
+
+			void remove_free(uint32_t pIndex)
+			{
+				uint32_t fl, sl;
+				mapping(mRanges[pIndex].mSize, fl, sl);
+				range& r = mRanges[pIndex];
+				if (kInvalidIndex != r.mPrevFree) {
+					mRanges[r.mPrevFree].mNextFree = r.mNextFree;
+				}
+				else {
+					mHeads[fl * kSecondLevelCount + sl] = r.mNextFree;
+				}
+				if (kInvalidIndex != r.mNextFree) {
+					mRanges[r.mNextFree].mPrevFree = r.mPrevFree;
+				}
+				r.mFree = false;
+				if (kInvalidIndex == mHeads[fl * kSecondLevelCount + sl]) {
+					mSecondLevelMaps[fl] &= ~(1u << sl);
+					if (0 == mSecondLevelMaps[fl]) {
+						mFirstLevelMap &= ~(1ull << fl);
+					}
+				}
+			}
+
+			std::vector<range> mRanges;
+			std::vector<uint32_t> mUnusedRanges;
+			uint64_t mFirstLevelMap = 0;
+			std::array<uint32_t, kFirstLevelCount> mSecondLevelMaps{};
+			std::array<uint32_t, kFirstLevelCount * kSecondLevelCount> mHeads;
+			size_t mUsedCount = 0;
+		};
+	}
+
+	struct device_memory_allocator::block
+	{
+		device_memory_handle mMemory;
+		uint64_t mSize;
+		void* mMapped;
+		uint32_t mMemoryTypeIndex;
+		device_resource_kind mKind;
+		device_allocation_lifetime mLifetime;
+		size_t mAllocationCount = 0;
+		uint64_t mUsedBytes = 0;
+		/** Free ranges of general blocks */
+		std::optional<tlsf_ranges> mRanges;
+		/** Next free byte of transient blocks */
+		uint64_t mLinearOffset = 0;
+		/** Owners and alignments of the movable allocations of general blocks, by range */
+		std::map<uint32_t, std::pair<void*, uint64_t>> mOwners;
+	};
+
+	device_memory_allocator::device_memory_allocator(device_memory_backend& pBackend, std::vector<device_memory_type> pMemoryTypes, const device_memory_allocator_settings& pSettings)
+		: mBackend{ pBackend }
+		, mMemoryTypes{ std::move(pMemoryTypes) }
+		, mSettings{ pSettings }
+		, mDedicatedCounts(mMemoryTypes.size(), 0)
+		, mDedicatedBytes(mMemoryTypes.size(), 0)
+	{
+		if (!std::has_single_bit(mSettings.mBufferImageGranularity)) {
+			throw std::runtime_error(fmt::format("The buffer-image granularity must be a power of two, but is {}", mSettings.mBufferImageGranularity));
+		}
+		for (const auto& type : mMemoryTypes) {
+			mHeapCount = std::max<size_t>(mHeapCount, type.mHeapIndex + 1);
+		}
+	}
+
+	device_memory_allocator::~device_memory_allocator()
+	{
+		size_t liveAllocations = 0;
+		for (auto& b : mBlocks) {
+			if (b) {
+				if (device_allocation_lifetime::general == b->mLifetime) {
+					liveAllocations += b->mAllocationCount;
+				}
+				mBackend.free(b->mMemory);
+			}
+		}
+		if (liveAllocations > 0) {
+			LOG_WARNING(fmt::format("{} device memory allocations have not been freed before the allocator has been destroyed", liveAllocations));
+		}
+	}
+
+	bool device_memory_allocator::kind_compatible(const block& pBlock, device_resource_kind pKind) const
+	{
+		return 1 == mSettings.mBufferImageGranularity || pBlock.mKind == pKind;
+	}
+
+	device_memory_allocator::block* device_memory_allocator::create_block(uint32_t pMemoryTypeIndex, uint64_t pMinSize, uint64_t pPreferredSize, device_resource_kind pKind, device_allocation_lifetime pLifetime)
+	{
+		// Small heaps (e.g. device-local, host-visible memory of 256 MiB) must not be filled by few blocks
+		const uint64_t heapSize = mMemoryTypes[pMemoryTypeIndex].mHeapSize;
+		uint64_t size = std::max(pMinSize, 0 == heapSize ? pPreferredSize : std::min(pPreferredSize, heapSize / 8));
+
+		device_memory_handle memory = mBackend.allocate(pMemoryTypeIndex, size);
+		for (int attempt = 0; 0 == memory && attempt < 3 && size / 2 >= pMinSize; ++attempt) {
+			size /= 2;
+			memory = mBackend.allocate(pMemoryTypeIndex, size);
+		}
+		if (0 == memory) {
+			return nullptr;
+		}
+
+		auto b = std::make_unique<block>();
+		b->mMemory = memory;
+		b->mSize = size;
+		b->mMapped = mMemoryTypes[pMemoryTypeIndex].mHostVisible ? mBackend.map(memory) : nullptr;
+		b->mMemoryTypeIndex = pMemoryTypeIndex;
+		b->mKind = pKind;
+		b->mLifetime = pLifetime;
+		if (device_allocation_lifetime::general == pLifetime) {
+			b->mRanges.emplace(size);
+		}
+
+		auto freeSlot = std::find(std::begin(mBlocks), std::end(mBlocks), nullptr);
+		if (freeSlot == std::end(mBlocks)) {
+			mBlocks.push_back(std::move(b));
+			return mBlocks.back().get();
+		}
+		*freeSlot = std::move(b);
+		return freeSlot->get();
+	}
+
+	void device_memory_allocator::release_block(uint32_t pBlock)
+	{
+		mBackend.free(mBlocks[pBlock]->mMemory);
+		mBlocks[pBlock].reset();
+	}
+
+	device_allocation device_memory_allocator::allocate_dedicated(uint32_t pMemoryTypeIndex, uint64_t pSize)
+	{
+		const device_memory_handle memory = mBackend.allocate(pMemoryTypeIndex, pSize);
+		if (0 == memory) {
+			return {};
+		}
+		device_allocation result;
+		result.mMemory = memory;
+		result.mSize = pSize;
+		result.mMapped = mMemoryTypes[pMemoryTypeIndex].mHostVisible ? mBackend.map(memory) : nullptr;
+		result.mMemoryTypeIndex = pMemoryTypeIndex;
+		result.mBlock = kDedicatedBlock;
+		++mDedicatedCounts[pMemoryTypeIndex];
+		mDedicatedBytes[pMemoryTypeIndex] += pSize;
+		return result;
+	}
+
+	device_allocation device_memory_allocator::allocation_in_block(uint32_t pBlock, uint64_t pOffset, uint64_t pSize, uint32_t pRange)
+	{
+		block& b = *mBlocks[pBlock];
+		++b.mAllocationCount;
+		b.mUsedBytes += pSize;
+		device_allocation result;
+		result.mMemory = b.mMemory;
+		result.mOffset = pOffset;
+		result.mSize = pSize;
+		result.mMapped = nullptr == b.mMapped ? nullptr : static_cast<uint8_t*>(b.mMapped) + pOffset;
+		result.mMemoryTypeIndex = b.mMemoryTypeIndex;
+		result.mBlock = pBlock;
+		result.mRange = pRange;
+		return result;
+	}
+
+	device_allocation device_memory_allocator::allocate(uint32_t pMemoryTypeIndex, uint64_t pSize, uint64_t pAlignment, device_resource_kind pKind, device_allocation_lifetime pLifetime)
+	{
+		if (pMemoryTypeIndex >= mMemoryTypes.size()) {
+			throw std::runtime_error(fmt::format("There is no memory type with index {}", pMemoryTypeIndex));
+		}
+		const uint64_t alignment = std::max<uint64_t>(pAlignment, 1);
+		if (!std::has_single_bit(alignment)) {
+			throw std::runtime_error(fmt::format("The alignment must be a power of two, but is {}", pAlignment));
+		}
+		const uint64_t size = std::max<uint64_t>(pSize, 1);
+
+		uint64_t shortfall = 0;
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			device_allocation result = try_allocate(pMemoryTypeIndex, size, alignment, pKind, pLifetime, true, shortfall);
+			if (result.valid()) {
+				return result;
+			}
+		}
+
+		// Give the owners of streamable resources the chance to make room before exceeding the budget
+		const uint32_t heapIndex = mMemoryTypes[pMemoryTypeIndex].mHeapIndex;
+		evict(heapIndex, shortfall);
+
+		std::lock_guard<std::mutex> guard(mMutex);
+		device_allocation result = try_allocate(pMemoryTypeIndex, size, alignment, pKind, pLifetime, true, shortfall);
+		if (result.valid()) {
+			return result;
+		}
+		result = try_allocate(pMemoryTypeIndex, size, alignment, pKind, pLifetime, false, shortfall);
+		if (!result.valid()) {
+			throw std::runtime_error(fmt::format("Out of device memory while allocating {} bytes of memory type {}", size, pMemoryTypeIndex));
+		}
+		LOG_WARNING(fmt::format("Heap {} exceeds its budget after allocating {} bytes of memory type {}", heapIndex, size, pMemoryTypeIndex));
+		return result;
+	}
+
+	device_allocation device_memory_allocator::try_allocate(uint32_t pMemoryTypeIndex, uint64_t pSize, uint64_t pAlignment, device_resource_kind pKind, device_allocation_lifetime pLifetime, bool pWithinBudget, uint64_t& outShortfall)
+	{
+		outShortfall = 0;
+		// Only evaluated once new device memory is needed, since querying the budget might reach the driver
+		auto available = [&]() {
+			return pWithinBudget ? budget_remaining(pMemoryTypeIndex) : std::numeric_limits<uint64_t>::max();
+		};
+		auto block_index = [&](const block* pBlock) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+				if (mBlocks[i].get() == pBlock) {
+					return i;
+				}
+			}
+			return kInvalidIndex;
+		};
+
+		if (device_allocation_lifetime::transient == pLifetime) {
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+				const auto& b = mBlocks[i];
+				if (!b || b->mLifetime != pLifetime || b->mMemoryTypeIndex != pMemoryTypeIndex || !kind_compatible(*b, pKind)) {
+					continue;
+				}
+				const uint64_t offset = align_up(b->mLinearOffset, pAlignment);
+				if (offset + pSize <= b->mSize) {
+					b->mLinearOffset = offset + pSize;
+					return allocation_in_block(i, offset, pSize, kInvalidIndex);
+				}
+			}
+			const uint64_t remaining = available();
+			if (pSize > remaining) {
+				outShortfall = pSize - remaining;
+				return {};
+			}
+			block* b = create_block(pMemoryTypeIndex, pSize, std::min(std::max(mSettings.mTransientBlockSize, pSize), remaining), pKind, pLifetime);
+			if (nullptr == b) {
+				outShortfall = pSize;
+				return {};
+			}
+			b->mLinearOffset = pSize;
+			return allocation_in_block(block_index(b), 0, pSize, kInvalidIndex);
+		}
+
+		if (pSize <= mSettings.mDedicatedThreshold) {
+			uint64_t offset = 0;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+				const auto& b = mBlocks[i];
+				if (!b || b->mLifetime != pLifetime || b->mMemoryTypeIndex != pMemoryTypeIndex || !kind_compatible(*b, pKind)) {
+					continue;
+				}
+				const uint32_t range = b->mRanges->allocate(pSize, pAlignment, offset);
+				if (kInvalidIndex != range) {
+					return allocation_in_block(i, offset, pSize, range);
+				}
+			}
+			const uint64_t minBlockSize = pSize + pAlignment - 1;
+			const uint64_t remaining = available();
+			if (minBlockSize <= remaining) {
+				block* b = create_block(pMemoryTypeIndex, minBlockSize, std::min(std::max(mSettings.mBlockSize, minBlockSize), remaining), pKind, pLifetime);
+				if (nullptr != b) {
+					const uint32_t range = b->mRanges->allocate(pSize, pAlignment, offset);
+					assert(kInvalidIndex != range);
+					return allocation_in_block(block_index(b), offset, pSize, range);
+				}
+			}
+			// The device might still be able to provide an allocation of exactly the requested size
+		}
+
+		const uint64_t remaining = available();
+		if (pSize > remaining) {
+			outShortfall = pSize - remaining;
+			return {};
+		}
+		device_allocation result = allocate_dedicated(pMemoryTypeIndex, pSize);
+		if (!result.valid()) {
+			outShortfall = pSize;
+		}
+		return result;
+	}
+
+	uint64_t device_memory_allocator::evict(uint32_t pHeapIndex, uint64_t pBytes)
+	{
+		std::lock_guard<std::recursive_mutex> evictionGuard(mEvictionMutex);
+		std::vector<device_memory_eviction_callback> callbacks;
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			for (const auto& [id, callback] : mEvictionCallbacks) {
+				callbacks.push_back(callback);
+			}
+		}
+		uint64_t freed = 0;
+		for (const auto& callback : callbacks) {
+			if (freed >= pBytes) {
+				break;
+			}
+			freed += callback(pHeapIndex, pBytes - freed);
+		}
+		return freed;
+	}
+
+	void device_memory_allocator::free(device_allocation& pAllocation)
+	{
+		if (!pAllocation.valid()) {
+			return;
+		}
+		std::lock_guard<std::mutex> guard(mMutex);
+		if (kDedicatedBlock == pAllocation.mBlock) {
+			mBackend.free(pAllocation.mMemory);
+			--mDedicatedCounts[pAllocation.mMemoryTypeIndex];
+			mDedicatedBytes[pAllocation.mMemoryTypeIndex] -= pAllocation.mSize;
+			pAllocation = device_allocation{};
+			return;
+		}
+
+		block& b = *mBlocks.at(pAllocation.mBlock);
+		if (device_allocation_lifetime::transient == b.mLifetime) {
+			pAllocation = device_allocation{};
+			return;
+		}
+		b.mRanges->free(pAllocation.mRange);
+		b.mOwners.erase(pAllocation.mRange);
+		--b.mAllocationCount;
+		b.mUsedBytes -= pAllocation.mSize;
+
+		// Keep one empty block per memory type around, so that allocating and freeing a resource repeatedly does not reach the device
+		if (0 == b.mAllocationCount) {
+			const bool anotherEmptyBlock = std::any_of(std::begin(mBlocks), std::end(mBlocks), [&](const auto& other) {
+				return other && other.get() != &b && 0 == other->mAllocationCount && other->mMemoryTypeIndex == b.mMemoryTypeIndex && device_allocation_lifetime::general == other->mLifetime;
+			});
+			if (anotherEmptyBlock) {
+				release_block(pAllocation.mBlock);
+			}
+		}
+		pAllocation = device_allocation{};
+	}
+
+	void device_memory_allocator::reset_transient()
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		for (auto& b : mBlocks) {
+			if (b && device_allocation_lifetime::transient == b->mLifetime) {
+				b->mLinearOffset = 0;
+				b->mAllocationCount = 0;
+				b->mUsedBytes = 0;
+			}
+		}
+	}
+
+	void device_memory_allocator::release_empty_blocks()
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+			if (mBlocks[i] && 0 == mBlocks[i]->mAllocationCount) {
+				release_block(i);
+			}
+		}
+	}
+
+	size_t device_memory_allocator::add_eviction_callback(device_memory_eviction_callback pCallback)
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		const size_t id = mNextEvictionCallbackId++;
+		mEvictionCallbacks.emplace_back(id, std::move(pCallback));
+		return id;
+	}
+
+	void device_memory_allocator::remove_eviction_callback(size_t pId)
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		mEvictionCallbacks.erase(std::remove_if(std::begin(mEvictionCallbacks), std::end(mEvictionCallbacks), [pId](const auto& entry) {
+			return entry.first == pId;
+		}), std::end(mEvictionCallbacks));
+	}
+
+	void device_memory_allocator::set_owner(const device_allocation& pAllocation, void* pOwner, uint64_t pAlignment)
+	{
+		if (!pAllocation.valid() || kDedicatedBlock == pAllocation.mBlock) {
+			return;
+		}
+		std::lock_guard<std::mutex> guard(mMutex);
+		block& b = *mBlocks.at(pAllocation.mBlock);
+		if (device_allocation_lifetime::transient == b.mLifetime) {
+			return;
+		}
+		if (nullptr == pOwner) {
+			b.mOwners.erase(pAllocation.mRange);
+		}
+		else {
+			b.mOwners[pAllocation.mRange] = { pOwner, std::max<uint64_t>(pAlignment, 1) };
+		}
+	}
+
+	std::vector<device_defragmentation_move> device_memory_allocator::plan_defragmentation(uint64_t pMaxBytes, size_t pMaxMoves)
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		std::vector<device_defragmentation_move> moves;
+		uint64_t movedBytes = 0;
+		for (uint32_t type = 0; type < static_cast<uint32_t>(mMemoryTypes.size()); ++type) {
+			// The least used block is the cheapest one to empty, but only if all of its allocations can be moved
+			uint32_t source = kInvalidIndex;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+				const auto& b = mBlocks[i];
+				if (!b || device_allocation_lifetime::general != b->mLifetime || b->mMemoryTypeIndex != type || 0 == b->mAllocationCount || b->mOwners.size() != b->mAllocationCount) {
+					continue;
+				}
+				if (kInvalidIndex == source || b->mUsedBytes < mBlocks[source]->mUsedBytes) {
+					source = i;
+				}
+			}
+			if (kInvalidIndex == source) {
+				continue;
+			}
+			block& src = *mBlocks[source];
+
+			// Fill the fullest blocks first, which keeps the emptier ones as candidates for the next passes
+			std::vector<uint32_t> destinations;
+			for (uint32_t i = 0; i < static_cast<uint32_t>(mBlocks.size()); ++i) {
+				const auto& b = mBlocks[i];
+				if (b && i != source && device_allocation_lifetime::general == b->mLifetime && b->mMemoryTypeIndex == type && kind_compatible(*b, src.mKind)) {
+					destinations.push_back(i);
+				}
+			}
+			std::sort(std::begin(destinations), std::end(destinations), [this](uint32_t a, uint32_t b) {
+				return mBlocks[a]->mUsedBytes > mBlocks[b]->mUsedBytes;
+			});
+
+			for (auto it = std::begin(src.mOwners); it != std::end(src.mOwners);) {
+				const uint32_t range = it->first;
+				const uint64_t size = src.mRanges->size_of(range);
+				if (moves.size() >= pMaxMoves || movedBytes + size > pMaxBytes) {
+					return moves;
+				}
+				device_defragmentation_move move;
+				for (uint32_t d : destinations) {
+					uint64_t offset = 0;
+					const uint32_t destinationRange = mBlocks[d]->mRanges->allocate(size, it->second.second, offset);
+					if (kInvalidIndex != destinationRange) {
+						move.mDestination = allocation_in_block(d, offset, size, destinationRange);
+						break;
+					}
+				}
+				if (!move.mDestination.valid()) {
+					// The other blocks are too full or too fragmented for the rest of this block
+					break;
+				}
+				move.mSource.mMemory = src.mMemory;
+				move.mSource.mOffset = src.mRanges->offset_of(range);
+				move.mSource.mSize = size;
+				move.mSource.mMapped = nullptr == src.mMapped ? nullptr : static_cast<uint8_t*>(src.mMapped) + move.mSource.mOffset;
+				move.mSource.mMemoryTypeIndex = type;
+				move.mSource.mBlock = source;
+				move.mSource.mRange = range;
+				move.mOwner = it->second.first;
+				move.mAlignment = it->second.second;
+				moves.push_back(move);
+				movedBytes += size;
+				// The source is not movable anymore, so that it is not planned twice before the move has been finished
+				it = src.mOwners.erase(it);
+			}
+		}
+		return moves;
+	}
+
+	void device_memory_allocator::finish_defragmentation(std::vector<device_defragmentation_move>& pMoves)
+	{
+		for (auto& move : pMoves) {
+			set_owner(move.mDestination, move.mOwner, move.mAlignment);
+			free(move.mSource);
+		}
+		pMoves.clear();
+	}
+
+	device_memory_statistics device_memory_allocator::statistics(uint32_t pMemoryTypeIndex) const
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		device_memory_statistics result;
+		for (const auto& b : mBlocks) {
+			if (b && b->mMemoryTypeIndex == pMemoryTypeIndex) {
+				++result.mBlockCount;
+				result.mAllocationCount += b->mAllocationCount;
+				result.mReservedBytes += b->mSize;
+				result.mUsedBytes += b->mUsedBytes;
+			}
+		}
+		result.mDedicatedAllocationCount = mDedicatedCounts.at(pMemoryTypeIndex);
+		result.mAllocationCount += result.mDedicatedAllocationCount;
+		result.mReservedBytes += mDedicatedBytes[pMemoryTypeIndex];
+		result.mUsedBytes += mDedicatedBytes[pMemoryTypeIndex];
+		result.mDeviceMemoryCount = result.mBlockCount + result.mDedicatedAllocationCount;
+		return result;
+	}
+
+	device_memory_statistics device_memory_allocator::statistics() const
+	{
+		device_memory_statistics result;
+		for (uint32_t i = 0; i < static_cast<uint32_t>(mMemoryTypes.size()); ++i) {
+			const auto s = statistics(i);
+			result.mDeviceMemoryCount += s.mDeviceMemoryCount;
+			result.mBlockCount += s.mBlockCount;
+			result.mDedicatedAllocationCount += s.mDedicatedAllocationCount;
+			result.mAllocationCount += s.mAllocationCount;
+			result.mReservedBytes += s.mReservedBytes;
+			result.mUsedBytes += s.mUsedBytes;
+		}
+		return result;
+	}
+
+	std::vector<device_memory_budget> device_memory_allocator::budgets_unlocked() const
+	{
+		std::vector<device_memory_budget> result(mHeapCount);
+		std::vector<uint64_t> heapSizes(mHeapCount, 0);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(mMemoryTypes.size()); ++i) {
+			auto& heap = result[mMemoryTypes[i].mHeapIndex];
+			heap.mReservedBytes += mDedicatedBytes[i];
+			heap.mUsedBytes += mDedicatedBytes[i];
+			heapSizes[mMemoryTypes[i].mHeapIndex] = mMemoryTypes[i].mHeapSize;
+		}
+		for (const auto& b : mBlocks) {
+			if (b) {
+				auto& heap = result[mMemoryTypes[b->mMemoryTypeIndex].mHeapIndex];
+				heap.mReservedBytes += b->mSize;
+				heap.mUsedBytes += b->mUsedBytes;
+			}
+		}
+
+		std::vector<device_memory_budget> reported(mHeapCount);
+		const bool reportedByDevice = mBackend.query_budgets(reported);
+		for (size_t h = 0; h < mHeapCount; ++h) {
+			result[h].mReportedByDevice = reportedByDevice;
+			if (reportedByDevice) {
+				result[h].mBudget = reported[h].mBudget;
+				result[h].mUsage = reported[h].mUsage;
+			}
+			else {
+				// Without the device's view, only the memory of this allocator can be accounted for
+				result[h].mBudget = 0 == heapSizes[h] ? std::numeric_limits<uint64_t>::max() : static_cast<uint64_t>(static_cast<double>(heapSizes[h]) * mSettings.mBudgetFraction);
+				result[h].mUsage = result[h].mReservedBytes;
+			}
+		}
+		return result;
+	}
+
+	uint64_t device_memory_allocator::budget_remaining(uint32_t pMemoryTypeIndex) const
+	{
+		const auto heap = budgets_unlocked()[mMemoryTypes[pMemoryTypeIndex].mHeapIndex];
+		return heap.mUsage < heap.mBudget ? heap.mBudget - heap.mUsage : 0;
+	}
+
+	std::vector<device_memory_budget> device_memory_allocator::budgets() const
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		return budgets_unlocked();
+	}
+
+	void device_memory_allocator::log_statistics() const
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(mMemoryTypes.size()); ++i) {
+			const auto s = statistics(i);
+			if (0 == s.mDeviceMemoryCount) {
+				continue;
+			}
+			LOG_INFO(fmt::format("Memory type {}: {} allocations in {} blocks and {} dedicated allocations, {} of {} reserved bytes in use", i, s.mAllocationCount, s.mBlockCount, s.mDedicatedAllocationCount, s.mUsedBytes, s.mReservedBytes));
+		}
+		const auto heaps = budgets();
+		for (size_t h = 0; h < heaps.size(); ++h) {
+			LOG_INFO(fmt::format("Memory heap {}: {} of {} budget bytes in use{}, {} bytes reserved by the allocator", h, heaps[h].mUsage, heaps[h].mBudget, heaps[h].mReportedByDevice ? "" : " (estimated)", heaps[h].mReservedBytes));
+		}
+	}
+}
@@ -0,0 +1,500 @@
+#include "dynamic_aabb_tree.h"
+
+namespace cgb
+{
+	namespace
+	{
+		aabb merged(const aabb& pA, const aabb& pB)
+		{
+			return aabb{ glm::min(pA.mMin, pB.mMin), glm::max(pA.mMax, pB.mMax) };
+		}
+
+		float surface_area(const aabb& pBox)
+		{
+			const glm::vec3 d = pBox.mMax - pBox.mMin;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		bool contains(const aabb& pOuter, const aabb& pInner)
+		{
+			return glm::all(glm::lessThanEqual(pOuter.mMin, pInner.mMin)) && glm::all(glm::lessThanEqual(pInner.mMax, pOuter.mMax));
+		}
+
+		bool overlap(const aabb& pA, const aabb& pB)
+		{
+			return glm::all(glm::lessThanEqual(pA.mMin, pB.mMax)) && glm::all(glm::lessThanEqual(pB.mMin, pA.mMax));
+		}
+
+		bool overlap(const aabb& pBox, const bounding_sphere& pSphere)
+		{
+			const glm::vec3 d = glm::clamp(pSphere.mCenter, pBox.mMin, pBox.mMax) - pSphere.mCenter;
+			return glm::dot(d, d) <= pSphere.mRadius * pSphere.mRadius;
+		}
+
+		/** Returns true if the box lies completely on the inner side of all planes */
+		bool inside(const frustum& pFrustum, const aabb& pBox)
+		{
+			for (const auto& plane : pFrustum.planes()) {
+				// the corner which is farthest on the outer side of the plane
+				const glm::vec3 corner = glm::mix(pBox.mMax, pBox.mMin, glm::vec3(glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0.0f))));
+				if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/** Returns the ray parameter at which the ray enters the box, or infinity if it misses it */
+		float ray_entry(const aabb& pBox, const glm::vec3& pOrigin, const glm::vec3& pInvDirection, float pTMin, float pTMax)
+		{
+			const glm::vec3 t0 = (pBox.mMin - pOrigin) * pInvDirection;
+			const glm::vec3 t1 = (pBox.mMax - pOrigin) * pInvDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float enter = std::max({ tNear.x, tNear.y, tNear.z, pTMin });
+			const float exit = std::min({ tFar.x, tFar.y, tFar.z, pTMax });
+			return enter <= exit ? enter : std::numeric_limits<float>::infinity();
+		}
+	}
+
+	dynamic_aabb_tree::dynamic_aabb_tree(const dynamic_aabb_tree_settings& pSettings)
+		: mSettings{ pSettings }
+	{
+	}
+
+	const dynamic_aabb_tree::node& dynamic_aabb_tree::leaf(proxy_id pProxy) const
+	{
+		if (pProxy >= mNodes.size() || 0 != mNodes[pProxy].mHeight) {
+			throw std::runtime_error(fmt::format("{} is not a valid proxy id", pProxy));
+		}
+		return mNodes[pProxy];
+	}
+
+	uint32_t dynamic_aabb_tree::allocate_node()
+	{
+		if (null_node == mFreeList) {
+			mNodes.emplace_back();
+			return static_cast<uint32_t>(mNodes.size() - 1);
+		}
+		const uint32_t index = mFreeList;
+		mFreeList = mNodes[index].mParentOrNext;
+		mNodes[index] = node{};
+		return index;
+	}
+
+	void dynamic_aabb_tree::free_node(uint32_t pNode)
+	{
+		mNodes[pNode] = node{};
+		mNodes[pNode].mParentOrNext = mFreeList;
+		mFreeList = pNode;
+	}
+
+	aabb dynamic_aabb_tree::fatten(const aabb& pBounds, const glm::vec3& pDisplacement) const
+	{
+		aabb result{ pBounds.mMin - glm::vec3(mSettings.mFatMargin), pBounds.mMax + glm::vec3(mSettings.mFatMargin) };
+		const glm::vec3 d = mSettings.mDisplacementMultiplier * pDisplacement;
+		result.mMin += glm::min(d, glm::vec3(0.0f));
+		result.mMax += glm::max(d, glm::vec3(0.0f));
+		return result;
+	}
+
+	dynamic_aabb_tree::proxy_id dynamic_aabb_tree::insert(const aabb& pBounds, uint64_t pUserData)
+	{
+		if (pBounds.empty()) {
+			throw std::runtime_error("Empty bounds can not be inserted into a dynamic_aabb_tree");
+		}
+		const uint32_t index = allocate_node();
+		mNodes[index].mBounds = fatten(pBounds, glm::vec3{ 0.0f });
+		mNodes[index].mHeight = 0;
+		mNodes[index].mUserData = pUserData;
+		insert_leaf(index);
+		++mProxyCount;
+		return index;
+	}
+
+	void dynamic_aabb_tree::remove(proxy_id pProxy)
+	{
+		const uint32_t trackedIndex = leaf(pProxy).mTrackedIndex;
+		if (null_node != trackedIndex) {
+			if (trackedIndex + 1 != mTracked.size()) {
+				mTracked[trackedIndex] = std::move(mTracked.back());
+				mNodes[mTracked[trackedIndex].mProxy].mTrackedIndex = trackedIndex;
+			}
+			mTracked.pop_back();
+		}
+		remove_leaf(pProxy);
+		free_node(pProxy);
+		--mProxyCount;
+	}
+
+	bool dynamic_aabb_tree::update(proxy_id pProxy, const aabb& pBounds, const glm::vec3& pDisplacement)
+	{
+		const aabb fat = fatten(pBounds, pDisplacement);
+		const aabb& current = leaf(pProxy).mBounds;
+		if (contains(current, pBounds)) {
+			// Keep the stored box unless it has become much larger than necessary, e.g. after a fast movement has stopped
+			const glm::vec3 slack(4.0f * mSettings.mFatMargin);
+			if (contains(aabb{ fat.mMin - slack, fat.mMax + slack }, current)) {
+				return false;
+			}
+		}
+		remove_leaf(pProxy);
+		mNodes[pProxy].mBounds = fat;
+		insert_leaf(pProxy);
+		return true;
+	}
+
+	size_t dynamic_aabb_tree::update(std::span<const proxy_update> pUpdates)
+	{
+		size_t reinserted = 0;
+		for (const auto& u : pUpdates) {
+			if (update(u.mProxy, u.mBounds, u.mDisplacement)) {
+				++reinserted;
+			}
+		}
+		return reinserted;
+	}
+
+	dynamic_aabb_tree::proxy_id dynamic_aabb_tree::track(transform::ptr pTransform, const aabb& pLocalBounds, uint64_t pUserData)
+	{
+		if (!pTransform) {
+			throw std::runtime_error("Can not track an object without a transform");
+		}
+		const aabb bounds = pLocalBounds.transformed(pTransform->global_transformation_matrix());
+		const proxy_id proxy = insert(bounds, pUserData);
+		mNodes[proxy].mTrackedIndex = static_cast<uint32_t>(mTracked.size());
+		const uint64_t changeCount = pTransform->change_count();
+		mTracked.push_back(tracked_object{ std::move(pTransform), pLocalBounds, bounds.center(), changeCount, proxy });
+		return proxy;
+	}
+
+	void dynamic_aabb_tree::set_local_bounds(proxy_id pProxy, const aabb& pLocalBounds)
+	{
+		const uint32_t trackedIndex = leaf(pProxy).mTrackedIndex;
+		if (null_node == trackedIndex) {
+			throw std::runtime_error(fmt::format("Proxy {} does not follow a transform", pProxy));
+		}
+		auto& tracked = mTracked[trackedIndex];
+		tracked.mLocalBounds = pLocalBounds;
+		const aabb bounds = pLocalBounds.transformed(tracked.mTransform->global_transformation_matrix());
+		tracked.mLastCenter = bounds.center();
+		tracked.mChangeCount = tracked.mTransform->change_count();
+		update(pProxy, bounds);
+	}
+
+	size_t dynamic_aabb_tree::update_tracked()
+	{
+		size_t reinserted = 0;
+		for (auto& tracked : mTracked) {
+			const uint64_t changeCount = tracked.mTransform->change_count();
+			if (changeCount == tracked.mChangeCount) {
+				continue;
+			}
+			tracked.mChangeCount = changeCount;
+			const aabb bounds = tracked.mLocalBounds.transformed(tracked.mTransform->global_transformation_matrix());
+			const glm::vec3 center = bounds.center();
+			if (update(tracked.mProxy, bounds, center - tracked.mLastCenter)) {
+				++reinserted;
+			}
+			tracked.mLastCenter = center;
+		}
+		return reinserted;
+	}
+
+	void dynamic_aabb_tree::insert_leaf(uint32_t pLeaf)
+	{
+		if (null_node == mRoot) {
+			mRoot = pLeaf;
+			mNodes[pLeaf].mParentOrNext = null_node;
+			return;
+		}
+
+		// Descend towards the sibling which minimizes the surface area heuristic. Every node on the way is
+		// enlarged by the new leaf (the inheritance cost), which is why stopping early can be cheaper.
+		const aabb leafBounds = mNodes[pLeaf].mBounds;
+		uint32_t index = mRoot;
+		while (!mNodes[index].is_leaf()) {
+			const node& n = mNodes[index];
+			const float area = surface_area(n.mBounds);
+			const float combinedArea = surface_area(merged(n.mBounds, leafBounds));
+			const float cost = 2.0f * combinedArea;
+			const float inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](uint32_t pChild) {
+				const node& c = mNodes[pChild];
+				const float newArea = surface_area(merged(c.mBounds, leafBounds));
+				return c.is_leaf() ? newArea + inheritanceCost : newArea - surface_area(c.mBounds) + inheritanceCost;
+			};
+			const float cost1 = childCost(n.mChild1);
+			const float cost2 = childCost(n.mChild2);
+			if (cost < cost1 && cost < cost2) {
+				break;
+			}
+			index = cost1 < cost2 ? n.mChild1 : n.mChild2;
+		}
+
+		const uint32_t sibling = index;
+		const uint32_t oldParent = mNodes[sibling].mParentOrNext;
+		const uint32_t newParent = allocate_node();
+		node& p = mNodes[newParent];
+		p.mParentOrNext = oldParent;
+		p.mBounds = merged(leafBounds, mNodes[sibling].mBounds);
+		p.mHeight = mNodes[sibling].mHeight + 1;
+		p.mChild1 = sibling;
+		p.mChild2 = pLeaf;
+		mNodes[sibling].mParentOrNext = newParent;
+		mNodes[pLeaf].mParentOrNext = newParent;
+
+		if (null_node == oldParent) {
+			mRoot = newParent;
+		}
+		else if (mNodes[oldParent].mChild1 == sibling) {
+			mNodes[oldParent].mChild1 = newParent;
+		}
+		else {
+			mNodes[oldParent].mChild2 = newParent;
+		}
+		refit_and_rotate(oldParent);
+	}
+
+	void dynamic_aabb_tree::remove_leaf(uint32_t pLeaf)
+	{
+		if (pLeaf == mRoot) {
+			mRoot = null_node;
+			return;
+		}
+		const uint32_t parent = mNodes[pLeaf].mParentOrNext;
+		const uint32_t grandParent = mNodes[parent].mParentOrNext;
+		const uint32_t sibling = mNodes[parent].mChild1 == pLeaf ? mNodes[parent].mChild2 : mNodes[parent].mChild1;
+
+		mNodes[sibling].mParentOrNext = grandParent;
+		free_node(parent);
+		if (null_node == grandParent) {
+			mRoot = sibling;
+			return;
+		}
+		if (mNodes[grandParent].mChild1 == parent) {
+			mNodes[grandParent].mChild1 = sibling;
+		}
+		else {
+			mNodes[grandParent].mChild2 = sibling;
+		}
+		refit_and_rotate(grandParent);
+	}
+
+	void dynamic_aabb_tree::refit_and_rotate(uint32_t pNode)
+	{
+		for (uint32_t index = pNode; null_node != index; index = mNodes[index].mParentOrNext) {
+			node& n = mNodes[index];
+			n.mBounds = merged(mNodes[n.mChild1].mBounds, mNodes[n.mChild2].mBounds);
+			n.mHeight = 1 + std::max(mNodes[n.mChild1].mHeight, mNodes[n.mChild2].mHeight);
+			rotate(index);
+		}
+	}
+
+	void dynamic_aabb_tree::rotate(uint32_t pNode)
+	{
+		// Swapping one child of pNode with a grandchild on the other side leaves pNode's bounds unchanged,
+		// but changes the bounds of the other child. Perform the swap which reduces its area the most (Kensler 2008).
+		const uint32_t b = mNodes[pNode].mChild1;
+		const uint32_t c = mNodes[pNode].mChild2;
+		float bestDiff = 0.0f;
+		uint32_t bestChild = null_node, bestGrandChild = null_node;
+
+		auto consider = [&](uint32_t pChild, uint32_t pOtherChild) {
+			const node& other = mNodes[pOtherChild];
+			if (other.is_leaf()) {
+				return;
+			}
+			const float area = surface_area(other.mBounds);
+			const float diff1 = surface_area(merged(mNodes[pChild].mBounds, mNodes[other.mChild2].mBounds)) - area;
+			const float diff2 = surface_area(merged(mNodes[other.mChild1].mBounds, mNodes[pChild].mBounds)) - area;
+			if (diff1 < bestDiff) {
+				bestDiff = diff1;
+				bestChild = pChild;
+				bestGrandChild = other.mChild1;
+			}
+			if (diff2 < bestDiff) {
+				bestDiff = diff2;
+				bestChild = pChild;
+				bestGrandChild = other.mChild2;
+			}
+		};
+		consider(b, c);
+		consider(c, b);
+		if (null_node == bestChild) {
+			return;
+		}
+
+		const uint32_t other = bestChild == b ? c : b;
+		node& n = mNodes[pNode];
+		node& o = mNodes[other];
+		(n.mChild1 == bestChild ? n.mChild1 : n.mChild2) = bestGrandChild;
+		(o.mChild1 == bestGrandChild ? o.mChild1 : o.mChild2) = bestChild;
+		mNodes[bestGrandChild].mParentOrNext = pNode;
+		mNodes[bestChild].mParentOrNext = other;
+		o.mBounds = merged(mNodes[o.mChild1].mBounds, mNodes[o.mChild2].mBounds);
+		o.mHeight = 1 + std::max(mNodes[o.mChild1].mHeight, mNodes[o.mChild2].mHeight);
+		n.mHeight = 1 + std::max(mNodes[n.mChild1].mHeight, mNodes[n.mChild2].mHeight);
+	}
+
+	void dynamic_aabb_tree::query_aabb(const aabb& pBounds, std::vector<proxy_id>& outProxies) const
+	{
+		if (null_node == mRoot) {
+			return;
+		}
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+		while (!stack.empty()) {
+			const uint32_t index = stack.back();
+			const node& n = mNodes[index];
+			stack.pop_back();
+			if (!overlap(n.mBounds, pBounds)) {
+				continue;
+			}
+			if (n.is_leaf()) {
+				outProxies.push_back(index);
+			}
+			else {
+				stack.push_back(n.mChild1);
+				stack.push_back(n.mChild2);
+			}
+		}
+	}
+
+	void dynamic_aabb_tree::query_sphere(const bounding_sphere& pSphere, std::vector<proxy_id>& outProxies) const
+	{
+		if (null_node == mRoot || pSphere.empty()) {
+			return;
+		}
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+		while (!stack.empty()) {
+			const uint32_t index = stack.back();
+			const node& n = mNodes[index];
+			stack.pop_back();
+			if (!overlap(n.mBounds, pSphere)) {
+				continue;
+			}
+			if (n.is_leaf()) {
+				outProxies.push_back(index);
+			}
+			else {
+				stack.push_back(n.mChild1);
+				stack.push_back(n.mChild2);
+			}
+		}
+	}
+
+	void dynamic_aabb_tree::query_frustum(const frustum& pFrustum, std::vector<proxy_id>& outProxies) const
+	{
+		if (null_node == mRoot) {
+			return;
+		}
+		// Entries with the highest bit set denote subtrees which are completely inside the frustum
+		constexpr uint32_t insideBit = 0x80000000u;
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+		while (!stack.empty()) {
+			const uint32_t entry = stack.back();
+			stack.pop_back();
+			const uint32_t index = entry & ~insideBit;
+			const node& n = mNodes[index];
+			uint32_t childFlag = entry & insideBit;
+			if (0 == childFlag) {
+				if (!pFrustum.intersects_aabb(n.mBounds)) {
+					continue;
+				}
+				if (!n.is_leaf() && inside(pFrustum, n.mBounds)) {
+					childFlag = insideBit;
+				}
+			}
+			if (n.is_leaf()) {
+				outProxies.push_back(index);
+			}
+			else {
+				stack.push_back(n.mChild1 | childFlag);
+				stack.push_back(n.mChild2 | childFlag);
+			}
+		}
+	}
+
+	void dynamic_aabb_tree::query_ray(const ray& pRay, std::vector<proxy_id>& outProxies) const
+	{
+		if (null_node == mRoot) {
+			return;
+		}
+		const glm::vec3 invDirection = 1.0f / pRay.mDirection;
+		std::vector<std::pair<float, proxy_id>> hits;
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(mRoot);
+		while (!stack.empty()) {
+			const uint32_t index = stack.back();
+			const node& n = mNodes[index];
+			stack.pop_back();
+			const float t = ray_entry(n.mBounds, pRay.mOrigin, invDirection, pRay.mTMin, pRay.mTMax);
+			if (t == std::numeric_limits<float>::infinity()) {
+				continue;
+			}
+			if (n.is_leaf()) {
+				hits.emplace_back(t, index);
+			}
+			else {
+				stack.push_back(n.mChild1);
+				stack.push_back(n.mChild2);
+			}
+		}
+		std::sort(std::begin(hits), std::end(hits));
+		for (const auto& hit : hits) {
+			outProxies.push_back(hit.second);
+		}
+	}
+
+	void dynamic_aabb_tree::query_pairs(std::vector<std::pair<proxy_id, proxy_id>>& outPairs) const
+	{
+		if (null_node == mRoot) {
+			return;
+		}
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(mNodes.size()); ++i) {
+			if (0 != mNodes[i].mHeight) {
+				continue;
+			}
+			const aabb& bounds = mNodes[i].mBounds;
+			stack.push_back(mRoot);
+			while (!stack.empty()) {
+				const uint32_t index = stack.back();
+				const node& n = mNodes[index];
+				stack.pop_back();
+				if (!overlap(n.mBounds, bounds)) {
+					continue;
+				}
+				if (n.is_leaf()) {
+					if (index > i) {
+						outPairs.emplace_back(i, index);
+					}
+				}
+				else {
+					stack.push_back(n.mChild1);
+					stack.push_back(n.mChild2);
+				}
+			}
+		}
+	}
+
+	float dynamic_aabb_tree::total_inner_area() const
+	{
+		float area = 0.0f;
+		for (const auto& n : mNodes) {
+			if (n.mHeight > 0) {
+				area += surface_area(n.mBounds);
+			}
+		}
+		return area;
+	}
+}
@@ -0,0 +1,160 @@
+#include "frustum.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CGB_FRUSTUM_SSE
+#endif
+
+namespace cgb
+{
+#ifdef CGB_FRUSTUM_SSE
+	namespace
+	{
+		/** The frustum's planes with every component broadcast into all four lanes */
+		struct broadcast_planes
+		{
+			__m128 mNx[6], mNy[6], mNz[6], mD[6];
+			__m128 mAbsNx[6], mAbsNy[6], mAbsNz[6];
+
+			explicit broadcast_planes(const frustum& pFrustum)
+			{
+				for (size_t i = 0; i < 6; ++i) {
+					const glm::vec4& p = pFrustum.planes()[i];
+					mNx[i] = _mm_set1_ps(p.x); mNy[i] = _mm_set1_ps(p.y); mNz[i] = _mm_set1_ps(p.z); mD[i] = _mm_set1_ps(p.w);
+					mAbsNx[i] = _mm_set1_ps(std::abs(p.x)); mAbsNy[i] = _mm_set1_ps(std::abs(p.y)); mAbsNz[i] = _mm_set1_ps(std::abs(p.z));
+				}
+			}
+
+			/** Returns a mask with one bit per lane which is set if the lane's volume is completely outside of a plane */
+			int outside_mask(__m128 pCx, __m128 pCy, __m128 pCz, __m128 pRx, __m128 pRy, __m128 pRz, bool pIsSphere) const
+			{
+				__m128 outside = _mm_setzero_ps();
+				for (size_t i = 0; i < 6; ++i) {
+					const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mNx[i], pCx), _mm_mul_ps(mNy[i], pCy)), _mm_add_ps(_mm_mul_ps(mNz[i], pCz), mD[i]));
+					// projected radius of the box onto the plane normal, or the sphere's radius (which is passed in pRx)
+					const __m128 radius = pIsSphere ? pRx
+						: _mm_add_ps(_mm_add_ps(_mm_mul_ps(mAbsNx[i], pRx), _mm_mul_ps(mAbsNy[i], pRy)), _mm_mul_ps(mAbsNz[i], pRz));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+				}
+				return _mm_movemask_ps(outside);
+			}
+		};
+
+		void append_visible(int pOutsideMask, uint32_t pFirstIndex, std::vector<uint32_t>& outVisible)
+		{
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+				if (0 == (pOutsideMask & (1 << lane))) {
+					outVisible.push_back(pFirstIndex + lane);
+				}
+			}
+		}
+	}
+#endif
+
+	frustum::frustum() noexcept
+	{
+		// A default frustum contains everything
+		mPlanes.fill(glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f });
+	}
+
+	frustum frustum::from_matrix(const glm::mat4& pProjectionAndView)
+	{
+		// rows of the matrix (glm is column-major)
+		const glm::mat4 m = glm::transpose(pProjectionAndView);
+		frustum result;
+		result.mPlanes[left_plane]   = m[3] + m[0];
+		result.mPlanes[right_plane]  = m[3] - m[0];
+		result.mPlanes[bottom_plane] = m[3] + m[1];
+		result.mPlanes[top_plane]    = m[3] - m[1];
+		result.mPlanes[near_plane]   = m[2];
+		result.mPlanes[far_plane]    = m[3] - m[2];
+		for (auto& p : result.mPlanes) {
+			const float len = glm::length(glm::vec3(p));
+			if (len > 0.0f) {
+				p /= len;
+			}
+		}
+		return result;
+	}
+
+	frustum frustum::from_camera(const camera& pCamera)
+	{
+		return from_matrix(pCamera.projection_and_view_matrix());
+	}
+
+	bool frustum::intersects_sphere(const glm::vec3& pCenter, float pRadius) const
+	{
+		for (const auto& p : mPlanes) {
+			if (glm::dot(glm::vec3(p), pCenter) + p.w < -pRadius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool frustum::intersects_aabb(const aabb& pBox) const
+	{
+		const glm::vec3 center = pBox.center();
+		const glm::vec3 halfExtent = pBox.half_extent();
+		for (const auto& p : mPlanes) {
+			const float radius = glm::dot(glm::abs(glm::vec3(p)), halfExtent);
+			if (glm::dot(glm::vec3(p), center) + p.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void cull_aabbs(std::span<const aabb> pBoxes, const frustum& pFrustum, std::vector<uint32_t>& outVisible)
+	{
+		outVisible.clear();
+		size_t i = 0;
+#ifdef CGB_FRUSTUM_SSE
+		const broadcast_planes planes(pFrustum);
+		const __m128 half = _mm_set1_ps(0.5f);
+		for (; i + 4 <= pBoxes.size(); i += 4) {
+			const aabb* b = &pBoxes[i];
+			const __m128 minX = _mm_setr_ps(b[0].mMin.x, b[1].mMin.x, b[2].mMin.x, b[3].mMin.x);
+			const __m128 minY = _mm_setr_ps(b[0].mMin.y, b[1].mMin.y, b[2].mMin.y, b[3].mMin.y);
+			const __m128 minZ = _mm_setr_ps(b[0].mMin.z, b[1].mMin.z, b[2].mMin.z, b[3].mMin.z);
+			const __m128 maxX = _mm_setr_ps(b[0].mMax.x, b[1].mMax.x, b[2].mMax.x, b[3].mMax.x);
+			const __m128 maxY = _mm_setr_ps(b[0].mMax.y, b[1].mMax.y, b[2].mMax.y, b[3].mMax.y);
+			const __m128 maxZ = _mm_setr_ps(b[0].mMax.z, b[1].mMax.z, b[2].mMax.z, b[3].mMax.z);
+			const int outside = planes.outside_mask(
+				_mm_mul_ps(_mm_add_ps(minX, maxX), half), _mm_mul_ps(_mm_add_ps(minY, maxY), half), _mm_mul_ps(_mm_add_ps(minZ, maxZ), half),
+				_mm_mul_ps(_mm_sub_ps(maxX, minX), half), _mm_mul_ps(_mm_sub_ps(maxY, minY), half), _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half),
+				false);
+			append_visible(outside, static_cast<uint32_t>(i), outVisible);
+		}
+#endif
+		for (; i < pBoxes.size(); ++i) {
+			if (pFrustum.intersects_aabb(pBoxes[i])) {
+				outVisible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	void cull_spheres(std::span<const bounding_sphere> pSpheres, const frustum& pFrustum, std::vector<uint32_t>& outVisible)
+	{
+		outVisible.clear();
+		size_t i = 0;
+#ifdef CGB_FRUSTUM_SSE
+		const broadcast_planes planes(pFrustum);
+		for (; i + 4 <= pSpheres.size(); i += 4) {
+			const bounding_sphere* s = &pSpheres[i];
+			const __m128 radius = _mm_setr_ps(s[0].mRadius, s[1].mRadius, s[2].mRadius, s[3].mRadius);
+			const int outside = planes.outside_mask(
+				_mm_setr_ps(s[0].mCenter.x, s[1].mCenter.x, s[2].mCenter.x, s[3].mCenter.x),
+				_mm_setr_ps(s[0].mCenter.y, s[1].mCenter.y, s[2].mCenter.y, s[3].mCenter.y),
+				_mm_setr_ps(s[0].mCenter.z, s[1].mCenter.z, s[2].mCenter.z, s[3].mCenter.z),
+				radius, radius, radius, true);
+			append_visible(outside, static_cast<uint32_t>(i), outVisible);
+		}
+#endif
+		for (; i < pSpheres.size(); ++i) {
+			if (pFrustum.intersects_sphere(pSpheres[i])) {
+				outVisible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	}
+}
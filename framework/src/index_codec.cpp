@@ -0,0 +1,144 @@
+#include "index_codec.h"
+
+namespace cgb
+{
+	namespace
+	{
+		void write_varint(std::vector<uint8_t>& pOut, uint64_t pValue)
+		{
+			while (pValue >= 0x80) {
+				pOut.push_back(static_cast<uint8_t>(pValue | 0x80));
+				pValue >>= 7;
+			}
+			pOut.push_back(static_cast<uint8_t>(pValue));
+		}
+
+		uint64_t read_varint(const uint8_t*& pCursor, const uint8_t* pEnd)
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				if (pCursor == pEnd) {
+					throw std::runtime_error("Compressed index data is truncated");
+				}
+				const uint8_t byte = *pCursor++;
+				value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+				if (0 == (byte & 0x80)) {
+					return value;
+				}
+			}
+			throw std::runtime_error("Compressed index data contains an invalid variable-length integer");
+		}
+
+		uint64_t zigzag_encode(int64_t pValue)
+		{
+			return (static_cast<uint64_t>(pValue) << 1) ^ static_cast<uint64_t>(pValue >> 63);
+		}
+
+		int64_t zigzag_decode(uint64_t pValue)
+		{
+			return static_cast<int64_t>(pValue >> 1) ^ -static_cast<int64_t>(pValue & 1);
+		}
+	}
+
+	size_t smallest_index_size(const std::vector<uint32_t>& pIndices)
+	{
+		const auto maxIt = std::max_element(std::begin(pIndices), std::end(pIndices));
+		if (maxIt == std::end(pIndices) || *maxIt < kPrimitiveRestartIndex16) {
+			return sizeof(uint16_t);
+		}
+		return sizeof(uint32_t);
+	}
+
+	std::vector<uint8_t> pack_indices(const std::vector<uint32_t>& pIndices, size_t pIndexSize)
+	{
+		std::vector<uint8_t> result(pIndices.size() * pIndexSize);
+		switch (pIndexSize) {
+		case sizeof(uint16_t):
+		{
+			auto* dst = reinterpret_cast<uint16_t*>(result.data());
+			for (size_t i = 0; i < pIndices.size(); ++i) {
+				assert(pIndices[i] < kPrimitiveRestartIndex16);
+				dst[i] = static_cast<uint16_t>(pIndices[i]);
+			}
+			break;
+		}
+		case sizeof(uint32_t):
+			if (!pIndices.empty()) {
+				memcpy(result.data(), pIndices.data(), result.size());
+			}
+			break;
+		default:
+			throw std::runtime_error(fmt::format("Invalid index size of {} bytes", pIndexSize));
+		}
+		return result;
+	}
+
+	std::vector<uint32_t> unpack_indices(const uint8_t* pData, size_t pIndexCount, size_t pIndexSize)
+	{
+		std::vector<uint32_t> result(pIndexCount);
+		switch (pIndexSize) {
+		case sizeof(uint16_t):
+		{
+			const auto* src = reinterpret_cast<const uint16_t*>(pData);
+			for (size_t i = 0; i < pIndexCount; ++i) {
+				result[i] = src[i];
+			}
+			break;
+		}
+		case sizeof(uint32_t):
+			if (pIndexCount > 0) {
+				memcpy(result.data(), pData, pIndexCount * sizeof(uint32_t));
+			}
+			break;
+		default:
+			throw std::runtime_error(fmt::format("Invalid index size of {} bytes", pIndexSize));
+		}
+		return result;
+	}
+
+	std::vector<uint8_t> compress_indices(const std::vector<uint32_t>& pIndices)
+	{
+		std::vector<uint8_t> result;
+		result.reserve(pIndices.size() * 2);
+
+		// Code 0 refers to the next vertex which has not been referenced so far,
+		// every other code c stores the zigzag-encoded delta to the previous index as c-1.
+		uint64_t nextUnused = 0;
+		int64_t previous = 0;
+		for (const uint32_t index : pIndices) {
+			if (index == nextUnused) {
+				write_varint(result, 0);
+			}
+			else {
+				write_varint(result, zigzag_encode(static_cast<int64_t>(index) - previous) + 1);
+			}
+			nextUnused = std::max(nextUnused, static_cast<uint64_t>(index) + 1);
+			previous = index;
+		}
+		return result;
+	}
+
+	std::vector<uint32_t> decompress_indices(const uint8_t* pData, size_t pDataSize, size_t pIndexCount)
+	{
+		std::vector<uint32_t> result;
+		result.reserve(pIndexCount);
+
+		const uint8_t* cursor = pData;
+		const uint8_t* end = pData + pDataSize;
+		uint64_t nextUnused = 0;
+		int64_t previous = 0;
+		for (size_t i = 0; i < pIndexCount; ++i) {
+			const uint64_t code = read_varint(cursor, end);
+			const int64_t index = 0 == code
+				? static_cast<int64_t>(nextUnused)
+				: previous + zigzag_decode(code - 1);
+			if (index < 0 || index > static_cast<int64_t>(UINT32_MAX)) {
+				throw std::runtime_error("Compressed index data contains an out-of-range index");
+			}
+			result.push_back(static_cast<uint32_t>(index));
+			nextUnused = std::max(nextUnused, static_cast<uint64_t>(index) + 1);
+			previous = index;
+		}
+		return result;
+	}
+}
@@ -0,0 +1,252 @@
+#include "mapped_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cgb
+{
+	mapped_file::mapped_file() noexcept
+		: mData(nullptr)
+		, mSize(0)
+		, mFileHandle(nullptr)
+		, mMappingHandle(nullptr)
+	{ }
+
+	mapped_file::mapped_file(mapped_file&& other) noexcept
+		: mData(std::move(other.mData))
+		, mSize(std::move(other.mSize))
+		, mFileHandle(std::move(other.mFileHandle))
+		, mMappingHandle(std::move(other.mMappingHandle))
+	{
+		other.mData = nullptr;
+		other.mSize = 0;
+		other.mFileHandle = nullptr;
+		other.mMappingHandle = nullptr;
+	}
+
+	mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+	{
+		close();
+		mData = std::move(other.mData);
+		mSize = std::move(other.mSize);
+		mFileHandle = std::move(other.mFileHandle);
+		mMappingHandle = std::move(other.mMappingHandle);
+		other.mData = nullptr;
+		other.mSize = 0;
+		other.mFileHandle = nullptr;
+		other.mMappingHandle = nullptr;
+		return *this;
+	}
+
+	mapped_file::~mapped_file()
+	{
+		close();
+	}
+
+	mapped_file mapped_file::open(const std::string& pPath)
+	{
+		mapped_file result;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(pPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (INVALID_HANDLE_VALUE == file) {
+			throw std::runtime_error(fmt::format("Couldn't open file '{}' for mapping", pPath));
+		}
+		result.mFileHandle = file;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			throw std::runtime_error(fmt::format("Couldn't determine the size of file '{}'", pPath));
+		}
+		result.mSize = static_cast<size_t>(size.QuadPart);
+		// Empty files can not be mapped, but there is nothing to read from them anyways
+		if (0 == result.mSize) {
+			return result;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (nullptr == mapping) {
+			throw std::runtime_error(fmt::format("Couldn't create a file mapping for '{}'", pPath));
+		}
+		result.mMappingHandle = mapping;
+
+		result.mData = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (nullptr == result.mData) {
+			throw std::runtime_error(fmt::format("Couldn't map file '{}' into memory", pPath));
+		}
+#else
+		const int file = ::open(pPath.c_str(), O_RDONLY);
+		if (-1 == file) {
+			throw std::runtime_error(fmt::format("Couldn't open file '{}' for mapping", pPath));
+		}
+
+		struct stat info;
+		if (0 != fstat(file, &info)) {
+			::close(file);
+			throw std::runtime_error(fmt::format("Couldn't determine the size of file '{}'", pPath));
+		}
+		result.mSize = static_cast<size_t>(info.st_size);
+		if (0 == result.mSize) {
+			::close(file);
+			return result;
+		}
+
+		void* mapped = mmap(nullptr, result.mSize, PROT_READ, MAP_PRIVATE, file, 0);
+		// The mapping stays valid after the descriptor has been closed
+		::close(file);
+		if (MAP_FAILED == mapped) {
+			result.mSize = 0;
+			throw std::runtime_error(fmt::format("Couldn't map file '{}' into memory", pPath));
+		}
+		madvise(mapped, result.mSize, MADV_SEQUENTIAL);
+		result.mData = static_cast<const std::byte*>(mapped);
+#endif
+		return result;
+	}
+
+	void mapped_file::close() noexcept
+	{
+#ifdef _WIN32
+		if (nullptr != mData) {
+			UnmapViewOfFile(mData);
+		}
+		if (nullptr != mMappingHandle) {
+			CloseHandle(mMappingHandle);
+		}
+		if (nullptr != mFileHandle) {
+			CloseHandle(mFileHandle);
+		}
+#else
+		if (nullptr != mData) {
+			munmap(const_cast<std::byte*>(mData), mSize);
+		}
+#endif
+		mData = nullptr;
+		mSize = 0;
+		mFileHandle = nullptr;
+		mMappingHandle = nullptr;
+	}
+
+
+	mapped_io_stream::mapped_io_stream(std::span<const std::byte> pData, std::shared_ptr<const mapped_file> pFile)
+		: mData(pData)
+		, mPosition(0)
+		, mFile(std::move(pFile))
+	{ }
+
+	size_t mapped_io_stream::Read(void* pvBuffer, size_t pSize, size_t pCount)
+	{
+		if (0 == pSize || 0 == pCount) {
+			return 0;
+		}
+		const size_t count = std::min(pCount, (mData.size() - mPosition) / pSize);
+		memcpy(pvBuffer, mData.data() + mPosition, count * pSize);
+		mPosition += count * pSize;
+		return count;
+	}
+
+	size_t mapped_io_stream::Write(const void*, size_t, size_t)
+	{
+		// read-only
+		return 0;
+	}
+
+	aiReturn mapped_io_stream::Seek(size_t pOffset, aiOrigin pOrigin)
+	{
+		size_t newPosition;
+		switch (pOrigin) {
+		case aiOrigin_SET:
+			newPosition = pOffset;
+			break;
+		case aiOrigin_CUR:
+			newPosition = mPosition + pOffset;
+			break;
+		case aiOrigin_END:
+			if (pOffset > mData.size()) {
+				return aiReturn_FAILURE;
+			}
+			newPosition = mData.size() - pOffset;
+			break;
+		default:
+			return aiReturn_FAILURE;
+		}
+		if (newPosition > mData.size()) {
+			return aiReturn_FAILURE;
+		}
+		mPosition = newPosition;
+		return aiReturn_SUCCESS;
+	}
+
+	size_t mapped_io_stream::Tell() const
+	{
+		return mPosition;
+	}
+
+	size_t mapped_io_stream::FileSize() const
+	{
+		return mData.size();
+	}
+
+	void mapped_io_stream::Flush()
+	{ }
+
+
+	bool mapped_io_system::Exists(const char* pFile) const
+	{
+		if (mMappedFiles.count(pFile) > 0) {
+			return true;
+		}
+		std::error_code ec;
+		return std::filesystem::is_regular_file(pFile, ec);
+	}
+
+	char mapped_io_system::getOsSeparator() const
+	{
+#ifdef _WIN32
+		return '\\';
+#else
+		return '/';
+#endif
+	}
+
+	Assimp::IOStream* mapped_io_system::Open(const char* pFile, const char* pMode)
+	{
+		if (nullptr != strchr(pMode, 'w') || nullptr != strchr(pMode, 'a') || nullptr != strchr(pMode, '+')) {
+			LOG_WARNING(fmt::format("mapped_io_system is read-only, can't open '{}' with mode '{}'", pFile, pMode));
+			return nullptr;
+		}
+
+		auto it = mMappedFiles.find(pFile);
+		if (it == mMappedFiles.end()) {
+			std::error_code ec;
+			if (!std::filesystem::is_regular_file(pFile, ec)) {
+				return nullptr;
+			}
+			try {
+				it = mMappedFiles.emplace(pFile, std::make_shared<const mapped_file>(mapped_file::open(pFile))).first;
+			}
+			catch (std::runtime_error& e) {
+				LOG_ERROR(e.what());
+				return nullptr;
+			}
+		}
+		return new mapped_io_stream(it->second->bytes(), it->second);
+	}
+
+	void mapped_io_system::Close(Assimp::IOStream* pFile)
+	{
+		delete pFile;
+	}
+
+	size_t mapped_io_system::mapped_bytes() const
+	{
+		size_t total = 0;
+		for (const auto& entry : mMappedFiles) {
+			total += entry.second->size();
+		}
+		return total;
+	}
+}
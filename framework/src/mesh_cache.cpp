@@ -0,0 +1,238 @@
+#include "mesh_cache.h"
+
+namespace cgb
+{
+	namespace
+	{
+		const char kMeshCacheMagic[4] = { 'C', 'G', 'B', 'M' };
+
+		enum struct index_encoding : uint8_t
+		{
+			packed = 0,
+			compressed = 1
+		};
+
+		template <typename T>
+		void write_value(std::ostream& pStream, const T& pValue)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be written directly");
+			pStream.write(reinterpret_cast<const char*>(&pValue), sizeof(T));
+		}
+
+		template <typename T>
+		T read_value(std::istream& pStream)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read directly");
+			T value;
+			pStream.read(reinterpret_cast<char*>(&value), sizeof(T));
+			if (!pStream) {
+				throw std::runtime_error("Unexpected end of mesh cache data");
+			}
+			return value;
+		}
+
+		void write_bytes(std::ostream& pStream, const void* pData, size_t pSize)
+		{
+			write_value(pStream, static_cast<uint64_t>(pSize));
+			if (pSize > 0) {
+				pStream.write(reinterpret_cast<const char*>(pData), pSize);
+			}
+		}
+
+		std::vector<uint8_t> read_bytes(std::istream& pStream)
+		{
+			const auto size = static_cast<size_t>(read_value<uint64_t>(pStream));
+			std::vector<uint8_t> bytes(size);
+			if (size > 0) {
+				pStream.read(reinterpret_cast<char*>(bytes.data()), size);
+				if (!pStream) {
+					throw std::runtime_error("Unexpected end of mesh cache data");
+				}
+			}
+			return bytes;
+		}
+
+		template <typename T>
+		void read_array(std::istream& pStream, std::vector<T>& outArray)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable types can be read directly");
+			const auto bytes = read_bytes(pStream);
+			if (bytes.size() % sizeof(T) != 0) {
+				throw std::runtime_error("Array data in the mesh cache has an unexpected size");
+			}
+			outArray.resize(bytes.size() / sizeof(T));
+			if (!bytes.empty()) {
+				memcpy(outArray.data(), bytes.data(), bytes.size());
+			}
+		}
+
+		void write_indices(std::ostream& pStream, const std::vector<uint32_t>& pIndices, size_t pIndexSize, bool pCompress)
+		{
+			write_value(pStream, static_cast<uint64_t>(pIndices.size()));
+			write_value(pStream, static_cast<uint8_t>(pIndexSize));
+			if (pCompress) {
+				write_value(pStream, index_encoding::compressed);
+				const auto compressed = compress_indices(pIndices);
+				write_bytes(pStream, compressed.data(), compressed.size());
+			}
+			else {
+				write_value(pStream, index_encoding::packed);
+				const auto packed = pack_indices(pIndices, pIndexSize);
+				write_bytes(pStream, packed.data(), packed.size());
+			}
+		}
+
+		std::vector<uint32_t> read_indices(std::istream& pStream)
+		{
+			const auto indexCount = static_cast<size_t>(read_value<uint64_t>(pStream));
+			const auto indexSize = static_cast<size_t>(read_value<uint8_t>(pStream));
+			const auto encoding = read_value<index_encoding>(pStream);
+			const auto indexData = read_bytes(pStream);
+			switch (encoding) {
+			case index_encoding::packed:
+				if (indexData.size() != indexCount * indexSize) {
+					throw std::runtime_error("Packed index data in the mesh cache has an unexpected size");
+				}
+				return unpack_indices(indexData.data(), indexCount, indexSize);
+			case index_encoding::compressed:
+				return decompress_indices(indexData.data(), indexData.size(), indexCount);
+			default:
+				throw std::runtime_error("Unknown index encoding in the mesh cache");
+			}
+		}
+	}
+
+	void write_mesh_to_cache(std::ostream& pStream, const Mesh& pMesh, bool pCompressIndices)
+	{
+		write_value(pStream, static_cast<int32_t>(pMesh.m_index));
+		write_bytes(pStream, pMesh.m_name.data(), pMesh.m_name.size());
+		write_value(pStream, pMesh.m_vertex_data_layout);
+		write_value(pStream, static_cast<int32_t>(pMesh.m_patch_size));
+		write_value(pStream, pMesh.m_scene_transformation_matrix);
+
+		const std::array<uint64_t, 17> layout = {
+			pMesh.m_size_one_vertex,
+			pMesh.m_position_offset, pMesh.m_normal_offset, pMesh.m_tex_coords_offset, pMesh.m_color_offset,
+			pMesh.m_bone_incides_offset, pMesh.m_bone_weights_offset, pMesh.m_tangent_offset, pMesh.m_bitangent_offset,
+			pMesh.m_position_size, pMesh.m_normal_size, pMesh.m_tex_coords_size, pMesh.m_color_size,
+			pMesh.m_bone_indices_size, pMesh.m_bone_weights_size, pMesh.m_tangent_size, pMesh.m_bitangent_size
+		};
+		write_value(pStream, layout);
+		write_bytes(pStream, pMesh.m_vertex_data.data(), pMesh.m_vertex_data.size());
+
+		write_indices(pStream, pMesh.m_indices, pMesh.m_index_size, pCompressIndices);
+
+		write_value(pStream, static_cast<uint32_t>(pMesh.m_lods.size()));
+		for (const auto& lod : pMesh.m_lods) {
+			write_value(pStream, lod.m_error);
+			write_indices(pStream, lod.m_indices, pMesh.m_index_size, pCompressIndices);
+		}
+
+		const auto& meshlets = pMesh.m_meshlets;
+		write_value(pStream, meshlets.mMaxVertices);
+		write_value(pStream, meshlets.mMaxTriangles);
+		write_bytes(pStream, meshlets.mMeshlets.data(), meshlets.mMeshlets.size() * sizeof(meshlet));
+		write_bytes(pStream, meshlets.mBounds.data(), meshlets.mBounds.size() * sizeof(meshlet_bounds));
+		write_bytes(pStream, meshlets.mVertices.data(), meshlets.mVertices.size() * sizeof(uint32_t));
+		write_bytes(pStream, meshlets.mTriangles.data(), meshlets.mTriangles.size());
+
+		write_bytes(pStream, pMesh.m_instances.data(), pMesh.m_instances.size() * sizeof(MeshInstance));
+
+		write_value(pStream, pMesh.m_local_bounds);
+		write_value(pStream, pMesh.m_local_bounding_sphere);
+		write_value(pStream, pMesh.m_bounds);
+		write_value(pStream, pMesh.m_bounding_sphere);
+	}
+
+	Mesh read_mesh_from_cache(std::istream& pStream)
+	{
+		Mesh mesh;
+		mesh.m_index = read_value<int32_t>(pStream);
+		const auto name = read_bytes(pStream);
+		mesh.m_name.assign(name.begin(), name.end());
+		const auto vertexDataLayout = read_value<VertexAttribData>(pStream);
+		const auto patchSize = read_value<int32_t>(pStream);
+		mesh.m_scene_transformation_matrix = read_value<glm::mat4>(pStream);
+
+		const auto layout = read_value<std::array<uint64_t, 17>>(pStream);
+		mesh.m_size_one_vertex = static_cast<size_t>(layout[0]);
+		auto vertexData = read_bytes(pStream);
+		mesh.SetVertexData(std::move(vertexData), vertexDataLayout,
+			layout[1], layout[2], layout[3], layout[4], layout[5], layout[6], layout[7], layout[8],
+			layout[9], layout[10], layout[11], layout[12], layout[13], layout[14], layout[15], layout[16]);
+
+		mesh.SetIndices(read_indices(pStream), patchSize);
+
+		const auto lodCount = read_value<uint32_t>(pStream);
+		mesh.m_lods.resize(lodCount);
+		for (auto& lod : mesh.m_lods) {
+			lod.m_error = read_value<float>(pStream);
+			lod.m_indices = read_indices(pStream);
+		}
+
+		auto& meshlets = mesh.m_meshlets;
+		meshlets.mMaxVertices = read_value<uint32_t>(pStream);
+		meshlets.mMaxTriangles = read_value<uint32_t>(pStream);
+		read_array(pStream, meshlets.mMeshlets);
+		read_array(pStream, meshlets.mBounds);
+		read_array(pStream, meshlets.mVertices);
+		meshlets.mTriangles = read_bytes(pStream);
+
+		read_array(pStream, mesh.m_instances);
+		// The nodes are not cached, don't let the instances refer to the nodes of the model which has been saved
+		for (auto& instance : mesh.m_instances) {
+			instance.m_node_index = -1;
+		}
+
+		mesh.m_local_bounds = read_value<aabb>(pStream);
+		mesh.m_local_bounding_sphere = read_value<bounding_sphere>(pStream);
+		mesh.m_bounds = read_value<aabb>(pStream);
+		mesh.m_bounding_sphere = read_value<bounding_sphere>(pStream);
+		return mesh;
+	}
+
+	void save_meshes_to_cache(const std::string& pPath, const std::vector<Mesh>& pMeshes, bool pCompressIndices)
+	{
+		std::ofstream os(pPath.c_str(), std::ofstream::binary);
+		if (!os) {
+			throw std::runtime_error(fmt::format("Couldn't open mesh cache file '{}' for writing", pPath));
+		}
+
+		os.write(kMeshCacheMagic, sizeof(kMeshCacheMagic));
+		write_value(os, kMeshCacheVersion);
+		write_value(os, static_cast<uint64_t>(pMeshes.size()));
+		for (const auto& mesh : pMeshes) {
+			write_mesh_to_cache(os, mesh, pCompressIndices);
+		}
+
+		if (!os) {
+			throw std::runtime_error(fmt::format("Couldn't write mesh cache file '{}'", pPath));
+		}
+	}
+
+	std::vector<Mesh> load_meshes_from_cache(const std::string& pPath)
+	{
+		std::ifstream is(pPath.c_str(), std::ifstream::binary);
+		if (!is) {
+			throw std::runtime_error(fmt::format("Couldn't open mesh cache file '{}'", pPath));
+		}
+
+		char magic[sizeof(kMeshCacheMagic)];
+		is.read(magic, sizeof(magic));
+		if (!is || 0 != memcmp(magic, kMeshCacheMagic, sizeof(magic))) {
+			throw std::runtime_error(fmt::format("'{}' is not a mesh cache file", pPath));
+		}
+		const auto version = read_value<uint32_t>(is);
+		if (version != kMeshCacheVersion) {
+			throw std::runtime_error(fmt::format("Mesh cache file '{}' has version {}, expected version {}", pPath, version, kMeshCacheVersion));
+		}
+
+		const auto meshCount = static_cast<size_t>(read_value<uint64_t>(is));
+		std::vector<Mesh> meshes;
+		meshes.reserve(meshCount);
+		for (size_t i = 0; i < meshCount; ++i) {
+			meshes.push_back(read_mesh_from_cache(is));
+		}
+		return meshes;
+	}
+}
@@ -0,0 +1,313 @@
+#include "mesh_simplifier.h"
+
+namespace cgb
+{
+	namespace
+	{
+		/** Symmetric 4x4 error quadric of the form (A, b, c) plus the accumulated weight */
+		struct quadric
+		{
+			double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+			double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+			double c = 0.0;
+			double w = 0.0;
+
+			void add_plane(const glm::dvec3& n, double d, double weight)
+			{
+				a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z;
+				a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a22 += weight * n.z * n.z;
+				b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+				c += weight * d * d;
+				w += weight;
+			}
+
+			quadric& operator+=(const quadric& o)
+			{
+				a00 += o.a00; a01 += o.a01; a02 += o.a02; a11 += o.a11; a12 += o.a12; a22 += o.a22;
+				b0 += o.b0; b1 += o.b1; b2 += o.b2;
+				c += o.c;
+				w += o.w;
+				return *this;
+			}
+
+			/** Weighted sum of squared distances of p to all planes */
+			double evaluate(const glm::dvec3& p) const
+			{
+				const double r = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+					+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+					+ 2.0 * (b0 * p.x + b1 * p.y + b2 * p.z)
+					+ c;
+				return std::max(r, 0.0);
+			}
+		};
+
+		enum struct vertex_kind : uint8_t
+		{
+			manifold,	// may collapse onto any neighbor
+			border,		// may only collapse along border edges onto other border vertices
+			locked		// seam or non-manifold vertex, never moves
+		};
+
+		/** Weight of the planes which keep open borders in place, relative to the triangle planes */
+		const double kBorderWeight = 10.0;
+
+		uint64_t edge_key(uint32_t a, uint32_t b)
+		{
+			if (a > b) std::swap(a, b);
+			return (static_cast<uint64_t>(a) << 32) | b;
+		}
+
+		struct position_hash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				uint32_t h[3];
+				memcpy(h, &p.x, sizeof(h));
+				return (h[0] * 73856093u) ^ (h[1] * 19349663u) ^ (h[2] * 83492791u);
+			}
+		};
+
+		struct collapse
+		{
+			uint32_t mFrom;
+			uint32_t mTo;
+			double mError;
+		};
+	}
+
+	std::vector<uint32_t> simplify_triangles(const std::vector<glm::vec3>& pPositions, const std::vector<uint32_t>& pIndices, size_t pTargetIndexCount, float pMaxError, float& outError)
+	{
+		assert(pIndices.size() % 3 == 0);
+		const size_t vertexCount = pPositions.size();
+		std::vector<uint32_t> indices = pIndices;
+		outError = 0.0f;
+
+		// Vertices with the same position are copies of one "wedge" which differ in other attributes
+		std::vector<uint32_t> wedge(vertexCount);
+		std::vector<uint32_t> wedgeSize(vertexCount, 0u);
+		{
+			std::unordered_map<glm::vec3, uint32_t, position_hash> firstVertexAtPosition;
+			firstVertexAtPosition.reserve(vertexCount);
+			for (uint32_t i = 0; i < static_cast<uint32_t>(vertexCount); ++i) {
+				wedge[i] = firstVertexAtPosition.emplace(pPositions[i], i).first->second;
+				++wedgeSize[wedge[i]];
+			}
+		}
+
+		// Classify vertices by the number of triangles which use each position-level edge
+		std::unordered_map<uint64_t, uint32_t> edgeUseCount;
+		edgeUseCount.reserve(indices.size());
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int e = 0; e < 3; ++e) {
+				++edgeUseCount[edge_key(wedge[indices[t + e]], wedge[indices[t + (e + 1) % 3]])];
+			}
+		}
+		std::vector<vertex_kind> kind(vertexCount, vertex_kind::manifold);
+		for (uint32_t i = 0; i < static_cast<uint32_t>(vertexCount); ++i) {
+			if (wedgeSize[wedge[i]] > 1) {
+				kind[i] = vertex_kind::locked;
+			}
+		}
+		auto isBorderEdge = [&](uint32_t a, uint32_t b) {
+			const auto it = edgeUseCount.find(edge_key(wedge[a], wedge[b]));
+			return it != edgeUseCount.end() && 1 == it->second;
+		};
+		for (const auto& entry : edgeUseCount) {
+			if (entry.second > 2) {
+				kind[entry.first >> 32] = vertex_kind::locked;
+				kind[entry.first & 0xFFFFFFFF] = vertex_kind::locked;
+			}
+		}
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			for (int e = 0; e < 3; ++e) {
+				const uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+				if (isBorderEdge(a, b)) {
+					if (vertex_kind::manifold == kind[a]) kind[a] = vertex_kind::border;
+					if (vertex_kind::manifold == kind[b]) kind[b] = vertex_kind::border;
+				}
+			}
+		}
+
+		// Accumulate the area-weighted plane quadrics, plus planes perpendicular to open borders
+		std::vector<quadric> quadrics(vertexCount);
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			const glm::dvec3 p[3] = { pPositions[indices[t]], pPositions[indices[t + 1]], pPositions[indices[t + 2]] };
+			const glm::dvec3 cr = glm::cross(p[1] - p[0], p[2] - p[0]);
+			const double crLen = glm::length(cr);
+			if (crLen <= 0.0) {
+				continue;
+			}
+			const glm::dvec3 n = cr / crLen;
+			const double area = 0.5 * crLen;
+			quadric q;
+			q.add_plane(n, -glm::dot(n, p[0]), area);
+			for (int e = 0; e < 3; ++e) {
+				quadrics[indices[t + e]] += q;
+			}
+
+			for (int e = 0; e < 3; ++e) {
+				const uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+				if (!isBorderEdge(a, b)) {
+					continue;
+				}
+				const glm::dvec3 edge = p[(e + 1) % 3] - p[e];
+				const double edgeLen = glm::length(edge);
+				if (edgeLen <= 0.0) {
+					continue;
+				}
+				const glm::dvec3 bn = glm::normalize(glm::cross(edge, n));
+				quadric bq;
+				bq.add_plane(bn, -glm::dot(bn, p[e]), edgeLen * edgeLen * kBorderWeight);
+				quadrics[a] += bq;
+				quadrics[b] += bq;
+			}
+		}
+
+		auto collapseError = [&](uint32_t from, uint32_t to) {
+			quadric q = quadrics[from];
+			q += quadrics[to];
+			return q.w > 0.0 ? q.evaluate(pPositions[to]) / q.w : 0.0;
+		};
+		auto canCollapse = [&](uint32_t from, uint32_t to) {
+			switch (kind[from]) {
+			case vertex_kind::manifold:
+				return true;
+			case vertex_kind::border:
+				return vertex_kind::locked != kind[to] && isBorderEdge(from, to);
+			default:
+				return false;
+			}
+		};
+
+		const double maxErrorSq = static_cast<double>(pMaxError) * static_cast<double>(pMaxError);
+		double resultErrorSq = 0.0;
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint8_t> passLocked(vertexCount);
+		std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+		std::vector<uint32_t> vertexTriangles;
+		std::vector<collapse> collapses;
+
+		while (indices.size() > pTargetIndexCount) {
+			const size_t triangleCount = indices.size() / 3;
+
+			// Vertex -> triangle adjacency of the current triangle list
+			std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+			for (const uint32_t idx : indices) {
+				++triangleOffsets[idx + 1];
+			}
+			for (size_t i = 0; i < vertexCount; ++i) {
+				triangleOffsets[i + 1] += triangleOffsets[i];
+			}
+			vertexTriangles.resize(indices.size());
+			{
+				std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+				for (size_t t = 0; t < triangleCount; ++t) {
+					for (int e = 0; e < 3; ++e) {
+						vertexTriangles[fill[indices[t * 3 + e]]++] = static_cast<uint32_t>(t);
+					}
+				}
+			}
+
+			// Gather the cheapest allowed direction of every edge
+			collapses.clear();
+			for (size_t t = 0; t < indices.size(); t += 3) {
+				for (int e = 0; e < 3; ++e) {
+					const uint32_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+					if (a > b && !isBorderEdge(a, b)) {
+						continue; // interior edges are visited twice, handle them only once
+					}
+					const bool ab = canCollapse(a, b), ba = canCollapse(b, a);
+					if (!ab && !ba) {
+						continue;
+					}
+					const double eab = ab ? collapseError(a, b) : std::numeric_limits<double>::max();
+					const double eba = ba ? collapseError(b, a) : std::numeric_limits<double>::max();
+					collapses.push_back(eab <= eba ? collapse{ a, b, eab } : collapse{ b, a, eba });
+				}
+			}
+			if (collapses.empty()) {
+				break;
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const collapse& x, const collapse& y) { return x.mError < y.mError; });
+
+			// Perform independent collapses in order of increasing error
+			for (uint32_t i = 0; i < static_cast<uint32_t>(vertexCount); ++i) {
+				remap[i] = i;
+			}
+			std::fill(passLocked.begin(), passLocked.end(), uint8_t{ 0 });
+			const size_t trianglesToRemove = (indices.size() - pTargetIndexCount + 2) / 3;
+			size_t trianglesRemoved = 0;
+			size_t collapsesPerformed = 0;
+			for (const auto& c : collapses) {
+				if (c.mError > maxErrorSq || trianglesRemoved >= trianglesToRemove) {
+					break;
+				}
+				if (passLocked[c.mFrom] || passLocked[c.mTo]) {
+					continue;
+				}
+
+				// Reject collapses which would flip a remaining triangle
+				bool flips = false;
+				size_t degenerates = 0;
+				for (uint32_t k = triangleOffsets[c.mFrom]; k < triangleOffsets[c.mFrom + 1]; ++k) {
+					const size_t t = vertexTriangles[k] * 3;
+					const uint32_t v[3] = { indices[t], indices[t + 1], indices[t + 2] };
+					if (v[0] == c.mTo || v[1] == c.mTo || v[2] == c.mTo) {
+						++degenerates;
+						continue;
+					}
+					const glm::vec3 p0 = pPositions[v[0]], p1 = pPositions[v[1]], p2 = pPositions[v[2]];
+					const glm::vec3 nBefore = glm::cross(p1 - p0, p2 - p0);
+					const glm::vec3 q0 = pPositions[v[0] == c.mFrom ? c.mTo : v[0]];
+					const glm::vec3 q1 = pPositions[v[1] == c.mFrom ? c.mTo : v[1]];
+					const glm::vec3 q2 = pPositions[v[2] == c.mFrom ? c.mTo : v[2]];
+					const glm::vec3 nAfter = glm::cross(q1 - q0, q2 - q0);
+					if (glm::dot(nBefore, nAfter) <= 0.0f) {
+						flips = true;
+						break;
+					}
+				}
+				if (flips) {
+					continue;
+				}
+
+				remap[c.mFrom] = c.mTo;
+				quadrics[c.mTo] += quadrics[c.mFrom];
+				// Lock the whole one-ring, so that all collapses within one pass are independent
+				for (uint32_t k = triangleOffsets[c.mFrom]; k < triangleOffsets[c.mFrom + 1]; ++k) {
+					const size_t t = vertexTriangles[k] * 3;
+					passLocked[indices[t]] = passLocked[indices[t + 1]] = passLocked[indices[t + 2]] = 1;
+				}
+				resultErrorSq = std::max(resultErrorSq, c.mError);
+				trianglesRemoved += degenerates;
+				++collapsesPerformed;
+			}
+			if (0 == collapsesPerformed) {
+				break;
+			}
+
+			// Apply the collapses and remove degenerate triangles
+			size_t writePos = 0;
+			for (size_t t = 0; t < indices.size(); t += 3) {
+				const uint32_t a = remap[indices[t]], b = remap[indices[t + 1]], c = remap[indices[t + 2]];
+				if (a == b || b == c || c == a) {
+					continue;
+				}
+				indices[writePos++] = a;
+				indices[writePos++] = b;
+				indices[writePos++] = c;
+			}
+			indices.resize(writePos);
+		}
+
+		outError = static_cast<float>(std::sqrt(resultErrorSq));
+		return indices;
+	}
+
+	float lod_error_threshold(float pDistance, float pFieldOfViewY, float pViewportHeight, float pPixelError)
+	{
+		// Size of one pixel in object-space units at the given distance
+		const float pixelSize = 2.0f * pDistance * std::tan(0.5f * pFieldOfViewY) / pViewportHeight;
+		return pPixelError * pixelSize;
+	}
+}
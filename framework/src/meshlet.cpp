@@ -0,0 +1,231 @@
+#include "meshlet.h"
+
+namespace cgb
+{
+	namespace
+	{
+		meshlet_bounds compute_bounds(const std::vector<glm::vec3>& pPositions, const meshlet_data& pData, const meshlet& pMeshlet)
+		{
+			meshlet_bounds bounds;
+
+			// Bounding sphere around the center of the bounding box
+			glm::vec3 minPos{ std::numeric_limits<float>::max() };
+			glm::vec3 maxPos{ std::numeric_limits<float>::lowest() };
+			for (uint32_t i = 0; i < pMeshlet.mVertexCount; ++i) {
+				const auto& p = pPositions[pData.mVertices[pMeshlet.mVertexOffset + i]];
+				minPos = glm::min(minPos, p);
+				maxPos = glm::max(maxPos, p);
+			}
+			bounds.mCenter = 0.5f * (minPos + maxPos);
+			float radiusSq = 0.0f;
+			for (uint32_t i = 0; i < pMeshlet.mVertexCount; ++i) {
+				const auto d = pPositions[pData.mVertices[pMeshlet.mVertexOffset + i]] - bounds.mCenter;
+				radiusSq = std::max(radiusSq, glm::dot(d, d));
+			}
+			bounds.mRadius = std::sqrt(radiusSq);
+
+			// Normal cone around the average of the triangle normals
+			std::vector<glm::vec3> normals;
+			normals.reserve(pMeshlet.mTriangleCount);
+			glm::vec3 axis{ 0.0f };
+			for (uint32_t t = 0; t < pMeshlet.mTriangleCount; ++t) {
+				const uint8_t* tri = &pData.mTriangles[pMeshlet.mTriangleOffset + t * 3];
+				const auto& p0 = pPositions[pData.mVertices[pMeshlet.mVertexOffset + tri[0]]];
+				const auto& p1 = pPositions[pData.mVertices[pMeshlet.mVertexOffset + tri[1]]];
+				const auto& p2 = pPositions[pData.mVertices[pMeshlet.mVertexOffset + tri[2]]];
+				const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				const float len = glm::length(n);
+				if (len > 0.0f) {
+					normals.push_back(n / len);
+					axis += normals.back();
+				}
+			}
+			const float axisLen = glm::length(axis);
+			bounds.mConeAxis = axisLen > 0.0f ? axis / axisLen : glm::vec3{ 0.0f, 0.0f, 1.0f };
+			float minDot = axisLen > 0.0f ? 1.0f : -1.0f;
+			for (const auto& n : normals) {
+				minDot = std::min(minDot, glm::dot(n, bounds.mConeAxis));
+			}
+			// Cones which are (almost) wider than a hemisphere are useless for culling
+			bounds.mConeCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+			return bounds;
+		}
+	}
+
+	meshlet_data build_meshlets(const std::vector<glm::vec3>& pPositions, const std::vector<uint32_t>& pIndices, uint32_t pMaxVertices, uint32_t pMaxTriangles)
+	{
+		assert(pIndices.size() % 3 == 0);
+		assert(pMaxVertices >= 3 && pMaxVertices < 0xFF);
+		assert(pMaxTriangles >= 1);
+
+		const size_t vertexCount = pPositions.size();
+		const size_t triangleCount = pIndices.size() / 3;
+
+		meshlet_data result;
+		result.mMaxVertices = pMaxVertices;
+		result.mMaxTriangles = pMaxTriangles;
+		result.mMeshlets.reserve(triangleCount / pMaxTriangles + 1);
+		result.mVertices.reserve(pIndices.size() / 2);
+		result.mTriangles.reserve(pIndices.size());
+
+		// Vertex -> triangle adjacency
+		std::vector<uint32_t> triangleOffsets(vertexCount + 1, 0u);
+		for (const uint32_t idx : pIndices) {
+			++triangleOffsets[idx + 1];
+		}
+		for (size_t i = 0; i < vertexCount; ++i) {
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+		std::vector<uint32_t> vertexTriangles(pIndices.size());
+		{
+			std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (size_t i = 0; i < pIndices.size(); ++i) {
+				vertexTriangles[fill[pIndices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		// Meshlet-local index of every vertex which is used by the current meshlet, 0xFF otherwise
+		std::vector<uint8_t> localIndex(vertexCount, 0xFF);
+
+		meshlet current{ 0u, 0u, 0u, 0u };
+		glm::vec3 centroidSum{ 0.0f };
+
+		auto newVerticesOf = [&](size_t t) {
+			uint32_t count = 0;
+			for (int e = 0; e < 3; ++e) {
+				if (0xFF == localIndex[pIndices[t * 3 + e]]) {
+					++count;
+				}
+			}
+			return count;
+		};
+
+		auto finishMeshlet = [&]() {
+			if (0 == current.mTriangleCount) {
+				return;
+			}
+			for (uint32_t i = 0; i < current.mVertexCount; ++i) {
+				localIndex[result.mVertices[current.mVertexOffset + i]] = 0xFF;
+			}
+			result.mMeshlets.push_back(current);
+			current = meshlet{ static_cast<uint32_t>(result.mVertices.size()), static_cast<uint32_t>(result.mTriangles.size()), 0u, 0u };
+			centroidSum = glm::vec3{ 0.0f };
+		};
+
+		auto appendTriangle = [&](size_t t) {
+			for (int e = 0; e < 3; ++e) {
+				const uint32_t v = pIndices[t * 3 + e];
+				if (0xFF == localIndex[v]) {
+					localIndex[v] = static_cast<uint8_t>(current.mVertexCount++);
+					result.mVertices.push_back(v);
+					centroidSum += pPositions[v];
+				}
+				result.mTriangles.push_back(localIndex[v]);
+			}
+			++current.mTriangleCount;
+			emitted[t] = 1;
+		};
+
+		size_t seedCursor = 0;
+		size_t emittedCount = 0;
+		while (emittedCount < triangleCount) {
+			// Find the best adjacent triangle: fewest new vertices, then closest to the meshlet's centroid
+			size_t best = triangleCount;
+			uint32_t bestNew = 4;
+			float bestDistSq = std::numeric_limits<float>::max();
+			if (current.mTriangleCount > 0) {
+				const glm::vec3 centroid = centroidSum / static_cast<float>(current.mVertexCount);
+				for (uint32_t i = 0; i < current.mVertexCount && bestNew > 0; ++i) {
+					const uint32_t v = result.mVertices[current.mVertexOffset + i];
+					for (uint32_t k = triangleOffsets[v]; k < triangleOffsets[v + 1]; ++k) {
+						const uint32_t t = vertexTriangles[k];
+						if (emitted[t]) {
+							continue;
+						}
+						const uint32_t newVerts = newVerticesOf(t);
+						if (current.mVertexCount + newVerts > pMaxVertices) {
+							continue;
+						}
+						const glm::vec3 triCenter = (pPositions[pIndices[t * 3]] + pPositions[pIndices[t * 3 + 1]] + pPositions[pIndices[t * 3 + 2]]) / 3.0f;
+						const glm::vec3 d = triCenter - centroid;
+						const float distSq = glm::dot(d, d);
+						if (newVerts < bestNew || (newVerts == bestNew && distSq < bestDistSq)) {
+							best = t;
+							bestNew = newVerts;
+							bestDistSq = distSq;
+						}
+					}
+				}
+			}
+
+			if (best == triangleCount) {
+				// No adjacent triangle fits: continue with the next unused triangle in index order
+				while (emitted[seedCursor]) {
+					++seedCursor;
+				}
+				best = seedCursor;
+				if (current.mVertexCount + newVerticesOf(best) > pMaxVertices) {
+					finishMeshlet();
+				}
+			}
+
+			appendTriangle(best);
+			++emittedCount;
+			if (current.mTriangleCount >= pMaxTriangles || current.mVertexCount == pMaxVertices) {
+				finishMeshlet();
+			}
+		}
+		finishMeshlet();
+
+		result.mBounds.reserve(result.mMeshlets.size());
+		for (const auto& m : result.mMeshlets) {
+			result.mBounds.push_back(compute_bounds(pPositions, result, m));
+		}
+		return result;
+	}
+
+	void cull_meshlets(const meshlet_data& pMeshlets, const glm::mat4& pModelMatrix, const frustum& pFrustum, const glm::vec3& pCameraPosition, std::vector<uint32_t>& outVisible, meshlet_culling_stats* outStats)
+	{
+		const glm::mat3 normalMatrix = glm::mat3(pModelMatrix);
+		const float maxScale = std::sqrt(std::max({
+			glm::dot(normalMatrix[0], normalMatrix[0]),
+			glm::dot(normalMatrix[1], normalMatrix[1]),
+			glm::dot(normalMatrix[2], normalMatrix[2]) }));
+		// Non-uniform scale distorts normal cones, don't use them in that case
+		const bool useCones = std::abs(glm::length(normalMatrix[0]) - glm::length(normalMatrix[1])) < 1e-4f * maxScale
+			&& std::abs(glm::length(normalMatrix[0]) - glm::length(normalMatrix[2])) < 1e-4f * maxScale
+			&& glm::determinant(normalMatrix) > 0.0f;
+
+		meshlet_culling_stats stats;
+		outVisible.clear();
+		for (size_t i = 0; i < pMeshlets.mMeshlets.size(); ++i) {
+			const auto& b = pMeshlets.mBounds[i];
+			++stats.mTested;
+
+			const glm::vec3 center = glm::vec3(pModelMatrix * glm::vec4(b.mCenter, 1.0f));
+			const float radius = b.mRadius * maxScale;
+			if (!pFrustum.intersects_sphere(center, radius)) {
+				++stats.mFrustumCulled;
+				continue;
+			}
+
+			if (useCones && b.mConeCutoff < 1.0f) {
+				// The meshlet is backfacing if the whole bounding sphere lies within the cone's negative space
+				const glm::vec3 axis = glm::normalize(normalMatrix * b.mConeAxis);
+				const glm::vec3 toCenter = center - pCameraPosition;
+				if (glm::dot(toCenter, axis) >= b.mConeCutoff * glm::length(toCenter) + radius) {
+					++stats.mBackfaceCulled;
+					continue;
+				}
+			}
+
+			outVisible.push_back(static_cast<uint32_t>(i));
+			stats.mVisibleTriangles += pMeshlets.mMeshlets[i].mTriangleCount;
+		}
+
+		if (nullptr != outStats) {
+			*outStats = stats;
+		}
+	}
+}
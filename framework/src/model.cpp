@@ -11,6 +11,22 @@
 
 namespace cgb
 {
+	namespace
+	{
+		// resizes one of a mesh's output buffers and records the heap allocation, if the resize made one
+		template <typename T>
+		void resize_output(std::vector<T>& buffer, size_t size, ModelImportStats& stats)
+		{
+			const size_t capacityBefore = buffer.capacity();
+			buffer.resize(size);
+			if (buffer.capacity() != capacityBefore)
+			{
+				++stats.m_output_allocations;
+				stats.m_output_bytes += buffer.capacity() * sizeof(T);
+			}
+		}
+	}
+
 	const char* Model::kIndent = "    ";
 	const glm::vec4 Model::kDefaultDiffuseColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
 	const glm::vec4 Model::kDefaultSpecularColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
@@ -35,7 +51,13 @@ namespace cgb
 
 	Model::Model(Model&& other) noexcept :
 		m_meshes(std::move(other.m_meshes)),
-		m_load_transformation_matrix(std::move(other.m_load_transformation_matrix))
+		m_skeleton(std::move(other.m_skeleton)),
+		m_animation_clips(std::move(other.m_animation_clips)),
+		m_bounds(other.m_bounds),
+		m_bounding_sphere(other.m_bounding_sphere),
+		m_load_transformation_matrix(std::move(other.m_load_transformation_matrix)),
+		m_import_stats(std::move(other.m_import_stats)),
+		m_nodes(std::move(other.m_nodes))
 	{
 	}
 
@@ -43,6 +65,12 @@ namespace cgb
 	{
 		m_meshes = std::move(other.m_meshes);
 		m_load_transformation_matrix = std::move(other.m_load_transformation_matrix);
+		m_import_stats = std::move(other.m_import_stats);
+		m_nodes = std::move(other.m_nodes);
+		m_skeleton = std::move(other.m_skeleton);
+		m_animation_clips = std::move(other.m_animation_clips);
+		m_bounds = other.m_bounds;
+		m_bounding_sphere = other.m_bounding_sphere;
 
 		return *this;
 	}
@@ -59,6 +87,11 @@ namespace cgb
 	}
 
 	std::unique_ptr<Model> Model::LoadFromMemory(const std::string& memory, const glm::mat4& transform_matrix, const unsigned int model_loader_flags)
+	{
+		return LoadFromMemory(std::as_bytes(std::span<const char>(memory.data(), memory.size())), transform_matrix, model_loader_flags);
+	}
+
+	std::unique_ptr<Model> Model::LoadFromMemory(std::span<const std::byte> memory, const glm::mat4& transform_matrix, const unsigned int model_loader_flags)
 	{
 		std::unique_ptr<Model> model = std::make_unique<Model>(transform_matrix);
 		if (!model->LoadFromMemory(memory, model_loader_flags))
@@ -92,23 +125,103 @@ namespace cgb
 	}
 
 
+	std::unique_ptr<Model> Model::LoadFromCache(const std::string& path, const glm::mat4& transform_matrix)
+	{
+		std::unique_ptr<Model> model = std::make_unique<Model>(transform_matrix);
+		model->m_meshes = load_meshes_from_cache(path);
+		model->UpdateBounds();
+		return model;
+	}
+
+	void Model::SaveToCache(const std::string& path, bool with_compressed_indices) const
+	{
+		save_meshes_to_cache(path, m_meshes, with_compressed_indices);
+	}
+
+	void Model::GenerateLods(const lod_settings& settings)
+	{
+		parallel_for(m_meshes.size(), [this, &settings](size_t i) {
+			m_meshes[i].GenerateLods(settings);
+		});
+	}
+
+	void Model::UpdateBounds()
+	{
+		m_bounds = aabb{};
+		m_bounding_sphere = cgb::bounding_sphere{};
+		for (const auto& mesh : m_meshes)
+		{
+			m_bounds.extend(mesh.m_bounds);
+			m_bounding_sphere = m_bounding_sphere.merged(mesh.m_bounding_sphere);
+		}
+	}
+
+	void Model::SplitVertexStreams()
+	{
+		for (auto& mesh : m_meshes)
+		{
+			mesh.SplitVertexStreams();
+		}
+	}
+
+	void Model::BuildMeshlets(uint32_t max_vertices, uint32_t max_triangles)
+	{
+		parallel_for(m_meshes.size(), [this, max_vertices, max_triangles](size_t i) {
+			m_meshes[i].BuildMeshlets(max_vertices, max_triangles);
+		});
+	}
+
 	bool Model::LoadFromFile(const std::string& path, const unsigned int modelLoaderFlags)
 	{
 		// Create an importer and load from file (only this overload can load additional textures from the file system)
 		Assimp::Importer importer;
+		// The model file and all dependent files are read from memory-mapped pages; the importer takes ownership of the IO system
+		auto* ioSystem = new mapped_io_system();
+		importer.SetIOHandler(ioSystem);
 		const auto assimp_importer_flags = CompileAssimpImportFlags(modelLoaderFlags);
 		const aiScene* scene = importer.ReadFile(path.c_str(), assimp_importer_flags);
-		return PostLoadProcessing(importer, scene, &path);
+		if (!PostLoadProcessing(importer, scene, &path))
+		{
+			return false;
+		}
+		m_import_stats.m_mapped_files = ioSystem->mapped_file_count();
+		m_import_stats.m_mapped_bytes = ioSystem->mapped_bytes();
+		if (modelLoaderFlags & MOLF_splitVertexStreams)
+		{
+			SplitVertexStreams();
+		}
+		if (modelLoaderFlags & MOLF_generateLods)
+		{
+			GenerateLods();
+		}
+		return true;
 	}
 
-	bool Model::LoadFromMemory(const std::string& data, const unsigned int modelLoaderFlags)
+	bool Model::LoadFromMemory(std::span<const std::byte> data, const unsigned int modelLoaderFlags)
 	{
 		// Release the previously loaded mesh (if it exists)
-		// Create an importer and load from file (can't load additional textures in this case)
+		// Create an importer and load from memory. Assimp reads the given data in place and opens
+		// dependent files (if any) through the IO system, i.e. they are memory-mapped as well.
 		Assimp::Importer importer;
+		auto* ioSystem = new mapped_io_system();
+		importer.SetIOHandler(ioSystem);
 		const auto assimp_importer_flags = CompileAssimpImportFlags(modelLoaderFlags);
-		const aiScene* scene = importer.ReadFileFromMemory(data.c_str(), data.size(), assimp_importer_flags);
-		return PostLoadProcessing(importer, scene, nullptr);
+		const aiScene* scene = importer.ReadFileFromMemory(data.data(), data.size(), assimp_importer_flags);
+		if (!PostLoadProcessing(importer, scene, nullptr))
+		{
+			return false;
+		}
+		m_import_stats.m_mapped_files = ioSystem->mapped_file_count();
+		m_import_stats.m_mapped_bytes = ioSystem->mapped_bytes();
+		if (modelLoaderFlags & MOLF_splitVertexStreams)
+		{
+			SplitVertexStreams();
+		}
+		if (modelLoaderFlags & MOLF_generateLods)
+		{
+			GenerateLods();
+		}
+		return true;
 	}
 
 	bool Model::PostLoadProcessing(Assimp::Importer& importer, const aiScene* scene, const std::string* file_path_or_null)
@@ -129,26 +242,61 @@ namespace cgb
 
 	bool Model::InitScene(const aiScene* scene)
 	{
+		m_meshes.clear();
 		m_meshes.resize(scene->mNumMeshes);
+		m_import_stats = ModelImportStats{};
+
+		// All transient per-mesh data lives in one arena per import. Size it for the whole
+		// scene upfront, so that it needs a single heap allocation at most.
+		size_t transientSize = 0;
+		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+		{
+			const aiMesh* paiMesh = scene->mMeshes[i];
+			if (!paiMesh->HasBones())
+			{
+				continue;
+			}
+			size_t numWeights = 0;
+			for (unsigned int j = 0; j < paiMesh->mNumBones; j++)
+			{
+				numWeights += paiMesh->mBones[j]->mNumWeights;
+			}
+			transientSize += (paiMesh->mNumVertices + 1) * sizeof(uint32_t) + numWeights * sizeof(aiVertexWeight) + 2 * alignof(std::max_align_t);
+		}
+		counting_memory_resource heapCounter;
+		std::pmr::monotonic_buffer_resource arena(std::max<size_t>(transientSize, 1), &heapCounter);
 
 		for (unsigned int i = 0; i < scene->mNumMeshes; i++)
 		{
 			// initialize mesh
 			const aiMesh* paiMesh = scene->mMeshes[i];
-			if (!InitMesh(i, paiMesh))
+			if (!InitMesh(i, paiMesh, &arena))
 			{
 				LOG_ERROR(fmt::format("Initializing mesh[{}] failed in Model::InitScene", i));
 				return false;
 			}
 		}
 
+		m_nodes.clear();
 		InitTransformationMatrices(scene->mRootNode, aiMatrix4x4());
+		InitSkeleton(scene);
+		for (auto& mesh : m_meshes)
+		{
+			mesh.UpdateTransformedBounds();
+		}
+		UpdateBounds();
+
+		m_import_stats.m_transient_bytes = heapCounter.bytes_allocated();
+		m_import_stats.m_transient_allocations = heapCounter.allocation_count();
+		LOG_DEBUG(fmt::format("Imported {} meshes: {} bytes of vertex and index data in {} allocations, {} bytes of transient data in {} allocations",
+			m_meshes.size(), m_import_stats.m_output_bytes, m_import_stats.m_output_allocations,
+			m_import_stats.m_transient_bytes, m_import_stats.m_transient_allocations));
 
 		return true;
 	}
 
 
-	bool Model::InitMesh(const int index, const aiMesh* paiMesh)
+	bool Model::InitMesh(const int index, const aiMesh* paiMesh, std::pmr::memory_resource* transient_memory)
 	{
 		if (!(paiMesh->HasPositions() && paiMesh->HasNormals()))
 		{
@@ -227,7 +375,7 @@ namespace cgb
 
 		// alloc the temporary storage and FILL THE MEMORY
 		size_t bufferSize = paiMesh->mNumVertices * sizeOneVtx;
-		m_meshes[index].m_vertex_data.resize(bufferSize);
+		resize_output(m_meshes[index].m_vertex_data, bufferSize, m_import_stats);
 		auto* vertexData = &m_meshes[index].m_vertex_data[0];
 		for (unsigned int i = 0; i < paiMesh->mNumVertices; i++)
 		{
@@ -250,44 +398,98 @@ namespace cgb
 
 		if (paiMesh->HasBones())
 		{
-			//read bone indices and weights for bone animation
-			std::vector<aiVertexWeight>* vTempWeightsPerVertex = new std::vector<aiVertexWeight>[paiMesh->mNumVertices];
+			// The bones' node indices are resolved in InitSkeleton, once the scene graph is known
+			m_meshes[index].m_bones.resize(paiMesh->mNumBones);
 			for (unsigned int j = 0; j < paiMesh->mNumBones; j++)
 			{
-				const aiBone * pBone = paiMesh->mBones[j];
+				const aiBone* pBone = paiMesh->mBones[j];
+				m_meshes[index].m_bones[j] = MeshBone{ pBone->mName.data, -1, glm::transpose(glm::make_mat4(&pBone->mOffsetMatrix.a1)) };
+			}
+
+			// Gather the bone weights per vertex in CSR layout: count them first, ...
+			std::pmr::vector<uint32_t> weightOffsets(paiMesh->mNumVertices + 1, 0u, transient_memory);
+			for (unsigned int j = 0; j < paiMesh->mNumBones; j++)
+			{
+				const aiBone* pBone = paiMesh->mBones[j];
 				for (unsigned int b = 0; b < pBone->mNumWeights; b++)
 				{
-					vTempWeightsPerVertex[pBone->mWeights[b].mVertexId].push_back(aiVertexWeight(j, pBone->mWeights[b].mWeight));
+					++weightOffsets[pBone->mWeights[b].mVertexId];
 				}
 			}
-
-			// set the bones for each vertex, if there are any
 			for (unsigned int j = 0; j < paiMesh->mNumVertices; j++)
 			{
-				glm::uvec4 boneIndices(0, 0, 0, 0);
-				glm::vec4 boneWeights(0.0f, 0.0f, 0.0f, 0.0f);
-
-				if (vTempWeightsPerVertex[j].size() > 4)
+				if (weightOffsets[j] > 4)
 				{
 					LOG_ERROR("The model has invalid bone weights and is not loaded.");
 					return false;
 				}
+			}
+			for (unsigned int j = 0; j < paiMesh->mNumVertices; j++)
+			{
+				weightOffsets[j + 1] += weightOffsets[j];
+			}
+
+			// ... then fill them from the back, so that weightOffsets[j] ends up at the first weight of vertex j
+			// and the weights of each vertex are sorted by bone index. mVertexId holds the bone index here.
+			std::pmr::vector<aiVertexWeight> weights(weightOffsets[paiMesh->mNumVertices], transient_memory);
+			for (unsigned int j = paiMesh->mNumBones; j-- > 0;)
+			{
+				const aiBone* pBone = paiMesh->mBones[j];
+				for (unsigned int b = pBone->mNumWeights; b-- > 0;)
+				{
+					weights[--weightOffsets[pBone->mWeights[b].mVertexId]] = aiVertexWeight(j, pBone->mWeights[b].mWeight);
+				}
+			}
 
-				// vTempWeightsPerVertex[j].size() is <= 3
-				for (unsigned int k = 0; k < vTempWeightsPerVertex[j].size(); k++)
+			// set the bones for each vertex, if there are any
+			for (unsigned int j = 0; j < paiMesh->mNumVertices; j++)
+			{
+				glm::uvec4 boneIndices(0, 0, 0, 0);
+				glm::vec4 boneWeights(0.0f, 0.0f, 0.0f, 0.0f);
+
+				for (uint32_t k = weightOffsets[j]; k < weightOffsets[j + 1]; k++)
 				{
-					// write into glm::uvec4 and glm::vec4 via []-operator
 					// NOTE: the indices are cast to GLuint here, the weights to GLfloat!
-					boneIndices[k] = vTempWeightsPerVertex[j][k].mVertexId;
-					boneWeights[k] = vTempWeightsPerVertex[j][k].mWeight;
+					boneIndices[k - weightOffsets[j]] = weights[k].mVertexId;
+					boneWeights[k - weightOffsets[j]] = weights[k].mWeight;
 				}
 
 				memcpy(&vertexData[j * sizeOneVtx + boneIndicesOffset], &boneIndices[0], boneIndicesSize);
 				memcpy(&vertexData[j * sizeOneVtx + boneWeightsOffset], &boneWeights[0], boneWeightsSize);
 			}
+		}
 
-			delete[] vTempWeightsPerVertex;
-			vTempWeightsPerVertex = 0;
+		m_meshes[index].m_morph_targets.clear();
+		for (unsigned int j = 0; j < paiMesh->mNumAnimMeshes; j++)
+		{
+			const aiAnimMesh* pAnimMesh = paiMesh->mAnimMeshes[j];
+			if (pAnimMesh->mNumVertices != paiMesh->mNumVertices)
+			{
+				LOG_WARNING(fmt::format("Morph target '{}' of mesh '{}' has a different vertex count and is ignored", pAnimMesh->mName.data, paiMesh->mName.data));
+				continue;
+			}
+			// Assimp stores the morphed attributes, keep only the differences to the mesh's attributes
+			auto& target = m_meshes[index].m_morph_targets.emplace_back();
+			target.m_name = pAnimMesh->mName.data;
+			target.m_default_weight = pAnimMesh->mWeight;
+			if (pAnimMesh->HasPositions())
+			{
+				target.m_position_deltas.resize(pAnimMesh->mNumVertices);
+				for (unsigned int v = 0; v < pAnimMesh->mNumVertices; v++)
+				{
+					const aiVector3D delta = pAnimMesh->mVertices[v] - paiMesh->mVertices[v];
+					target.m_position_deltas[v] = glm::vec3(delta.x, delta.y, delta.z);
+				}
+			}
+			if (pAnimMesh->HasNormals())
+			{
+				target.m_normal_deltas.resize(pAnimMesh->mNumVertices);
+				for (unsigned int v = 0; v < pAnimMesh->mNumVertices; v++)
+				{
+					const aiVector3D delta = pAnimMesh->mNormals[v] - paiMesh->mNormals[v];
+					target.m_normal_deltas[v] = glm::vec3(delta.x, delta.y, delta.z);
+				}
+			}
 		}
 
 		m_meshes[index].m_size_one_vertex = sizeOneVtx;
@@ -313,18 +515,25 @@ namespace cgb
 		
 		// store the indices in a vector
 		size_t indicesCount = paiMesh->mNumFaces * kNumFaceVertices;
-		m_meshes[index].m_indices.reserve(indicesCount);
+		resize_output(m_meshes[index].m_indices, indicesCount, m_import_stats);
+		auto* indexData = m_meshes[index].m_indices.data();
 		for (unsigned int i = 0; i < paiMesh->mNumFaces; i++)
 		{
 			// we're working with triangulated meshes only
 			const aiFace& Face = paiMesh->mFaces[i];
-			m_meshes[index].m_indices.push_back(Face.mIndices[0]);
-			m_meshes[index].m_indices.push_back(Face.mIndices[1]);
-			m_meshes[index].m_indices.push_back(Face.mIndices[2]);
+			indexData[i * kNumFaceVertices + 0] = Face.mIndices[0];
+			indexData[i * kNumFaceVertices + 1] = Face.mIndices[1];
+			indexData[i * kNumFaceVertices + 2] = Face.mIndices[2];
 		}
+		m_meshes[index].m_index_size = smallest_index_size(m_meshes[index].m_indices);
 
 		m_meshes[index].m_patch_size = 3;
 
+		// aiVector3D has the same layout as glm::vec3, the transformed bounds follow once the instances are known
+		const auto* positions = reinterpret_cast<const glm::vec3*>(paiMesh->mVertices);
+		m_meshes[index].m_local_bounds = compute_aabb(positions, paiMesh->mNumVertices);
+		m_meshes[index].m_local_bounding_sphere = compute_bounding_sphere(positions, paiMesh->mNumVertices, m_meshes[index].m_local_bounds);
+
 		return true;
 	}
 
@@ -345,6 +554,134 @@ namespace cgb
 		return m_indices.at(index);
 	}
 
+	std::vector<uint8_t> Mesh::index_data() const
+	{
+		return pack_indices(m_indices, m_index_size);
+	}
+
+	size_t Mesh::select_lod(float max_error) const
+	{
+		size_t level = 0;
+		while (level + 1 < lod_count() && lod_error(level + 1) <= max_error)
+		{
+			++level;
+		}
+		return level;
+	}
+
+	std::vector<uint8_t> Mesh::lod_index_data(size_t level) const
+	{
+		return pack_indices(lod_indices(level), m_index_size);
+	}
+
+	std::vector<glm::vec3> Mesh::vertex_positions() const
+	{
+		if (has_split_vertex_streams())
+		{
+			return m_position_data;
+		}
+		const size_t numVertices = num_vertices();
+		std::vector<glm::vec3> positions;
+		positions.reserve(numVertices);
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			positions.push_back(vertex_position_at(i));
+		}
+		return positions;
+	}
+
+	void Mesh::ComputeBounds()
+	{
+		const auto positions = vertex_positions();
+		m_local_bounds = compute_aabb(positions.data(), positions.size());
+		m_local_bounding_sphere = compute_bounding_sphere(positions.data(), positions.size(), m_local_bounds);
+		UpdateTransformedBounds();
+	}
+
+	void Mesh::UpdateTransformedBounds()
+	{
+		if (m_instances.empty())
+		{
+			m_bounds = m_local_bounds.transformed(m_scene_transformation_matrix);
+			m_bounding_sphere = m_local_bounding_sphere.transformed(m_scene_transformation_matrix);
+			return;
+		}
+		m_bounds = aabb{};
+		m_bounding_sphere = cgb::bounding_sphere{};
+		for (const auto& instance : m_instances)
+		{
+			m_bounds.extend(m_local_bounds.transformed(instance.m_transformation));
+			m_bounding_sphere = m_bounding_sphere.merged(m_local_bounding_sphere.transformed(instance.m_transformation));
+		}
+	}
+
+	uint64_t Mesh::content_hash() const
+	{
+		const std::array<uint64_t, 4> layout = {
+			static_cast<uint64_t>(m_vertex_data_layout), m_size_one_vertex, m_index_size, num_vertices() };
+		uint64_t hash = hash_bytes(layout.data(), layout.size() * sizeof(uint64_t));
+		hash = hash_bytes(m_vertex_data.data(), m_vertex_data.size(), hash);
+		return hash_bytes(m_indices.data(), m_indices.size() * sizeof(uint32_t), hash);
+	}
+
+	void Mesh::SplitVertexStreams()
+	{
+		const size_t numVertices = num_vertices();
+		if (0 == numVertices || sizeof(glm::vec3) != m_position_size)
+		{
+			return;
+		}
+		m_size_one_attribute_vertex = m_size_one_vertex - m_position_size;
+		m_position_data.resize(numVertices);
+		m_attribute_data.resize(numVertices * m_size_one_attribute_vertex);
+
+		// everything in front of and behind the position is copied as one block each
+		const size_t sizeBefore = m_position_offset;
+		const size_t sizeAfter = m_size_one_vertex - m_position_offset - m_position_size;
+		for (size_t i = 0; i < numVertices; i++)
+		{
+			const uint8_t* src = &m_vertex_data[i * m_size_one_vertex];
+			uint8_t* dst = m_attribute_data.data() + i * m_size_one_attribute_vertex;
+			memcpy(&m_position_data[i], src + m_position_offset, sizeof(glm::vec3));
+			if (sizeBefore > 0)
+			{
+				memcpy(dst, src, sizeBefore);
+			}
+			if (sizeAfter > 0)
+			{
+				memcpy(dst + sizeBefore, src + m_position_offset + m_position_size, sizeAfter);
+			}
+		}
+	}
+
+	void Mesh::GenerateLods(const lod_settings& settings)
+	{
+		m_lods.clear();
+		m_lods.reserve(settings.mMaxLevelCount);
+		const auto positions = vertex_positions();
+		const std::vector<uint32_t>* previous = &m_indices;
+		float previousError = 0.0f;
+		for (uint32_t level = 0; level < settings.mMaxLevelCount; level++)
+		{
+			const size_t target = static_cast<size_t>(previous->size() / 3 * settings.mReductionPerLevel) * 3;
+			float error = 0.0f;
+			auto simplified = simplify_triangles(positions, *previous, target, settings.mMaxError - previousError, error);
+			if (simplified.empty() || simplified.size() > previous->size() * settings.mMinReductionPerLevel)
+			{
+				break;
+			}
+			// the error is measured relative to the previous level, the sum is a conservative bound for the whole chain
+			previousError += error;
+			m_lods.push_back(MeshLod{ std::move(simplified), previousError });
+			previous = &m_lods.back().m_indices;
+		}
+	}
+
+	void Mesh::BuildMeshlets(uint32_t max_vertices, uint32_t max_triangles)
+	{
+		m_meshlets = build_meshlets(vertex_positions(), m_indices, max_vertices, max_triangles);
+	}
+
 	void Mesh::SetVertexData(
 		std::vector<uint8_t>&& vertex_data,
 		VertexAttribData vertex_data_layout,
@@ -428,32 +765,117 @@ namespace cgb
 	void Mesh::SetIndices(std::vector<GLuint>&& indices, int patch_size)
 	{
 		m_indices = std::move(indices);
+		m_index_size = smallest_index_size(m_indices);
 		m_patch_size = patch_size;
 	}
 
 	void Mesh::SetIndices(const std::vector<GLuint>& indices, int patch_size)
 	{
 		m_indices = indices;
+		m_index_size = smallest_index_size(m_indices);
 		m_patch_size = patch_size;
 	}
 
 
-	void Model::InitTransformationMatrices(const aiNode* pNode, const aiMatrix4x4& accTrans)
+	void Model::InitTransformationMatrices(const aiNode* pNode, const aiMatrix4x4& accTrans, int parentIndex)
 	{
+		const aiMatrix4x4 finalAccTranse = accTrans * pNode->mTransformation;
+		const int nodeIndex = static_cast<int>(m_nodes.size());
+		{
+			auto& node = m_nodes.emplace_back();
+			node.m_name = pNode->mName.data;
+			node.m_parent = parentIndex;
+			node.m_local_transformation = glm::transpose(glm::make_mat4(&pNode->mTransformation.a1));
+			node.m_global_transformation = glm::transpose(glm::make_mat4(&finalAccTranse.a1));
+			node.m_mesh_indices.assign(pNode->mMeshes, pNode->mMeshes + pNode->mNumMeshes);
+		}
+		if (parentIndex >= 0)
+		{
+			m_nodes[parentIndex].m_children.push_back(nodeIndex);
+		}
+
 		for (unsigned int i = 0; i < pNode->mNumMeshes; i++)
 		{
-			aiMatrix4x4 finalAccTranse = accTrans * pNode->mTransformation;
-			m_meshes[pNode->mMeshes[i]].m_scene_transformation_matrix = glm::transpose(glm::make_mat4(&finalAccTranse.a1));
+			auto& mesh = m_meshes[pNode->mMeshes[i]];
+			mesh.m_instances.push_back(MeshInstance{ m_nodes[nodeIndex].m_global_transformation, nodeIndex });
+			mesh.m_scene_transformation_matrix = m_nodes[nodeIndex].m_global_transformation;
 		}
 
 		for (unsigned int i = 0; i < pNode->mNumChildren; i++)
 		{
-			InitTransformationMatrices(pNode->mChildren[i], accTrans * pNode->mTransformation);
+			InitTransformationMatrices(pNode->mChildren[i], finalAccTranse, nodeIndex);
 		}
 	}
 
 
 
+	void Model::InitSkeleton(const aiScene* scene)
+	{
+		m_skeleton = cgb::skeleton{};
+		m_skeleton.mRestPose.resize(m_nodes.size());
+		std::unordered_map<std::string, int> nodeIndices;
+		for (size_t i = 0; i < m_nodes.size(); i++)
+		{
+			const auto& node = m_nodes[i];
+			m_skeleton.mNames.push_back(node.m_name);
+			m_skeleton.mParents.push_back(node.m_parent);
+			nodeIndices.emplace(node.m_name, static_cast<int>(i));
+
+			// decompose into translation, rotation and scale; shear is not supported by the rest pose
+			const glm::mat4& local = node.m_local_transformation;
+			glm::vec3 scale(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+			if (glm::determinant(glm::mat3(local)) < 0.0f)
+			{
+				scale.x = -scale.x;
+			}
+			// collapsed axes have no direction, they are completed from the others or the rotation is left out
+			glm::mat3 rotation(1.0f);
+			int collapsedAxis = -1;
+			int collapsedCount = 0;
+			for (int a = 0; a < 3; a++)
+			{
+				if (std::abs(scale[a]) < 1e-12f)
+				{
+					collapsedAxis = a;
+					collapsedCount++;
+				}
+				else
+				{
+					rotation[a] = glm::vec3(local[a]) / scale[a];
+				}
+			}
+			if (1 == collapsedCount)
+			{
+				rotation[collapsedAxis] = glm::normalize(glm::cross(rotation[(collapsedAxis + 1) % 3], rotation[(collapsedAxis + 2) % 3]));
+			}
+			else if (collapsedCount > 1)
+			{
+				rotation = glm::mat3(1.0f);
+			}
+			m_skeleton.mRestPose.set(i, glm::vec3(local[3]), glm::normalize(glm::quat_cast(rotation)), scale);
+		}
+
+		for (auto& mesh : m_meshes)
+		{
+			for (auto& bone : mesh.m_bones)
+			{
+				const auto it = nodeIndices.find(bone.m_name);
+				bone.m_node_index = it == nodeIndices.end() ? -1 : it->second;
+				if (bone.m_node_index < 0)
+				{
+					LOG_WARNING(fmt::format("Bone '{}' of mesh '{}' has no corresponding node", bone.m_name, mesh.m_name));
+				}
+			}
+		}
+
+		m_animation_clips.clear();
+		m_animation_clips.reserve(scene->mNumAnimations);
+		for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+		{
+			m_animation_clips.push_back(animation_clip::from_assimp(scene->mAnimations[i], m_skeleton));
+		}
+	}
+
 	void Model::PrintIndent(std::ostream& stream, int indent)
 	{
 		for (int i = 0; i < indent; i++)
@@ -682,6 +1104,28 @@ namespace cgb
 		return m_load_transformation_matrix * m_meshes[meshIndex].m_scene_transformation_matrix;
 	}
 
+	std::vector<glm::mat4> Model::instance_transformation_matrices(unsigned int meshIndex) const
+	{
+		const auto& instances = m_meshes.at(meshIndex).m_instances;
+		std::vector<glm::mat4> result;
+		result.reserve(instances.size());
+		for (const auto& instance : instances)
+		{
+			result.push_back(m_load_transformation_matrix * instance.m_transformation);
+		}
+		return result;
+	}
+
+	size_t Model::num_instances() const
+	{
+		size_t count = 0;
+		for (const auto& mesh : m_meshes)
+		{
+			count += mesh.m_instances.size();
+		}
+		return count;
+	}
+
 
 	size_t Model::num_meshes() const
 	{
@@ -690,8 +1134,7 @@ namespace cgb
 
 	size_t Model::num_vertices(unsigned int meshIndex) const
 	{
-		const auto& mesh = m_meshes.at(meshIndex);
-		return mesh.m_vertex_data.size() / mesh.m_size_one_vertex;
+		return m_meshes.at(meshIndex).num_vertices();
 	}
 
 	size_t Model::indices_length(unsigned int meshIndex) const
@@ -782,6 +1225,11 @@ namespace cgb
 		return m_meshes[meshIndex];
 	}
 
+	const Mesh& Model::mesh_at(unsigned int meshIndex) const
+	{
+		return m_meshes[meshIndex];
+	}
+
 
 
 }
@@ -0,0 +1,134 @@
+#include "model_registry.h"
+
+#include <cstring>
+
+namespace cgb
+{
+	namespace
+	{
+		size_t geometry_bytes_of(Model& pModel)
+		{
+			size_t bytes = 0;
+			for (unsigned int i = 0; i < pModel.num_meshes(); ++i) {
+				bytes += pModel.mesh_at(i).geometry_bytes();
+			}
+			return bytes;
+		}
+	}
+
+	model_registry& model_registry::instance()
+	{
+		static model_registry sInstance;
+		return sInstance;
+	}
+
+	std::shared_ptr<Model> model_registry::load(const std::string& pPath, unsigned int pModelLoaderFlags)
+	{
+		std::error_code ec;
+		auto canonicalPath = std::filesystem::weakly_canonical(pPath, ec);
+		const std::string key = fmt::format("{}|{:x}", ec ? pPath : canonicalPath.string(), pModelLoaderFlags);
+
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			++mStats.mModelRequests;
+			auto it = mModels.find(key);
+			if (it != mModels.end()) {
+				if (auto existing = it->second.lock()) {
+					++mStats.mModelHits;
+					mStats.mModelBytesSaved += geometry_bytes_of(*existing);
+					return existing;
+				}
+			}
+		}
+
+		// Load outside of the lock, so that different models can be loaded concurrently
+		std::shared_ptr<Model> loaded = Model::LoadFromFile(pPath, glm::mat4(1.0f), pModelLoaderFlags);
+		if (!loaded) {
+			return nullptr;
+		}
+
+		std::lock_guard<std::mutex> guard(mMutex);
+		auto& entry = mModels[key];
+		if (auto existing = entry.lock()) {
+			// Another thread has loaded the same model in the meantime
+			++mStats.mModelHits;
+			mStats.mModelBytesSaved += geometry_bytes_of(*existing);
+			return existing;
+		}
+		entry = loaded;
+		return loaded;
+	}
+
+	model_registry_stats model_registry::statistics() const
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		model_registry_stats stats = mStats;
+		stats.mLiveModels = std::count_if(mModels.begin(), mModels.end(), [](const auto& entry) { return !entry.second.expired(); });
+		stats.mLiveGeometries = std::count_if(mGeometries.begin(), mGeometries.end(), [](const auto& entry) { return !entry.second.mResource.expired(); });
+		return stats;
+	}
+
+	void model_registry::collect_garbage()
+	{
+		std::lock_guard<std::mutex> guard(mMutex);
+		for (auto it = mModels.begin(); it != mModels.end();) {
+			it = it->second.expired() ? mModels.erase(it) : std::next(it);
+		}
+		remove_expired_geometries();
+	}
+
+	bool model_registry::geometry_entry::has_geometry_of(const Mesh& pMesh) const
+	{
+		// Equal hashes do not guarantee equal geometry, compare the actual bytes
+		const auto& vertexData = pMesh.vertex_data();
+		const auto& indices = pMesh.indices();
+		return mVertexDataLayout == pMesh.vertex_data_layout()
+			&& mIndexSize == pMesh.index_size()
+			&& mVertexData.size() == vertexData.size()
+			&& mIndices.size() == indices.size()
+			&& (vertexData.empty() || 0 == std::memcmp(mVertexData.data(), vertexData.data(), vertexData.size()))
+			&& (indices.empty() || 0 == std::memcmp(mIndices.data(), indices.data(), indices.size() * sizeof(uint32_t)));
+	}
+
+	std::shared_ptr<void> model_registry::find_geometry(const geometry_key& pKey, const Mesh& pMesh)
+	{
+		auto range = mGeometries.equal_range(pKey);
+		for (auto it = range.first; it != range.second; ++it) {
+			if (it->second.has_geometry_of(pMesh)) {
+				if (auto existing = it->second.mResource.lock()) {
+					return existing;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	void model_registry::add_geometry(const geometry_key& pKey, const Mesh& pMesh, std::shared_ptr<void> pResource)
+	{
+		// Reuse the entry of a freed resource with the same geometry instead of copying it again,
+		// drop the entries of other freed resources with this key together with their geometry copies
+		auto range = mGeometries.equal_range(pKey);
+		for (auto it = range.first; it != range.second;) {
+			if (it->second.has_geometry_of(pMesh)) {
+				it->second.mResource = pResource;
+				return;
+			}
+			it = it->second.mResource.expired() ? mGeometries.erase(it) : std::next(it);
+		}
+		mGeometries.emplace(pKey, geometry_entry{ pMesh.vertex_data_layout(), pMesh.index_size(), pMesh.vertex_data(), pMesh.indices(), pResource });
+
+		// Entries of freed resources which are never requested again would keep their geometry copies forever;
+		// sweeping whenever the entries have doubled keeps them from outnumbering the live ones at amortized constant cost
+		if (mGeometries.size() >= 2 * mGeometriesAfterSweep) {
+			remove_expired_geometries();
+		}
+	}
+
+	void model_registry::remove_expired_geometries()
+	{
+		for (auto it = mGeometries.begin(); it != mGeometries.end();) {
+			it = it->second.mResource.expired() ? mGeometries.erase(it) : std::next(it);
+		}
+		mGeometriesAfterSweep = std::max(mGeometries.size(), size_t{ 16 });
+	}
+}
@@ -0,0 +1,70 @@
+#include "ring_allocator.h"
+
+namespace cgb
+{
+	ring_allocator::ring_allocator(uint64_t pSize)
+		: mSize{ pSize }
+	{
+		assert(mSize > 0);
+	}
+
+	std::optional<uint64_t> ring_allocator::allocate(uint64_t pSize, uint64_t pAlignment)
+	{
+		assert(pSize > 0);
+		assert(pAlignment > 0 && 0 == (pAlignment & (pAlignment - 1)));
+		if (pSize > mSize) {
+			return {};
+		}
+		if (0 == mUsedBytes) {
+			// Nothing is alive, start over at the beginning to have the whole ring available
+			mHead = mTail = 0;
+		}
+
+		uint64_t offset = (mHead + pAlignment - 1) & ~(pAlignment - 1);
+		uint64_t consumed;
+		if (mHead > mTail || 0 == mUsedBytes) {
+			// The live ranges are [mTail, mHead), the free space is behind the head and in front of the tail
+			if (offset + pSize <= mSize) {
+				consumed = offset + pSize - mHead;
+			}
+			else if (pSize <= mTail) {
+				// Skip the rest of the ring; the skipped bytes are released together with this batch
+				offset = 0;
+				consumed = mSize - mHead + pSize;
+			}
+			else {
+				return {};
+			}
+		}
+		else {
+			// The live ranges have wrapped around, the free space is [mHead, mTail)
+			if (offset + pSize > mTail) {
+				return {};
+			}
+			consumed = offset + pSize - mHead;
+		}
+
+		mHead = offset + pSize;
+		mUsedBytes += consumed;
+		mOpenBytes += consumed;
+		return offset;
+	}
+
+	void ring_allocator::close_batch()
+	{
+		if (0 == mOpenBytes) {
+			return;
+		}
+		mClosedBatches.push_back({ mHead, mOpenBytes });
+		mOpenBytes = 0;
+	}
+
+	void ring_allocator::retire_oldest_batch()
+	{
+		assert(!mClosedBatches.empty());
+		const auto& oldest = mClosedBatches.front();
+		mTail = oldest.mEnd;
+		mUsedBytes -= oldest.mBytes;
+		mClosedBatches.pop_front();
+	}
+}
@@ -0,0 +1,210 @@
+#include "skinning.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define CGB_SKINNING_SSE
+#endif
+
+namespace cgb
+{
+	namespace
+	{
+		/** A rigid transformation, i.e. rotation and translation, as unit dual quaternion */
+		struct dual_quat
+		{
+			glm::quat mReal;
+			glm::quat mDual;
+		};
+
+		dual_quat to_dual_quat(const glm::mat4& pMatrix)
+		{
+			const glm::mat3 rotation(glm::normalize(glm::vec3(pMatrix[0])), glm::normalize(glm::vec3(pMatrix[1])), glm::normalize(glm::vec3(pMatrix[2])));
+			const glm::quat real = glm::normalize(glm::quat_cast(rotation));
+			const glm::vec3 t(pMatrix[3]);
+			return { real, glm::quat(0.0f, t.x, t.y, t.z) * real * 0.5f };
+		}
+
+		/** Skins the vertices [pBegin, pEnd) which have already been gathered into outPositions and outNormals */
+		void skin_block_linear_blend(const Mesh& pMesh, std::span<const glm::mat4> pPalette, size_t pBegin, size_t pEnd, glm::vec3* outPositions, glm::vec3* outNormals)
+		{
+			for (size_t v = pBegin; v < pEnd; ++v) {
+				const uint8_t* src = &pMesh.m_vertex_data[v * pMesh.m_size_one_vertex];
+				glm::uvec4 indices;
+				glm::vec4 weights;
+				memcpy(&indices, src + pMesh.m_bone_incides_offset, sizeof(indices));
+				memcpy(&weights, src + pMesh.m_bone_weights_offset, sizeof(weights));
+				if (0.0f == weights[0] + weights[1] + weights[2] + weights[3]) {
+					// not influenced by any bone, only the morph targets apply
+					if (nullptr != outNormals) {
+						outNormals[v] = glm::normalize(outNormals[v]);
+					}
+					continue;
+				}
+				for (int i = 0; i < 4; ++i) {
+					if (indices[i] >= pPalette.size()) {
+						throw std::runtime_error(fmt::format("Bone index {} of vertex {} is outside of the palette with {} matrices", indices[i], v, pPalette.size()));
+					}
+				}
+
+#ifdef CGB_SKINNING_SSE
+				// Blend the matrices column by column, then transform with the blended matrix
+				__m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+				for (int i = 0; i < 4; ++i) {
+					const __m128 w = _mm_set1_ps(weights[i]);
+					const glm::mat4& m = pPalette[indices[i]];
+					c0 = _mm_add_ps(c0, _mm_mul_ps(w, _mm_loadu_ps(&m[0][0])));
+					c1 = _mm_add_ps(c1, _mm_mul_ps(w, _mm_loadu_ps(&m[1][0])));
+					c2 = _mm_add_ps(c2, _mm_mul_ps(w, _mm_loadu_ps(&m[2][0])));
+					c3 = _mm_add_ps(c3, _mm_mul_ps(w, _mm_loadu_ps(&m[3][0])));
+				}
+				alignas(16) float result[4];
+				const glm::vec3 p = outPositions[v];
+				_mm_store_ps(result, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p.x)), _mm_mul_ps(c1, _mm_set1_ps(p.y))), _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p.z)), c3)));
+				outPositions[v] = glm::vec3(result[0], result[1], result[2]);
+				if (nullptr != outNormals) {
+					const glm::vec3 n = outNormals[v];
+					_mm_store_ps(result, _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n.x)), _mm_mul_ps(c1, _mm_set1_ps(n.y))), _mm_mul_ps(c2, _mm_set1_ps(n.z))));
+					outNormals[v] = glm::normalize(glm::vec3(result[0], result[1], result[2]));
+				}
+#else
+				const glm::mat4 m = weights[0] * pPalette[indices[0]] + weights[1] * pPalette[indices[1]]
+					+ weights[2] * pPalette[indices[2]] + weights[3] * pPalette[indices[3]];
+				outPositions[v] = glm::vec3(m * glm::vec4(outPositions[v], 1.0f));
+				if (nullptr != outNormals) {
+					outNormals[v] = glm::normalize(glm::mat3(m) * outNormals[v]);
+				}
+#endif
+			}
+		}
+
+		void skin_block_dual_quaternion(const Mesh& pMesh, const std::vector<dual_quat>& pPalette, size_t pBegin, size_t pEnd, glm::vec3* outPositions, glm::vec3* outNormals)
+		{
+			for (size_t v = pBegin; v < pEnd; ++v) {
+				const uint8_t* src = &pMesh.m_vertex_data[v * pMesh.m_size_one_vertex];
+				glm::uvec4 indices;
+				glm::vec4 weights;
+				memcpy(&indices, src + pMesh.m_bone_incides_offset, sizeof(indices));
+				memcpy(&weights, src + pMesh.m_bone_weights_offset, sizeof(weights));
+				if (0.0f == weights[0] + weights[1] + weights[2] + weights[3]) {
+					if (nullptr != outNormals) {
+						outNormals[v] = glm::normalize(outNormals[v]);
+					}
+					continue;
+				}
+
+				glm::quat real(0.0f, 0.0f, 0.0f, 0.0f), dual(0.0f, 0.0f, 0.0f, 0.0f);
+				const glm::quat* pivot = nullptr;
+				for (int i = 0; i < 4; ++i) {
+					if (indices[i] >= pPalette.size()) {
+						throw std::runtime_error(fmt::format("Bone index {} of vertex {} is outside of the palette with {} matrices", indices[i], v, pPalette.size()));
+					}
+					if (0.0f == weights[i]) {
+						continue;
+					}
+					const dual_quat& dq = pPalette[indices[i]];
+					if (nullptr == pivot) {
+						pivot = &dq.mReal;
+					}
+					// q and -q are the same rotation, blend within the pivot's hemisphere
+					const float w = glm::dot(*pivot, dq.mReal) < 0.0f ? -weights[i] : weights[i];
+					real = real + dq.mReal * w;
+					dual = dual + dq.mDual * w;
+				}
+				const float invLength = 1.0f / glm::length(real);
+				real = real * invLength;
+				dual = dual * invLength;
+
+				const glm::vec3 r(real.x, real.y, real.z), d(dual.x, dual.y, dual.z);
+				const glm::vec3 translation = 2.0f * (real.w * d - dual.w * r + glm::cross(r, d));
+				outPositions[v] = real * outPositions[v] + translation;
+				if (nullptr != outNormals) {
+					outNormals[v] = glm::normalize(real * outNormals[v]);
+				}
+			}
+		}
+	}
+
+	void skin_mesh(const Mesh& pMesh, std::span<const glm::mat4> pPalette, std::span<const float> pMorphWeights,
+		std::span<glm::vec3> outPositions, std::span<glm::vec3> outNormals, const skinning_settings& pSettings)
+	{
+		const size_t numVertices = pMesh.num_vertices();
+		if (outPositions.size() < numVertices) {
+			throw std::runtime_error(fmt::format("The position buffer holds {} elements, but the mesh has {} vertices", outPositions.size(), numVertices));
+		}
+		if (!outNormals.empty() && outNormals.size() < numVertices) {
+			throw std::runtime_error(fmt::format("The normal buffer holds {} elements, but the mesh has {} vertices", outNormals.size(), numVertices));
+		}
+		if (sizeof(glm::vec3) != pMesh.m_position_size || (!outNormals.empty() && sizeof(glm::vec3) != pMesh.m_normal_size)) {
+			throw std::runtime_error("Only meshes with three-component positions and normals can be skinned");
+		}
+		if (pMorphWeights.size() > pMesh.m_morph_targets.size()) {
+			throw std::runtime_error(fmt::format("{} morph weights have been passed, but the mesh has {} morph targets", pMorphWeights.size(), pMesh.m_morph_targets.size()));
+		}
+
+		const bool withBones = !pMesh.m_bones.empty() && sizeof(glm::vec4) == pMesh.m_bone_weights_size;
+		if (withBones && pPalette.size() < pMesh.m_bones.size()) {
+			throw std::runtime_error(fmt::format("The palette holds {} matrices, but the mesh has {} bones", pPalette.size(), pMesh.m_bones.size()));
+		}
+		std::vector<dual_quat> dualQuatPalette;
+		if (withBones && skinning_method::dual_quaternion == pSettings.mMethod) {
+			dualQuatPalette.reserve(pPalette.size());
+			for (const auto& m : pPalette) {
+				dualQuatPalette.push_back(to_dual_quat(m));
+			}
+		}
+
+		glm::vec3* positions = outPositions.data();
+		glm::vec3* normals = outNormals.empty() ? nullptr : outNormals.data();
+		const size_t blockSize = std::max<size_t>(pSettings.mBlockSize, 1);
+		const size_t blockCount = (numVertices + blockSize - 1) / blockSize;
+
+		// Each block is gathered into the output buffers, then morphed and skinned in place while it is still in the cache;
+		// skinning runs every frame, so the threads are kept alive in the shared pool
+		worker_pool::shared().run(blockCount, [&](size_t block, size_t) {
+			const size_t begin = block * blockSize;
+			const size_t end = std::min(begin + blockSize, numVertices);
+
+			for (size_t v = begin; v < end; ++v) {
+				const uint8_t* src = &pMesh.m_vertex_data[v * pMesh.m_size_one_vertex];
+				memcpy(&positions[v], src + pMesh.m_position_offset, sizeof(glm::vec3));
+				if (nullptr != normals) {
+					memcpy(&normals[v], src + pMesh.m_normal_offset, sizeof(glm::vec3));
+				}
+			}
+
+			bool morphedNormals = false;
+			for (size_t t = 0; t < pMorphWeights.size(); ++t) {
+				const float w = pMorphWeights[t];
+				const auto& target = pMesh.m_morph_targets[t];
+				if (0.0f == w) {
+					continue;
+				}
+				if (!target.m_position_deltas.empty()) {
+					for (size_t v = begin; v < end; ++v) {
+						positions[v] += w * target.m_position_deltas[v];
+					}
+				}
+				if (nullptr != normals && !target.m_normal_deltas.empty()) {
+					for (size_t v = begin; v < end; ++v) {
+						normals[v] += w * target.m_normal_deltas[v];
+					}
+					morphedNormals = true;
+				}
+			}
+
+			if (withBones) {
+				if (skinning_method::dual_quaternion == pSettings.mMethod) {
+					skin_block_dual_quaternion(pMesh, dualQuatPalette, begin, end, positions, normals);
+				}
+				else {
+					skin_block_linear_blend(pMesh, pPalette, begin, end, positions, normals);
+				}
+			}
+			else if (morphedNormals) {
+				for (size_t v = begin; v < end; ++v) {
+					normals[v] = glm::normalize(normals[v]);
+				}
+			}
+		}, pSettings.mMaxThreads);
+	}
+}
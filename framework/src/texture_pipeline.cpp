@@ -0,0 +1,261 @@
+#include "texture_pipeline.h"
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+namespace cgb
+{
+	namespace
+	{
+		constexpr std::array<char, 4> kTextureCacheMagic = { 'C', 'G', 'B', 'T' };
+		constexpr uint32_t kTextureCacheVersion = 1;
+
+		template <typename T>
+		void write_value(std::ostream& pStream, const T& pValue)
+		{
+			pStream.write(reinterpret_cast<const char*>(&pValue), sizeof(T));
+		}
+
+		template <typename T>
+		T read_value(std::istream& pStream)
+		{
+			T value;
+			pStream.read(reinterpret_cast<char*>(&value), sizeof(T));
+			if (!pStream) {
+				throw std::runtime_error("Unexpected end of texture cache file");
+			}
+			return value;
+		}
+
+		/** Returns the path of the cache entry for the given source file and settings, or an empty path if there is no cache */
+		std::filesystem::path cache_path_for(const std::string& pPath, const texture_settings& pSettings)
+		{
+			if (pSettings.mCacheDirectory.empty()) {
+				return {};
+			}
+			std::error_code ec;
+			const auto canonicalPath = std::filesystem::weakly_canonical(pPath, ec);
+			const auto fileSize = std::filesystem::file_size(pPath, ec);
+			if (ec) {
+				return {};
+			}
+			const auto lastWrite = std::filesystem::last_write_time(pPath, ec);
+			if (ec) {
+				return {};
+			}
+			const std::string key = fmt::format("{}|{}|{}|{}|{}|{}|{}",
+				canonicalPath.string(), fileSize, lastWrite.time_since_epoch().count(),
+				pSettings.mGenerateMipmaps, static_cast<uint32_t>(pSettings.mCompression), pSettings.mSrgb, pSettings.mFlipVertically);
+			return std::filesystem::path(pSettings.mCacheDirectory) / fmt::format("{:016x}.cgbt", hash_bytes(key.data(), key.size()));
+		}
+
+		/** Returns the number of bytes of a level with the given size and compression */
+		uint64_t level_size_in_bytes(uint32_t pWidth, uint32_t pHeight, texture_compression pCompression)
+		{
+			if (texture_compression::none == pCompression) {
+				return static_cast<uint64_t>(pWidth) * pHeight * 4;
+			}
+			const uint64_t blockSize = texture_compression::bc3 == pCompression ? 16 : 8;
+			return ((static_cast<uint64_t>(pWidth) + 3) / 4) * ((static_cast<uint64_t>(pHeight) + 3) / 4) * blockSize;
+		}
+
+		std::optional<texture_data> read_from_cache(const std::filesystem::path& pCachePath, const std::string& pPath)
+		{
+			std::error_code ec;
+			const uint64_t fileSize = std::filesystem::file_size(pCachePath, ec);
+			std::ifstream is(pCachePath, std::ios::binary);
+			if (ec || !is) {
+				return std::nullopt;
+			}
+			try {
+				if (read_value<std::array<char, 4>>(is) != kTextureCacheMagic || read_value<uint32_t>(is) != kTextureCacheVersion) {
+					return std::nullopt;
+				}
+				texture_data result;
+				result.mPath = pPath;
+				const auto compression = read_value<uint32_t>(is);
+				if (compression > static_cast<uint32_t>(texture_compression::bc3)) {
+					return std::nullopt;
+				}
+				result.mCompression = static_cast<texture_compression>(compression);
+				result.mSrgb = 0 != read_value<uint8_t>(is);
+				// Sizes are validated before anything is allocated for them, a broken entry must not cause huge allocations
+				const auto levelCount = read_value<uint32_t>(is);
+				if (0 == levelCount || levelCount > 32) {
+					return std::nullopt;
+				}
+				result.mLevels.resize(levelCount);
+				for (auto& level : result.mLevels) {
+					level.mWidth = read_value<uint32_t>(is);
+					level.mHeight = read_value<uint32_t>(is);
+					const auto size = read_value<uint64_t>(is);
+					const uint64_t position = static_cast<uint64_t>(is.tellg());
+					if (size != level_size_in_bytes(level.mWidth, level.mHeight, result.mCompression) || size > fileSize - std::min(position, fileSize)) {
+						return std::nullopt;
+					}
+					level.mData.resize(static_cast<size_t>(size));
+					is.read(reinterpret_cast<char*>(level.mData.data()), level.mData.size());
+					if (!is) {
+						return std::nullopt;
+					}
+				}
+				result.mFromCache = true;
+				return result;
+			}
+			catch (std::runtime_error&) {
+				// A truncated or otherwise broken entry is just a cache miss
+				return std::nullopt;
+			}
+		}
+
+		void write_to_cache(const std::filesystem::path& pCachePath, const texture_data& pTexture)
+		{
+			std::error_code ec;
+			std::filesystem::create_directories(pCachePath.parent_path(), ec);
+			std::ofstream os(pCachePath, std::ios::binary);
+			if (!os) {
+				LOG_WARNING(fmt::format("Couldn't write texture cache file '{}'", pCachePath.string()));
+				return;
+			}
+			write_value(os, kTextureCacheMagic);
+			write_value(os, kTextureCacheVersion);
+			write_value(os, static_cast<uint32_t>(pTexture.mCompression));
+			write_value(os, static_cast<uint8_t>(pTexture.mSrgb ? 1 : 0));
+			write_value(os, pTexture.level_count());
+			for (const auto& level : pTexture.mLevels) {
+				write_value(os, level.mWidth);
+				write_value(os, level.mHeight);
+				write_value(os, static_cast<uint64_t>(level.mData.size()));
+				os.write(reinterpret_cast<const char*>(level.mData.data()), level.mData.size());
+			}
+		}
+	}
+
+	size_t texture_data::size_in_bytes() const
+	{
+		size_t size = 0;
+		for (const auto& level : mLevels) {
+			size += level.mData.size();
+		}
+		return size;
+	}
+
+	uint32_t mip_level_count(uint32_t pWidth, uint32_t pHeight)
+	{
+		uint32_t count = 1;
+		for (uint32_t size = std::max(pWidth, pHeight); size > 1; size /= 2) {
+			++count;
+		}
+		return count;
+	}
+
+	std::vector<texture_level> generate_mip_chain(const uint8_t* pRgba, uint32_t pWidth, uint32_t pHeight, bool pSrgb)
+	{
+		std::vector<texture_level> levels;
+		levels.reserve(mip_level_count(pWidth, pHeight) - 1);
+		const uint8_t* src = pRgba;
+		uint32_t srcWidth = pWidth, srcHeight = pHeight;
+		while (srcWidth > 1 || srcHeight > 1) {
+			auto& level = levels.emplace_back();
+			level.mWidth = std::max(1u, srcWidth / 2);
+			level.mHeight = std::max(1u, srcHeight / 2);
+			level.mData.resize(static_cast<size_t>(level.mWidth) * level.mHeight * 4);
+			const int ok = pSrgb
+				? stbir_resize_uint8_srgb(src, srcWidth, srcHeight, 0, level.mData.data(), level.mWidth, level.mHeight, 0, 4, 3, 0)
+				: stbir_resize_uint8(src, srcWidth, srcHeight, 0, level.mData.data(), level.mWidth, level.mHeight, 0, 4);
+			if (!ok) {
+				throw std::runtime_error(fmt::format("Couldn't generate the {}x{} mip level", level.mWidth, level.mHeight));
+			}
+			src = level.mData.data();
+			srcWidth = level.mWidth;
+			srcHeight = level.mHeight;
+		}
+		return levels;
+	}
+
+	std::vector<uint8_t> compress_texture_level(const uint8_t* pRgba, uint32_t pWidth, uint32_t pHeight, texture_compression pCompression)
+	{
+		assert(texture_compression::none != pCompression);
+		const bool withAlpha = texture_compression::bc3 == pCompression;
+		const size_t blockSize = withAlpha ? 16 : 8;
+		const uint32_t blocksX = (pWidth + 3) / 4;
+		const uint32_t blocksY = (pHeight + 3) / 4;
+
+		std::vector<uint8_t> result(blocksX * blocksY * blockSize);
+		std::array<uint8_t, 4 * 4 * 4> block;
+		for (uint32_t by = 0; by < blocksY; ++by) {
+			for (uint32_t bx = 0; bx < blocksX; ++bx) {
+				for (uint32_t y = 0; y < 4; ++y) {
+					const uint32_t srcY = std::min(by * 4 + y, pHeight - 1);
+					for (uint32_t x = 0; x < 4; ++x) {
+						const uint32_t srcX = std::min(bx * 4 + x, pWidth - 1);
+						memcpy(&block[(y * 4 + x) * 4], &pRgba[(static_cast<size_t>(srcY) * pWidth + srcX) * 4], 4);
+					}
+				}
+				stb_compress_dxt_block(&result[(by * blocksX + bx) * blockSize], block.data(), withAlpha ? 1 : 0, STB_DXT_HIGHQUAL);
+			}
+		}
+		return result;
+	}
+
+	texture_data load_texture(const std::string& pPath, const texture_settings& pSettings)
+	{
+		const auto cachePath = cache_path_for(pPath, pSettings);
+		if (!cachePath.empty()) {
+			if (auto cached = read_from_cache(cachePath, pPath)) {
+				return std::move(*cached);
+			}
+		}
+
+		int width, height, channels;
+		stbi_uc* pixels = stbi_load(pPath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+		if (nullptr == pixels) {
+			throw std::runtime_error(fmt::format("Couldn't decode image '{}': {}", pPath, stbi_failure_reason()));
+		}
+
+		texture_data result;
+		result.mPath = pPath;
+		result.mCompression = pSettings.mCompression;
+		result.mSrgb = pSettings.mSrgb;
+		auto& base = result.mLevels.emplace_back();
+		base.mWidth = static_cast<uint32_t>(width);
+		base.mHeight = static_cast<uint32_t>(height);
+		base.mData.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+		stbi_image_free(pixels);
+
+		// stbi_set_flip_vertically_on_load is global state, flip here instead so that workers don't interfere
+		if (pSettings.mFlipVertically) {
+			const size_t rowSize = static_cast<size_t>(width) * 4;
+			for (int y = 0; y < height / 2; ++y) {
+				std::swap_ranges(base.mData.begin() + y * rowSize, base.mData.begin() + (y + 1) * rowSize, base.mData.begin() + (height - 1 - y) * rowSize);
+			}
+		}
+
+		if (pSettings.mGenerateMipmaps) {
+			auto mips = generate_mip_chain(base.mData.data(), base.mWidth, base.mHeight, pSettings.mSrgb);
+			std::move(mips.begin(), mips.end(), std::back_inserter(result.mLevels));
+		}
+
+		if (texture_compression::none != pSettings.mCompression) {
+			for (auto& level : result.mLevels) {
+				level.mData = compress_texture_level(level.mData.data(), level.mWidth, level.mHeight, pSettings.mCompression);
+			}
+		}
+
+		if (!cachePath.empty()) {
+			write_to_cache(cachePath, result);
+		}
+		return result;
+	}
+
+	std::vector<texture_data> load_textures(const std::vector<std::string>& pPaths, const texture_settings& pSettings, size_t pMaxThreads)
+	{
+		std::vector<texture_data> results(pPaths.size());
+		worker_pool::shared().run(pPaths.size(), [&](size_t i, size_t) {
+			results[i] = load_texture(pPaths[i], pSettings);
+		}, pMaxThreads);
+		return results;
+	}
+}
@@ -16,6 +16,7 @@ namespace cgb
 			vec4(z, 0.0f) * mScale.z,
 			vec4(mTranslation, 1.0f)
 		);
+		mark_changed();
 	}
 	
 	void transform::update_transforms_from_matrix()
@@ -31,6 +32,15 @@ namespace cgb
 			mMatrix[1] / mScale.y,
 			mMatrix[2] / mScale.z
 		));
+		mark_changed();
+	}
+
+	void transform::mark_changed()
+	{
+		++mChangeCount;
+		for (auto& child : mChilds) {
+			child->mark_changed();
+		}
 	}
 
 	transform::transform(vec3 pTranslation, quat pRotation, vec3 pScale) noexcept
@@ -181,6 +191,7 @@ namespace cgb
 		}
 		pChild->mParent = pParent;
 		pParent->mChilds.push_back(pChild);
+		pChild->mark_changed();
 	}
 
 	void detach_transform(transform::ptr pParent, transform::ptr pChild)
@@ -197,6 +208,7 @@ namespace cgb
 			std::end(pParent->mChilds),
 			pChild
 		));
+		pChild->mark_changed();
 	}
 
 	glm::vec3 front_wrt(const transform& pTransform, glm::mat4 pReference)
@@ -0,0 +1,105 @@
+#include "worker_pool.h"
+
+namespace cgb
+{
+	worker_pool::worker_pool(size_t pThreadCount)
+	{
+		const size_t threadCount = 0 == pThreadCount ? std::max(1u, std::thread::hardware_concurrency()) : pThreadCount;
+		mThreads.reserve(threadCount - 1);
+		for (size_t worker = 1; worker < threadCount; ++worker) {
+			mThreads.emplace_back(&worker_pool::worker_main, this, worker);
+		}
+	}
+
+	worker_pool::~worker_pool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			mStopping = true;
+		}
+		mJobStarted.notify_all();
+		for (auto& t : mThreads) {
+			t.join();
+		}
+	}
+
+	void worker_pool::run(size_t pCount, const std::function<void(size_t, size_t)>& pFunc, size_t pMaxThreads)
+	{
+		const size_t workerCount = std::min({ 0 == pMaxThreads ? thread_count() : pMaxThreads, thread_count(), pCount });
+		// a job which is started while another one is running, e.g. from within that job, runs on the calling thread
+		bool idle = false;
+		if (workerCount <= 1 || !mBusy.compare_exchange_strong(idle, true)) {
+			for (size_t i = 0; i < pCount; ++i) {
+				pFunc(i, 0);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(mMutex);
+			mJob = &pFunc;
+			mJobCount = pCount;
+			mJobWorkers = workerCount;
+			mPendingWorkers = workerCount - 1;
+			mNextIndex = 0;
+			mFirstException = nullptr;
+			++mJobNumber;
+		}
+		mJobStarted.notify_all();
+		process(0);
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		mJobFinished.wait(lock, [this]() { return 0 == mPendingWorkers; });
+		mJob = nullptr;
+		mBusy = false;
+		if (mFirstException) {
+			std::exception_ptr exception = mFirstException;
+			mFirstException = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+
+	worker_pool& worker_pool::shared()
+	{
+		static worker_pool sInstance;
+		return sInstance;
+	}
+
+	void worker_pool::worker_main(size_t pWorker)
+	{
+		uint64_t lastJobNumber = 0;
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (true) {
+			mJobStarted.wait(lock, [&]() { return mStopping || mJobNumber != lastJobNumber; });
+			if (mStopping) {
+				return;
+			}
+			lastJobNumber = mJobNumber;
+			// the job does not wait for workers beyond its limit
+			if (pWorker >= mJobWorkers) {
+				continue;
+			}
+			lock.unlock();
+			process(pWorker);
+			lock.lock();
+			if (0 == --mPendingWorkers) {
+				mJobFinished.notify_one();
+			}
+		}
+	}
+
+	void worker_pool::process(size_t pWorker)
+	{
+		for (size_t i = mNextIndex++; i < mJobCount; i = mNextIndex++) {
+			try {
+				(*mJob)(i, pWorker);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> guard(mMutex);
+				if (!mFirstException) {
+					mFirstException = std::current_exception();
+				}
+			}
+		}
+	}
+}
@@ -3,6 +3,7 @@
 #include <stdexcept>
 
 #include "vulkan_memory_manager.h"
+#include "vulkan_staging_ring.h"
 
 namespace cgb {
 
@@ -23,30 +24,29 @@ namespace cgb {
 
 	vulkan_buffer::vulkan_buffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, void* bufferData, std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager) :
 		mCommandBufferManager(commandBufferManager) {
-		vk::Buffer stagingBuffer;
-		vulkan_memory stagingBufferMemory;
-		createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(vulkan_context::instance().device, stagingBufferMemory.memory, stagingBufferMemory.offset, size, 0, &data);
-		memcpy(data, bufferData, (size_t)size);
-		vkUnmapMemory(vulkan_context::instance().device, stagingBufferMemory.memory);
-
 		createBuffer(size, usage, properties, mBuffer, mBufferMemory);
-
-		copy_buffer(stagingBuffer, size);
-
-		vkDestroyBuffer(vulkan_context::instance().device, stagingBuffer, nullptr);
-		vulkan_context::instance().memoryManager->free_memory(stagingBufferMemory);
+		upload(bufferData, size, true);
 	}
 
 	vulkan_buffer::~vulkan_buffer()
 	{
+		if (mMovedFromBuffer) {
+			vulkan_context::instance().memoryManager->cancel_move(this);
+			finish_move();
+		}
 		vkDestroyBuffer(vulkan_context::instance().device, mBuffer, nullptr);
 		vulkan_context::instance().memoryManager->free_memory(mBufferMemory);
 	}
 
 	void vulkan_buffer::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer& buffer, vulkan_memory &cgbMemory) {
+		const bool movable = is_movable(usage, properties);
+		if (movable) {
+			// the contents are copied to the new buffer when the buffer is moved
+			usage |= vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+		}
+		mSize = size;
+		mUsage = usage;
+
 		vk::BufferCreateInfo bufferInfo = {};
 		bufferInfo.size = size;
 		bufferInfo.usage = usage;
@@ -62,6 +62,56 @@ namespace cgb {
 		vulkan_context::instance().memoryManager->allocate_memory(memRequirements, properties, cgbMemory);
 
 		vulkan_context::instance().device.bindBufferMemory(buffer, cgbMemory.memory, cgbMemory.offset);
+
+		mCopyable = movable;
+		mAlignment = memRequirements.alignment;
+		if (movable) {
+			vulkan_context::instance().memoryManager->set_movable(this, cgbMemory, mAlignment);
+		}
+	}
+
+	void vulkan_buffer::set_movable(bool movable)
+	{
+		assert(mCopyable || !movable);
+		if (mCopyable) {
+			vulkan_context::instance().memoryManager->set_movable(this, mBufferMemory, mAlignment, movable);
+		}
+	}
+
+	bool vulkan_buffer::is_movable(vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties)
+	{
+		const vk::BufferUsageFlags descriptorUsage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer
+			| vk::BufferUsageFlagBits::eUniformTexelBuffer | vk::BufferUsageFlagBits::eStorageTexelBuffer;
+		return !(properties & vk::MemoryPropertyFlagBits::eHostVisible) && !(usage & descriptorUsage);
+	}
+
+	void vulkan_buffer::begin_move(vk::CommandBuffer commandBuffer, const vulkan_memory& newMemory)
+	{
+		// a buffer created with the same parameters has the same memory requirements
+		vk::BufferCreateInfo bufferInfo = {};
+		bufferInfo.size = mSize;
+		bufferInfo.usage = mUsage;
+		bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		vk::Buffer newBuffer;
+		if (vulkan_context::instance().device.createBuffer(&bufferInfo, nullptr, &newBuffer) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+		vulkan_context::instance().device.bindBufferMemory(newBuffer, newMemory.memory, newMemory.offset);
+
+		vk::BufferCopy copyRegion = {};
+		copyRegion.size = mSize;
+		commandBuffer.copyBuffer(mBuffer, newBuffer, 1, &copyRegion);
+
+		mMovedFromBuffer = mBuffer;
+		mBuffer = newBuffer;
+		mBufferMemory = newMemory;
+	}
+
+	void vulkan_buffer::finish_move()
+	{
+		vulkan_context::instance().device.destroyBuffer(mMovedFromBuffer);
+		mMovedFromBuffer = nullptr;
 	}
 
 	void vulkan_buffer::copy_buffer(vk::Buffer srcBuffer, vk::DeviceSize size) {
@@ -76,10 +126,28 @@ namespace cgb {
 
 	void vulkan_buffer::update_buffer(void* bufferData, vk::DeviceSize size)
 	{
-		void* data;
-		vkMapMemory(vulkan_context::instance().device, mBufferMemory.memory, mBufferMemory.offset, size, 0, &data);
-		memcpy(data, bufferData, size);
-		vkUnmapMemory(vulkan_context::instance().device, mBufferMemory.memory);
+		upload(bufferData, size, false);
+	}
+
+	void vulkan_buffer::upload(void* bufferData, vk::DeviceSize size, bool newBuffer)
+	{
+		// host visible memory is mapped persistently, since other resources might share its vk::DeviceMemory
+		if (nullptr != mBufferMemory.mapped) {
+			memcpy(mBufferMemory.mapped, bufferData, (size_t)size);
+		}
+		else {
+			mUploadTicket = vulkan_context::instance().stagingRing->upload_to_buffer(mBuffer, 0, bufferData, size, newBuffer);
+		}
+	}
+
+	bool vulkan_buffer::is_uploaded()
+	{
+		return vulkan_context::instance().stagingRing->is_complete(mUploadTicket);
+	}
+
+	void vulkan_buffer::wait_for_upload()
+	{
+		vulkan_context::instance().stagingRing->wait(mUploadTicket);
 	}
 
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "vulkan_command_buffer_manager.h"
+#include "vulkan_staging_ring.h"
 
 namespace cgb {
 
@@ -16,6 +17,15 @@ namespace cgb {
 	vulkan_command_buffer_manager::~vulkan_command_buffer_manager()
 	{
 		for (int i = 0; i < mImageCount; i++) {
+			// worker command buffers are freed with their pools
+			auto& recordedSecCmdBuffers = mSecondaryCmdBuffers.mRecordedCommandBuffers[i];
+			for (vk::CommandBuffer workerCmdBuffer : mRecordedWorkerCmdBuffers[i]) {
+				recordedSecCmdBuffers.erase(std::remove(recordedSecCmdBuffers.begin(), recordedSecCmdBuffers.end(), workerCmdBuffer), recordedSecCmdBuffers.end());
+			}
+			for (auto& workerPool : mWorkerPools[i]) {
+				vulkan_context::instance().device.destroyCommandPool(workerPool.mCommandPool);
+			}
+
 			vulkan_context::instance().device.freeCommandBuffers(mCommandPool, static_cast<uint32_t>(mPrimaryCmdBuffers.mFreeCommandBuffers[i].size()), mPrimaryCmdBuffers.mFreeCommandBuffers[i].data());
 			vulkan_context::instance().device.freeCommandBuffers(mCommandPool, static_cast<uint32_t>(mPrimaryCmdBuffers.mRecordedCommandBuffers[i].size()), mPrimaryCmdBuffers.mRecordedCommandBuffers[i].data());
 			vulkan_context::instance().device.freeCommandBuffers(mCommandPool, static_cast<uint32_t>(mPrimaryCmdBuffers.mSubmittedCommandBuffers[i].size()), mPrimaryCmdBuffers.mSubmittedCommandBuffers[i].data());
@@ -28,6 +38,8 @@ namespace cgb {
 	void vulkan_command_buffer_manager::create_command_buffers() {
 		mPrimaryCmdBuffers.init_frames(mImageCount);
 		mSecondaryCmdBuffers.init_frames(mImageCount);
+		mWorkerPools.resize(mImageCount);
+		mRecordedWorkerCmdBuffers.resize(mImageCount);
 	}
 
 	vk::CommandBuffer vulkan_command_buffer_manager::get_command_buffer(vk::CommandBufferLevel bufferLevel, vk::CommandBufferBeginInfo &beginInfo) {
@@ -77,6 +89,64 @@ namespace cgb {
 		auto &finishedSecCmdBuffer = mSecondaryCmdBuffers.mSubmittedCommandBuffers[vulkan_context::instance().currentFrame];
 		freeSecCmdBuffer.insert(freeSecCmdBuffer.end(), finishedSecCmdBuffer.begin(), finishedSecCmdBuffer.end());
 		finishedSecCmdBuffer.clear();
+
+		for (auto& workerPool : mWorkerPools[vulkan_context::instance().currentFrame]) {
+			if (workerPool.mUsedCount > 0) {
+				vulkan_context::instance().device.resetCommandPool(workerPool.mCommandPool, {});
+				workerPool.mUsedCount = 0;
+			}
+		}
+	}
+
+	void vulkan_command_buffer_manager::prepare_workers(uint32_t workerCount)
+	{
+		vk::CommandPoolCreateInfo poolInfo = {};
+		poolInfo.queueFamilyIndex = vulkan_context::instance().findQueueFamilies().graphicsFamily.value();
+		// the command buffers are re-recorded every frame
+		poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+
+		for (auto& workerPools : mWorkerPools) {
+			while (workerPools.size() < workerCount) {
+				worker_command_pool workerPool;
+				if (vulkan_context::instance().device.createCommandPool(&poolInfo, nullptr, &workerPool.mCommandPool) != vk::Result::eSuccess) {
+					throw std::runtime_error("failed to create worker command pool!");
+				}
+				workerPools.push_back(workerPool);
+			}
+		}
+		if (!mWorkers || mWorkers->thread_count() < workerCount) {
+			mWorkers = std::make_unique<worker_pool>(workerCount);
+		}
+	}
+
+	vk::CommandBuffer vulkan_command_buffer_manager::get_worker_command_buffer(uint32_t worker, vk::CommandBufferBeginInfo &beginInfo)
+	{
+		worker_command_pool& workerPool = mWorkerPools[vulkan_context::instance().currentFrame][worker];
+		if (workerPool.mUsedCount == workerPool.mCommandBuffers.size()) {
+			vk::CommandBufferAllocateInfo allocInfo = {};
+			allocInfo.commandPool = workerPool.mCommandPool;
+			allocInfo.level = vk::CommandBufferLevel::eSecondary;
+			allocInfo.commandBufferCount = 1;
+
+			vk::CommandBuffer commandBuffer;
+			if (vulkan_context::instance().device.allocateCommandBuffers(&allocInfo, &commandBuffer) != vk::Result::eSuccess) {
+				throw std::runtime_error("failed to allocate command buffers!");
+			}
+			workerPool.mCommandBuffers.push_back(commandBuffer);
+		}
+		vk::CommandBuffer ret = workerPool.mCommandBuffers[workerPool.mUsedCount++];
+		if (ret.begin(&beginInfo) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		return ret;
+	}
+
+	void vulkan_command_buffer_manager::add_worker_command_buffers(const std::vector<vk::CommandBuffer> &commandBuffers)
+	{
+		auto &recordedSecCmdBuffers = mSecondaryCmdBuffers.mRecordedCommandBuffers[vulkan_context::instance().currentFrame];
+		recordedSecCmdBuffers.insert(recordedSecCmdBuffers.end(), commandBuffers.begin(), commandBuffers.end());
+		auto &recordedWorkerCmdBuffers = mRecordedWorkerCmdBuffers[vulkan_context::instance().currentFrame];
+		recordedWorkerCmdBuffers.insert(recordedWorkerCmdBuffers.end(), commandBuffers.begin(), commandBuffers.end());
 	}
 
 	vk::CommandBuffer vulkan_command_buffer_manager::begin_single_time_commands() {
@@ -99,12 +169,19 @@ namespace cgb {
 	void vulkan_command_buffer_manager::end_single_time_commands(vk::CommandBuffer commandBuffer) {
 		vkEndCommandBuffer(commandBuffer);
 
+		vulkan_context::instance().stagingRing->flush_for(mTransferQueue);
+
 		vk::SubmitInfo submitInfo = {};
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		mTransferQueue.submit(1, &submitInfo, nullptr);
-		vkQueueWaitIdle(mTransferQueue);
+		// wait for this submission only, instead of for everything on the queue
+		vk::FenceCreateInfo fenceInfo = {};
+		vk::Fence fence;
+		vulkan_context::instance().device.createFence(&fenceInfo, nullptr, &fence);
+		mTransferQueue.submit(1, &submitInfo, fence);
+		vulkan_context::instance().device.waitForFences(1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		vulkan_context::instance().device.destroyFence(fence);
 
 		vulkan_context::instance().device.freeCommandBuffers(mCommandPool, 1, &commandBuffer);
 	}
@@ -138,7 +215,14 @@ namespace cgb {
 	{
 		auto &submittedBuffersForFrame = cmdBufferSystem.mSubmittedCommandBuffers[vulkan_context::instance().currentFrame];
 		auto recordedBuffersForFrame = cmdBufferSystem.mRecordedCommandBuffers[vulkan_context::instance().currentFrame];
-		submittedBuffersForFrame.insert(submittedBuffersForFrame.end(), recordedBuffersForFrame.begin(), recordedBuffersForFrame.end());
+		// worker command buffers are recycled with their pools instead
+		auto &recordedWorkerBuffers = mRecordedWorkerCmdBuffers[vulkan_context::instance().currentFrame];
+		std::copy_if(recordedBuffersForFrame.begin(), recordedBuffersForFrame.end(), std::back_inserter(submittedBuffersForFrame), [&recordedWorkerBuffers](vk::CommandBuffer cmdBuf) {
+			return std::find(recordedWorkerBuffers.begin(), recordedWorkerBuffers.end(), cmdBuf) == recordedWorkerBuffers.end();
+		});
+		if (&cmdBufferSystem == &mSecondaryCmdBuffers) {
+			recordedWorkerBuffers.clear();
+		}
 		cmdBufferSystem.mRecordedCommandBuffers[vulkan_context::instance().currentFrame].clear();
 
 		return recordedBuffersForFrame;
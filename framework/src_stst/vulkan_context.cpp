@@ -1,4 +1,7 @@
 #include "vulkan_context.h"
+#include "vulkan_memory_manager.h"
+#include "vulkan_staging_ring.h"
+#include "vulkan_frame_allocator.h"
 
 #include <set>
 
@@ -29,6 +32,9 @@ namespace cgb {
 	vulkan_context::~vulkan_context()
 	{
 		vulkanFramebuffer.reset();
+		delete frameAllocator;
+		delete stagingRing;
+		delete memoryManager;
 		//vulkan_context::instance().device.destroy();
 		//if (enableValidationLayers) {
 		//	vkInstance.destroyDebugUtilsMessengerEXT(callback, nullptr, dynamicDispatchInstance);
@@ -319,6 +325,10 @@ namespace cgb {
 		device.getQueue(indices.presentFamily.value(), 0, &presentQueue);
 		device.getQueue(indices.computeFamily.value(), 0, &computeQueue);
 		dynamicDispatchInstanceDevice = vk::DispatchLoaderDynamic(vkInstance, device);
+
+		memoryManager = new vulkan_memory_manager();
+		stagingRing = new vulkan_staging_ring(32 * 1024 * 1024);
+		frameAllocator = new vulkan_frame_allocator(frameAllocatorSize, MAX_FRAMES_IN_FLIGHT);
 	}
 
 	SwapChainSupportDetails vulkan_context::querySwapChainSupport(vk::PhysicalDevice device) {
@@ -14,7 +14,61 @@ namespace cgb {
 
 	void vulkan_drawer::draw(std::vector<vulkan_render_object*> renderObjects)
 	{
-		record_secondary_command_buffer(renderObjects);
+		if (!mCullingFrustum) {
+			mCulledCount = 0;
+		}
+		std::vector<vulkan_render_object*> visibleObjects = mCullingFrustum ? cull(renderObjects) : renderObjects;
+		if (mSortingEnabled) {
+			sort(visibleObjects);
+		}
+		record_secondary_command_buffer(std::move(visibleObjects));
+	}
+
+	std::vector<vulkan_render_object*> vulkan_drawer::cull(const std::vector<vulkan_render_object*>& renderObjects)
+	{
+		// test the world-space bounds of all objects in one batch
+		mWorldBounds.clear();
+		for (vulkan_render_object* renderObject : renderObjects) {
+			if (!renderObject->get_bounds().empty()) {
+				mWorldBounds.push_back(renderObject->get_bounds().transformed(renderObject->get_push_uniforms().model));
+			}
+		}
+		cull_aabbs(mWorldBounds, *mCullingFrustum, mVisibleIndices);
+		mCulledCount = mWorldBounds.size() - mVisibleIndices.size();
+
+		// keep the order of the render objects, the visible indices are sorted
+		std::vector<vulkan_render_object*> visibleObjects;
+		visibleObjects.reserve(renderObjects.size() - mCulledCount);
+		uint32_t boundsIndex = 0;
+		auto nextVisible = mVisibleIndices.begin();
+		for (vulkan_render_object* renderObject : renderObjects) {
+			if (renderObject->get_bounds().empty()) {
+				visibleObjects.push_back(renderObject);
+				continue;
+			}
+			if (nextVisible != mVisibleIndices.end() && *nextVisible == boundsIndex) {
+				visibleObjects.push_back(renderObject);
+				++nextVisible;
+			}
+			++boundsIndex;
+		}
+		return visibleObjects;
+	}
+
+	void vulkan_drawer::sort(std::vector<vulkan_render_object*>& renderObjects)
+	{
+		mDrawKeys.clear();
+		mDrawKeys.reserve(renderObjects.size());
+		for (vulkan_render_object* renderObject : renderObjects) {
+			const glm::vec3 position = glm::vec3(renderObject->get_push_uniforms().model[3]);
+			const glm::vec3 toObject = position - mSortingViewPosition;
+			mDrawKeys.push_back({ renderObject->get_vertex_buffer(0), renderObject->get_index_buffer(), renderObject->get_resource_bundle()->get_descriptor_set(),
+				glm::dot(toObject, toObject), renderObject });
+		}
+		std::sort(mDrawKeys.begin(), mDrawKeys.end());
+		for (size_t i = 0; i < mDrawKeys.size(); i++) {
+			renderObjects[i] = mDrawKeys[i].renderObject;
+		}
 	}
 
 	void vulkan_drawer::record_secondary_command_buffer(std::vector<vulkan_render_object*> renderObjects) {
@@ -28,31 +82,116 @@ namespace cgb {
 		beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse;
 		beginInfo.pInheritanceInfo = &inheritanceInfo;
 
-		vk::CommandBuffer commandBuffer = mCommandBufferManager->get_command_buffer(vk::CommandBufferLevel::eSecondary, beginInfo);
+		// the uniforms are written into the frame allocator, which is not thread-safe, before the draws are recorded
+		mUniformOffsets.resize(renderObjects.size());
+		for (size_t i = 0; i < renderObjects.size(); i++) {
+			mUniformOffsets[i] = renderObjects[i]->get_uniform_offset();
+		}
+
+		const size_t maxThreads = 0 == mMaxRecordingThreads ? std::max(1u, std::thread::hardware_concurrency()) : mMaxRecordingThreads;
+		const size_t chunkCount = std::min(maxThreads, renderObjects.size() / mMinObjectsPerThread);
+		if (chunkCount <= 1) {
+			vk::CommandBuffer commandBuffer = mCommandBufferManager->get_command_buffer(vk::CommandBufferLevel::eSecondary, beginInfo);
+			mBindCounters = record_draws(commandBuffer, renderObjects, 0, renderObjects.size());
+			return;
+		}
+
+		// every chunk is recorded into its own secondary command buffer from the command pool of the worker which records it,
+		// the primary command buffer executes them in the order of the render objects
+		// the workers are kept by the command buffer manager, so no threads are started per frame
+		mCommandBufferManager->prepare_workers(static_cast<uint32_t>(chunkCount));
+		std::vector<vk::CommandBuffer> commandBuffers(chunkCount);
+		std::vector<bind_counters> chunkCounters(chunkCount);
+		mCommandBufferManager->get_workers().run(chunkCount, [&](size_t chunk, size_t worker) {
+			commandBuffers[chunk] = mCommandBufferManager->get_worker_command_buffer(static_cast<uint32_t>(worker), beginInfo);
+			chunkCounters[chunk] = record_draws(commandBuffers[chunk], renderObjects, renderObjects.size() * chunk / chunkCount, renderObjects.size() * (chunk + 1) / chunkCount);
+		}, chunkCount);
+		mCommandBufferManager->add_worker_command_buffers(commandBuffers);
+
+		mBindCounters = {};
+		for (const bind_counters& counters : chunkCounters) {
+			mBindCounters.issued += counters.issued;
+			mBindCounters.skipped += counters.skipped;
+		}
+	}
+
+	bind_counters vulkan_drawer::record_draws(vk::CommandBuffer commandBuffer, const std::vector<vulkan_render_object*>& renderObjects, size_t begin, size_t end) {
+		bind_counters counters;
 		// bind pipeline for this draw command
 		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline());
+		counters.issued++;
 
 		if (vulkan_context::instance().shadingRateImageSupported) {
 			commandBuffer.bindShadingRateImageNV(mVrsImages[vulkan_context::instance().currentFrame]->get_image_view(), vk::ImageLayout::eShadingRateOptimalNV, vulkan_context::instance().dynamicDispatchInstanceDevice);
 		}
 
-		for (vulkan_render_object* renderObject : renderObjects) {
+		// state bound by the previous draw, secondary command buffers do not inherit any state
+		vk::Buffer boundVertexBuffer;
+		vk::Buffer boundIndexBuffer;
+		vk::IndexType boundIndexType = vk::IndexType::eUint32;
+		vk::DescriptorSet boundDescriptorSet;
+		uint32_t boundUniformOffset = 0;
+		PushUniforms boundPushUniforms;
+		bool pushUniformsBound = false;
+
+		for (size_t i = begin; i < end; i++) {
+			vulkan_render_object* renderObject = renderObjects[i];
+
+			vk::Buffer vertexBuffer = renderObject->get_vertex_buffer(0);
+			if (vertexBuffer != boundVertexBuffer) {
+				vk::Buffer vertexBuffers[] = { vertexBuffer, vertexBuffer };
+				vk::DeviceSize offsets[] = { 0, 0 };
+				commandBuffer.bindVertexBuffers(1, 2, vertexBuffers, offsets);
+				boundVertexBuffer = vertexBuffer;
+				counters.issued++;
+			}
+			else {
+				counters.skipped++;
+			}
 
-			vk::Buffer vertexBuffers[] = { renderObject->get_vertex_buffer(0) , renderObject->get_vertex_buffer(0) };
-			vk::DeviceSize offsets[] = { 0, 0 };
-			commandBuffer.bindVertexBuffers(1, 2, vertexBuffers, offsets);
-			commandBuffer.bindIndexBuffer(renderObject->get_index_buffer(), 0, vk::IndexType::eUint32);
+			vk::Buffer indexBuffer = renderObject->get_index_buffer();
+			vk::IndexType indexType = renderObject->get_index_type();
+			if (indexBuffer != boundIndexBuffer || indexType != boundIndexType) {
+				commandBuffer.bindIndexBuffer(indexBuffer, 0, indexType);
+				boundIndexBuffer = indexBuffer;
+				boundIndexType = indexType;
+				counters.issued++;
+			}
+			else {
+				counters.skipped++;
+			}
 
-			commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline_layout(), 0, 1, &(renderObject->get_resource_bundle()->get_descriptor_set()), 0, nullptr);
+			// the uniforms are selected within the frame allocator's buffer with a dynamic offset
+			vk::DescriptorSet descriptorSet = renderObject->get_resource_bundle()->get_descriptor_set();
+			if (descriptorSet != boundDescriptorSet || mUniformOffsets[i] != boundUniformOffset) {
+				commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline_layout(), 0, 1, &descriptorSet, 1, &mUniformOffsets[i]);
+				boundDescriptorSet = descriptorSet;
+				boundUniformOffset = mUniformOffsets[i];
+				counters.issued++;
+			}
+			else {
+				counters.skipped++;
+			}
 
-			commandBuffer.pushConstants(
-				mPipeline->get_pipeline_layout(),
-				vk::ShaderStageFlagBits::eVertex,
-				0,
-				sizeof(PushUniforms),
-				&(renderObject->get_push_uniforms()));
+			PushUniforms pushUniforms = renderObject->get_push_uniforms();
+			if (!pushUniformsBound || memcmp(&pushUniforms, &boundPushUniforms, sizeof(PushUniforms)) != 0) {
+				commandBuffer.pushConstants(
+					mPipeline->get_pipeline_layout(),
+					vk::ShaderStageFlagBits::eVertex,
+					0,
+					sizeof(PushUniforms),
+					&pushUniforms);
+				boundPushUniforms = pushUniforms;
+				pushUniformsBound = true;
+				counters.issued++;
+			}
+			else {
+				counters.skipped++;
+			}
 
-			commandBuffer.drawIndexed(static_cast<uint32_t>(renderObject->get_index_count()), 1, 0, 0, 0);
+			const vulkan_mesh_range& meshRange = renderObject->get_mesh_range();
+			commandBuffer.drawIndexed(meshRange.indexCount, 1, meshRange.firstIndex, meshRange.vertexOffset, 0);
 		}
+		return counters;
 	}
 }
\ No newline at end of file
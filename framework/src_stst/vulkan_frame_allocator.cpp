@@ -0,0 +1,46 @@
+#include "vulkan_frame_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cgb {
+
+	vulkan_frame_allocator::vulkan_frame_allocator(vk::DeviceSize frameSize, uint32_t frameCount) : mFrameCount(frameCount)
+	{
+		vk::PhysicalDeviceLimits limits = vulkan_context::instance().physicalDevice.getProperties().limits;
+		mAlignment = std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+		// every region has to start at an aligned offset
+		mFrameSize = (frameSize + mAlignment - 1) / mAlignment * mAlignment;
+
+		mBuffer = std::make_shared<vulkan_buffer>(mFrameSize * mFrameCount, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+	}
+
+	vulkan_frame_allocator::~vulkan_frame_allocator()
+	{
+	}
+
+	void vulkan_frame_allocator::begin_frame(size_t frameIndex)
+	{
+		assert(frameIndex < mFrameCount);
+		if (frameIndex == mCurrentFrame) {
+			return;
+		}
+		mCurrentFrame = frameIndex;
+		mFrameSerial++;
+		mUsed = 0;
+	}
+
+	vulkan_frame_allocator::allocation vulkan_frame_allocator::allocate(vk::DeviceSize size)
+	{
+		vk::DeviceSize offset = (mUsed + mAlignment - 1) / mAlignment * mAlignment;
+		if (offset + size > mFrameSize) {
+			throw std::runtime_error("frame allocator is out of memory for this frame!");
+		}
+		mUsed = offset + size;
+
+		offset += mCurrentFrame * mFrameSize;
+		return allocation{ static_cast<char*>(mBuffer->get_mapped()) + offset, static_cast<uint32_t>(offset) };
+	}
+
+}
@@ -0,0 +1,51 @@
+#include "vulkan_geometry_pool.h"
+
+#include <stdexcept>
+
+#include "vulkan_staging_ring.h"
+
+namespace cgb {
+
+	vulkan_geometry_pool::vulkan_geometry_pool(vk::DeviceSize vertexSize, uint32_t maxVertexCount, uint32_t maxIndexCount) :
+		mVertexSize(vertexSize), mMaxVertexCount(maxVertexCount), mMaxIndexCount(maxIndexCount)
+	{
+		mVertexBuffer = std::make_shared<vulkan_buffer>(mVertexSize * mMaxVertexCount,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		mIndexBuffer = std::make_shared<vulkan_buffer>(sizeof(uint32_t) * mMaxIndexCount,
+			vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal);
+		// the buffers are written piecewise while the meshes added before are drawn, so they must not be moved by the defragmentation
+		mVertexBuffer->set_movable(false);
+		mIndexBuffer->set_movable(false);
+	}
+
+	vulkan_geometry_pool::~vulkan_geometry_pool()
+	{
+	}
+
+	vulkan_mesh_range vulkan_geometry_pool::add_mesh(const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices)
+	{
+		const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+		if (vertexCount > mMaxVertexCount - mVertexCount || indexCount > mMaxIndexCount - mIndexCount) {
+			throw std::runtime_error("geometry pool is full!");
+		}
+
+		vulkan_mesh_range range;
+		range.firstIndex = mIndexCount;
+		range.indexCount = indexCount;
+		range.vertexOffset = static_cast<int32_t>(mVertexCount);
+
+		// only the first mesh may be copied on the transfer queue, the meshes after it are appended while the buffers are drawn from
+		vulkan_staging_ring& stagingRing = *vulkan_context::instance().stagingRing;
+		if (vertexCount > 0) {
+			stagingRing.upload_to_buffer(mVertexBuffer->get_vk_buffer(), mVertexSize * mVertexCount, vertices, mVertexSize * vertexCount, 0 == mVertexCount);
+		}
+		if (indexCount > 0) {
+			stagingRing.upload_to_buffer(mIndexBuffer->get_vk_buffer(), sizeof(uint32_t) * mIndexCount, indices.data(), sizeof(uint32_t) * indexCount, 0 == mIndexCount);
+		}
+
+		mVertexCount += vertexCount;
+		mIndexCount += indexCount;
+		return range;
+	}
+
+}
@@ -3,8 +3,8 @@
 #include <algorithm>
 #include <stdexcept>
 
-#include "vulkan_buffer.h"
 #include "vulkan_memory_manager.h"
+#include "vulkan_staging_ring.h"
 
 namespace cgb {
 	vulkan_image::vulkan_image(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, void* pixels, int texWidth, int texHeight, int texChannels) :
@@ -22,32 +22,64 @@ namespace cgb {
 		mImageView = create_image_view(format, aspects, mipLevels);
 	}
 
+	vulkan_image::vulkan_image(uint32_t width, uint32_t height, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspects) :
+		mTexWidth(width), mTexHeight(height), mMipLevels(1), mNumSamples(numSamples), mFormat(format), mTiling(vk::ImageTiling::eOptimal), mUsage(usage),
+		mMemoryProperties(vk::MemoryPropertyFlagBits::eDeviceLocal), mAspects(aspects), mOwnsMemory(false)
+	{
+		vk::ImageCreateInfo imageInfo = {};
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = format;
+		imageInfo.tiling = vk::ImageTiling::eOptimal;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageInfo.usage = usage;
+		imageInfo.samples = numSamples;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		if (vulkan_context::instance().device.createImage(&imageInfo, nullptr, &mImage) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create image!");
+		}
+	}
+
 
 	vulkan_image::~vulkan_image()
 	{
+		if (mMovedFromImage) {
+			vulkan_context::instance().memoryManager->cancel_move(this);
+			finish_move();
+		}
 		vkDestroyImageView(vulkan_context::instance().vulkan_context::instance().device, mImageView, nullptr);
 		vkDestroyImage(vulkan_context::instance().vulkan_context::instance().device, mImage, nullptr);
-		vulkan_context::instance().memoryManager->free_memory(mImageMemory);
+		if (mOwnsMemory) {
+			vulkan_context::instance().memoryManager->free_memory(mImageMemory);
+		}
 	}
 
 	void vulkan_image::create_texture_image(void* pixels, int texWidth, int texHeight, int texChannels) {
-		vk::DeviceSize imageSize = texWidth * texHeight * 4;
 		mMipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
 
 		if (!pixels) {
 			throw std::runtime_error("failed to load texture image!");
 		}
 
-		vulkan_buffer stagingBuffer(imageSize, vk::BufferUsageFlagBits::eTransferSrc, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mCommandBufferManager);
-		stagingBuffer.update_buffer(pixels, imageSize);
-
-		create_image(texWidth, texHeight, mMipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Unorm, vk::ImageTiling::eOptimal,
-			vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::MemoryPropertyFlagBits::eDeviceLocal, mImage, mImageMemory);
+		mNumSamples = vk::SampleCountFlagBits::e1;
+		mFormat = vk::Format::eR8G8B8A8Unorm;
+		mTiling = vk::ImageTiling::eOptimal;
+		mUsage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+		mMemoryProperties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+		mAspects = vk::ImageAspectFlagBits::eColor;
+		create_image(texWidth, texHeight, mMipLevels, mNumSamples, mFormat, mTiling, mUsage, mMemoryProperties, mImage, mImageMemory);
 
-		transition_image_layout(vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mMipLevels);
-		copy_buffer_to_image(stagingBuffer, mImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+		// the upload and the mipmap generation are recorded into the staging ring's current batch, so that loading many textures
+		// results in one submission per queue; the upload leaves all mip levels in transfer dst layout, owned by the graphics queue
+		vulkan_staging_ring& stagingRing = *vulkan_context::instance().stagingRing;
+		mUploadTicket = stagingRing.upload_to_image(mImage, pixels, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), 4, mMipLevels);
 
-		generate_mipmaps(mImage, vk::Format::eR8G8B8A8Unorm, texWidth, texHeight, mMipLevels);
+		generate_mipmaps(stagingRing.get_graphics_command_buffer(), mImage, vk::Format::eR8G8B8A8Unorm, texWidth, texHeight, mMipLevels);
 	}
 
 	void vulkan_image::create_image(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
@@ -72,15 +104,21 @@ namespace cgb {
 
 		vk::MemoryRequirements memRequirements;
 		vulkan_context::instance().device.getImageMemoryRequirements(image, &memRequirements);
+		mAlignment = memRequirements.alignment;
 
-		vulkan_context::instance().memoryManager->allocate_memory(memRequirements, properties, imageMemory);
+		vulkan_context::instance().memoryManager->allocate_memory(memRequirements, properties, imageMemory,
+			tiling == vk::ImageTiling::eOptimal ? device_resource_kind::optimal : device_resource_kind::linear);
 
 		vkBindImageMemory(vulkan_context::instance().device, image, imageMemory.memory, imageMemory.offset);
 	}
 
 	void vulkan_image::transition_image_layout(vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels) {
 		vk::CommandBuffer commandBuffer = mCommandBufferManager->begin_single_time_commands();
+		record_layout_transition(commandBuffer, format, oldLayout, newLayout, mipLevels);
+		mCommandBufferManager->end_single_time_commands(commandBuffer);
+	}
 
+	void vulkan_image::record_layout_transition(vk::CommandBuffer commandBuffer, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels) {
 		vk::ImageMemoryBarrier barrier = {};
 		barrier.oldLayout = oldLayout;
 		barrier.newLayout = newLayout;
@@ -167,46 +205,131 @@ namespace cgb {
 			0, nullptr,
 			1, &barrier
 		);
+	}
 
-		mCommandBufferManager->end_single_time_commands(commandBuffer);
+	vk::MemoryRequirements vulkan_image::get_memory_requirements() {
+		vk::MemoryRequirements memRequirements;
+		vulkan_context::instance().device.getImageMemoryRequirements(mImage, &memRequirements);
+		return memRequirements;
 	}
 
-	bool vulkan_image::has_stencil_component(vk::Format format) {
-		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+	void vulkan_image::bind_memory(vk::DeviceMemory memory, vk::DeviceSize offset) {
+		if (vkBindImageMemory(vulkan_context::instance().device, mImage, memory, offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind image memory!");
+		}
+		mImageView = create_image_view(mFormat, mAspects, mMipLevels);
 	}
 
-	void vulkan_image::copy_buffer_to_image(vulkan_buffer& buffer, vk::Image image, uint32_t width, uint32_t height) {
-		vk::CommandBuffer commandBuffer = mCommandBufferManager->begin_single_time_commands();
+	void vulkan_image::set_movable(bool movable, vk::ImageLayout layout) {
+		const vk::ImageUsageFlags copyUsage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+		assert(!movable || (mOwnsMemory && (mUsage & copyUsage) == copyUsage));
+		if (!mOwnsMemory) {
+			return;
+		}
+		mMovableLayout = layout;
+		vulkan_context::instance().memoryManager->set_movable(this, mImageMemory, mAlignment, movable);
+	}
 
-		vk::BufferImageCopy region = {};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-
-		region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = {
-			width,
-			height,
-			1
-		};
-
-		commandBuffer.copyBufferToImage(
-			buffer.get_vk_buffer(),
-			image,
-			vk::ImageLayout::eTransferDstOptimal,
-			1,
-			&region
-		);
+	void vulkan_image::begin_move(vk::CommandBuffer commandBuffer, const vulkan_memory& newMemory) {
+		// an image created with the same parameters has the same memory requirements
+		vk::ImageCreateInfo imageInfo = {};
+		imageInfo.imageType = vk::ImageType::e2D;
+		imageInfo.extent.width = mTexWidth;
+		imageInfo.extent.height = mTexHeight;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mMipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = mFormat;
+		imageInfo.tiling = mTiling;
+		imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+		imageInfo.usage = mUsage;
+		imageInfo.samples = mNumSamples;
+		imageInfo.sharingMode = vk::SharingMode::eExclusive;
 
-		mCommandBufferManager->end_single_time_commands(commandBuffer);
+		vk::Image newImage;
+		if (vulkan_context::instance().device.createImage(&imageInfo, nullptr, &newImage) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create image!");
+		}
+		if (vkBindImageMemory(vulkan_context::instance().device, newImage, newMemory.memory, newMemory.offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind image memory!");
+		}
+
+		std::array<vk::ImageMemoryBarrier, 2> barriers = {};
+		for (vk::ImageMemoryBarrier& barrier : barriers) {
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange.aspectMask = mAspects;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = mMipLevels;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+		}
+		// the copy waits for everything which has been submitted before, since the old image might still be written
+		barriers[0].image = mImage;
+		barriers[0].oldLayout = mMovableLayout;
+		barriers[0].newLayout = vk::ImageLayout::eTransferSrcOptimal;
+		barriers[0].srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+		barriers[0].dstAccessMask = vk::AccessFlagBits::eTransferRead;
+		barriers[1].image = newImage;
+		barriers[1].oldLayout = vk::ImageLayout::eUndefined;
+		barriers[1].newLayout = vk::ImageLayout::eTransferDstOptimal;
+		barriers[1].srcAccessMask = {};
+		barriers[1].dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {},
+			0, nullptr,
+			0, nullptr,
+			static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		std::vector<vk::ImageCopy> regions(mMipLevels);
+		for (uint32_t level = 0; level < mMipLevels; level++) {
+			regions[level].srcSubresource.aspectMask = mAspects;
+			regions[level].srcSubresource.mipLevel = level;
+			regions[level].srcSubresource.baseArrayLayer = 0;
+			regions[level].srcSubresource.layerCount = 1;
+			regions[level].dstSubresource = regions[level].srcSubresource;
+			regions[level].extent = vk::Extent3D{ std::max(static_cast<uint32_t>(mTexWidth) >> level, 1u), std::max(static_cast<uint32_t>(mTexHeight) >> level, 1u), 1 };
+		}
+		commandBuffer.copyImage(mImage, vk::ImageLayout::eTransferSrcOptimal, newImage, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(regions.size()), regions.data());
+
+		// the new image is left in the layout in which its owner expects it
+		barriers[1].oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barriers[1].newLayout = mMovableLayout;
+		barriers[1].srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barriers[1].dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {},
+			0, nullptr,
+			0, nullptr,
+			1, &barriers[1]);
+
+		mMovedFromImage = mImage;
+		mMovedFromImageView = mImageView;
+		mImage = newImage;
+		mImageMemory = newMemory;
+		mImageView = create_image_view(mFormat, mAspects, mMipLevels);
+	}
+
+	void vulkan_image::finish_move() {
+		vkDestroyImageView(vulkan_context::instance().device, mMovedFromImageView, nullptr);
+		vkDestroyImage(vulkan_context::instance().device, mMovedFromImage, nullptr);
+		mMovedFromImageView = nullptr;
+		mMovedFromImage = nullptr;
+	}
+
+	bool vulkan_image::is_uploaded() {
+		return vulkan_context::instance().stagingRing->is_complete(mUploadTicket);
+	}
+
+	void vulkan_image::wait_for_upload() {
+		vulkan_context::instance().stagingRing->wait(mUploadTicket);
 	}
 
-	void vulkan_image::generate_mipmaps(vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
+	bool vulkan_image::has_stencil_component(vk::Format format) {
+		return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
+	}
+
+	void vulkan_image::generate_mipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
 		// Check if image format supports linear blitting
 		vk::FormatProperties formatProperties;
 		vulkan_context::instance().physicalDevice.getFormatProperties(imageFormat, &formatProperties);
@@ -214,8 +337,6 @@ namespace cgb {
 			throw std::runtime_error("texture image format does not support linear blitting!");
 		}
 
-		vk::CommandBuffer commandBuffer = mCommandBufferManager->begin_single_time_commands();
-
 		vk::ImageMemoryBarrier barrier = {};
 		barrier.image = image;
 		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -287,8 +408,6 @@ namespace cgb {
 			0, nullptr,
 			0, nullptr,
 			1, &barrier);
-
-		mCommandBufferManager->end_single_time_commands(commandBuffer);
 	}
 
 	void vulkan_image::create_texture_image_view() {
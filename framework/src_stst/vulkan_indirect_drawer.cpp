@@ -0,0 +1,187 @@
+#include "vulkan_indirect_drawer.h"
+
+#include <stdexcept>
+
+#include "vulkan_framebuffer.h"
+#include "vulkan_staging_ring.h"
+
+namespace cgb {
+
+	vulkan_indirect_drawer::vulkan_indirect_drawer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, std::shared_ptr<vulkan_pipeline> pipeline,
+		std::shared_ptr<vulkan_geometry_pool> geometryPool, std::shared_ptr<vulkan_resource_bundle> resourceBundle, uint32_t maxDrawCount) :
+		vulkan_drawer(commandBufferManager, pipeline), mGeometryPool(geometryPool), mResourceBundle(resourceBundle), mMaxDrawCount(maxDrawCount)
+	{
+		// every draw command selects its per-draw data with its first instance
+		if (!cgb::context().supports_multi_draw_indirect()) {
+			throw std::runtime_error("failed to create indirect drawer, multiDrawIndirect and drawIndirectFirstInstance are not supported!");
+		}
+
+		for (size_t i = 0; i < vulkan_context::instance().dynamicRessourceCount; i++) {
+			mDrawDataBuffers.push_back(std::make_shared<vulkan_buffer>(sizeof(indirect_draw_data) * mMaxDrawCount, vk::BufferUsageFlagBits::eStorageBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+			mDrawCommandBuffers.push_back(std::make_shared<vulkan_buffer>(sizeof(vk::DrawIndexedIndirectCommand) * mMaxDrawCount, vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+				vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent));
+		}
+		mResourceBundle->add_dynamic_buffer_resource(0, mDrawDataBuffers, sizeof(indirect_draw_data) * mMaxDrawCount);
+	}
+
+	vulkan_indirect_drawer::~vulkan_indirect_drawer()
+	{
+	}
+
+	void vulkan_indirect_drawer::enable_gpu_culling(const std::string& cullShaderFilename)
+	{
+		if (mCullPipeline) {
+			return;
+		}
+
+		for (size_t i = 0; i < vulkan_context::instance().dynamicRessourceCount; i++) {
+			mCulledCommandBuffers.push_back(std::make_shared<vulkan_buffer>(CULLED_COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * mMaxDrawCount,
+				vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::MemoryPropertyFlagBits::eDeviceLocal));
+		}
+
+		mCullResourceBundleLayout = std::make_shared<vulkan_resource_bundle_layout>();
+		mCullResourceBundleLayout->add_binding(0, vk::DescriptorType::eStorageBuffer, ShaderStageFlagBits::eCompute);
+		mCullResourceBundleLayout->add_binding(1, vk::DescriptorType::eStorageBuffer, ShaderStageFlagBits::eCompute);
+		mCullResourceBundleLayout->add_binding(2, vk::DescriptorType::eStorageBuffer, ShaderStageFlagBits::eCompute);
+		mCullResourceBundleLayout->bake();
+
+		mCullResourceBundleGroup = std::make_shared<vulkan_resource_bundle_group>();
+		mCullResourceBundle = mCullResourceBundleGroup->create_resource_bundle(mCullResourceBundleLayout, true);
+		mCullResourceBundle->add_dynamic_buffer_resource(0, mDrawDataBuffers, sizeof(indirect_draw_data) * mMaxDrawCount);
+		mCullResourceBundle->add_dynamic_buffer_resource(1, mDrawCommandBuffers, sizeof(vk::DrawIndexedIndirectCommand) * mMaxDrawCount);
+		mCullResourceBundle->add_dynamic_buffer_resource(2, mCulledCommandBuffers, CULLED_COMMANDS_OFFSET + sizeof(vk::DrawIndexedIndirectCommand) * mMaxDrawCount);
+		mCullResourceBundleGroup->allocate_resource_bundle(mCullResourceBundle.get());
+
+		mCullPipeline = std::make_shared<vulkan_pipeline>(cullShaderFilename, std::vector<std::shared_ptr<vulkan_resource_bundle_layout>> { mCullResourceBundleLayout }, sizeof(cull_push_constants));
+		mCullPipeline->add_shader(ShaderStageFlagBits::eCompute, cullShaderFilename);
+		mCullPipeline->bake();
+	}
+
+	void vulkan_indirect_drawer::draw(std::vector<vulkan_render_object*> renderObjects)
+	{
+		const bool cullOnGpu = mCullPipeline && mCullingFrustum;
+		mCulledCount = 0;
+		std::vector<vulkan_render_object*> visibleObjects = (mCullingFrustum && !cullOnGpu) ? cull(renderObjects) : std::move(renderObjects);
+		if (visibleObjects.size() > mMaxDrawCount) {
+			throw std::runtime_error("too many render objects for the indirect drawer!");
+		}
+		const uint32_t drawCount = static_cast<uint32_t>(visibleObjects.size());
+
+		// the buffers of this frame are not in use anymore, like the frame's descriptor sets
+		const size_t frame = vulkan_context::instance().currentFrame;
+		indirect_draw_data* drawData = static_cast<indirect_draw_data*>(mDrawDataBuffers[frame]->get_mapped());
+		vk::DrawIndexedIndirectCommand* drawCommands = static_cast<vk::DrawIndexedIndirectCommand*>(mDrawCommandBuffers[frame]->get_mapped());
+		for (uint32_t i = 0; i < drawCount; i++) {
+			vulkan_render_object* renderObject = visibleObjects[i];
+			const UniformBufferObject& uniforms = renderObject->get_uniforms();
+			drawData[i].model = uniforms.model;
+			drawData[i].mvp = uniforms.mvp;
+			const aabb& bounds = renderObject->get_bounds();
+			if (bounds.empty()) {
+				drawData[i].boundsCenter = glm::vec4(0.0f);
+				drawData[i].boundsExtent = glm::vec4(0.0f);
+			}
+			else {
+				drawData[i].boundsCenter = glm::vec4(bounds.center(), 1.0f);
+				drawData[i].boundsExtent = glm::vec4(bounds.half_extent(), 1.0f);
+			}
+
+			const vulkan_mesh_range& meshRange = renderObject->get_mesh_range();
+			drawCommands[i] = vk::DrawIndexedIndirectCommand(meshRange.indexCount, 1, meshRange.firstIndex, meshRange.vertexOffset, i);
+		}
+
+		if (cullOnGpu && drawCount > 0) {
+			record_cull_pass(drawCount);
+		}
+		record_indirect_draws(drawCount, cullOnGpu);
+	}
+
+	void vulkan_indirect_drawer::record_cull_pass(uint32_t drawCount)
+	{
+		const size_t frame = vulkan_context::instance().currentFrame;
+		vk::Buffer culledCommands = mCulledCommandBuffers[frame]->get_vk_buffer();
+		vk::CommandBuffer commandBuffer = vulkan_context::instance().stagingRing->get_graphics_command_buffer();
+
+		// the draws of the buffer's previous frame have to be finished before the buffer is written again
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect, vk::PipelineStageFlagBits::eTransfer, {}, nullptr, nullptr, nullptr);
+		commandBuffer.fillBuffer(culledCommands, 0, sizeof(uint32_t), 0);
+
+		vk::BufferMemoryBarrier countBarrier = {};
+		countBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		countBarrier.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+		countBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		countBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		countBarrier.buffer = culledCommands;
+		countBarrier.offset = 0;
+		countBarrier.size = sizeof(uint32_t);
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, nullptr, countBarrier, nullptr);
+
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, mCullPipeline->get_pipeline());
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, mCullPipeline->get_pipeline_layout(), 0, 1, &mCullResourceBundle->get_descriptor_set(), 0, nullptr);
+
+		cull_push_constants pushConstants = {};
+		for (size_t i = 0; i < 6; i++) {
+			pushConstants.planes[i] = mCullingFrustum->planes()[i];
+		}
+		pushConstants.drawCount = drawCount;
+		pushConstants.compact = cgb::context().supports_draw_indirect_count() ? 1 : 0;
+		commandBuffer.pushConstants(mCullPipeline->get_pipeline_layout(), vk::ShaderStageFlagBits::eCompute, 0, sizeof(cull_push_constants), &pushConstants);
+
+		commandBuffer.dispatch((drawCount + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+		vk::BufferMemoryBarrier commandsBarrier = countBarrier;
+		commandsBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+		commandsBarrier.dstAccessMask = vk::AccessFlagBits::eIndirectCommandRead;
+		commandsBarrier.size = VK_WHOLE_SIZE;
+		commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eDrawIndirect, {}, nullptr, commandsBarrier, nullptr);
+	}
+
+	void vulkan_indirect_drawer::record_indirect_draws(uint32_t drawCount, bool culledOnGpu)
+	{
+		vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.renderPass = vulkan_context::instance().vulkanFramebuffer->get_render_pass();
+		inheritanceInfo.framebuffer = vulkan_context::instance().vulkanFramebuffer->get_swapchain_framebuffer();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+
+		vk::CommandBufferBeginInfo beginInfo = {};
+		beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		vk::CommandBuffer commandBuffer = mCommandBufferManager->get_command_buffer(vk::CommandBufferLevel::eSecondary, beginInfo);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline());
+
+		if (vulkan_context::instance().shadingRateImageSupported) {
+			commandBuffer.bindShadingRateImageNV(mVrsImages[vulkan_context::instance().currentFrame]->get_image_view(), vk::ImageLayout::eShadingRateOptimalNV, vulkan_context::instance().dynamicDispatchInstanceDevice);
+		}
+
+		// all objects share the pool's buffers and the resource bundle, so everything is bound once
+		vk::Buffer vertexBuffer = mGeometryPool->get_vertex_buffer()->get_vk_buffer();
+		vk::Buffer vertexBuffers[] = { vertexBuffer, vertexBuffer };
+		vk::DeviceSize offsets[] = { 0, 0 };
+		commandBuffer.bindVertexBuffers(1, 2, vertexBuffers, offsets);
+		commandBuffer.bindIndexBuffer(mGeometryPool->get_index_buffer()->get_vk_buffer(), 0, vk::IndexType::eUint32);
+		commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline_layout(), 0, 1, &mResourceBundle->get_descriptor_set(), 0, nullptr);
+		mBindCounters = { 4, 0 };
+
+		if (drawCount == 0) {
+			return;
+		}
+
+		const uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+		const size_t frame = vulkan_context::instance().currentFrame;
+		if (!culledOnGpu) {
+			commandBuffer.drawIndexedIndirect(mDrawCommandBuffers[frame]->get_vk_buffer(), 0, drawCount, stride);
+		}
+		else if (cgb::context().supports_draw_indirect_count()) {
+			vk::Buffer culledCommands = mCulledCommandBuffers[frame]->get_vk_buffer();
+			commandBuffer.drawIndexedIndirectCountKHR(culledCommands, CULLED_COMMANDS_OFFSET, culledCommands, 0, drawCount, stride, vulkan_context::instance().dynamicDispatchInstanceDevice);
+		}
+		else {
+			// the culled draw commands have an instance count of 0
+			commandBuffer.drawIndexedIndirect(mCulledCommandBuffers[frame]->get_vk_buffer(), CULLED_COMMANDS_OFFSET, drawCount, stride);
+		}
+	}
+
+}
@@ -0,0 +1,163 @@
+#include "vulkan_instanced_drawer.h"
+
+#include "vulkan_framebuffer.h"
+
+namespace cgb {
+
+	vulkan_instanced_drawer::vulkan_instanced_drawer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager, std::shared_ptr<vulkan_pipeline> pipeline, uint32_t instanceBinding) :
+		vulkan_drawer(commandBufferManager, pipeline), mInstanceBinding(instanceBinding)
+	{
+		mInstanceBuffers.resize(vulkan_context::instance().dynamicRessourceCount);
+		mInstanceCapacities.resize(vulkan_context::instance().dynamicRessourceCount, 0);
+	}
+
+	vulkan_instanced_drawer::~vulkan_instanced_drawer()
+	{
+	}
+
+	std::shared_ptr<vulkan_attribute_description_binding> vulkan_instanced_drawer::create_instance_binding(uint32_t binding, uint32_t firstLocation)
+	{
+		auto instanceBinding = std::make_shared<vulkan_attribute_description_binding>(binding, sizeof(instance_data), vk::VertexInputRate::eInstance);
+		for (uint32_t column = 0; column < 4; column++) {
+			instanceBinding->add_attribute_description(firstLocation + column, vk::Format::eR32G32B32A32Sfloat, offsetof(instance_data, model) + column * sizeof(glm::vec4));
+		}
+		instanceBinding->add_attribute_description(firstLocation + 4, vk::Format::eR32G32Uint, offsetof(instance_data, objectId));
+		return instanceBinding;
+	}
+
+	void vulkan_instanced_drawer::draw(std::vector<vulkan_render_object*> renderObjects)
+	{
+		std::vector<vulkan_render_object*> visibleObjects = mCullingFrustum ? cull(renderObjects) : std::move(renderObjects);
+
+		// objects which share their state are next to each other after sorting, each run is one group
+		mInstanceKeys.clear();
+		mInstanceKeys.reserve(visibleObjects.size());
+		for (uint32_t i = 0; i < visibleObjects.size(); i++) {
+			vulkan_render_object* renderObject = visibleObjects[i];
+			const vulkan_mesh_range& meshRange = renderObject->get_mesh_range();
+			mInstanceKeys.push_back({ renderObject->get_resource_bundle()->get_descriptor_set(), renderObject->get_vertex_buffer(0), renderObject->get_index_buffer(),
+				renderObject->get_index_type(), meshRange.firstIndex, meshRange.indexCount, meshRange.vertexOffset, i });
+		}
+		std::sort(mInstanceKeys.begin(), mInstanceKeys.end());
+
+		// the instance buffer of this frame is not in use anymore, like the frame's descriptor sets
+		const size_t frame = vulkan_context::instance().currentFrame;
+		reserve_instances(frame, mInstanceKeys.size());
+
+		vk::CommandBufferInheritanceInfo inheritanceInfo = {};
+		inheritanceInfo.renderPass = vulkan_context::instance().vulkanFramebuffer->get_render_pass();
+		inheritanceInfo.framebuffer = vulkan_context::instance().vulkanFramebuffer->get_swapchain_framebuffer();
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+
+		vk::CommandBufferBeginInfo beginInfo = {};
+		beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eSimultaneousUse;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		vk::CommandBuffer commandBuffer = mCommandBufferManager->get_command_buffer(vk::CommandBufferLevel::eSecondary, beginInfo);
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline());
+		mBindCounters = { 1, 0 };
+		mGroupCount = 0;
+
+		if (vulkan_context::instance().shadingRateImageSupported) {
+			commandBuffer.bindShadingRateImageNV(mVrsImages[vulkan_context::instance().currentFrame]->get_image_view(), vk::ImageLayout::eShadingRateOptimalNV, vulkan_context::instance().dynamicDispatchInstanceDevice);
+		}
+
+		if (mInstanceKeys.empty()) {
+			return;
+		}
+
+		vk::Buffer instanceBuffer = mInstanceBuffers[frame]->get_vk_buffer();
+		vk::DeviceSize instanceOffset = 0;
+		commandBuffer.bindVertexBuffers(mInstanceBinding, 1, &instanceBuffer, &instanceOffset);
+		mBindCounters.issued++;
+
+		instance_data* instances = static_cast<instance_data*>(mInstanceBuffers[frame]->get_mapped());
+		vk::Buffer boundVertexBuffer;
+		vk::Buffer boundIndexBuffer;
+		vk::IndexType boundIndexType = vk::IndexType::eUint32;
+		vk::DescriptorSet boundDescriptorSet;
+		uint32_t boundUniformOffset = 0;
+		PushUniforms boundPushUniforms;
+		bool pushUniformsBound = false;
+
+		size_t groupBegin = 0;
+		while (groupBegin < mInstanceKeys.size()) {
+			size_t groupEnd = groupBegin + 1;
+			while (groupEnd < mInstanceKeys.size() && mInstanceKeys[groupEnd].same_group(mInstanceKeys[groupBegin])) {
+				groupEnd++;
+			}
+
+			const uint32_t groupId = static_cast<uint32_t>(mGroupCount++);
+			for (size_t i = groupBegin; i < groupEnd; i++) {
+				const uint32_t objectIndex = mInstanceKeys[i].objectIndex;
+				instances[i].model = visibleObjects[objectIndex]->get_push_uniforms().model;
+				instances[i].objectId = objectIndex;
+				instances[i].groupId = groupId;
+			}
+
+			// the state of the group's first render object is used for all of its instances
+			const instance_key& key = mInstanceKeys[groupBegin];
+			vulkan_render_object* renderObject = visibleObjects[key.objectIndex];
+
+			if (key.vertexBuffer != boundVertexBuffer) {
+				vk::Buffer vertexBuffers[] = { key.vertexBuffer, key.vertexBuffer };
+				vk::DeviceSize offsets[] = { 0, 0 };
+				commandBuffer.bindVertexBuffers(1, 2, vertexBuffers, offsets);
+				boundVertexBuffer = key.vertexBuffer;
+				mBindCounters.issued++;
+			}
+			else {
+				mBindCounters.skipped++;
+			}
+
+			if (key.indexBuffer != boundIndexBuffer || key.indexType != boundIndexType) {
+				commandBuffer.bindIndexBuffer(key.indexBuffer, 0, key.indexType);
+				boundIndexBuffer = key.indexBuffer;
+				boundIndexType = key.indexType;
+				mBindCounters.issued++;
+			}
+			else {
+				mBindCounters.skipped++;
+			}
+
+			const uint32_t uniformOffset = renderObject->get_uniform_offset();
+			if (key.descriptorSet != boundDescriptorSet || uniformOffset != boundUniformOffset) {
+				commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, mPipeline->get_pipeline_layout(), 0, 1, &key.descriptorSet, 1, &uniformOffset);
+				boundDescriptorSet = key.descriptorSet;
+				boundUniformOffset = uniformOffset;
+				mBindCounters.issued++;
+			}
+			else {
+				mBindCounters.skipped++;
+			}
+
+			PushUniforms pushUniforms = renderObject->get_push_uniforms();
+			if (!pushUniformsBound || memcmp(&pushUniforms, &boundPushUniforms, sizeof(PushUniforms)) != 0) {
+				commandBuffer.pushConstants(mPipeline->get_pipeline_layout(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushUniforms), &pushUniforms);
+				boundPushUniforms = pushUniforms;
+				pushUniformsBound = true;
+				mBindCounters.issued++;
+			}
+			else {
+				mBindCounters.skipped++;
+			}
+
+			commandBuffer.drawIndexed(key.indexCount, static_cast<uint32_t>(groupEnd - groupBegin), key.firstIndex, key.vertexOffset, static_cast<uint32_t>(groupBegin));
+			groupBegin = groupEnd;
+		}
+	}
+
+	void vulkan_instanced_drawer::reserve_instances(size_t frame, size_t instanceCount)
+	{
+		if (instanceCount <= mInstanceCapacities[frame] && mInstanceBuffers[frame]) {
+			return;
+		}
+		// grow geometrically, so that slowly growing scenes do not create a buffer every frame
+		const size_t capacity = std::max<size_t>({ instanceCount, mInstanceCapacities[frame] * 2, 1024 });
+		mInstanceBuffers[frame] = std::make_shared<vulkan_buffer>(sizeof(instance_data) * capacity, vk::BufferUsageFlagBits::eVertexBuffer,
+			vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+		mInstanceCapacities[frame] = capacity;
+	}
+
+}
@@ -1,7 +1,11 @@
 #include "vulkan_memory_manager.h"
 
+#include <algorithm>
 #include <stdexcept>
 
+#include "vulkan_staging_ring.h"
+#include "vulkan_frame_allocator.h"
+
 namespace cgb {
 
 	vulkan_memory_manager::vulkan_memory_manager()
@@ -13,34 +17,88 @@ namespace cgb {
 	{
 	}
 
-	void vulkan_memory_manager::allocate_memory(vk::MemoryRequirements memRequirements, vk::MemoryPropertyFlags properties, vulkan_memory &cgbMemory)
+	void vulkan_memory_manager::allocate_memory(vk::MemoryRequirements memRequirements, vk::MemoryPropertyFlags properties, vulkan_memory &cgbMemory, device_resource_kind kind)
 	{
-		vk::MemoryAllocateInfo allocInfo = {};
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = find_memory_type(memRequirements.memoryTypeBits, properties);
-
-		if (vulkan_context::instance().device.allocateMemory(&allocInfo, nullptr, &cgbMemory.memory) != vk::Result::eSuccess) {
-			throw std::runtime_error("failed to allocate buffer memory!");
-		}
+		// vulkan_context shares its device with cgb::context(), whose allocator sub-allocates from large blocks
+		assign_allocation(cgb::context().allocate_memory(memRequirements, properties, kind), cgbMemory);
+	}
 
+	void vulkan_memory_manager::free_memory(vulkan_memory &cgbMemory)
+	{
+		cgb::context().memory_allocator().free(cgbMemory.allocation);
+		cgbMemory.memory = nullptr;
 		cgbMemory.offset = 0;
+		cgbMemory.mapped = nullptr;
 	}
 
-	uint32_t vulkan_memory_manager::find_memory_type(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
-		vk::PhysicalDeviceMemoryProperties memProperties;
-		vulkan_context::instance().physicalDevice.getMemoryProperties(&memProperties);
+	void vulkan_memory_manager::set_movable(vulkan_movable_resource* resource, const vulkan_memory& cgbMemory, vk::DeviceSize alignment, bool movable)
+	{
+		// the owner is a vulkan_movable_resource*, since defragment() casts it back from void*
+		cgb::context().memory_allocator().set_owner(cgbMemory.allocation, movable ? resource : nullptr, alignment);
+
+		// finishing a pending move registers the resource for its destination
+		auto move = std::find_if(mPendingMoves.begin(), mPendingMoves.end(), [resource](const device_defragmentation_move& m) { return m.mOwner == resource; });
+		auto unmovable = std::find(mUnmovableAfterMove.begin(), mUnmovableAfterMove.end(), resource);
+		if (move != mPendingMoves.end() && !movable && unmovable == mUnmovableAfterMove.end()) {
+			mUnmovableAfterMove.push_back(resource);
+		}
+		else if (movable && unmovable != mUnmovableAfterMove.end()) {
+			mUnmovableAfterMove.erase(unmovable);
+		}
+	}
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
+	void vulkan_memory_manager::defragment(vk::DeviceSize maxBytes)
+	{
+		auto& allocator = cgb::context().memory_allocator();
+		auto& context = vulkan_context::instance();
+
+		if (!mPendingMoves.empty()) {
+			// frames which have been recorded before the moves might still use the old buffers
+			if (context.frameAllocator->get_frame_serial() < mPendingFrameSerial + MAX_FRAMES_IN_FLIGHT || !context.stagingRing->is_complete(mPendingTicket)) {
+				return;
+			}
+			for (auto& move : mPendingMoves) {
+				static_cast<vulkan_movable_resource*>(move.mOwner)->finish_move();
+				if (std::find(mUnmovableAfterMove.begin(), mUnmovableAfterMove.end(), move.mOwner) != mUnmovableAfterMove.end()) {
+					move.mOwner = nullptr;
+				}
 			}
+			mUnmovableAfterMove.clear();
+			allocator.finish_defragmentation(mPendingMoves);
+			allocator.release_empty_blocks();
+		}
+
+		mPendingMoves = allocator.plan_defragmentation(maxBytes);
+		if (mPendingMoves.empty()) {
+			return;
 		}
+		vk::CommandBuffer commandBuffer = context.stagingRing->get_graphics_command_buffer();
+		for (auto& move : mPendingMoves) {
+			vulkan_memory newMemory;
+			assign_allocation(move.mDestination, newMemory);
+			static_cast<vulkan_movable_resource*>(move.mOwner)->begin_move(commandBuffer, newMemory);
+		}
+		mPendingTicket = context.stagingRing->get_current_ticket();
+		mPendingFrameSerial = context.frameAllocator->get_frame_serial();
+	}
 
-		throw std::runtime_error("failed to find suitable memory type!");
+	void vulkan_memory_manager::cancel_move(vulkan_movable_resource* resource)
+	{
+		auto move = std::find_if(mPendingMoves.begin(), mPendingMoves.end(), [resource](const device_defragmentation_move& m) { return m.mOwner == resource; });
+		if (move == mPendingMoves.end()) {
+			return;
+		}
+		mUnmovableAfterMove.erase(std::remove(mUnmovableAfterMove.begin(), mUnmovableAfterMove.end(), resource), mUnmovableAfterMove.end());
+		// the resource frees its new memory itself
+		cgb::context().memory_allocator().free(move->mSource);
+		mPendingMoves.erase(move);
 	}
 
-	void vulkan_memory_manager::free_memory(vulkan_memory &cgbMemory)
+	void vulkan_memory_manager::assign_allocation(const device_allocation& allocation, vulkan_memory &cgbMemory)
 	{
-		vkFreeMemory(vulkan_context::instance().device, cgbMemory.memory, nullptr);
+		cgbMemory.allocation = allocation;
+		cgbMemory.memory = to_device_memory(allocation.mMemory);
+		cgbMemory.offset = allocation.mOffset;
+		cgbMemory.mapped = allocation.mMapped;
 	}
 }
\ No newline at end of file
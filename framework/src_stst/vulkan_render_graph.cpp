@@ -0,0 +1,582 @@
+#include "vulkan_render_graph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vulkan_memory_manager.h"
+
+namespace cgb {
+
+	vulkan_render_graph::vulkan_render_graph()
+	{
+	}
+
+	vulkan_render_graph::~vulkan_render_graph()
+	{
+		destroy_transient_images();
+	}
+
+	vulkan_render_graph::resource_id vulkan_render_graph::create_image(const std::string& name, const image_desc& desc)
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to add a resource, the render graph has been compiled already!");
+		}
+		resource newResource;
+		newResource.name = name;
+		newResource.transient = true;
+		newResource.desc = desc;
+		mResources.push_back(newResource);
+		return static_cast<resource_id>(mResources.size() - 1);
+	}
+
+	vulkan_render_graph::resource_id vulkan_render_graph::import_image(const std::string& name, std::shared_ptr<vulkan_image> image, vk::ImageLayout initialLayout, vk::ImageLayout finalLayout)
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to add a resource, the render graph has been compiled already!");
+		}
+		resource newResource;
+		newResource.name = name;
+		newResource.transient = false;
+		newResource.image = image;
+		newResource.initialLayout = initialLayout;
+		newResource.finalLayout = finalLayout;
+		mResources.push_back(newResource);
+		return static_cast<resource_id>(mResources.size() - 1);
+	}
+
+	vulkan_render_graph::resource_id vulkan_render_graph::import_buffer(const std::string& name, std::shared_ptr<vulkan_buffer> buffer)
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to add a resource, the render graph has been compiled already!");
+		}
+		resource newResource;
+		newResource.name = name;
+		newResource.transient = false;
+		newResource.buffer = buffer;
+		mResources.push_back(newResource);
+		return static_cast<resource_id>(mResources.size() - 1);
+	}
+
+	vulkan_render_graph::pass_id vulkan_render_graph::add_pass(const std::string& name, record_function record)
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to add a pass, the render graph has been compiled already!");
+		}
+		pass newPass;
+		newPass.name = name;
+		newPass.record = record;
+		mPasses.push_back(newPass);
+		return static_cast<pass_id>(mPasses.size() - 1);
+	}
+
+	void vulkan_render_graph::use(pass_id passId, resource_id resourceId, resource_usage usage)
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to add a resource usage, the render graph has been compiled already!");
+		}
+		if (passId >= mPasses.size() || resourceId >= mResources.size()) {
+			throw std::runtime_error("failed to add a resource usage, unknown pass or resource!");
+		}
+
+		// storage and transfer usages apply to both
+		const bool isBufferUsage = usage == resource_usage::vertex_buffer || usage == resource_usage::index_buffer
+			|| usage == resource_usage::indirect_buffer || usage == resource_usage::uniform_buffer;
+		const bool isImageUsage = usage == resource_usage::color_attachment || usage == resource_usage::depth_stencil_attachment
+			|| usage == resource_usage::depth_stencil_read || usage == resource_usage::shader_read || usage == resource_usage::shading_rate_image;
+		if (mResources[resourceId].buffer && isImageUsage) {
+			throw std::runtime_error("failed to add a resource usage, " + mResources[resourceId].name + " is a buffer!");
+		}
+		if (!mResources[resourceId].buffer && isBufferUsage) {
+			throw std::runtime_error("failed to add a resource usage, " + mResources[resourceId].name + " is an image!");
+		}
+		// all barriers of a pass are recorded at once, so an image can only be in one layout during the pass
+		for (const resource_access& access : mPasses[passId].accesses) {
+			if (access.resource == resourceId && !mResources[resourceId].buffer && get_usage_info(access.usage).layout != get_usage_info(usage).layout) {
+				throw std::runtime_error("failed to add a resource usage, " + mPasses[passId].name + " uses " + mResources[resourceId].name + " in two layouts!");
+			}
+		}
+
+		mPasses[passId].accesses.push_back({ resourceId, usage });
+	}
+
+	void vulkan_render_graph::set_side_effects(pass_id passId)
+	{
+		mPasses[passId].sideEffects = true;
+	}
+
+	void vulkan_render_graph::compile()
+	{
+		if (mCompiled) {
+			throw std::runtime_error("failed to compile the render graph, it has been compiled already!");
+		}
+
+		cull_passes();
+
+		mSchedule.clear();
+		for (pass_id passId = 0; passId < mPasses.size(); passId++) {
+			if (!mPasses[passId].culled) {
+				mSchedule.push_back(passId);
+			}
+		}
+
+		// lifetimes of the resources in the schedule
+		for (uint32_t i = 0; i < mSchedule.size(); i++) {
+			for (const resource_access& access : mPasses[mSchedule[i]].accesses) {
+				resource& res = mResources[access.resource];
+				if (res.firstUse == UINT32_MAX) {
+					res.firstUse = i;
+				}
+				res.lastUse = i;
+			}
+		}
+		for (uint32_t i = 0; i < mSchedule.size(); i++) {
+			const pass& schedulePass = mPasses[mSchedule[i]];
+			for (const resource_access& access : schedulePass.accesses) {
+				const resource& res = mResources[access.resource];
+				const bool writtenByPass = std::any_of(schedulePass.accesses.begin(), schedulePass.accesses.end(), [&](const resource_access& other) {
+					return other.resource == access.resource && get_usage_info(other.usage).write;
+				});
+				if (res.transient && res.firstUse == i && !writtenByPass) {
+					throw std::runtime_error("failed to compile the render graph, " + schedulePass.name + " reads " + res.name + " before it is written!");
+				}
+			}
+		}
+
+		create_transient_images();
+
+		// the first run finds out in which state the schedule leaves the memory of the transient images, which is the state
+		// the next frame finds it in; the second run computes the barriers with it
+		for (memory_slot& slot : mMemorySlots) {
+			slot.lastStages = vk::PipelineStageFlags();
+			slot.lastWriteAccess = vk::AccessFlags();
+		}
+		build_barriers();
+		build_barriers();
+
+		mCompiled = true;
+	}
+
+	void vulkan_render_graph::execute(vk::CommandBuffer commandBuffer)
+	{
+		if (!mCompiled) {
+			throw std::runtime_error("failed to execute the render graph, it has not been compiled!");
+		}
+
+		for (pass_id passId : mSchedule) {
+			pass& schedulePass = mPasses[passId];
+			if (!schedulePass.imageBarriers.empty() || !schedulePass.bufferBarriers.empty()) {
+				update_buffer_handles(schedulePass.bufferBarriers, schedulePass.bufferBarrierResources);
+				commandBuffer.pipelineBarrier(schedulePass.srcStages, schedulePass.dstStages, {},
+					0, nullptr,
+					static_cast<uint32_t>(schedulePass.bufferBarriers.size()), schedulePass.bufferBarriers.data(),
+					static_cast<uint32_t>(schedulePass.imageBarriers.size()), schedulePass.imageBarriers.data());
+			}
+			schedulePass.record(commandBuffer);
+		}
+
+		if (!mFinalImageBarriers.empty() || !mFinalBufferBarriers.empty()) {
+			update_buffer_handles(mFinalBufferBarriers, mFinalBufferBarrierResources);
+			commandBuffer.pipelineBarrier(mFinalSrcStages, mFinalDstStages, {},
+				0, nullptr,
+				static_cast<uint32_t>(mFinalBufferBarriers.size()), mFinalBufferBarriers.data(),
+				static_cast<uint32_t>(mFinalImageBarriers.size()), mFinalImageBarriers.data());
+		}
+	}
+
+	void vulkan_render_graph::clear()
+	{
+		destroy_transient_images();
+		mPasses.clear();
+		mResources.clear();
+		mSchedule.clear();
+		mFinalImageBarriers.clear();
+		mFinalBufferBarriers.clear();
+		mFinalBufferBarrierResources.clear();
+		mBarrierBatchCount = 0;
+		mBarrierCount = 0;
+		mTransientMemorySize = 0;
+		mUnaliasedMemorySize = 0;
+		mCompiled = false;
+	}
+
+	std::shared_ptr<vulkan_image> vulkan_render_graph::get_image(resource_id resourceId)
+	{
+		return mResources[resourceId].image;
+	}
+
+	std::shared_ptr<vulkan_buffer> vulkan_render_graph::get_buffer(resource_id resourceId)
+	{
+		return mResources[resourceId].buffer;
+	}
+
+	vk::ImageLayout vulkan_render_graph::get_layout(resource_usage usage)
+	{
+		return get_usage_info(usage).layout;
+	}
+
+	bool vulkan_render_graph::is_culled(pass_id passId)
+	{
+		return mPasses[passId].culled;
+	}
+
+	vulkan_render_graph::usage_info vulkan_render_graph::get_usage_info(resource_usage usage)
+	{
+		const vk::PipelineStageFlags shaderStages = vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+		const vk::PipelineStageFlags depthStages = vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+
+		switch (usage) {
+		case resource_usage::color_attachment:
+			return { vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+				vk::ImageLayout::eColorAttachmentOptimal, true, vk::ImageUsageFlagBits::eColorAttachment };
+		case resource_usage::depth_stencil_attachment:
+			return { depthStages, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+				vk::ImageLayout::eDepthStencilAttachmentOptimal, true, vk::ImageUsageFlagBits::eDepthStencilAttachment };
+		case resource_usage::depth_stencil_read:
+			return { depthStages, vk::AccessFlagBits::eDepthStencilAttachmentRead,
+				vk::ImageLayout::eDepthStencilReadOnlyOptimal, false, vk::ImageUsageFlagBits::eDepthStencilAttachment };
+		case resource_usage::shader_read:
+			return { shaderStages, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eShaderReadOnlyOptimal, false, vk::ImageUsageFlagBits::eSampled };
+		case resource_usage::storage_read:
+			return { shaderStages, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral, false, vk::ImageUsageFlagBits::eStorage };
+		case resource_usage::storage_write:
+			return { shaderStages, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eGeneral, true, vk::ImageUsageFlagBits::eStorage };
+		case resource_usage::transfer_src:
+			return { vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferSrcOptimal, false, vk::ImageUsageFlagBits::eTransferSrc };
+		case resource_usage::transfer_dst:
+			return { vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eTransferDstOptimal, true, vk::ImageUsageFlagBits::eTransferDst };
+		case resource_usage::shading_rate_image:
+			return { vk::PipelineStageFlagBits::eShadingRateImageNV, vk::AccessFlagBits::eShadingRateImageReadNV,
+				vk::ImageLayout::eShadingRateOptimalNV, false, vk::ImageUsageFlagBits::eShadingRateImageNV };
+		case resource_usage::vertex_buffer:
+			return { vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eVertexAttributeRead, vk::ImageLayout::eUndefined, false, {} };
+		case resource_usage::index_buffer:
+			return { vk::PipelineStageFlagBits::eVertexInput, vk::AccessFlagBits::eIndexRead, vk::ImageLayout::eUndefined, false, {} };
+		case resource_usage::indirect_buffer:
+			return { vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eIndirectCommandRead, vk::ImageLayout::eUndefined, false, {} };
+		case resource_usage::uniform_buffer:
+			return { shaderStages, vk::AccessFlagBits::eUniformRead, vk::ImageLayout::eUndefined, false, {} };
+		}
+		throw std::invalid_argument("unsupported resource usage!");
+	}
+
+	vk::ImageAspectFlags vulkan_render_graph::get_aspects(vk::Format format)
+	{
+		switch (format) {
+		case vk::Format::eD16Unorm:
+		case vk::Format::eX8D24UnormPack32:
+		case vk::Format::eD32Sfloat:
+			return vk::ImageAspectFlagBits::eDepth;
+		case vk::Format::eD16UnormS8Uint:
+		case vk::Format::eD24UnormS8Uint:
+		case vk::Format::eD32SfloatS8Uint:
+			return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+		case vk::Format::eS8Uint:
+			return vk::ImageAspectFlagBits::eStencil;
+		default:
+			return vk::ImageAspectFlagBits::eColor;
+		}
+	}
+
+	void vulkan_render_graph::cull_passes()
+	{
+		// a pass is needed if it has side effects or writes a resource which is needed afterwards; imported resources are always needed,
+		// transient ones only if a later pass which is needed uses them in any way, since attachments, storage writes and even
+		// transfers of parts of an image keep the contents which they do not overwrite
+		// walking the passes backwards sees every use of a resource before the passes which write it for that use
+		std::vector<bool> needed(mResources.size());
+		for (resource_id resourceId = 0; resourceId < mResources.size(); resourceId++) {
+			needed[resourceId] = !mResources[resourceId].transient;
+		}
+
+		for (pass_id passId = static_cast<pass_id>(mPasses.size()); passId-- > 0;) {
+			pass& candidate = mPasses[passId];
+			const bool writesNeeded = std::any_of(candidate.accesses.begin(), candidate.accesses.end(), [&](const resource_access& access) {
+				return get_usage_info(access.usage).write && needed[access.resource];
+			});
+			candidate.culled = !candidate.sideEffects && !writesNeeded;
+			if (candidate.culled) {
+				continue;
+			}
+			for (const resource_access& access : candidate.accesses) {
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	void vulkan_render_graph::create_transient_images()
+	{
+		std::vector<resource_id> transientImages;
+		for (resource_id resourceId = 0; resourceId < mResources.size(); resourceId++) {
+			resource& res = mResources[resourceId];
+			if (!res.transient || res.firstUse == UINT32_MAX) {
+				continue;
+			}
+
+			vk::ImageUsageFlags usage;
+			for (pass_id passId : mSchedule) {
+				for (const resource_access& access : mPasses[passId].accesses) {
+					if (access.resource == resourceId) {
+						usage |= get_usage_info(access.usage).imageUsage;
+					}
+				}
+			}
+			// views of depth stencil images can only be sampled with one aspect
+			vk::ImageAspectFlags viewAspects = get_aspects(res.desc.format);
+			if (viewAspects & vk::ImageAspectFlagBits::eDepth) {
+				viewAspects = vk::ImageAspectFlagBits::eDepth;
+			}
+			res.image = std::make_shared<vulkan_image>(res.desc.width, res.desc.height, res.desc.samples, res.desc.format, usage, viewAspects);
+			transientImages.push_back(resourceId);
+		}
+
+		std::vector<vk::MemoryRequirements> requirements(mResources.size());
+		for (resource_id resourceId : transientImages) {
+			requirements[resourceId] = mResources[resourceId].image->get_memory_requirements();
+			mUnaliasedMemorySize += requirements[resourceId].size;
+		}
+
+		// place the largest images first, each into the first slot whose images are not used at the same time
+		std::stable_sort(transientImages.begin(), transientImages.end(), [&](resource_id a, resource_id b) {
+			return requirements[a].size > requirements[b].size;
+		});
+		for (resource_id resourceId : transientImages) {
+			resource& res = mResources[resourceId];
+			const vk::MemoryRequirements& imageRequirements = requirements[resourceId];
+
+			uint32_t slotIndex = 0;
+			for (; slotIndex < mMemorySlots.size(); slotIndex++) {
+				const memory_slot& slot = mMemorySlots[slotIndex];
+				const bool overlaps = std::any_of(slot.lifetimes.begin(), slot.lifetimes.end(), [&](const std::pair<uint32_t, uint32_t>& lifetime) {
+					return lifetime.first <= res.lastUse && res.firstUse <= lifetime.second;
+				});
+				if (!overlaps && (slot.requirements.memoryTypeBits & imageRequirements.memoryTypeBits)) {
+					break;
+				}
+			}
+
+			if (slotIndex == mMemorySlots.size()) {
+				memory_slot slot;
+				slot.requirements = imageRequirements;
+				mMemorySlots.push_back(slot);
+			}
+			else {
+				vk::MemoryRequirements& slotRequirements = mMemorySlots[slotIndex].requirements;
+				slotRequirements.size = std::max(slotRequirements.size, imageRequirements.size);
+				slotRequirements.alignment = std::max(slotRequirements.alignment, imageRequirements.alignment);
+				slotRequirements.memoryTypeBits &= imageRequirements.memoryTypeBits;
+			}
+			mMemorySlots[slotIndex].lifetimes.push_back({ res.firstUse, res.lastUse });
+			res.memorySlot = slotIndex;
+		}
+
+		for (memory_slot& slot : mMemorySlots) {
+			vulkan_context::instance().memoryManager->allocate_memory(slot.requirements, vk::MemoryPropertyFlagBits::eDeviceLocal, slot.memory, device_resource_kind::optimal);
+			mTransientMemorySize += slot.requirements.size;
+		}
+		for (resource_id resourceId : transientImages) {
+			const memory_slot& slot = mMemorySlots[mResources[resourceId].memorySlot];
+			mResources[resourceId].image->bind_memory(slot.memory.memory, slot.memory.offset);
+		}
+	}
+
+	void vulkan_render_graph::build_barriers()
+	{
+		for (resource& res : mResources) {
+			res.state = resource_state();
+			if (!res.transient) {
+				// imported resources might have been written by anything before the graph
+				res.state.layout = res.initialLayout;
+				res.state.writeStages = vk::PipelineStageFlagBits::eAllCommands;
+				res.state.writeAccess = vk::AccessFlagBits::eMemoryWrite;
+			}
+		}
+		mBarrierBatchCount = 0;
+		mBarrierCount = 0;
+
+		for (uint32_t i = 0; i < mSchedule.size(); i++) {
+			pass& schedulePass = mPasses[mSchedule[i]];
+			schedulePass.srcStages = vk::PipelineStageFlags();
+			schedulePass.dstStages = vk::PipelineStageFlags();
+			schedulePass.imageBarriers.clear();
+			schedulePass.bufferBarriers.clear();
+			schedulePass.bufferBarrierResources.clear();
+
+			// all usages of a resource within the pass need one barrier
+			std::vector<std::pair<resource_id, usage_info>> passUsages;
+			for (const resource_access& access : schedulePass.accesses) {
+				const usage_info info = get_usage_info(access.usage);
+				auto existing = std::find_if(passUsages.begin(), passUsages.end(), [&](const std::pair<resource_id, usage_info>& passUsage) {
+					return passUsage.first == access.resource;
+				});
+				if (existing == passUsages.end()) {
+					passUsages.push_back({ access.resource, info });
+				}
+				else {
+					existing->second.stages |= info.stages;
+					existing->second.access |= info.access;
+					existing->second.write = existing->second.write || info.write;
+				}
+			}
+
+			for (const std::pair<resource_id, usage_info>& passUsage : passUsages) {
+				resource& res = mResources[passUsage.first];
+				if (res.transient && res.firstUse == i) {
+					// the memory was used by the previous image in the slot, or by the last image in the slot in the previous frame
+					const memory_slot& slot = mMemorySlots[res.memorySlot];
+					res.state.writeStages = slot.lastStages;
+					res.state.writeAccess = slot.lastWriteAccess;
+				}
+
+				add_barrier(schedulePass, passUsage.first, passUsage.second);
+
+				if (res.transient) {
+					memory_slot& slot = mMemorySlots[res.memorySlot];
+					slot.lastStages = res.state.writeStages | res.state.readStages;
+					slot.lastWriteAccess = res.state.writeAccess;
+				}
+			}
+
+			if (!schedulePass.imageBarriers.empty() || !schedulePass.bufferBarriers.empty()) {
+				mBarrierBatchCount++;
+				mBarrierCount += schedulePass.imageBarriers.size() + schedulePass.bufferBarriers.size();
+			}
+		}
+
+		// make the writes of the graph visible to whatever uses the imported resources afterwards
+		mFinalSrcStages = vk::PipelineStageFlags();
+		mFinalDstStages = vk::PipelineStageFlags();
+		mFinalImageBarriers.clear();
+		mFinalBufferBarriers.clear();
+		mFinalBufferBarrierResources.clear();
+		for (resource_id resourceId = 0; resourceId < mResources.size(); resourceId++) {
+			resource& res = mResources[resourceId];
+			if (res.transient || res.firstUse == UINT32_MAX) {
+				continue;
+			}
+
+			const vk::ImageLayout finalLayout = res.finalLayout != vk::ImageLayout::eUndefined ? res.finalLayout : res.state.layout;
+			const bool layoutChange = res.image && finalLayout != res.state.layout;
+			if (!layoutChange && !res.state.writeAccess) {
+				continue;
+			}
+
+			vk::PipelineStageFlags srcStages = layoutChange ? res.state.writeStages | res.state.readStages : res.state.writeStages;
+			mFinalSrcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+			mFinalDstStages |= vk::PipelineStageFlagBits::eAllCommands;
+			if (res.image) {
+				vk::ImageMemoryBarrier barrier = {};
+				barrier.srcAccessMask = res.state.writeAccess;
+				barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+				barrier.oldLayout = res.state.layout;
+				barrier.newLayout = finalLayout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = res.image->get_image();
+				barrier.subresourceRange = { get_aspects(res.image->get_format()), 0, res.image->get_mip_levels(), 0, 1 };
+				mFinalImageBarriers.push_back(barrier);
+			}
+			else {
+				vk::BufferMemoryBarrier barrier = {};
+				barrier.srcAccessMask = res.state.writeAccess;
+				barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				mFinalBufferBarriers.push_back(barrier);
+				mFinalBufferBarrierResources.push_back(resourceId);
+			}
+		}
+		if (!mFinalImageBarriers.empty() || !mFinalBufferBarriers.empty()) {
+			mBarrierBatchCount++;
+			mBarrierCount += mFinalImageBarriers.size() + mFinalBufferBarriers.size();
+		}
+	}
+
+	void vulkan_render_graph::add_barrier(pass& schedulePass, resource_id resourceId, const usage_info& info)
+	{
+		resource& res = mResources[resourceId];
+		resource_state& state = res.state;
+		const bool layoutChange = res.image && state.layout != info.layout;
+
+		vk::PipelineStageFlags srcStages;
+		vk::AccessFlags srcAccess;
+		if (info.write || layoutChange) {
+			// writes and layout transitions wait for all previous reads and writes
+			srcStages = state.writeStages | state.readStages;
+			srcAccess = state.writeAccess;
+		}
+		else if (state.writeStages && ((info.stages & ~state.visibleStages) || (info.access & ~state.visibleAccess))) {
+			// reads wait for the last write unless it has been made visible to them already
+			srcStages = state.writeStages;
+			srcAccess = state.writeAccess;
+		}
+
+		if (layoutChange || srcStages) {
+			schedulePass.srcStages |= srcStages ? srcStages : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+			schedulePass.dstStages |= info.stages;
+			if (res.image) {
+				vk::ImageMemoryBarrier barrier = {};
+				barrier.srcAccessMask = srcAccess;
+				barrier.dstAccessMask = info.access;
+				// eUndefined discards the contents, e.g. those of the previous image in the memory of a transient image
+				barrier.oldLayout = state.layout;
+				barrier.newLayout = info.layout;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = res.image->get_image();
+				barrier.subresourceRange = { get_aspects(res.image->get_format()), 0, res.image->get_mip_levels(), 0, 1 };
+				schedulePass.imageBarriers.push_back(barrier);
+			}
+			else {
+				vk::BufferMemoryBarrier barrier = {};
+				barrier.srcAccessMask = srcAccess;
+				barrier.dstAccessMask = info.access;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.offset = 0;
+				barrier.size = VK_WHOLE_SIZE;
+				schedulePass.bufferBarriers.push_back(barrier);
+				schedulePass.bufferBarrierResources.push_back(resourceId);
+			}
+		}
+
+		if (info.write || layoutChange) {
+			state.layout = res.image ? info.layout : state.layout;
+			// a layout transition is a write which the barrier has made visible to this pass
+			state.writeStages = info.stages;
+			state.writeAccess = info.write ? info.access : vk::AccessFlags();
+			state.visibleStages = info.write ? vk::PipelineStageFlags() : info.stages;
+			state.visibleAccess = info.write ? vk::AccessFlags() : info.access;
+			state.readStages = info.write ? vk::PipelineStageFlags() : info.stages;
+		}
+		else {
+			if (srcStages) {
+				state.visibleStages |= info.stages;
+				state.visibleAccess |= info.access;
+			}
+			state.readStages |= info.stages;
+		}
+	}
+
+	void vulkan_render_graph::update_buffer_handles(std::vector<vk::BufferMemoryBarrier>& barriers, const std::vector<resource_id>& resources)
+	{
+		for (size_t i = 0; i < barriers.size(); i++) {
+			barriers[i].buffer = mResources[resources[i]].buffer->get_vk_buffer();
+		}
+	}
+
+	void vulkan_render_graph::destroy_transient_images()
+	{
+		for (resource& res : mResources) {
+			if (res.transient) {
+				res.image.reset();
+			}
+		}
+		for (memory_slot& slot : mMemorySlots) {
+			vulkan_context::instance().memoryManager->free_memory(slot.memory);
+		}
+		mMemorySlots.clear();
+	}
+
+}
@@ -1,9 +1,12 @@
 #include "vulkan_render_object.h"
 
+#include "vulkan_frame_allocator.h"
+
 namespace cgb {
 
-	vulkan_render_object::vulkan_render_object(std::vector<std::shared_ptr<vulkan_buffer>> vertexBuffers, std::shared_ptr<vulkan_buffer> indexBuffer, size_t indexCount) :
-	mVertexBuffers(vertexBuffers), mIndexBuffer(indexBuffer), mIndexCount(indexCount) {
+	vulkan_render_object::vulkan_render_object(std::vector<std::shared_ptr<vulkan_buffer>> vertexBuffers, std::shared_ptr<vulkan_buffer> indexBuffer, size_t indexCount, vk::IndexType indexType) :
+	mVertexBuffers(vertexBuffers), mIndexBuffer(indexBuffer), mIndexCount(indexCount), mIndexType(indexType) {
+		mMeshRange.indexCount = static_cast<uint32_t>(mIndexCount);
 
 	}
 
@@ -15,32 +18,43 @@ namespace cgb {
 		auto vertexBuffer = std::make_shared<vulkan_buffer>(sizeof(mVertices[0]) * mVertices.size(), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, mVertices.data());
 		mVertexBuffers.push_back(vertexBuffer);
 
-		mIndexBuffer = std::make_shared<vulkan_buffer>(sizeof(mIndices[0]) * mIndices.size(), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, mIndices.data());
+		// use 16-bit indices whenever all indices fit, this halves the index buffer's memory and bandwidth
+		const size_t indexSize = smallest_index_size(mIndices);
+		mIndexType = index_type_for_size(indexSize);
+		auto indexData = pack_indices(mIndices, indexSize);
+		mIndexBuffer = std::make_shared<vulkan_buffer>(indexData.size(), vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal, indexData.data());
+
 
+		mMeshRange.indexCount = static_cast<uint32_t>(mIndexCount);
 
-		create_uniform_buffer(commandBufferManager);
 		create_descriptor_sets(resourceBundleLayout, resourceBundleGroup, texture, debugTextures);
 	}
 
-
-	vulkan_render_object::~vulkan_render_object()
+	vulkan_render_object::vulkan_render_object(std::shared_ptr<vulkan_geometry_pool> geometryPool, std::vector<Vertex> vertices, std::vector<uint32_t> indices)
+		: mImageCount(0), mVertices(vertices), mIndices(indices), mIndexCount(indices.size()), mIndexType(vk::IndexType::eUint32)
 	{
+		mMeshRange = geometryPool->add_mesh(mVertices.data(), static_cast<uint32_t>(mVertices.size()), mIndices);
+		mVertexBuffers.push_back(geometryPool->get_vertex_buffer());
+		mIndexBuffer = geometryPool->get_index_buffer();
 	}
 
-	void vulkan_render_object::create_uniform_buffer(std::shared_ptr<vulkan_command_buffer_manager> commandBufferManager) {
-		vk::DeviceSize bufferSize = sizeof(UniformBufferObject);
+	vulkan_render_object::vulkan_render_object(const vulkan_render_object& prototype, const UniformBufferObject& ubo)
+		: mImageCount(prototype.mImageCount), mVertexBuffers(prototype.mVertexBuffers), mIndexBuffer(prototype.mIndexBuffer), mIndexCount(prototype.mIndexCount),
+		mIndexType(prototype.mIndexType), mMeshRange(prototype.mMeshRange), mBounds(prototype.mBounds), mResourceBundle(prototype.mResourceBundle)
+	{
+		update_uniform_buffer(0, ubo);
+	}
 
-		mUniformBuffers.resize(mImageCount);
 
-		for (size_t i = 0; i < mImageCount; i++) {
-			mUniformBuffers[i] = std::make_shared<vulkan_buffer>(bufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
-		}
+	vulkan_render_object::~vulkan_render_object()
+	{
 	}
 
 	void vulkan_render_object::create_descriptor_sets(std::shared_ptr<vulkan_resource_bundle_layout> resourceBundleLayout, std::shared_ptr<vulkan_resource_bundle_group> resourceBundleGroup, std::shared_ptr<vulkan_texture> texture, std::vector<std::shared_ptr<vulkan_texture>> debugTextures) {
 		
 		mResourceBundle = resourceBundleGroup->create_resource_bundle(resourceBundleLayout, true);
-		mResourceBundle->add_dynamic_buffer_resource(0, mUniformBuffers, sizeof(UniformBufferObject));
+		// all render objects share the frame allocator's buffer, the uniforms are selected with dynamic offsets
+		mResourceBundle->add_buffer_resource(0, vulkan_context::instance().frameAllocator->get_buffer(), sizeof(UniformBufferObject));
 		mResourceBundle->add_image_resource(1, vk::ImageLayout::eShaderReadOnlyOptimal, texture);
 
 		if (vulkan_context::instance().shadingRateImageSupported) {
@@ -55,7 +69,25 @@ namespace cgb {
 		mPushUniforms.proj = ubo.proj;
 		mPushUniforms.mvp = ubo.mvp;
 
-		mUniformBuffers[currentImage]->update_buffer(&ubo, sizeof(ubo));
+		mUniforms = ubo;
+		// written by get_uniform_offset(), so that objects which are culled or drawn without the frame allocator do not use it
+		mUniformFrameSerial = 0;
+	}
+
+	uint32_t vulkan_render_object::get_uniform_offset() {
+		// the uniforms of objects which have not been updated this frame are copied into this frame's region again
+		if (mUniformFrameSerial != vulkan_context::instance().frameAllocator->get_frame_serial()) {
+			write_uniforms();
+		}
+		return mUniformOffset;
+	}
+
+	void vulkan_render_object::write_uniforms() {
+		vulkan_frame_allocator& frameAllocator = *vulkan_context::instance().frameAllocator;
+		vulkan_frame_allocator::allocation uniforms = frameAllocator.allocate(sizeof(UniformBufferObject));
+		memcpy(uniforms.mapped, &mUniforms, sizeof(UniformBufferObject));
+		mUniformOffset = uniforms.offset;
+		mUniformFrameSerial = frameAllocator.get_frame_serial();
 	}
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <array>
 
 #include "vulkan_framebuffer.h"
+#include "vulkan_staging_ring.h"
 
 namespace cgb {
 
@@ -18,6 +19,9 @@ namespace cgb {
 
 	void vulkan_render_queue::submit(std::vector<vk::CommandBuffer> commandBuffers, vk::Fence inFlightFence, std::vector<vk::Semaphore> waitSemaphores, std::vector<vk::Semaphore> signalSemaphores)
 	{
+		// uploads which have been recorded since the last frame must be executed before they are used
+		vulkan_context::instance().stagingRing->flush_for(mGraphicsQueue);
+
 		vk::SubmitInfo submitInfo = {};
 
 		vk::PipelineStageFlags waitStages[] = { vk::PipelineStageFlagBits::eColorAttachmentOutput };
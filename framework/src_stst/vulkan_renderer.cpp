@@ -1,6 +1,8 @@
 #include "vulkan_renderer.h"
 
 #include "vulkan_framebuffer.h"
+#include "vulkan_frame_allocator.h"
+#include "vulkan_memory_manager.h"
 
 namespace cgb {
 
@@ -34,6 +36,11 @@ namespace cgb {
 		mCurrentImageAvailableSemaphores.push_back(mImageAvailableSemaphores[mCurrentFrame]);
 		mImagePresenter->fetch_next_swapchain_image(mCurrentInFlightFence, mImageAvailableSemaphores[mCurrentFrame]);
 
+		// the in flight fence has been waited for, so the frame's per frame data is not in use anymore
+		vulkan_context::instance().frameAllocator->begin_frame(mCurrentFrame);
+		// move a few buffers per frame out of sparsely used device memory blocks
+		vulkan_context::instance().memoryManager->defragment(4 * 1024 * 1024);
+
 		// reset all command buffers for this frame
 		mDrawCommandBufferManager->reset_command_buffers();
 
@@ -59,6 +66,12 @@ namespace cgb {
 		mSubmitted = false;
 	}
 
+	void vulkan_renderer::render(vulkan_render_graph& renderGraph)
+	{
+		renderGraph.execute(mPrimCmdBuffer);
+		mSubmitted = false;
+	}
+
 	void vulkan_renderer::end_frame()
 	{
 		submit_render();
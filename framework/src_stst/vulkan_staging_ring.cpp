@@ -0,0 +1,464 @@
+#include "vulkan_staging_ring.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "vulkan_memory_manager.h"
+
+namespace cgb {
+
+	namespace {
+		vk::CommandPool create_command_pool(uint32_t queueFamily) {
+			vk::CommandPoolCreateInfo poolInfo = {};
+			poolInfo.queueFamilyIndex = queueFamily;
+			poolInfo.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+			vk::CommandPool commandPool;
+			if (vulkan_context::instance().device.createCommandPool(&poolInfo, nullptr, &commandPool) != vk::Result::eSuccess) {
+				throw std::runtime_error("failed to create staging ring command pool!");
+			}
+			return commandPool;
+		}
+
+		vk::CommandBuffer allocate_command_buffer(vk::CommandPool commandPool) {
+			vk::CommandBufferAllocateInfo allocInfo = {};
+			allocInfo.level = vk::CommandBufferLevel::ePrimary;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			vk::CommandBuffer commandBuffer;
+			vulkan_context::instance().device.allocateCommandBuffers(&allocInfo, &commandBuffer);
+			return commandBuffer;
+		}
+	}
+
+	vulkan_staging_ring::vulkan_staging_ring(vk::DeviceSize size) : mRing(size)
+	{
+		vk::BufferCreateInfo bufferInfo = {};
+		bufferInfo.size = size;
+		bufferInfo.usage = vk::BufferUsageFlagBits::eTransferSrc;
+		bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+
+		if (vulkan_context::instance().device.createBuffer(&bufferInfo, nullptr, &mBuffer) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to create staging ring buffer!");
+		}
+
+		vk::MemoryRequirements memRequirements;
+		vulkan_context::instance().device.getBufferMemoryRequirements(mBuffer, &memRequirements);
+		vulkan_context::instance().memoryManager->allocate_memory(memRequirements, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, mMemory);
+		vulkan_context::instance().device.bindBufferMemory(mBuffer, mMemory.memory, mMemory.offset);
+
+		// the context picks a transfer-only queue family if there is one, and the graphics queue otherwise
+		mTransferQueueFamily = cgb::context().transfer_queue_index();
+		mTransferQueue = cgb::context().transfer_queue();
+		mGraphicsQueueFamily = vulkan_context::instance().findQueueFamilies().graphicsFamily.value();
+		mGraphicsQueue = vulkan_context::instance().graphicsQueue;
+
+		mTransferCommandPool = create_command_pool(mTransferQueueFamily);
+		if (has_dedicated_transfer_queue()) {
+			mGraphicsCommandPool = create_command_pool(mGraphicsQueueFamily);
+		}
+	}
+
+	vulkan_staging_ring::~vulkan_staging_ring()
+	{
+		wait_idle();
+
+		// command buffers are freed with the pools
+		for (batch& freeBatch : mFreeBatches) {
+			vulkan_context::instance().device.destroyFence(freeBatch.fence);
+			if (freeBatch.transferFinished) {
+				vulkan_context::instance().device.destroySemaphore(freeBatch.transferFinished);
+			}
+		}
+		vulkan_context::instance().device.destroyCommandPool(mTransferCommandPool);
+		if (mGraphicsCommandPool) {
+			vulkan_context::instance().device.destroyCommandPool(mGraphicsCommandPool);
+		}
+		vkDestroyBuffer(vulkan_context::instance().device, mBuffer, nullptr);
+		vulkan_context::instance().memoryManager->free_memory(mMemory);
+	}
+
+	vulkan_staging_ring::upload_ticket vulkan_staging_ring::upload_to_buffer(vk::Buffer dstBuffer, vk::DeviceSize dstOffset, const void* data, vk::DeviceSize size, bool newBuffer)
+	{
+		// a buffer which the graphics queue might use is updated on the graphics queue, since the transfer queue could only
+		// acquire it after a release on the graphics queue and would have to wait for the reads of the frames in flight
+		const bool onTransferQueue = newBuffer && has_dedicated_transfer_queue();
+		vk::CommandBuffer commandBuffer = onTransferQueue ? current_batch().transferCommandBuffer : current_batch().graphicsCommandBuffer;
+		if (!newBuffer) {
+			// the copy must not overwrite the buffer before the work submitted so far has read or written it
+			vk::MemoryBarrier barrier = {};
+			barrier.srcAccessMask = vk::AccessFlagBits::eMemoryWrite;
+			barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {},
+				1, &barrier,
+				0, nullptr,
+				0, nullptr);
+		}
+
+		// larger uploads are split, so that they do not have to fit into the ring at once
+		const char* src = static_cast<const char*>(data);
+		vk::DeviceSize uploaded = 0;
+		while (uploaded < size) {
+			vk::DeviceSize chunkSize = std::min(size - uploaded, mRing.size());
+			vk::DeviceSize offset = allocate(chunkSize, 16);
+			memcpy(static_cast<char*>(mMemory.mapped) + offset, src + uploaded, static_cast<size_t>(chunkSize));
+
+			// a full ring submits the batch, which begins a new one
+			commandBuffer = onTransferQueue ? current_batch().transferCommandBuffer : current_batch().graphicsCommandBuffer;
+			vk::BufferCopy copyRegion = {};
+			copyRegion.srcOffset = offset;
+			copyRegion.dstOffset = dstOffset + uploaded;
+			copyRegion.size = chunkSize;
+			commandBuffer.copyBuffer(mBuffer, dstBuffer, 1, &copyRegion);
+
+			uploaded += chunkSize;
+		}
+
+		if (onTransferQueue) {
+			// release on the transfer queue, acquire on the graphics queue; both barriers must describe the same range
+			vk::BufferMemoryBarrier barrier = {};
+			barrier.srcQueueFamilyIndex = mTransferQueueFamily;
+			barrier.dstQueueFamilyIndex = mGraphicsQueueFamily;
+			barrier.buffer = dstBuffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+
+			barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+			barrier.dstAccessMask = {};
+			current_batch().transferCommandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {},
+				0, nullptr,
+				1, &barrier,
+				0, nullptr);
+
+			barrier.srcAccessMask = {};
+			barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+			current_batch().graphicsCommandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {},
+				0, nullptr,
+				1, &barrier,
+				0, nullptr);
+		}
+
+		return current_batch().ticket;
+	}
+
+	vulkan_staging_ring::upload_ticket vulkan_staging_ring::upload_to_image(vk::Image dstImage, const void* pixels, uint32_t width, uint32_t height, uint32_t bytesPerPixel, uint32_t mipLevels)
+	{
+		// buffer offsets of image copies must be multiples of 4 and of the texel size
+		assert(0 == (bytesPerPixel & (bytesPerPixel - 1)));
+		vk::DeviceSize alignment = std::max<vk::DeviceSize>(16, bytesPerPixel);
+
+		vk::DeviceSize rowSize = static_cast<vk::DeviceSize>(width) * bytesPerPixel;
+		if (rowSize > mRing.size()) {
+			throw std::runtime_error("a row of the image does not fit into the staging ring!");
+		}
+		uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<vk::DeviceSize>(height, mRing.size() / rowSize));
+
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.image = dstImage;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		const char* src = static_cast<const char*>(pixels);
+		for (uint32_t row = 0; row < height; row += rowsPerChunk) {
+			uint32_t chunkRows = std::min(rowsPerChunk, height - row);
+			vk::DeviceSize chunkSize = rowSize * chunkRows;
+			vk::DeviceSize offset = allocate(chunkSize, alignment);
+			memcpy(static_cast<char*>(mMemory.mapped) + offset, src + rowSize * row, static_cast<size_t>(chunkSize));
+
+			vk::CommandBuffer commandBuffer = current_batch().transferCommandBuffer;
+			if (0 == row) {
+				// the transfer queue acquires the image implicitly, since its contents are discarded
+				barrier.oldLayout = vk::ImageLayout::eUndefined;
+				barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.srcAccessMask = {};
+				barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+				commandBuffer.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+					0, nullptr,
+					0, nullptr,
+					1, &barrier);
+			}
+
+			vk::BufferImageCopy region = {};
+			region.bufferOffset = offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+
+			region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+			region.imageSubresource.mipLevel = 0;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = vk::Offset3D{ 0, static_cast<int32_t>(row), 0 };
+			region.imageExtent = vk::Extent3D{ width, chunkRows, 1 };
+
+			commandBuffer.copyBufferToImage(mBuffer, dstImage, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+		}
+
+		hand_over_image(barrier);
+		return current_batch().ticket;
+	}
+
+	vulkan_staging_ring::upload_ticket vulkan_staging_ring::upload_to_image_levels(vk::Image dstImage, const void* data, vk::DeviceSize size, const std::vector<vk::BufferImageCopy>& regions, uint32_t mipLevels)
+	{
+		if (size > mRing.size()) {
+			throw std::runtime_error("image does not fit into the staging ring!");
+		}
+		// 16 is a multiple of 4 and of the texel block sizes of all color formats
+		vk::DeviceSize offset = allocate(size, 16);
+		memcpy(static_cast<char*>(mMemory.mapped) + offset, data, static_cast<size_t>(size));
+
+		vk::ImageMemoryBarrier barrier = {};
+		barrier.image = dstImage;
+		barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+
+		// the transfer queue acquires the image implicitly, since its contents are discarded
+		vk::CommandBuffer commandBuffer = current_batch().transferCommandBuffer;
+		barrier.oldLayout = vk::ImageLayout::eUndefined;
+		barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.srcAccessMask = {};
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		std::vector<vk::BufferImageCopy> ringRegions = regions;
+		for (vk::BufferImageCopy& region : ringRegions) {
+			region.bufferOffset += offset;
+		}
+		commandBuffer.copyBufferToImage(mBuffer, dstImage, vk::ImageLayout::eTransferDstOptimal, static_cast<uint32_t>(ringRegions.size()), ringRegions.data());
+
+		hand_over_image(barrier);
+		return current_batch().ticket;
+	}
+
+	void vulkan_staging_ring::hand_over_image(vk::ImageMemoryBarrier& barrier)
+	{
+		if (!has_dedicated_transfer_queue()) {
+			return;
+		}
+
+		// release on the transfer queue, acquire on the graphics queue, keeping the layout
+		barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+		barrier.srcQueueFamilyIndex = mTransferQueueFamily;
+		barrier.dstQueueFamilyIndex = mGraphicsQueueFamily;
+
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = {};
+		current_batch().transferCommandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {},
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		barrier.srcAccessMask = {};
+		barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+		current_batch().graphicsCommandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {},
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+	}
+
+	vk::CommandBuffer vulkan_staging_ring::get_graphics_command_buffer()
+	{
+		return current_batch().graphicsCommandBuffer;
+	}
+
+	vulkan_staging_ring::upload_ticket vulkan_staging_ring::get_current_ticket()
+	{
+		return current_batch().ticket;
+	}
+
+	vulkan_staging_ring::batch& vulkan_staging_ring::current_batch()
+	{
+		if (0 != mCurrentBatch.ticket) {
+			return mCurrentBatch;
+		}
+
+		retire_completed_batches();
+		if (!mFreeBatches.empty()) {
+			mCurrentBatch = mFreeBatches.back();
+			mFreeBatches.pop_back();
+		}
+		else {
+			mCurrentBatch.transferCommandBuffer = allocate_command_buffer(mTransferCommandPool);
+			mCurrentBatch.graphicsCommandBuffer = mCurrentBatch.transferCommandBuffer;
+			if (has_dedicated_transfer_queue()) {
+				mCurrentBatch.graphicsCommandBuffer = allocate_command_buffer(mGraphicsCommandPool);
+
+				vk::SemaphoreCreateInfo semaphoreInfo = {};
+				if (vulkan_context::instance().device.createSemaphore(&semaphoreInfo, nullptr, &mCurrentBatch.transferFinished) != vk::Result::eSuccess) {
+					throw std::runtime_error("failed to create staging ring semaphore!");
+				}
+			}
+
+			vk::FenceCreateInfo fenceInfo = {};
+			if (vulkan_context::instance().device.createFence(&fenceInfo, nullptr, &mCurrentBatch.fence) != vk::Result::eSuccess) {
+				throw std::runtime_error("failed to create staging ring fence!");
+			}
+		}
+		mCurrentBatch.ticket = mNextTicket++;
+
+		vk::CommandBufferBeginInfo beginInfo = {};
+		beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+		mCurrentBatch.transferCommandBuffer.begin(&beginInfo);
+		if (has_dedicated_transfer_queue()) {
+			mCurrentBatch.graphicsCommandBuffer.begin(&beginInfo);
+		}
+
+		return mCurrentBatch;
+	}
+
+	void vulkan_staging_ring::flush()
+	{
+		if (0 == mCurrentBatch.ticket) {
+			return;
+		}
+
+		// make the uploads visible to everything which is submitted to the graphics queue afterwards;
+		// with a dedicated transfer queue, the acquire barriers have done so for the copies on the transfer queue already
+		vk::MemoryBarrier barrier = {};
+		barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+		barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite;
+		mCurrentBatch.graphicsCommandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {},
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+
+		vk::SubmitInfo submitInfo = {};
+		submitInfo.commandBufferCount = 1;
+		if (has_dedicated_transfer_queue()) {
+			mCurrentBatch.transferCommandBuffer.end();
+			submitInfo.pCommandBuffers = &mCurrentBatch.transferCommandBuffer;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &mCurrentBatch.transferFinished;
+			if (mTransferQueue.submit(1, &submitInfo, nullptr) != vk::Result::eSuccess) {
+				throw std::runtime_error("failed to submit staging ring uploads!");
+			}
+
+			vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+			submitInfo = vk::SubmitInfo();
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &mCurrentBatch.transferFinished;
+			submitInfo.pWaitDstStageMask = &waitStage;
+			submitInfo.commandBufferCount = 1;
+		}
+		mCurrentBatch.graphicsCommandBuffer.end();
+		submitInfo.pCommandBuffers = &mCurrentBatch.graphicsCommandBuffer;
+		if (mGraphicsQueue.submit(1, &submitInfo, mCurrentBatch.fence) != vk::Result::eSuccess) {
+			throw std::runtime_error("failed to submit staging ring uploads!");
+		}
+
+		mCurrentBatch.hasRingRanges = mRing.has_open_batch();
+		mRing.close_batch();
+		mSubmittedBatches.push_back(mCurrentBatch);
+		mCurrentBatch = batch();
+	}
+
+	void vulkan_staging_ring::wait_idle()
+	{
+		flush();
+		while (!mSubmittedBatches.empty()) {
+			retire_oldest_batch();
+		}
+	}
+
+	void vulkan_staging_ring::flush_for(vk::Queue queue)
+	{
+		if (queue == mGraphicsQueue) {
+			flush();
+		}
+		else {
+			wait_idle();
+		}
+	}
+
+	bool vulkan_staging_ring::is_complete(upload_ticket ticket)
+	{
+		retire_completed_batches();
+		upload_ticket oldestPending = mNextTicket;
+		if (!mSubmittedBatches.empty()) {
+			oldestPending = mSubmittedBatches.front().ticket;
+		}
+		else if (0 != mCurrentBatch.ticket) {
+			oldestPending = mCurrentBatch.ticket;
+		}
+		return ticket < oldestPending;
+	}
+
+	void vulkan_staging_ring::wait(upload_ticket ticket)
+	{
+		if (0 != mCurrentBatch.ticket && ticket >= mCurrentBatch.ticket) {
+			flush();
+		}
+		while (!mSubmittedBatches.empty() && mSubmittedBatches.front().ticket <= ticket) {
+			retire_oldest_batch();
+		}
+	}
+
+	vk::DeviceSize vulkan_staging_ring::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+	{
+		retire_completed_batches();
+		std::optional<uint64_t> offset = mRing.allocate(size, alignment);
+		if (!offset && mRing.has_open_batch()) {
+			// the ring is full of this batch's uploads, submit them to be able to reuse their part later
+			flush();
+		}
+		while (!offset && !mSubmittedBatches.empty()) {
+			retire_oldest_batch();
+			offset = mRing.allocate(size, alignment);
+		}
+		if (!offset) {
+			throw std::runtime_error("upload does not fit into the staging ring!");
+		}
+		return offset.value();
+	}
+
+	void vulkan_staging_ring::retire_completed_batches()
+	{
+		while (!mSubmittedBatches.empty() && vulkan_context::instance().device.getFenceStatus(mSubmittedBatches.front().fence) == vk::Result::eSuccess) {
+			retire_oldest_batch();
+		}
+	}
+
+	void vulkan_staging_ring::retire_oldest_batch()
+	{
+		batch oldest = mSubmittedBatches.front();
+		mSubmittedBatches.pop_front();
+
+		// the graphics submission waits for the transfer submission, so its fence covers both
+		vulkan_context::instance().device.waitForFences(1, &oldest.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+		vulkan_context::instance().device.resetFences(1, &oldest.fence);
+		oldest.transferCommandBuffer.reset({});
+		if (has_dedicated_transfer_queue()) {
+			oldest.graphicsCommandBuffer.reset({});
+		}
+		if (oldest.hasRingRanges) {
+			mRing.retire_oldest_batch();
+		}
+		oldest.ticket = 0;
+		oldest.hasRingRanges = false;
+		mFreeBatches.push_back(oldest);
+	}
+
+}
@@ -0,0 +1,86 @@
+// culling_benchmark.cpp : Compares the batched frustum culling against testing one volume at a time
+//
+#include "cg_base.h"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+	const size_t kVolumeCount = 1000000;
+	const int kRuns = 20;
+
+	// Runs pFunc kRuns times and returns the average duration in milliseconds
+	template <typename F>
+	double average_milliseconds(F pFunc)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (int run = 0; run < kRuns; ++run) {
+			pFunc();
+		}
+		const std::chrono::duration<double, std::milli> duration = std::chrono::high_resolution_clock::now() - start;
+		return duration.count() / kRuns;
+	}
+
+	// Indices which are only in one of the two sorted lists
+	size_t count_differences(const std::vector<uint32_t>& pA, const std::vector<uint32_t>& pB)
+	{
+		std::vector<uint32_t> difference;
+		std::set_symmetric_difference(pA.begin(), pA.end(), pB.begin(), pB.end(), std::back_inserter(difference));
+		return difference.size();
+	}
+}
+
+int main()
+{
+	using namespace cgb;
+
+	// a scene of 1km x 100m x 1km with the camera in its center, looking along -z
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> horizontal(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> vertical(0.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 4.0f);
+	std::vector<aabb> boxes(kVolumeCount);
+	std::vector<bounding_sphere> spheres(kVolumeCount);
+	for (size_t i = 0; i < kVolumeCount; ++i) {
+		const glm::vec3 center{ horizontal(rng), vertical(rng), horizontal(rng) };
+		const glm::vec3 halfExtent{ size(rng), size(rng), size(rng) };
+		boxes[i].mMin = center - halfExtent;
+		boxes[i].mMax = center + halfExtent;
+		spheres[i].mCenter = center;
+		spheres[i].mRadius = glm::length(halfExtent);
+	}
+
+	const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+	const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 50.0f, 0.0f), glm::vec3(0.0f, 50.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const frustum viewFrustum = frustum::from_matrix(projection * view);
+
+	std::vector<uint32_t> singleVisible;
+	std::vector<uint32_t> batchedVisible;
+	singleVisible.reserve(kVolumeCount);
+	batchedVisible.reserve(kVolumeCount);
+
+	const double singleBoxes = average_milliseconds([&]() {
+		singleVisible.clear();
+		for (size_t i = 0; i < boxes.size(); ++i) {
+			if (viewFrustum.intersects_aabb(boxes[i])) {
+				singleVisible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	});
+	const double batchedBoxes = average_milliseconds([&]() { cull_aabbs(boxes, viewFrustum, batchedVisible); });
+	LOG_INFO(fmt::format("{} boxes, {} visible: {:.3f} ms one at a time, {:.3f} ms batched ({:.1f}x), {} differences",
+		kVolumeCount, batchedVisible.size(), singleBoxes, batchedBoxes, singleBoxes / batchedBoxes, count_differences(singleVisible, batchedVisible)));
+
+	const double singleSpheres = average_milliseconds([&]() {
+		singleVisible.clear();
+		for (size_t i = 0; i < spheres.size(); ++i) {
+			if (viewFrustum.intersects_sphere(spheres[i])) {
+				singleVisible.push_back(static_cast<uint32_t>(i));
+			}
+		}
+	});
+	const double batchedSpheres = average_milliseconds([&]() { cull_spheres(spheres, viewFrustum, batchedVisible); });
+	LOG_INFO(fmt::format("{} spheres, {} visible: {:.3f} ms one at a time, {:.3f} ms batched ({:.1f}x), {} differences",
+		kVolumeCount, batchedVisible.size(), singleSpheres, batchedSpheres, singleSpheres / batchedSpheres, count_differences(singleVisible, batchedVisible)));
+}
@@ -0,0 +1,347 @@
+// device_memory_allocator.cpp : Tests the device memory allocator against a mock device
+//
+#include "cg_base.h"
+
+#include <deque>
+#include <random>
+
+namespace
+{
+	using namespace cgb;
+
+	void check(bool pCondition, const std::string& pWhat)
+	{
+		if (!pCondition) {
+			throw std::runtime_error(pWhat);
+		}
+	}
+
+	/**	A device which keeps its memory in host vectors, so that mapped pointers can be written and read. Every heap
+	 *	has a fixed capacity, beyond which allocations fail like on a real device, and optionally reports a budget.
+	 */
+	class mock_device_backend : public device_memory_backend
+	{
+	public:
+		mock_device_backend(std::vector<uint32_t> pHeapOfType, std::vector<uint64_t> pHeapCapacities)
+			: mHeapOfType(std::move(pHeapOfType)), mCapacities(std::move(pHeapCapacities)), mUsage(mCapacities.size(), 0)
+		{ }
+
+		device_memory_handle allocate(uint32_t pMemoryTypeIndex, uint64_t pSize) override
+		{
+			const uint32_t heap = mHeapOfType.at(pMemoryTypeIndex);
+			if (mUsage[heap] + pSize > mCapacities[heap]) {
+				return 0;
+			}
+			mUsage[heap] += pSize;
+			++mAllocationCount;
+			auto& memory = mMemory[mNextHandle];
+			memory.mHeap = heap;
+			memory.mBytes.resize(pSize);
+			return mNextHandle++;
+		}
+
+		void free(device_memory_handle pMemory) override
+		{
+			auto it = mMemory.find(pMemory);
+			check(it != mMemory.end(), "freed device memory which has not been allocated");
+			mUsage[it->second.mHeap] -= it->second.mBytes.size();
+			mMemory.erase(it);
+		}
+
+		void* map(device_memory_handle pMemory) override
+		{
+			return mMemory.at(pMemory).mBytes.data();
+		}
+
+		bool query_budgets(std::vector<device_memory_budget>& outBudgets) override
+		{
+			if (mReportedBudgets.empty()) {
+				return false;
+			}
+			for (size_t h = 0; h < outBudgets.size(); ++h) {
+				outBudgets[h].mBudget = mReportedBudgets[h];
+				outBudgets[h].mUsage = mUsage[h];
+			}
+			return true;
+		}
+
+		size_t live_memory_count() const { return mMemory.size(); }
+		uint64_t memory_size(device_memory_handle pMemory) const { return mMemory.at(pMemory).mBytes.size(); }
+		uint64_t heap_usage(uint32_t pHeap) const { return mUsage[pHeap]; }
+		/** Device memory allocations which have been made so far */
+		size_t allocation_count() const { return mAllocationCount; }
+
+		/** Budgets which query_budgets reports, one per heap; none are reported if empty */
+		std::vector<uint64_t> mReportedBudgets;
+
+	private:
+		struct memory
+		{
+			uint32_t mHeap = 0;
+			std::vector<uint8_t> mBytes;
+		};
+
+		std::vector<uint32_t> mHeapOfType;
+		std::vector<uint64_t> mCapacities;
+		std::vector<uint64_t> mUsage;
+		std::map<device_memory_handle, memory> mMemory;
+		device_memory_handle mNextHandle = 1;
+		size_t mAllocationCount = 0;
+	};
+
+	// memory type 0 is host visible, type 1 is device local; both live on heaps of their own
+	const std::vector<uint32_t> kHeapOfType = { 0, 1 };
+	const uint64_t kHeapSize = 256ull << 20;
+
+	std::vector<device_memory_type> mock_memory_types()
+	{
+		return { device_memory_type{ true, kHeapSize, 0 }, device_memory_type{ false, kHeapSize, 1 } };
+	}
+
+	device_memory_allocator_settings mock_settings()
+	{
+		device_memory_allocator_settings settings;
+		settings.mBlockSize = 1ull << 20;
+		settings.mTransientBlockSize = 1ull << 20;
+		settings.mDedicatedThreshold = 512ull << 10;
+		settings.mBufferImageGranularity = 1024;
+		return settings;
+	}
+
+	/** Checks that no two live allocations overlap or share a granularity page while being of different kinds */
+	void check_layout(const mock_device_backend& pDevice, const std::vector<std::pair<device_allocation, device_resource_kind>>& pLive, uint64_t pGranularity)
+	{
+		std::map<device_memory_handle, std::vector<std::pair<device_allocation, device_resource_kind>>> perMemory;
+		for (const auto& entry : pLive) {
+			perMemory[entry.first.mMemory].push_back(entry);
+		}
+		for (auto& [memory, allocations] : perMemory) {
+			std::sort(allocations.begin(), allocations.end(), [](const auto& a, const auto& b) { return a.first.mOffset < b.first.mOffset; });
+			for (size_t i = 1; i < allocations.size(); ++i) {
+				const auto& [previous, previousKind] = allocations[i - 1];
+				const auto& [current, currentKind] = allocations[i];
+				check(previous.mOffset + previous.mSize <= current.mOffset, "allocations overlap");
+				check(previousKind == currentKind || (previous.mOffset + previous.mSize - 1) / pGranularity != current.mOffset / pGranularity,
+					"linear and optimal allocations share a page of the buffer-image granularity");
+			}
+			const auto& last = allocations.back().first;
+			check(last.mOffset + last.mSize <= pDevice.memory_size(memory), "allocation exceeds its device memory");
+		}
+	}
+
+	void test_general_allocations()
+	{
+		mock_device_backend device(kHeapOfType, { kHeapSize, kHeapSize });
+		const auto settings = mock_settings();
+		{
+			device_memory_allocator allocator(device, mock_memory_types(), settings);
+			std::mt19937 rng(3);
+			std::vector<std::pair<device_allocation, device_resource_kind>> live;
+			size_t allocationCount = 0;
+			for (int i = 0; i < 100000; ++i) {
+				if (live.empty() || 0 == rng() % 2) {
+					// mostly small allocations, some of which exceed the dedicated threshold
+					const uint64_t size = 0 == rng() % 8 ? rng() % 700000 : rng() % 5000 + 1;
+					const uint64_t alignment = 1ull << (rng() % 9);
+					const auto kind = 0 == rng() % 2 ? device_resource_kind::linear : device_resource_kind::optimal;
+					const uint32_t type = rng() % 2;
+					const auto allocation = allocator.allocate(type, size, alignment, kind);
+					check(0 == allocation.mOffset % alignment, "allocation is not aligned");
+					check(0 == type
+						? allocation.mMapped == static_cast<uint8_t*>(device.map(allocation.mMemory)) + allocation.mOffset
+						: nullptr == allocation.mMapped, "wrong mapped pointer");
+					live.emplace_back(allocation, kind);
+					++allocationCount;
+				}
+				else {
+					const size_t index = rng() % live.size();
+					allocator.free(live[index].first);
+					check(!live[index].first.valid(), "free has not reset the allocation");
+					live[index] = live.back();
+					live.pop_back();
+				}
+				if (0 == i % 5000) {
+					check_layout(device, live, settings.mBufferImageGranularity);
+				}
+			}
+			check_layout(device, live, settings.mBufferImageGranularity);
+
+			const auto statistics = allocator.statistics();
+			uint64_t usedBytes = 0;
+			for (const auto& entry : live) {
+				usedBytes += entry.first.mSize;
+			}
+			check(statistics.mAllocationCount == live.size(), "wrong allocation count");
+			check(statistics.mUsedBytes == usedBytes, "wrong used bytes");
+			check(statistics.mDeviceMemoryCount == device.live_memory_count(), "wrong device memory count");
+			check(device.allocation_count() < allocationCount / 10, "too few allocations share device memory");
+			LOG_INFO(fmt::format("{} allocations have needed {} device memory allocations", allocationCount, device.allocation_count()));
+
+			for (auto& entry : live) {
+				allocator.free(entry.first);
+			}
+			allocator.release_empty_blocks();
+			check(0 == device.live_memory_count(), "device memory has been leaked");
+
+			// transient allocations are reset at once and reuse their blocks every frame
+			size_t transientBlocks = 0;
+			for (int frame = 0; frame < 3; ++frame) {
+				for (int i = 0; i < 1000; ++i) {
+					const auto allocation = allocator.allocate(0, 3000, 256, device_resource_kind::linear, device_allocation_lifetime::transient);
+					check(0 == allocation.mOffset % 256, "transient allocation is not aligned");
+				}
+				const size_t blocks = allocator.statistics().mBlockCount;
+				check(0 == frame || blocks == transientBlocks, "transient blocks are not reused");
+				transientBlocks = blocks;
+				allocator.reset_transient();
+			}
+		}
+		check(0 == device.live_memory_count(), "the allocator has not freed its blocks");
+	}
+
+	void test_budget_and_eviction()
+	{
+		// heap 0 reports a budget of 4 MiB, but the device would provide 8 MiB
+		mock_device_backend device(kHeapOfType, { 8ull << 20, kHeapSize });
+		device.mReportedBudgets = { 4ull << 20, kHeapSize };
+		device_memory_allocator allocator(device, mock_memory_types(), mock_settings());
+
+		// a cache of streamed resources, which frees its oldest entries when the allocator asks for memory
+		// the entries are above the dedicated threshold, so that evicting one returns its memory to the device
+		const uint64_t entrySize = 1ull << 20;
+		std::deque<device_allocation> cache;
+		std::vector<std::pair<uint32_t, uint64_t>> evictionRequests;
+		const size_t callbackId = allocator.add_eviction_callback([&](uint32_t pHeapIndex, uint64_t pBytes) {
+			evictionRequests.emplace_back(pHeapIndex, pBytes);
+			uint64_t freed = 0;
+			while (freed < pBytes && !cache.empty()) {
+				freed += cache.front().mSize;
+				allocator.free(cache.front());
+				cache.pop_front();
+			}
+			return freed;
+		});
+
+		// streaming twice as much as fits into the budget makes the cache evict, but never exceeds the budget
+		for (int i = 0; i < 8; ++i) {
+			cache.push_back(allocator.allocate(0, entrySize, 256));
+			check(device.heap_usage(0) <= (4ull << 20), "the budget has been exceeded although the cache could evict");
+		}
+		check(allocator.budgets()[0].mReportedByDevice, "the reported budget is not used");
+		check(!evictionRequests.empty(), "the cache has not been asked to evict");
+		for (const auto& [heapIndex, bytes] : evictionRequests) {
+			check(0 == heapIndex && bytes > 0, "wrong eviction request");
+		}
+		LOG_INFO(fmt::format("{} of 8 streamed resources are cached after {} eviction requests", cache.size(), evictionRequests.size()));
+
+		// without anything to evict, the allocator exceeds the budget before failing
+		allocator.remove_eviction_callback(callbackId);
+		std::vector<device_allocation> overBudget;
+		overBudget.push_back(allocator.allocate(0, 2ull << 20, 256));
+		check(device.heap_usage(0) > (4ull << 20), "the allocator has not exceeded the budget");
+
+		// and only fails once the device is out of memory
+		bool threw = false;
+		try {
+			overBudget.push_back(allocator.allocate(0, 16ull << 20, 256));
+		}
+		catch (const std::runtime_error&) {
+			threw = true;
+		}
+		check(threw, "allocating more than the device provides has not thrown");
+
+		// without a reported budget, the budget is estimated from the heap size
+		device.mReportedBudgets.clear();
+		const auto estimated = allocator.budgets()[1];
+		check(!estimated.mReportedByDevice && estimated.mBudget == static_cast<uint64_t>(kHeapSize * mock_settings().mBudgetFraction), "wrong estimated budget");
+
+		for (auto& allocation : overBudget) {
+			allocator.free(allocation);
+		}
+		for (auto& allocation : cache) {
+			allocator.free(allocation);
+		}
+	}
+
+	void test_defragmentation()
+	{
+		mock_device_backend device(kHeapOfType, { kHeapSize, kHeapSize });
+		device_memory_allocator allocator(device, mock_memory_types(), mock_settings());
+
+		// three blocks of 16 allocations each, with the index of every allocation written into it
+		// the size leaves room for the worst-case alignment padding which the allocator reserves in the last range of a block
+		const uint64_t size = 63ull << 10;
+		std::vector<device_allocation> allocations;
+		std::vector<uint32_t> owners(48);
+		for (uint32_t i = 0; i < 48; ++i) {
+			allocations.push_back(allocator.allocate(0, size, 256));
+			owners[i] = i;
+			std::memset(allocations[i].mMapped, static_cast<int>(i), size);
+		}
+		check(3 == allocator.statistics(0).mBlockCount, "unexpected block count");
+		const size_t deviceMemoryCount = device.live_memory_count();
+
+		// the first block keeps four allocations, the others get room for them in pairs of neighboring ranges
+		const device_memory_handle sparse = allocations[0].mMemory;
+		for (uint32_t i = 0; i < 48; ++i) {
+			if (allocations[i].mMemory == sparse ? i >= 4 : i % 4 >= 2) {
+				allocator.free(allocations[i]);
+			}
+		}
+
+		// only the allocations of the sparse block are movable, and nothing moves as long as one of them is not
+		for (uint32_t i = 0; i < 4; ++i) {
+			if (i != 1) {
+				allocator.set_owner(allocations[i], &owners[i], 256);
+			}
+		}
+		auto moves = allocator.plan_defragmentation(std::numeric_limits<uint64_t>::max());
+		check(moves.empty(), "an allocation which is not movable has been planned to move");
+		allocator.set_owner(allocations[1], &owners[1], 256);
+
+		// the move budget limits the plan
+		moves = allocator.plan_defragmentation(std::numeric_limits<uint64_t>::max(), 2);
+		check(2 == moves.size(), "the move limit has not been respected");
+		for (auto& move : moves) {
+			allocator.free(move.mDestination);
+			allocator.set_owner(move.mSource, move.mOwner, move.mAlignment);
+		}
+
+		moves = allocator.plan_defragmentation(std::numeric_limits<uint64_t>::max());
+		check(4 == moves.size(), "the sparse block has not been emptied");
+		check(device.live_memory_count() == deviceMemoryCount, "defragmentation has allocated device memory");
+		for (auto& move : moves) {
+			check(move.mSource.mMemory == sparse && move.mDestination.mMemory != sparse, "wrong move");
+			check(0 == move.mDestination.mOffset % move.mAlignment, "destination is not aligned");
+			// the owner copies its resource and takes the destination
+			std::memcpy(move.mDestination.mMapped, move.mSource.mMapped, move.mSource.mSize);
+			const uint32_t index = *static_cast<uint32_t*>(move.mOwner);
+			allocations[index] = move.mDestination;
+		}
+		allocator.finish_defragmentation(moves);
+		allocator.release_empty_blocks();
+		check(device.live_memory_count() == deviceMemoryCount - 1, "the emptied block has not been released");
+
+		for (uint32_t i = 0; i < 48; ++i) {
+			if (allocations[i].valid()) {
+				check(static_cast<uint8_t*>(allocations[i].mMapped)[size - 1] == i, "contents have been lost");
+				allocator.free(allocations[i]);
+			}
+		}
+	}
+}
+
+int main()
+{
+	try {
+		test_general_allocations();
+		test_budget_and_eviction();
+		test_defragmentation();
+		LOG_INFO("All device memory allocator tests have passed");
+		return 0;
+	}
+	catch (const std::exception& e) {
+		LOG_ERROR(fmt::format("Device memory allocator test failed: {}", e.what()));
+		return 1;
+	}
+}